@@ -0,0 +1,134 @@
+// --- Sensor Acquisition ---
+// Finds the SHT31s fitted at the SENSOR_CHANNELS positions (see hal.h) and
+// measures them together: one pass starts a single-shot conversion on every
+// sensor back to back, waits one conversion time and then collects each
+// result, so N sensors cost one 15 ms wait plus N short transfers rather
+// than N waits. Each reading is stamped with its channel and served to
+// every consumer (manual reads, the automatic check, email reports) for as
+// long as it is fresh enough. A report built from one Sample never mixes
+// values from different conversions.
+//
+// In periodic mode (AcquisitionSettings::mps > 0) the sensors convert on
+// their own and poll(), called from loop(), fetches each one about once a
+// period, with no conversion wait at all. A read then serves the latest
+// fetched reading: the sensor has nothing newer.
+//
+// Every reading goes through the channel's median and EMA filters (see
+// sample_filter.h) before it is cached, so consumers only ever see
+// filtered values. With a heater threshold set, a sensor whose filtered
+// humidity reaches it (condensation) has its heater switched on for
+// SENSOR_HEATER_ON_MS, at most once per SENSOR_HEATER_INTERVAL_MS; its
+// readings are held at the last one before heating until
+// SENSOR_HEATER_SETTLE_MS after the heater is off, and its filters start
+// afresh.
+#pragma once
+
+#include "hal.h"
+#include "histogram.h"
+#include "sample_filter.h"
+
+#include <stdint.h>
+
+// Readings younger than this are reused instead of hitting the I2C bus.
+#define SAMPLE_MAX_AGE_MS 2000
+#define SENSOR_HEATER_ON_MS 30000UL
+#define SENSOR_HEATER_SETTLE_MS 120000UL
+#define SENSOR_HEATER_INTERVAL_MS 3600000UL
+
+struct AcquisitionSettings
+{
+    uint8_t mps; // Periodic measurements per second (1, 2, 4, 10); 0 = single shots
+    SensorRepeatability repeatability;
+    FilterSettings filter;
+    uint8_t heaterRH; // Heat a sensor reading at least this % RH; 0 = never
+};
+
+struct Sample
+{
+    float temperatureC;
+    float humidity;
+    int16_t centiC;  // The same reading in hundredths, for formatting
+    uint16_t centiRH;
+    uint8_t channel; // Sensor position, see hal.h
+    uint32_t takenAtMs; // hal::clock().millis() at the end of the measurement
+};
+
+struct AcquisitionStats
+{
+    uint32_t hits;     // Served from the cache
+    uint32_t misses;   // Needed a new measurement pass
+    uint32_t failures; // Readings a sensor could not deliver
+    uint32_t channelFailures[SENSOR_CHANNELS];
+    uint32_t lastI2cUs; // Whole passes, every sensor and the wait included
+    uint32_t maxI2cUs;
+    uint64_t totalI2cUs;
+    Histogram i2cUs; // Every pass, failed ones included
+    uint32_t heaterCycles;
+};
+
+class SensorAcquisition
+{
+public:
+    // Probes the positions without a sensor yet. Returns how many sensors
+    // answered for the first time.
+    int discover();
+    bool present(uint8_t channel) const { return fitted & (1u << channel); }
+    int count() const { return __builtin_popcount(fitted); }
+
+    // Applies the acquisition mode to every fitted sensor (and to those
+    // found later) and restarts the filters.
+    void configure(const AcquisitionSettings &settings);
+    const AcquisitionSettings &settings() const { return current; }
+    // Periodic mode: fetches every sensor when a period has passed. Also
+    // runs the heater cycles. Call from loop().
+    void poll();
+    bool heating(uint8_t channel) const { return heaterPhase[channel] != HEATER_OFF; }
+
+    // Fills 'sample' with a reading of 'channel' no older than maxAgeMs,
+    // measuring every sensor if needed. Returns false if it could not be read.
+    bool read(uint8_t channel, Sample &sample, uint32_t maxAgeMs = SAMPLE_MAX_AGE_MS);
+    // Always takes a new measurement pass (a fetch, in periodic mode).
+    // Returns how many sensors were read.
+    int measure();
+    // The last good reading of 'channel', however old, without touching the
+    // bus. Returns false if there has not been one.
+    bool latest(uint8_t channel, Sample &sample) const
+    {
+        sample = last[channel];
+        return measured & (1u << channel);
+    }
+    // Drops the cached readings so the next read() measures.
+    void invalidate() { cached = 0; }
+    const AcquisitionStats &stats() const { return counters; }
+
+private:
+    enum HeaterPhase : uint8_t
+    {
+        HEATER_OFF,
+        HEATER_ON,
+        HEATER_SETTLING,
+    };
+
+    bool startMode(uint8_t channel);
+    void store(uint8_t channel, uint16_t temperatureTicks, uint16_t humidityTicks);
+    void runHeater(uint8_t channel, uint32_t nowMs);
+    uint32_t fetchIntervalMs() const { return 1125 / current.mps; } // A period and 1/8 for the sensor's clock
+
+    AcquisitionSettings current = {0, SENSOR_REPEAT_HIGH, {1, 100}, 0};
+    TickFilter temperatureFilters[SENSOR_CHANNELS];
+    TickFilter humidityFilters[SENSOR_CHANNELS];
+    HeaterPhase heaterPhase[SENSOR_CHANNELS] = {};
+    uint32_t heaterSinceMs[SENSOR_CHANNELS] = {}; // Start of the current phase
+    uint32_t heatedAtMs[SENSOR_CHANNELS] = {};
+    uint8_t heated = 0; // Channel bits: heatedAtMs is set
+    uint32_t lastPassMs = 0;
+    uint32_t modeStartUs = 0;      // Last sensor put into periodic mode
+    uint8_t fetchedSinceStart = 0; // Channel bits: fetched since then
+    Sample last[SENSOR_CHANNELS] = {};
+    uint8_t fitted = 0;   // Channel bits: a sensor answered
+    uint8_t cached = 0;   // Channel bits: 'last' is fresh from the last pass
+    uint8_t measured = 0; // Channel bits: 'last' holds a reading
+    AcquisitionStats counters = {};
+};
+
+extern SensorAcquisition acquisition;
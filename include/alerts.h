@@ -0,0 +1,127 @@
+// --- Alert Rules ---
+// Evaluates threshold rules against the sample stream as it arrives, with
+// constant work per sample and rule, and reports alert/clear transitions.
+//
+// A rule list is a string of rules separated by ',' or ';', each
+//   [d]metric op threshold [~band] [@duration]
+//   metric     temp (degrees F) or rh (% relative humidity); a leading 'd'
+//              means its rate of change per minute over the last
+//              ALERT_RATE_WINDOW_S instead of the value
+//   op         '>' (too high) or '<' (too low)
+//   ~band      hysteresis: once raised, the alert clears only when the value
+//              is back past the threshold by this much (default 0)
+//   @duration  the condition must hold this long before the alert is
+//              raised, e.g. @90s, @5m, @1h (default at once)
+// e.g. "temp>82~1, temp<40~1@10m, rh>70~5@30m, dtemp>0.5".
+//
+// Each rule is NORMAL, PENDING (condition true, duration not yet reached)
+// or ACTIVE. Only NORMAL/PENDING -> ACTIVE (raised) and ACTIVE -> NORMAL
+// (cleared) are reported, so a value hovering around a threshold produces
+// one alert, not one per sample. Every rule applies to every sensor
+// channel, with its own state and rates per channel.
+#pragma once
+
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ALERT_MAX_RULES 8
+#define ALERT_RATE_WINDOW_S 300 // Rates are measured over about 5 minutes
+#define ALERT_RATE_SAMPLES 16   // Enough for the window at one sample per 20 s
+
+enum AlertMetric : uint8_t
+{
+    ALERT_TEMPERATURE,
+    ALERT_HUMIDITY,
+};
+
+enum AlertState : uint8_t
+{
+    ALERT_NORMAL,
+    ALERT_PENDING,
+    ALERT_ACTIVE,
+};
+
+struct AlertRule
+{
+    AlertMetric metric;
+    bool rate;  // Rate of change per minute rather than the value
+    bool above; // '>' rather than '<'
+    float threshold;
+    float band;
+    uint32_t minDurationSec;
+};
+
+struct AlertEvent
+{
+    int rule;
+    uint8_t channel;
+    bool raised;    // false: cleared
+    float value;    // The value (or rate) that caused the transition
+    uint32_t atSec; // Sample time
+    uint32_t sinceSec; // Raised: when the condition started; cleared: when it was raised
+};
+
+struct AlertStats
+{
+    uint32_t samples;
+    uint32_t raised;
+    uint32_t cleared;
+};
+
+class AlertEngine
+{
+public:
+    typedef void (*EventHandler)(const AlertEvent &event, void *context);
+
+    // Replaces the rules and resets every state. Returns false, and leaves
+    // the old rules in place, if the list does not parse; 'error' then
+    // says where.
+    bool configure(const char *rules, char *error = nullptr, size_t errorSize = 0);
+    // Feeds one sample of 'channel'; 'seconds' is monotonic (uptime, or
+    // trace time). Calls 'handler' for each rule that is raised or cleared.
+    void update(uint32_t seconds, uint8_t channel, float temperatureF, float humidity, EventHandler handler,
+                void *context);
+
+    int ruleCount() const { return count; }
+    const AlertRule &rule(int index) const { return rules[index]; }
+    AlertState state(int index, uint8_t channel) const { return states[channel][index].state; }
+    // Latest rate of change per minute, false until a window's worth of
+    // samples is in.
+    bool rate(uint8_t channel, AlertMetric metric, float &perMinute) const;
+    const AlertStats &stats() const { return counters; }
+
+    // "temp > 82 F ~1 @5m", "rh rate > 2 %/min".
+    static void formatRule(const AlertRule &rule, char *buffer, size_t size);
+    // "F", "%", "F/min" or "%/min".
+    static const char *unit(const AlertRule &rule);
+
+private:
+    struct RuleState
+    {
+        AlertState state;
+        uint32_t sinceSec;
+    };
+    // Recent samples of one metric, oldest kept just outside the window.
+    struct RateWindow
+    {
+        float values[ALERT_RATE_SAMPLES];
+        uint32_t times[ALERT_RATE_SAMPLES];
+        uint8_t head; // Next write
+        uint8_t tail; // Oldest
+        uint8_t size;
+        bool valid;
+        float perMinute;
+
+        void add(uint32_t seconds, float value);
+    };
+
+    AlertRule rules[ALERT_MAX_RULES] = {};
+    RuleState states[SENSOR_CHANNELS][ALERT_MAX_RULES] = {};
+    int count = 0;
+    RateWindow windows[SENSOR_CHANNELS][2] = {};
+    AlertStats counters = {};
+};
+
+extern AlertEngine alerts;
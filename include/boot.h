@@ -0,0 +1,70 @@
+// --- Staged Boot ---
+// setup() brings the board up in two lanes. The local stages (serial ports,
+// sensor and first reading, settings and flash log) run first, in order, on
+// the loop task, so the RS-232 link and the sensor are live within a few
+// hundred milliseconds of power-up. The network stages (WiFi, which may
+// mean the configuration portal, then starting SNTP) run on a background
+// task started part way through, and loop() picks up their result with
+// poll() once they are done.
+//
+// Every stage is timed in hal::clock().millis() since power-up, for the
+// boot timing report.
+// On the ESP32 the network lane is a FreeRTOS task, on the native build a
+// std::thread.
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+enum BootPhase : uint8_t
+{
+    BOOT_SERIAL,        // USB and RS-232 ports, consoles
+    BOOT_SENSOR,        // SHT31 probe
+    BOOT_FIRST_READING, // First measurement into the history
+    BOOT_STORAGE,       // LittleFS, settings, alert rules
+    BOOT_HISTORY_LOG,   // Flash log scan
+    BOOT_SERVICES,      // Mail task, scheduler
+    BOOT_WIFI,          // Network lane: connect or portal
+    BOOT_TIME,          // SNTP started until its first answer
+    BOOT_PHASES
+};
+
+struct BootPhaseTiming
+{
+    uint32_t startMs;
+    uint32_t endMs;
+    bool ran;
+    bool ok;
+};
+
+class BootSequence
+{
+public:
+    // The network lane. Runs on its own task; returns whether WiFi connected.
+    typedef bool (*NetworkFunction)();
+
+    void start(BootPhase phase);
+    void finish(BootPhase phase, bool ok = true);
+    // Starts 'fn' on the network task. Returns false if it could not be
+    // started (the caller can then run it in place).
+    bool startNetwork(NetworkFunction fn);
+    // True once the network lane has finished (or was never started).
+    bool networkDone() const { return !networkRunning.load(); }
+    // Call from loop(). Returns true exactly once, when the network lane has
+    // just finished; 'connected' is then what it returned.
+    bool poll(bool &connected);
+    // Called on the network task when 'fn' returns.
+    void networkFinished(bool connected);
+
+    const BootPhaseTiming &timing(BootPhase phase) const { return phases[phase]; }
+    static const char *phaseName(BootPhase phase);
+
+private:
+    BootPhaseTiming phases[BOOT_PHASES] = {};
+    std::atomic<bool> networkRunning{false};
+    std::atomic<bool> networkResult{false};
+    bool networkReported = true;
+};
+
+extern BootSequence boot;
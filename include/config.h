@@ -0,0 +1,142 @@
+// --- Configuration ---
+// Every setting is a fixed-size text buffer, declared once in the field
+// table in config.cpp with its key, size, type, default and portal label.
+// Loading, saving, the WiFiManager portal and the 'cfg' command are all
+// driven by that table, so adding a setting is one line there plus its
+// buffer here.
+//
+// Settings are stored as a small binary blob on LittleFS, written
+// alternately to two slots so a power cut during a save leaves the previous
+// copy intact:
+//   header  magic u32 "CFG1", version u8, fields u8, length u16,
+//           sequence u32, crc u16 (CRC-16 over the header before it and
+//           the payload)
+//   payload per field: id u8, length u8, value bytes (no terminator)
+// Fields are tagged with a fixed id, so a blob written by an older or newer
+// firmware still loads: unknown ids are skipped, missing ones keep their
+// defaults. Loading parses no JSON and allocates nothing. A /config.json
+// from earlier firmware is migrated once, on the first boot that finds no
+// valid blob, and then removed.
+#pragma once
+
+#include "hal.h"
+#include "scheduler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONFIG_SLOT_A "/config_a.bin"
+#define CONFIG_SLOT_B "/config_b.bin"
+#define CONFIG_LEGACY_PATH "/config.json"
+#define CONFIG_MAGIC 0x31474643UL // "CFG1"
+#define CONFIG_VERSION 1          // Bump when a field's meaning changes, not when one is added
+#define CONFIG_VALUES_MAX 1024    // Every setting's buffer end to end (the portal's copy)
+
+// --- Settings ---
+extern char timeZoneInfo[50];
+extern char mail_server[50];
+extern char mail_port[6];
+extern char mail_from[50];
+extern char mail_pass[50];
+extern char mail_to[50];
+extern char mail_subject[50];
+extern char mail_name[50];
+extern char stream_rate[6];        // Binary telemetry frames per second on RS-232
+extern char stream_baud[8];        // RS-232 baud while streaming (up to 921600)
+extern char digest_hours[4];       // One digest email per this many hours (divisor of 24), 0 = off
+extern char smtp_policy[12];       // SMTP session policy: persistent, ondemand or idle
+extern char smtp_idle_s[6];        // 'idle' policy: close the session after this many seconds unused
+extern char mqtt_host[50];         // MQTT broker, "" = off
+extern char mqtt_port[6];
+extern char mqtt_topic[64];        // Batches are published here
+extern char mqtt_user[32];         // "" for an anonymous broker
+extern char mqtt_pass[50];
+extern char mqtt_qos[2];           // 0 fire-and-forget, 1 wait for the broker's PUBACK
+extern char mqtt_interval_s[6];    // Publish a batch at least this often
+extern char report_cron[SCHEDULER_CRON_MAX]; // Report emails: minute hour day month weekday (local time)
+extern char alert_rules[96];       // Alert rules, see alerts.h
+extern char http_port[6];          // HTTP /metrics and /readings port, 0 = off
+extern char sensor_mps[3];         // SHT31 periodic measurements per second (1, 2, 4, 10), 0 = single shots
+extern char sensor_repeat[8];      // SHT31 repeatability: high, medium or low
+extern char filter_median[2];      // Median filter window in readings, 1 = off
+extern char filter_ema_pct[4];     // EMA weight of a new reading in %, 100 = off
+extern char heater_rh[4];          // Run the SHT31 heater at this % RH (condensation), 0 = off
+extern char duty_s[5];             // Deep-sleep between samples for this long (see duty_cycle.h), 0 = always on
+extern char modbus_addr[4];        // Modbus RTU unit address on RS-232 (1-247), 0 = off (see modbus_slave.h)
+extern char modbus_baud[7];        // RS-232 baud while it is the Modbus link
+
+enum ConfigType : uint8_t
+{
+    CONFIG_TEXT,
+    CONFIG_NUMBER, // Decimal digits within [min, max]
+    CONFIG_SECRET, // Text that is never echoed back
+};
+
+struct ConfigField
+{
+    uint8_t id;      // Tag in the binary store; never reuse one
+    const char *key; // 'cfg' name and /config.json key
+    char *value;
+    uint8_t size; // Including the terminator
+    ConfigType type;
+    uint32_t min, max; // CONFIG_NUMBER only
+    const char *defaultValue;
+    const char *portalId; // WiFiManager parameter id
+    const char *label;
+};
+
+enum ConfigSource : uint8_t
+{
+    CONFIG_FROM_DEFAULTS,
+    CONFIG_FROM_BLOB,
+    CONFIG_FROM_LEGACY_JSON,
+};
+
+struct ConfigStats
+{
+    ConfigSource source;
+    uint8_t version;    // Of the blob that was loaded
+    uint16_t bytes;     // Blob size
+    uint32_t sequence;  // Saves so far
+    uint32_t loadUs;
+    uint8_t badSlots;   // Slots with a bad magic, length or CRC at load
+    uint8_t truncated;  // Stored values too long for their field
+};
+
+class ConfigStore
+{
+public:
+    // Applies the defaults, then the newest valid blob or, failing that,
+    // the legacy JSON file (saving it as a blob). Storage must be mounted.
+    void load();
+    bool save();
+
+    size_t fieldCount() const;
+    const ConfigField &field(size_t index) const;
+    const ConfigField *find(const char *key) const;
+    // Checks length and, for numbers, digits and range. Returns false with
+    // a reason in 'error'.
+    static bool validate(const ConfigField &field, const char *value, char *error, size_t errorSize);
+    // Copies a validated value (truncating anything else).
+    static void set(const ConfigField &field, const char *value);
+    // Fills 'params' with every field for the portal, each pointing at a
+    // copy of its value in 'values' (CONFIG_VALUES_MAX bytes): the portal
+    // runs on the boot network task and must not write the live settings.
+    // Returns the count.
+    size_t portalParams(hal::PortalParam *params, size_t capacity, char *values, size_t valuesSize) const;
+    // Copies the values the portal saved into the settings, each checked
+    // as validate() does; a refused one is logged and the old value kept.
+    // Call on the task that saves them.
+    static void applyPortal(const hal::PortalParam *params, size_t count);
+    const ConfigStats &stats() const { return counters; }
+    static const char *sourceName(ConfigSource source);
+
+private:
+    bool readSlot(const char *path, char *blob, size_t capacity, uint32_t &sequence, long &length);
+    void apply(const char *blob, long length);
+    bool migrateLegacy();
+
+    ConfigStats counters = {};
+};
+
+extern ConfigStore configStore;
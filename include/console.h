@@ -0,0 +1,72 @@
+// --- Serial Command Console ---
+// Line-oriented command interpreter, one instance per serial port. poll()
+// takes every byte the port has waiting, assembles lines in a fixed buffer
+// and runs each complete line as it arrives, so several commands sent in
+// one burst are all handled in the same loop() pass. Lines are tokenised in
+// place (no copies, no heap) and looked up in a constant command table.
+// Replies go through the logger to this port's sink only.
+#pragma once
+
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONSOLE_LINE_MAX 128 // Longer lines are discarded with an error; fits 'cfg set' of any setting
+#define CONSOLE_MAX_ARGS 6  // Including the command name
+#define CONSOLE_POLL_BYTES 256 // Per poll(), so a flood cannot stall loop()
+
+class Console;
+
+struct ConsoleCommand
+{
+    const char *name;
+    const char *usage; // Arguments, for help and usage errors
+    uint8_t minArgs;   // Not counting the command name
+    uint8_t maxArgs;
+    void (*run)(Console &console, int argc, char **argv); // argv[0] is the name
+};
+
+struct ConsoleStats
+{
+    uint32_t lines;
+    uint32_t unknown;   // Lines that named no command
+    uint32_t usage;     // Commands rejected for their argument count
+    uint32_t overflows; // Lines longer than CONSOLE_LINE_MAX
+    uint32_t maxBurst;  // Most lines handled in one poll()
+};
+
+class Console
+{
+public:
+    // 'logSink' is the logger sink id replies are sent to.
+    void begin(hal::SerialPort &port, int logSink, const ConsoleCommand *commands, size_t count);
+    // Reads what the port has waiting and runs every complete line.
+    void poll();
+    // Tokenises and runs one line; 'line' is modified in place.
+    void execute(char *line);
+    // Sends one reply line to this console's port.
+    void reply(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Case-insensitive lookup in the command table.
+    const ConsoleCommand *find(const char *name) const;
+    const ConsoleCommand *commands() const { return table; }
+    size_t commandCount() const { return tableSize; }
+    const ConsoleStats &stats() const { return counters; }
+
+    // Splits 'line' on spaces in place; "double quotes" group words.
+    // Returns the number of tokens stored in argv (at most maxArgs), or -1
+    // if there are more.
+    static int tokenize(char *line, char **argv, int maxArgs);
+
+private:
+    hal::SerialPort *port = nullptr;
+    int sink = -1;
+    const ConsoleCommand *table = nullptr;
+    size_t tableSize = 0;
+    char line[CONSOLE_LINE_MAX];
+    size_t length = 0;
+    bool discarding = false; // Skipping the rest of an overlong line
+    bool lastWasCr = false;  // Treat CR LF as one line end
+    ConsoleStats counters = {};
+};
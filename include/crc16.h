@@ -0,0 +1,9 @@
+// --- CRC-16/CCITT-FALSE ---
+// Poly 0x1021, init 0xFFFF, no reflection. Used to protect history log
+// records on flash and binary frames on the RS-232 link.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint16_t crc16(const void *data, size_t len, uint16_t crc = 0xFFFF);
@@ -0,0 +1,90 @@
+// --- Digest Email ---
+// One email per configurable window instead of one per reading: summary
+// statistics in the body and every reading of the window, taken from the
+// flash history log, as a CSV attachment. poll() writes the CSV to a file
+// one chunk at a time, so neither RAM nor a single loop() pass grows with
+// the number of rows; the mail task then streams the file from flash
+// through the transport's file attachment path.
+//
+// Lifecycle: begin() -> poll() until it returns true -> queue the mail
+// with DIGEST_CSV_PATH attached -> release() once it has been sent (or
+// could not be queued), which deletes the file.
+#pragma once
+
+#include "hal.h"
+#include "history_log.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIGEST_CSV_PATH "/digest.csv"
+#define DIGEST_CHUNK_BYTES 1024 // CSV bytes written to flash per poll()
+
+struct DigestChannel
+{
+    uint32_t count;
+    int32_t minCentiC, maxCentiC;
+    int64_t sumCentiC;
+    int32_t minCentiRH, maxCentiRH;
+    int64_t sumCentiRH;
+};
+
+struct DigestSummary
+{
+    uint32_t fromEpoch, toEpoch;
+    uint32_t count; // All channels
+    DigestChannel channels[SENSOR_CHANNELS];
+};
+
+struct DigestStats
+{
+    uint32_t built;
+    uint32_t busy;        // Windows skipped because the previous digest was still out
+    uint32_t rows;        // Over all digests
+    uint32_t bytes;
+    uint32_t writeErrors;
+};
+
+class DigestBuilder
+{
+public:
+    // Starts a digest of readings with fromEpoch <= epoch < toEpoch.
+    // Returns false if the previous digest has not been released yet.
+    bool begin(uint32_t fromEpoch, uint32_t toEpoch);
+    // Writes the next chunk of rows. Returns true once, when the file is
+    // complete and the digest is ready to send.
+    bool poll();
+    // Formats the summary for the email body (local time, degrees F), one
+    // line pair per channel that has readings.
+    void formatBody(char *buffer, size_t size) const;
+    // Deletes the attachment and allows the next begin(). Safe to call from
+    // the mail task.
+    void release();
+
+    bool idle() const { return state == IDLE; }
+    const DigestSummary &summary() const { return totals; }
+    const DigestStats &stats() const { return counters; }
+
+private:
+    enum State : uint8_t
+    {
+        IDLE,
+        BUILDING,
+        READY, // File complete; owned by the mail queue until release()
+    };
+
+    static bool addRow(const LogRecord &record, void *context);
+
+    std::atomic<uint8_t> state{IDLE};
+    uint32_t nextEpoch = 0;     // Where the next chunk's query starts
+    uint32_t skipAtNext = 0;    // Rows at nextEpoch already written
+    uint32_t endEpoch = 0;
+    char chunk[DIGEST_CHUNK_BYTES];
+    size_t chunkUsed = 0;
+    bool chunkFull = false;
+    DigestSummary totals = {};
+    DigestStats counters = {};
+};
+
+extern DigestBuilder digest;
@@ -0,0 +1,164 @@
+// --- Duty Cycle ---
+// Low-power operation (duty_s > 0): instead of staying up with WiFi and
+// an SMTP session, the board deep-sleeps between samples. A timer wake
+// measures the sensors in single shot, appends the readings to a buffer in
+// RTC memory, runs them through the alert rules and sleeps again, all
+// before the serial ports or the file system are touched. Only when a
+// report is due, an alert was raised or cleared, or the buffer has no room
+// for another pass does the wake go on into the full boot (an uplink): the
+// buffered readings go to the flash log and MQTT, the report and alert
+// emails to the mail queue, and the board sleeps again once those have
+// gone out, or after DUTY_AWAKE_MAX_MS.
+//
+// An uplink first rejoins the access point it last used, on its channel
+// and with its last DHCP address as a static IP (no scan, no DHCP), and
+// falls back to the normal connect if that fails. A failed uplink holds
+// back the next one for reports and alerts by DUTY_UPLINK_RETRY_S.
+//
+// What must outlive a deep sleep is kept in hal::System::retainedMemory():
+// the settings the timer wakes need, the readings and alert transitions
+// waiting for an uplink, the alert engine's state, the fast-reconnect
+// details and the counters. A magic and a CRC-16 tell a wake from a
+// power-on. The alert rules and the RAM history run on uptimeSeconds(),
+// which carries on through the sleeps.
+//
+// Every timer wake times its phases. With the typical currents below (set
+// your board's with -D) that gives the average current draw:
+//   (sum of phase ms * phase current + sleep ms * sleep current) / total ms
+// A power-on or reset boots normally and stays up DUTY_FIRST_SLEEP_MS, and
+// as long again after each console command, so the consoles can be used
+// (e.g. 'cfg set duty_s 0'); duty cycling starts once the clock is set.
+#pragma once
+
+#include "acquisition.h"
+#include "alerts.h"
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DUTY_READINGS_MAX 256        // 4 h of one sensor at duty_s 60
+#define DUTY_EVENTS_MAX 4            // Alert transitions waiting for an uplink
+#define DUTY_AWAKE_MAX_MS 60000UL    // An uplink wake sleeps after this, done or not
+#define DUTY_FIRST_SLEEP_MS 300000UL // Awake after a power-on and each console command
+#define DUTY_FAST_CONNECT_MS 3000    // Then the normal connect
+#define DUTY_UPLINK_RETRY_S 900      // After an uplink that could not finish
+#define DUTY_MAGIC 0x31595444UL      // "DTY1"
+
+// Typical currents of an ESP32-WROOM-32 with an SHT31, in microamps. A dev
+// board's regulator and USB bridge add to the sleep current.
+#ifndef DUTY_ACTIVE_UA
+#define DUTY_ACTIVE_UA 40000 // CPU running, radio off
+#endif
+#ifndef DUTY_RADIO_UA
+#define DUTY_RADIO_UA 120000 // WiFi associating and transmitting, averaged
+#endif
+#ifndef DUTY_SLEEP_UA
+#define DUTY_SLEEP_UA 10 // Deep sleep, RTC timer and memory on
+#endif
+// ROM and bootloader time before the application's millis() starts; the
+// wake timings cannot see it, so measure it once and set it here.
+#ifndef DUTY_BOOT_EXTRA_MS
+#define DUTY_BOOT_EXTRA_MS 0
+#endif
+
+enum DutyPhase : uint8_t
+{
+    DUTY_PHASE_BOOT,   // Reset to setup()
+    DUTY_PHASE_SENSOR, // Measure, buffer, alert rules
+    DUTY_PHASE_LOCAL,  // Uplinks: settings, flash log, services
+    DUTY_PHASE_WIFI,   // Association, fast or normal
+    DUTY_PHASE_UPLINK, // NTP, emails, MQTT, until asleep
+    DUTY_PHASES
+};
+
+// Why a wake goes on to an uplink (bits).
+enum DutyUplinkReason : uint8_t
+{
+    DUTY_UPLINK_REPORT = 1,
+    DUTY_UPLINK_ALERT = 2,
+    DUTY_UPLINK_FULL = 4,
+};
+
+struct DutyStats
+{
+    uint32_t wakes;   // Timer wakes since power-on
+    uint32_t uplinks;
+    uint32_t fastConnects;
+    uint32_t fastConnectFailures;
+    uint32_t readings;   // Buffered in RTC memory
+    uint32_t events;     // Alert transitions buffered
+    uint32_t lostEvents; // Beyond DUTY_EVENTS_MAX
+    uint32_t timeouts;   // Uplinks cut short by DUTY_AWAKE_MAX_MS
+    uint64_t phaseMs[DUTY_PHASES]; // Over all wakes
+    uint64_t sleptMs;
+    uint32_t lastWakeMs[DUTY_PHASES];
+};
+
+class DutyCycle
+{
+public:
+    // Call first in setup(). True on a timer wake with intact retained
+    // state, which then goes through the wake path; otherwise the state is
+    // cleared.
+    bool resume();
+    // This boot is a timer wake.
+    bool resumed() const { return waking; }
+    // Starts 'phase' of this wake; the one before ends here.
+    void mark(DutyPhase phase);
+    // Since this wake began.
+    uint32_t awakeMs() const { return hal::clock().millis() - wakeStartMs; }
+
+    // --- Timer Wakes ---
+    void restoreAlerts(AlertEngine &engine) const;
+    void saveAlerts(const AlertEngine &engine);
+    // Buffers a reading; false if the buffer is full.
+    bool store(uint32_t epoch, const Sample &sample);
+    void addEvent(const AlertEvent &event, const Sample &sample);
+    // DUTY_UPLINK_* bits: what this wake has to go on to an uplink for.
+    uint8_t uplinkReasons(uint32_t nowEpoch) const;
+
+    // --- Uplinks ---
+    typedef void (*ReadingVisitor)(uint32_t epoch, uint8_t channel, float temperatureC, float humidity,
+                                   void *context);
+    // Visits the buffered readings oldest first and empties the buffer.
+    size_t drainReadings(ReadingVisitor visit, void *context);
+    // Takes the oldest alert transition waiting to be emailed.
+    bool takeEvent(AlertEvent &event, Sample &sample);
+    bool fastConnect(hal::FastConnectInfo &info) const;
+    void setFastConnect(const hal::FastConnectInfo &info);
+    void countFastConnect(bool ok);
+    // Holds back the next uplink for reports and alerts.
+    void uplinkFailed(uint32_t nowEpoch);
+    uint32_t nextReportEpoch() const;
+    // duty_s as of the last sleep: timer wakes run without the settings.
+    uint32_t intervalS() const;
+
+    // Records this wake's timings and sleeps until the next sample,
+    // intervalS after this wake began, or the report at nextReport (UTC, 0
+    // for none) if that comes first. Returns only on the native build.
+    void sleep(uint32_t intervalS, uint32_t nextReport, uint32_t nowEpoch);
+
+    const DutyStats &stats() const;
+    // Average over every wake and sleep so far; 0 before the first wake.
+    uint32_t averageMicroAmps() const;
+    static const char *phaseName(DutyPhase phase);
+
+private:
+    struct State; // Laid out in the retained memory, see duty_cycle.cpp
+    State *state();
+    const State *state() const;
+    static uint16_t checksum(const State &state);
+    void clear();
+    void seal();
+
+    bool waking = false;
+    uint32_t phaseStartMs[DUTY_PHASES] = {};
+    uint8_t phasesRun = 0;
+    uint32_t wakeStartMs = 0; // millis() at the wake: 0, as millis() restarts
+    // The native build keeps its RAM and millis() through a sleep: when it
+    // is to wake. Always 0 on the board.
+    uint32_t asleepUntilMs = 0;
+};
+
+extern DutyCycle dutyCycle;
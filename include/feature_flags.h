@@ -0,0 +1,54 @@
+// --- Build Features ---
+// Compile-time selection of the optional parts of the firmware, so that a
+// deployment which never emails or shows the portal doesn't carry ESP
+// Mail Client, WiFiManager or ArduinoJson, and an RS-232-only unit fits a
+// standard OTA partition layout. Each feature is built in (1) unless the
+// build sets it to 0 with -D; platformio.ini has the lean profiles, and
+// tools/footprint.py reports what each one costs in flash and RAM.
+//
+//   FEATURE_NETWORK      WiFi, NTP, the HTTP endpoint and MQTT. Without it
+//                        there is no wall-clock time, so no flash log,
+//                        reports or duty cycle either: readings, alerts
+//                        and statistics go to the serial ports only.
+//   FEATURE_EMAIL        Reports, alert emails, digests and the outbox over
+//                        ESP Mail Client. Needs FEATURE_NETWORK.
+//   FEATURE_PORTAL       The WiFiManager configuration portal. Without it
+//                        WiFi joins WIFI_SSID / WIFI_PASSWORD (-D, as
+//                        strings) or the credentials the ESP32 already
+//                        has saved, and the settings are changed with
+//                        'cfg'. Needs FEATURE_NETWORK.
+//   FEATURE_JSON_CONFIG  Conversion of a /config.json from earlier firmware
+//                        (ArduinoJson); the binary store works without it.
+//   FEATURE_RS232_TEXT   Status lines and the command console on RS-232;
+//                        without it the port only carries telemetry.
+//   FEATURE_STREAMING    Binary telemetry streaming on RS-232.
+//   FEATURE_MODBUS       The Modbus RTU slave on RS-232 (modbus_addr).
+//
+// EMAIL and PORTAL follow NETWORK unless set.
+#pragma once
+
+#ifndef FEATURE_NETWORK
+#define FEATURE_NETWORK 1
+#endif
+#ifndef FEATURE_EMAIL
+#define FEATURE_EMAIL FEATURE_NETWORK
+#endif
+#ifndef FEATURE_PORTAL
+#define FEATURE_PORTAL FEATURE_NETWORK
+#endif
+#ifndef FEATURE_JSON_CONFIG
+#define FEATURE_JSON_CONFIG 1
+#endif
+#ifndef FEATURE_RS232_TEXT
+#define FEATURE_RS232_TEXT 1
+#endif
+#ifndef FEATURE_STREAMING
+#define FEATURE_STREAMING 1
+#endif
+#ifndef FEATURE_MODBUS
+#define FEATURE_MODBUS 1
+#endif
+
+#if (FEATURE_EMAIL || FEATURE_PORTAL) && !FEATURE_NETWORK
+#error "FEATURE_EMAIL and FEATURE_PORTAL need FEATURE_NETWORK"
+#endif
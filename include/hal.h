@@ -0,0 +1,297 @@
+// --- Hardware Abstraction Layer ---
+// Thin interfaces over everything the application touches on the board:
+// the SHT31-D sensors, the two UARTs, the clock, WiFi, the SMTP transport,
+// the HTTP listening socket, the MQTT broker connection, the LittleFS
+// partition and a few system calls. The ESP32 implementation
+// lives in hal_esp32.cpp, the in-memory fakes used by the native build in
+// hal_native.cpp. Application code only ever talks to these interfaces.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// SHT31 positions: both I2C controllers (bus 0 on GPIO 21/22, bus 1 on
+// GPIO 18/19), each with the sensor's two addresses. A sensor's channel is
+// bus * 2 + (address - SENSOR_ADDRESS_LOW), so it keeps its number whatever
+// else is fitted; channel 0 is the original single sensor.
+#define SENSOR_CHANNELS 4
+#define SENSOR_ADDRESS_LOW 0x44
+#define SENSOR_ADDRESS_HIGH 0x45
+// High repeatability single shot: 15 ms worst case, plus margin.
+#define SENSOR_CONVERSION_US 15500
+// System::retainedMemory(): what survives a deep sleep (of the ESP32's
+// 8 KB of RTC slow memory).
+#define HAL_RETAINED_BYTES 4096
+
+// Repeatability of periodic measurements: higher costs more current and
+// a longer conversion, lower is noisier.
+enum SensorRepeatability : uint8_t
+{
+    SENSOR_REPEAT_HIGH,
+    SENSOR_REPEAT_MEDIUM,
+    SENSOR_REPEAT_LOW,
+};
+
+namespace hal
+{
+
+class Sensor
+{
+public:
+    virtual ~Sensor() {}
+    // Resets the sensor at this position; false if nothing answers.
+    virtual bool begin() = 0;
+    // Sends the single-shot command and returns at once; the result can be
+    // collected SENSOR_CONVERSION_US later. Several sensors convert at once.
+    virtual bool start() = 0;
+    // Reads the measurement start() triggered: the raw 16-bit temperature
+    // and humidity ticks of the same conversion, CRC-checked (see
+    // reading_format.h for the conversion). Returns false when the sensor
+    // cannot be read or is not done yet.
+    virtual bool collect(uint16_t &temperatureTicks, uint16_t &humidityTicks) = 0;
+
+    // Starts periodic acquisition at 'mps' measurements per second (1, 2,
+    // 4 or 10), after which the sensor converts on its own and fetch()
+    // reads the latest result without waiting; mps 0 stops it (single
+    // shots again).
+    virtual bool setPeriodic(uint8_t mps, SensorRepeatability repeatability) = 0;
+    // Periodic mode: the newest measurement, CRC-checked like collect().
+    // Returns false if the sensor has none since the last fetch.
+    virtual bool fetch(uint16_t &temperatureTicks, uint16_t &humidityTicks) = 0;
+    // Switches the on-chip heater, which raises the sensor's temperature
+    // by a few degrees to drive off condensation. Periodic acquisition
+    // carries on.
+    virtual bool setHeater(bool on) = 0;
+};
+
+class SerialPort
+{
+public:
+    virtual ~SerialPort() {}
+    virtual void begin(long baud) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    // Bytes that can be queued for transmit without blocking.
+    virtual int availableForWrite() = 0;
+    virtual size_t write(const char *data, size_t len) = 0;
+    // Hands each received byte to available() as it arrives rather than in
+    // FIFO-sized batches, for protocols that time the line (Modbus RTU).
+    virtual void setRxLowLatency(bool) {}
+
+    size_t print(const char *text);
+    size_t println(const char *text = "");
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Clock
+{
+public:
+    virtual ~Clock() {}
+    virtual uint32_t millis() = 0;
+    virtual uint32_t micros() = 0;
+    virtual void delay(uint32_t ms) = 0;
+    // Seconds since the Unix epoch (UTC); meaningless until time is synced.
+    virtual time_t now() = 0;
+    // Configures the POSIX time zone and up to three NTP servers.
+    virtual void configTzTime(const char *tz, const char *server1,
+                              const char *server2, const char *server3) = 0;
+    // Fills in local time; waits up to timeoutMs for the clock to be set.
+    virtual bool getLocalTime(struct tm *info, uint32_t timeoutMs = 5000) = 0;
+
+    // SNTP runs in the background once configTzTime() has been called. 'fn'
+    // is called from the SNTP task after every successful exchange, with the
+    // UTC time (microseconds since the epoch) the clock was just set to.
+    typedef void (*SyncCallback)(int64_t epochUs);
+    virtual void onTimeSync(SyncCallback fn, uint32_t intervalMs) = 0;
+    // Starts a new NTP exchange now. Returns at once.
+    virtual void requestSync() = 0;
+    // Slews the clock by deltaUs (positive: forward) without stepping it.
+    virtual void adjust(int32_t deltaUs) = 0;
+};
+
+// A text field shown in the WiFi configuration portal. 'value' is both the
+// default shown to the user and the destination of whatever they enter.
+struct PortalParam
+{
+    const char *id;
+    const char *label;
+    char *value;
+    size_t capacity;
+};
+
+// What a fast reconnect needs from the last association: the access
+// point and its channel (no scan) and the address DHCP handed out (used as
+// a static one, no DHCP).
+struct FastConnectInfo
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip, gateway, subnet, dns; // As lwIP keeps them
+};
+
+class Network
+{
+public:
+    virtual ~Network() {}
+    // Connects with saved credentials or opens the configuration portal.
+    // Blocking. 'paramsSaved' is set when the user submitted the portal form.
+    virtual bool autoConnect(const char *apName, PortalParam *params, size_t count,
+                             bool &paramsSaved) = 0;
+    virtual void resetSettings() = 0;
+    virtual bool isConnected() = 0;
+    virtual void reconnect() = 0;
+    virtual const char *localIP() = 0;
+    // The current association, for connectFast() after a deep sleep. False
+    // while not connected.
+    virtual bool fastConnectInfo(FastConnectInfo &info) = 0;
+    // Joins the saved network on 'info's access point and channel, with
+    // its address as a static IP. Blocking, up to timeoutMs; on failure the
+    // interface is left on DHCP again for autoConnect().
+    virtual bool connectFast(const FastConnectInfo &info, uint32_t timeoutMs) = 0;
+};
+
+struct MailServerConfig
+{
+    const char *host;
+    uint16_t port;
+    const char *email;
+    const char *password;
+};
+
+struct MailMessage
+{
+    const char *senderName;
+    const char *senderEmail;
+    const char *recipient;
+    const char *subject;
+    const char *body;
+    // Optional file on storage() sent as an attachment. Transports stream
+    // it from flash, so its size is not limited by RAM.
+    const char *attachmentPath = nullptr;
+    const char *attachmentName = nullptr;
+    const char *attachmentMime = nullptr;
+};
+
+class MailTransport
+{
+public:
+    virtual ~MailTransport() {}
+    virtual void setDebug(int level) = 0;
+    virtual void setNetworkReconnect(bool enable) = 0;
+    // Opens the session: TCP, TLS and greeting, without logging in.
+    virtual bool connect(const MailServerConfig &server) = 0;
+    // Authenticates the open session with the server's credentials.
+    virtual bool login() = 0;
+    virtual bool isLoggedIn() = 0;
+    virtual void close() = 0;
+    // Sends on a logged-in session; closes it afterwards if closeAfter.
+    virtual bool send(const MailMessage &message, bool closeAfter) = 0;
+    virtual const char *errorReason() = 0;
+};
+
+// A listening TCP socket and the connections accepted on it. Nothing
+// blocks: accept() and read() return at once when there is nothing to do
+// and write() takes only what fits in the socket's send buffer.
+class TcpServer
+{
+public:
+    virtual ~TcpServer() {}
+    virtual bool begin(uint16_t port) = 0;
+    virtual bool listening() = 0;
+    // Returns a connection handle, or -1 if no client is waiting.
+    virtual int accept() = 0;
+    // Returns the bytes read, 0 if nothing has arrived, -1 once the peer
+    // has closed or the connection failed.
+    virtual int read(int connection, char *buffer, size_t capacity) = 0;
+    // Returns the bytes taken (0 if the send buffer is full) or -1.
+    virtual int write(int connection, const char *data, size_t len) = 0;
+    virtual void close(int connection) = 0;
+};
+
+// An outgoing TCP connection for a background task: every call may block
+// for up to its timeout.
+class TcpClient
+{
+public:
+    virtual ~TcpClient() {}
+    virtual bool connect(const char *host, uint16_t port, uint32_t timeoutMs) = 0;
+    virtual bool connected() = 0;
+    virtual bool write(const uint8_t *data, size_t len) = 0;
+    // Reads exactly 'len' bytes; false on timeout or if the peer closed.
+    virtual bool read(uint8_t *buffer, size_t len, uint32_t timeoutMs) = 0;
+    virtual void close() = 0;
+};
+
+class Storage
+{
+public:
+    virtual ~Storage() {}
+    // Mounts the 'spiffs' partition, formatting it if it cannot be mounted.
+    virtual bool begin() = 0;
+    virtual bool format() = 0;
+    virtual bool exists(const char *path) = 0;
+    // Reads at most 'capacity' bytes; returns the number of bytes read or -1.
+    virtual long readFile(const char *path, char *buffer, size_t capacity) = 0;
+    virtual bool writeFile(const char *path, const char *data, size_t len) = 0;
+    // Like readFile(), starting at byte 'offset'.
+    virtual long readFileAt(const char *path, size_t offset, char *buffer, size_t capacity) = 0;
+    // Creates the file if needed.
+    virtual bool appendFile(const char *path, const char *data, size_t len) = 0;
+    // Returns -1 if the file does not exist.
+    virtual long fileSize(const char *path) = 0;
+    virtual bool remove(const char *path) = 0;
+    // Calls fn for every file in the root directory; 'path' starts with '/'.
+    typedef void (*FileVisitor)(const char *path, size_t size, void *context);
+    virtual void listFiles(FileVisitor fn, void *context) = 0;
+    virtual size_t totalBytes() = 0;
+    virtual size_t usedBytes() = 0;
+};
+
+class System
+{
+public:
+    virtual ~System() {}
+    // Configures 'pin' as an input with pull-up and reports whether it is held LOW.
+    virtual bool pinHeldLow(uint8_t pin) = 0;
+    virtual void restart() = 0;
+    // Stops the application for good (factory reset done, sensor missing).
+    virtual void halt() = 0;
+    virtual uint32_t freeHeap() = 0;
+    // Lowest free heap since boot.
+    virtual uint32_t minFreeHeap() = 0;
+    // Largest single allocation the heap could satisfy now; well below
+    // freeHeap() when the free space is fragmented.
+    virtual uint32_t largestFreeBlock() = 0;
+    // The calling task, as a handle for stackHighWater().
+    virtual void *currentTask() = 0;
+    // Least free stack 'task' has had, in bytes; 0 if unknown.
+    virtual uint32_t stackHighWater(void *task) = 0;
+
+    // HAL_RETAINED_BYTES that keep their contents through deep sleep (RTC
+    // slow memory on the ESP32); zeroed after a power-on. Callers must
+    // still validate it.
+    virtual uint8_t *retainedMemory() = 0;
+    // True if this boot is the timer wake from a deepSleep().
+    virtual bool wokeFromSleep() = 0;
+    // Powers down everything but the RTC for 'ms', after which the board
+    // starts again from setup(). Never returns on the board; the native
+    // fake moves the clock on, drops WiFi and returns.
+    virtual void deepSleep(uint32_t ms) = 0;
+};
+
+// --- Board Accessors ---
+// Each returns the one instance for the current build target ('channel'
+// below SENSOR_CHANNELS).
+Sensor &sensor(uint8_t channel);
+SerialPort &usbSerial();
+SerialPort &rs232Serial();
+Clock &clock();
+Network &network();
+MailTransport &mail();
+TcpServer &tcpServer();
+TcpClient &mqttSocket();
+Storage &storage();
+System &system();
+
+} // namespace hal
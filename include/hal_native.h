@@ -0,0 +1,299 @@
+// --- Native (host) HAL fakes ---
+// In-memory stand-ins for the board, used by the [env:native] build. The
+// host runner scripts them: inject serial input, set sensor values, move
+// the clock forward, take the network or mail relay down.
+#pragma once
+#ifndef ARDUINO
+
+#include "hal.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace hal
+{
+namespace native
+{
+
+class FakeSensor : public Sensor
+{
+public:
+    FakeSensor(bool present, float temperatureC) : present(present), temperatureC(temperatureC) {}
+
+    bool begin() override { return present; }
+    bool start() override;
+    // The configured values as the sensor would encode them, once
+    // conversionUs has passed since start().
+    bool collect(uint16_t &temperatureTicks, uint16_t &humidityTicks) override;
+    bool setPeriodic(uint8_t mps, SensorRepeatability repeatability) override;
+    // A new measurement every 1/mps s, the first conversionUs after
+    // setPeriodic().
+    bool fetch(uint16_t &temperatureTicks, uint16_t &humidityTicks) override;
+    bool setHeater(bool on) override;
+
+    bool present;
+    bool failReads = false;
+    float temperatureC;
+    float humidity = 45.0f;
+    // When non-zero, readings follow a daily sine of this amplitude plus a
+    // little deterministic noise, so history queries see realistic data.
+    float waveAmplitude = 0.0f;
+    // A high repeatability single-shot conversion. start() and collect()
+    // advance the fake clock by the time their transfers take at 100 kHz.
+    uint32_t conversionUs = 15000;
+    uint32_t startUs = 300;
+    uint32_t collectUs = 700;
+    uint32_t fetchUs = 900; // Command plus the 6-byte read
+    // While the heater is on the sensor reads this much warmer (and drier).
+    float heaterRiseC = 4.0f;
+    bool heaterOn = false;
+    uint8_t periodicMps = 0;
+    unsigned long reads = 0;
+
+private:
+    bool measurement(uint16_t &temperatureTicks, uint16_t &humidityTicks);
+
+    uint64_t startedAtUs = 0;
+    bool started = false;
+    uint64_t periodicSinceUs = 0;
+    uint64_t fetched = 0; // Periodic measurements read so far
+};
+
+class FakeSerialPort : public SerialPort
+{
+public:
+    explicit FakeSerialPort(const char *name) : name(name) {}
+    void begin(long baud) override { this->baud = baud; }
+    int available() override;
+    int read() override;
+    int availableForWrite() override { return 4096; }
+    size_t write(const char *data, size_t len) override;
+
+    void inject(const char *text) { input += text; }
+    // Backs the port with a pseudo-terminal so host tools can talk to it;
+    // returns the slave device path (e.g. /dev/pts/3) or nullptr.
+    const char *openPty();
+
+    const char *name;
+    long baud = 0;
+    bool echo = true; // Copy output to stdout
+    std::string input;
+    size_t inputPos = 0;
+    unsigned long bytesWritten = 0;
+    unsigned long bytesDropped = 0; // pty writes refused (host not reading)
+    int ptyFd = -1;
+};
+
+// The simulated clock. nowUs is the board's own oscillator (millis(),
+// micros()), which runs driftPpm fast against true time. The wall clock is
+// that oscillator plus an offset that SNTP steps to true time at each sync
+// and adjust() slews in between, as on the ESP32.
+class FakeClock : public Clock
+{
+public:
+    uint32_t millis() override { return (uint32_t)(nowUs / 1000); }
+    uint32_t micros() override { return (uint32_t)nowUs; }
+    time_t now() override { return (time_t)(wallUs() / 1000000); }
+    void delay(uint32_t ms) override { wait(ms); }
+    void configTzTime(const char *tz, const char *server1,
+                      const char *server2, const char *server3) override;
+    bool getLocalTime(struct tm *info, uint32_t timeoutMs) override;
+    void onTimeSync(SyncCallback fn, uint32_t intervalMs) override;
+    void requestSync() override;
+    void adjust(int32_t deltaUs) override;
+
+    void advance(uint32_t ms);
+    void advanceMicros(uint32_t us) { nowUs += us; }
+    // A blocking wait. On the thread that drives the simulation it moves the
+    // clock forward; any other thread (the boot network task) sleeps until
+    // the simulation has moved it that far.
+    void wait(uint32_t ms);
+    // Runs a due SNTP exchange; called by advance(), and by the runner after
+    // setting nowUs directly.
+    void service();
+
+    int64_t wallUs() const { return (int64_t)nowUs + offsetUs; }
+    int64_t trueUs() const { return (int64_t)epochAtZero * 1000000 + (int64_t)(nowUs * (1 - driftPpm * 1e-6)); }
+
+    std::atomic<uint64_t> nowUs{0};
+    bool ntpReachable = true;
+    time_t epochAtZero = 1714557600; // 2024-05-01 10:00:00 UTC
+    double driftPpm = 0;
+    uint32_t syncDelayMs = 800;   // From configTzTime()/requestSync() to the answer
+    uint32_t syncRetryMs = 15000; // After an unanswered request
+    std::atomic<int64_t> offsetUs{0};
+    int64_t slewedUs = 0; // adjust() total since the last sync
+    unsigned long syncs = 0;
+    std::thread::id driver = std::this_thread::get_id();
+
+private:
+    std::atomic<bool> sntpRunning{false}; // configTzTime() runs on the boot network task
+    std::atomic<uint64_t> nextSyncUs{0};
+    uint32_t syncIntervalMs = 3600000;
+    SyncCallback syncCallback = nullptr;
+};
+
+class FakeNetwork : public Network
+{
+public:
+    bool autoConnect(const char *apName, PortalParam *params, size_t count,
+                     bool &paramsSaved) override;
+    void resetSettings() override {}
+    bool isConnected() override { return connected; }
+    void reconnect() override { connected = reachable; }
+    const char *localIP() override { return "127.0.0.1"; }
+    bool fastConnectInfo(FastConnectInfo &info) override;
+    bool connectFast(const FastConnectInfo &info, uint32_t timeoutMs) override;
+
+    bool reachable = true;
+    std::atomic<bool> connected{false};
+    uint32_t connectDelayMs = 0;     // Simulated scan, association and DHCP time
+    uint32_t fastConnectDelayMs = 0; // Association only, on the known channel
+    bool fastConnectWorks = true;    // false: the access point moved
+    unsigned long fastConnects = 0;
+};
+
+// In memory by default. When relayHost is set it speaks plain SMTP
+// (no TLS, no AUTH) to a local stand-in server instead, for example
+//   python3 -m aiosmtpd -n -l 127.0.0.1:2525
+class FakeMailTransport : public MailTransport
+{
+public:
+    void setDebug(int) override {}
+    void setNetworkReconnect(bool) override {}
+    bool connect(const MailServerConfig &server) override;
+    bool login() override;
+    bool isLoggedIn() override { return loggedIn; }
+    void close() override;
+    bool send(const MailMessage &message, bool closeAfter) override;
+    const char *errorReason() override { return error; }
+
+    bool relayUp = true;
+    const char *relayHost = nullptr;
+    uint16_t relayPort = 2525;
+    // Simulated TCP + TLS handshake, AUTH and send times (in-memory mode).
+    uint32_t connectDelayMs = 0;
+    uint32_t loginDelayMs = 0;
+    uint32_t sendDelayMs = 0;
+    bool sessionOpen = false;
+    bool loggedIn = false;
+    unsigned long connects = 0;
+    unsigned long logins = 0;
+    unsigned long sent = 0;
+    std::string lastBody;
+    long lastAttachmentBytes = -1; // -1 if the last message had none
+    const char *error = "";
+
+private:
+    bool command(const char *line, int expectedCode);
+    bool transmit(const MailMessage &message);
+    bool sendAll(const char *data, size_t len);
+    bool sendAttachment(const char *path);
+    int readReply();
+    int socketFd = -1;
+};
+
+// A real listening socket, bound to 127.0.0.1 only, so the HTTP endpoint
+// can be scraped and load-tested from the host.
+class LoopbackTcpServer : public TcpServer
+{
+public:
+    bool begin(uint16_t port) override;
+    bool listening() override { return listenFd >= 0; }
+    int accept() override;
+    int read(int connection, char *buffer, size_t capacity) override;
+    int write(int connection, const char *data, size_t len) override;
+    void close(int connection) override;
+
+    unsigned long accepted = 0;
+    unsigned long bytesSent = 0;
+
+private:
+    int listenFd = -1;
+};
+
+// A real socket, for talking to a local broker (e.g. mosquitto or
+// tools/mqtt_sink.py). With nothing listening, connect() fails and the
+// publisher buffers, as with the broker down.
+class SocketTcpClient : public TcpClient
+{
+public:
+    bool connect(const char *host, uint16_t port, uint32_t timeoutMs) override;
+    bool connected() override { return socketFd >= 0; }
+    bool write(const uint8_t *data, size_t len) override;
+    bool read(uint8_t *buffer, size_t len, uint32_t timeoutMs) override;
+    void close() override;
+
+    unsigned long connects = 0;
+    unsigned long bytesSent = 0;
+
+private:
+    int socketFd = -1;
+};
+
+class FakeStorage : public Storage
+{
+public:
+    bool begin() override { return true; }
+    bool format() override;
+    bool exists(const char *path) override;
+    long readFile(const char *path, char *buffer, size_t capacity) override;
+    bool writeFile(const char *path, const char *data, size_t len) override;
+    long readFileAt(const char *path, size_t offset, char *buffer, size_t capacity) override;
+    bool appendFile(const char *path, const char *data, size_t len) override;
+    long fileSize(const char *path) override;
+    bool remove(const char *path) override;
+    void listFiles(FileVisitor fn, void *context) override;
+    size_t totalBytes() override { return 0xF0000; } // Size of the 'spiffs' partition
+    size_t usedBytes() override;
+
+    unsigned long bytesAppended = 0;
+    unsigned long appends = 0;
+};
+
+class FakeSystem : public System
+{
+public:
+    bool pinHeldLow(uint8_t) override { return resetHeld; }
+    // There is nothing to reboot into on the host, so both end the process.
+    void restart() override;
+    void halt() override;
+    uint32_t freeHeap() override { return 320 * 1024; }
+    uint32_t minFreeHeap() override { return 320 * 1024; }
+    // The ESP32's heap comes in several regions; the largest is about this.
+    uint32_t largestFreeBlock() override { return 110 * 1024; }
+    // Host threads have no stack watermark to read.
+    void *currentTask() override { return nullptr; }
+    uint32_t stackHighWater(void *) override { return 0; }
+    uint8_t *retainedMemory() override { return retained; }
+    bool wokeFromSleep() override { return woke; }
+    // The host keeps its RAM, so the caller carries on as the board would
+    // from setup() on the wake.
+    void deepSleep(uint32_t ms) override;
+
+    bool resetHeld = false;
+    bool woke = false;
+    unsigned long sleeps = 0;
+    uint64_t sleptMs = 0;
+
+private:
+    alignas(8) uint8_t retained[HAL_RETAINED_BYTES] = {};
+};
+
+// Typed access to the fakes behind hal::sensor(), hal::clock() and friends.
+FakeSensor &fakeSensor(uint8_t channel = 0);
+FakeSerialPort &fakeUsbSerial();
+FakeSerialPort &fakeRs232Serial();
+FakeClock &fakeClock();
+FakeNetwork &fakeNetwork();
+FakeMailTransport &fakeMail();
+LoopbackTcpServer &fakeTcpServer();
+SocketTcpClient &fakeMqttSocket();
+FakeStorage &fakeStorage();
+FakeSystem &fakeSystem();
+
+} // namespace native
+} // namespace hal
+
+#endif // !ARDUINO
@@ -0,0 +1,61 @@
+// --- Heap Monitor ---
+// Watches the heap of a unit that runs for months. Every check records
+// the free heap and the largest block that could still be allocated in
+// one piece; their ratio is the fragmentation:
+//   fragmentation % = 100 - largest block * 100 / free heap
+// The ESP32 heap spans several memory regions, so this is never 0 there;
+// what matters is that it does not creep up. The free heap is also kept
+// once an hour for HEAP_TREND_HOURS, to show a slow leak as bytes per hour.
+//
+// Once the largest block has stayed below HEAP_BLOCK_FLOOR (what a TLS
+// session allocates at once, with margin) for HEAP_DEGRADED_CHECKS checks
+// in a row the heap counts as degraded: check() reports it once, and a
+// build with -DHEAP_RESTART_DEGRADED=1 restarts the board at the next
+// quiet moment (the flash log, outbox and settings survive a restart).
+#pragma once
+
+#include <stdint.h>
+
+#define HEAP_CHECK_INTERVAL_MS 60000UL
+#define HEAP_TREND_HOURS 24
+#define HEAP_DEGRADED_CHECKS 15
+#ifndef HEAP_BLOCK_FLOOR
+#define HEAP_BLOCK_FLOOR 40960
+#endif
+#ifndef HEAP_RESTART_DEGRADED
+#define HEAP_RESTART_DEGRADED 0
+#endif
+
+struct HeapStats
+{
+    uint32_t checks;
+    uint32_t freeBytes;    // At the last check
+    uint32_t largestBlock; // At the last check
+    uint8_t fragmentation; // At the last check, %
+    uint8_t maxFragmentation;
+    uint32_t minLargestBlock;
+    uint32_t belowFloor;     // Checks in a row with the largest block below HEAP_BLOCK_FLOOR
+    uint32_t degradedEvents; // Times the heap became degraded
+};
+
+class HeapMonitor
+{
+public:
+    // Takes a sample; call every HEAP_CHECK_INTERVAL_MS. Returns true on the
+    // check at which the heap has just become degraded.
+    bool check();
+    bool degraded() const { return counters.belowFloor >= HEAP_DEGRADED_CHECKS; }
+    // Change of the free heap per hour over the hours kept (negative: it is
+    // shrinking); 0 until two hours have been kept.
+    int32_t freeTrendPerHour() const;
+    const HeapStats &stats() const { return counters; }
+    static uint8_t fragmentation(uint32_t freeBytes, uint32_t largestBlock);
+
+private:
+    HeapStats counters = {};
+    uint32_t hourlyFree[HEAP_TREND_HOURS] = {};
+    uint8_t hoursKept = 0;
+    uint8_t nextHour = 0;
+};
+
+extern HeapMonitor heapMonitor;
@@ -0,0 +1,25 @@
+// --- Latency Histogram ---
+// Fixed-size log2 histogram for durations: bucket i counts values below
+// 2^i (the last bucket takes everything larger), plus exact count, min,
+// max and total. Unit-agnostic; callers say what they record.
+#pragma once
+
+#include <stdint.h>
+
+#define HISTOGRAM_BUCKETS 20 // Up to ~524 s in ms, ~0.5 s in us
+
+struct Histogram
+{
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+
+    void record(uint32_t value);
+    void clear();
+    uint32_t mean() const { return count ? (uint32_t)(total / count) : 0; }
+    // Upper bound of the bucket holding the given percentile (0-100),
+    // clamped to max; 0 if empty.
+    uint32_t percentile(uint8_t percent) const;
+};
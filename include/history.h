@@ -0,0 +1,94 @@
+// --- In-RAM Sample History ---
+// Fixed-capacity ring of packed readings: 6 bytes per sample (timestamp
+// delta, centi-degrees C, centi-percent RH). Samples are grouped in blocks
+// of HISTORY_BLOCK_SAMPLES; each block keeps its start time and running
+// min/max/sum, updated on append, so a windowed query only decodes the one
+// block straddling the window start. The oldest whole block is recycled
+// when the ring is full, so between (HISTORY_BLOCKS - 1) and HISTORY_BLOCKS
+// blocks of samples are held. There is one ring per sensor channel (about
+// 9.4 KB each).
+#pragma once
+
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 24 h at one sample per minute, plus one block of slack.
+#define HISTORY_BLOCK_SAMPLES 60
+#define HISTORY_BLOCKS 25
+
+struct PackedSample
+{
+    uint16_t deltaSec; // Seconds since the previous sample in the block (0 for the first)
+    int16_t centiC;
+    uint16_t centiRH;
+} __attribute__((packed));
+
+enum HistoryMetric : uint8_t
+{
+    HISTORY_TEMPERATURE, // centi-degrees C
+    HISTORY_HUMIDITY,    // centi-percent RH
+};
+
+struct WindowStats
+{
+    uint32_t count;
+    int32_t minCentiC, maxCentiC;
+    int64_t sumCentiC;
+    int32_t minCentiRH, maxCentiRH;
+    int64_t sumCentiRH;
+
+    float meanC() const { return count ? sumCentiC / (100.0f * count) : 0; }
+    float meanRH() const { return count ? sumCentiRH / (100.0f * count) : 0; }
+};
+
+class SampleHistory
+{
+public:
+    static const size_t BYTES_PER_SAMPLE = sizeof(PackedSample);
+    static const size_t CAPACITY = HISTORY_BLOCKS * HISTORY_BLOCK_SAMPLES;
+
+    // O(1). Timestamps are seconds on any monotonic base (see uptimeSeconds()).
+    void append(uint32_t timestampSec, float temperatureC, float humidity);
+    // Aggregates over samples with timestamp in (nowSec - spanSec, nowSec].
+    // Returns false if the window holds no samples.
+    bool window(uint32_t nowSec, uint32_t spanSec, WindowStats &stats) const;
+    // Nearest-rank percentile (0-100) of one metric over the same window.
+    bool percentile(uint32_t nowSec, uint32_t spanSec, HistoryMetric metric,
+                    uint8_t percent, int32_t &value) const;
+
+    size_t size() const { return total; }
+    void clear();
+
+private:
+    struct Block
+    {
+        uint32_t startSec; // Timestamp of s[0]
+        uint32_t endSec;   // Timestamp of s[count - 1]
+        uint16_t count;
+        int16_t minCentiC, maxCentiC;
+        uint16_t minCentiRH, maxCentiRH;
+        int32_t sumCentiC;
+        uint32_t sumCentiRH;
+        PackedSample s[HISTORY_BLOCK_SAMPLES];
+    };
+
+    Block blocks[HISTORY_BLOCKS];
+    uint8_t current = 0; // Block being filled
+    uint8_t used = 0;    // Blocks holding samples
+    size_t total = 0;
+};
+
+// Time since power-up, without the 49-day millis() wrap. millis() starts
+// again after a deep sleep; setUptimeBase() carries the time before it
+// (and the sleep) over, so samples and alert rules see one timeline.
+uint32_t uptimeSeconds();
+uint64_t uptimeMillis();
+void setUptimeBase(uint64_t ms);
+
+// Parses "90s", "30m", "6h", "7d" (plain numbers are minutes, at most 400
+// days) into seconds: the spans 'history', 'log' and /readings take.
+bool parseSpan(const char *text, uint32_t &seconds);
+
+extern SampleHistory history[SENSOR_CHANNELS];
@@ -0,0 +1,99 @@
+// --- Persistent History Log ---
+// Append-only binary log of readings on the LittleFS 'spiffs' partition.
+// Readings are buffered in RAM and written one flash page (25 records) at a
+// time. The log is split into fixed-size segment files /hist_NNNNNNNN.bin
+// that rotate oldest-first; each record carries a CRC16.
+//
+// At boot begin() reads only each segment's header and last record to
+// build an in-RAM time index; a torn tail in the newest segment is detected
+// from its CRC and writing moves on to a fresh segment. A query for a time
+// range picks segments from the index and binary-searches inside them, so
+// it never scans the whole partition.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_LOG_SEGMENT_BYTES 65536 // ~4.5 days at one reading per minute
+#define HISTORY_LOG_MAX_SEGMENTS 12     // 768 KB of the 960 KB partition
+#define HISTORY_LOG_PAGE_BYTES 256      // One flash page per write
+
+// Readings exported as CSV (digest attachments, the HTTP endpoint).
+#define LOG_CSV_HEADER "time_utc,temperature_c,temperature_f,humidity_pct,channel\n"
+#define LOG_CSV_ROW_MAX 52 // "2024-05-01T13:00:00Z,-12.34,9.79,100.00,3\n" + slack
+
+// The channel lives in the two bits humidity never needs (at most 10000),
+// so records written before there were several sensors read as channel 0.
+struct LogRecord
+{
+    uint32_t epoch; // UTC seconds
+    int16_t centiC;
+    uint16_t centiRH : 14;
+    uint16_t channel : 2;
+    uint16_t crc; // CRC16 of the fields above
+} __attribute__((packed));
+
+struct HistoryLogStats
+{
+    uint32_t appended;
+    uint32_t flushes;
+    uint32_t bytesWritten;
+    uint32_t segments;
+    uint32_t rotations;
+    uint32_t tornTails;  // Segments found with a damaged tail at boot
+    uint32_t outOfOrder; // Appends dropped because time went backwards
+    uint32_t crcErrors;  // Bad records skipped during queries
+    uint32_t writeErrors;
+    uint32_t pending;    // Records buffered in RAM
+};
+
+class HistoryLog
+{
+public:
+    // Return false from the visitor to stop the query early.
+    typedef bool (*RecordVisitor)(const LogRecord &record, void *context);
+
+    static const size_t RECORDS_PER_PAGE = HISTORY_LOG_PAGE_BYTES / sizeof(LogRecord);
+
+    // Builds the index from the segments already on flash. Call after the
+    // file system is mounted.
+    bool begin();
+    // Buffers one reading; writes a page when the buffer is full. Readings
+    // of several channels may share an epoch.
+    bool append(uint32_t epoch, uint8_t channel, float temperatureC, float humidity);
+    // Writes whatever is buffered (before a restart or deep sleep).
+    bool flush();
+    // Visits records with fromEpoch <= epoch < toEpoch in time order,
+    // including ones still buffered in RAM. Returns the number visited.
+    size_t query(uint32_t fromEpoch, uint32_t toEpoch, RecordVisitor visit, void *context);
+
+    HistoryLogStats stats() const;
+
+private:
+    struct Segment
+    {
+        uint32_t seq;
+        uint32_t firstEpoch;
+        uint32_t lastEpoch;
+        uint32_t records; // Valid records (a torn tail is excluded)
+    };
+
+    bool startSegment(uint32_t firstEpoch);
+    bool readRecord(const Segment &segment, uint32_t index, LogRecord &record);
+    size_t querySegment(const Segment &segment, uint32_t fromEpoch, uint32_t toEpoch,
+                        RecordVisitor visit, void *context, bool &stop);
+
+    Segment segments[HISTORY_LOG_MAX_SEGMENTS]; // Oldest first
+    uint8_t segmentCount = 0;
+    bool appendable = false; // Newest segment can take more records
+    LogRecord page[RECORDS_PER_PAGE];
+    uint8_t pageUsed = 0;
+    uint32_t lastEpoch = 0;
+    HistoryLogStats counters = {};
+};
+
+// Formats one record as a LOG_CSV_HEADER row into 'out' (at least
+// LOG_CSV_ROW_MAX bytes). Returns its length.
+size_t formatCsvRow(const LogRecord &record, char *out);
+
+extern HistoryLog historyLog;
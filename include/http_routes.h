@@ -0,0 +1,22 @@
+// --- HTTP Routes ---
+// What the HTTP endpoint (http_server.h) serves:
+//   GET /metrics   Prometheus text format: per-channel readings, counters
+//                  and gauges from every module, and the latency
+//                  histograms, one metric per chunk.
+//   GET /readings?since=6h&format=csv
+//                  The flash history log as JSON (default) or CSV; 'since'
+//                  is a span as for 'history' or a Unix time, 24 h if left
+//                  out.
+// Both are written a piece at a time into the server's chunk buffer, from
+// what is already in RAM or on flash; nothing is allocated per request.
+#pragma once
+
+#include "http_server.h"
+
+#include <stddef.h>
+
+#define METRIC_PREFIX "tempsensor_"
+
+// For HttpServer::begin().
+extern const HttpRoute HTTP_ROUTES[];
+extern const size_t HTTP_ROUTE_COUNT;
@@ -0,0 +1,117 @@
+// --- HTTP Endpoint ---
+// A small HTTP/1.1 server for Prometheus scrapes and data pulls, polled
+// from loop() like the consoles. Up to HTTP_MAX_CLIENTS connections are
+// served at once, each with a fixed request buffer and a fixed chunk
+// buffer. A route's writer fills the chunk buffer a piece at a time and the
+// server sends it as one chunk of a chunked response, as fast as the socket
+// takes it. Nothing is allocated per request, and a response of any length
+// (a week of readings) costs the same RAM as a short one.
+//
+// Every response closes its connection. Further clients wait in the
+// socket's listen backlog until a slot is free, and a client that stalls
+// for HTTP_IDLE_TIMEOUT_MS is dropped.
+#pragma once
+
+#include "histogram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_MAX_CLIENTS 3
+#define HTTP_REQUEST_MAX 384      // Request line and headers
+#define HTTP_CHUNK_BYTES 1536     // Body bytes per chunk; a writer's largest piece
+#define HTTP_IDLE_TIMEOUT_MS 5000
+#define HTTP_CHUNKS_PER_POLL 2    // Per client, so a long response can't hog loop()
+
+// Progress of one response, kept by the server and interpreted only by the
+// route: which part it is on, where it got to, options from the query.
+struct HttpStream
+{
+    uint16_t step;
+    uint8_t format;
+    uint32_t index;
+    uint32_t fromEpoch;
+    uint32_t skip;
+};
+
+struct HttpRoute
+{
+    const char *path;
+    // Parses the query string ("" if none) into 'stream'. Returns the
+    // content type, or nullptr to answer 400 Bad Request.
+    const char *(*open)(HttpStream &stream, const char *query);
+    // Appends the next piece of the body to 'buffer'. Returns its length,
+    // 0 when the body is complete, or -1 if the piece needs more than
+    // 'capacity' bytes (the server sends what it has and calls again with
+    // a fresh HTTP_CHUNK_BYTES).
+    int (*write)(HttpStream &stream, char *buffer, size_t capacity);
+};
+
+struct HttpStats
+{
+    uint32_t accepted;
+    uint32_t responses;   // Complete 200 responses
+    uint32_t notFound;
+    uint32_t badRequests; // Malformed, too long, bad query or not GET
+    uint32_t timeouts;
+    uint32_t aborted;     // Client went away mid-response
+    uint32_t chunks;
+    uint64_t bytes;       // Sent, headers included
+    uint8_t maxActive;    // Most connections served at once
+    Histogram responseMs; // Request read until the last chunk is built
+};
+
+class HttpServer
+{
+public:
+    // Starts listening on hal::tcpServer(). 'routes' must outlive the server.
+    bool begin(uint16_t port, const HttpRoute *routes, size_t count);
+    bool running() const { return routeCount > 0; }
+    // Call from loop(): accepts, reads requests and sends a few chunks on
+    // each connection.
+    void poll();
+    const HttpStats &stats() const { return counters; }
+
+    // Copies the value of 'name' from a query string ("a=1&b=2") into
+    // 'value'. Returns false if it is missing or does not fit.
+    static bool queryParam(const char *query, const char *name, char *value, size_t size);
+
+private:
+    enum State : uint8_t
+    {
+        FREE,
+        READING, // Request headers
+        SENDING, // Head or a chunk in 'out'
+        CLOSING, // Last bytes in 'out'
+    };
+
+    struct Client
+    {
+        State state;
+        int connection;
+        uint32_t activeAtMs; // Last progress either way
+        uint32_t requestAtMs;
+        const HttpRoute *route;
+        HttpStream stream;
+        size_t requestUsed;
+        size_t outStart, outEnd;
+        char request[HTTP_REQUEST_MAX];
+        // Room for the chunk-size line before and the CRLF (plus the final
+        // zero chunk) after the body.
+        char out[8 + HTTP_CHUNK_BYTES + 8];
+    };
+
+    void serve(Client &client);
+    void handleRequest(Client &client);
+    void respond(Client &client, const char *status, const char *body);
+    void fillChunk(Client &client);
+    bool flush(Client &client);
+    void finish(Client &client);
+
+    const HttpRoute *routes = nullptr;
+    size_t routeCount = 0;
+    Client clients[HTTP_MAX_CLIENTS] = {};
+    HttpStats counters = {};
+};
+
+extern HttpServer httpServer;
@@ -0,0 +1,100 @@
+// --- Log Fan-Out ---
+// Each status line is formatted once and copied into a preallocated ring
+// per attached sink (USB, RS-232, later network). poll() drains the rings
+// into whatever space the sinks have free, so logging never waits on a
+// 9600 baud UART. A sink that falls behind drops whole new lines and counts
+// them rather than blocking the caller.
+#pragma once
+
+#include "hal.h"
+
+#include <mutex>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_MAX_SINKS 3
+#define LOG_SINK_BUFFER 1024
+#define LOG_LINE_MAX 192
+
+enum LogLevel : uint8_t
+{
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+    LOG_OFF, // As a sink level: mute the sink
+};
+
+class LogSink
+{
+public:
+    virtual ~LogSink() {}
+    // Bytes that can be written right now without blocking.
+    virtual size_t availableForWrite() = 0;
+    virtual size_t write(const char *data, size_t len) = 0;
+};
+
+// Adapts a HAL serial port to a log sink.
+class SerialLogSink : public LogSink
+{
+public:
+    explicit SerialLogSink(hal::SerialPort &port) : port(port) {}
+    size_t availableForWrite() override { return port.availableForWrite(); }
+    size_t write(const char *data, size_t len) override { return port.write(data, len); }
+
+private:
+    hal::SerialPort &port;
+};
+
+struct LogSinkStats
+{
+    uint32_t lines;      // Lines accepted into the ring
+    uint32_t overflows;  // Lines dropped because the ring was full
+    uint32_t filtered;   // Lines below the sink's level
+    uint32_t bytesOut;   // Bytes handed to the sink
+    uint32_t maxPending; // High-water mark of the ring, in bytes
+};
+
+class Logger
+{
+public:
+    // Returns the sink id (used with logTo()), or -1 if all slots are taken.
+    int attach(LogSink &sink, LogLevel minLevel);
+    void setLevel(int sinkId, LogLevel minLevel);
+
+    void debug(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void info(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void warn(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void error(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    // Logs to a single sink only, e.g. the port-specific boot banners.
+    void logTo(int sinkId, LogLevel level, const char *format, ...) __attribute__((format(printf, 4, 5)));
+    void vlogTo(int sinkId, LogLevel level, const char *format, va_list args);
+
+    // Moves as much buffered output to the sinks as they accept without blocking.
+    void poll();
+    // Like poll(), but keeps going until every ring is empty or timeoutMs passes.
+    void flush(uint32_t timeoutMs = 1000);
+
+    bool sinkStats(int sinkId, LogSinkStats &stats);
+
+private:
+    struct Slot
+    {
+        LogSink *sink;
+        LogLevel minLevel;
+        char ring[LOG_SINK_BUFFER];
+        size_t head; // Next byte to send
+        size_t used;
+        LogSinkStats stats;
+    };
+
+    void vlog(uint32_t sinkMask, LogLevel level, const char *format, va_list args);
+    void drain(Slot &slot);
+
+    Slot slots[LOG_MAX_SINKS];
+    int sinkCount = 0;
+    std::mutex lock; // The mail task logs too
+};
+
+extern Logger logger;
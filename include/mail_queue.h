@@ -0,0 +1,60 @@
+// --- Asynchronous Email Delivery ---
+// A dedicated mail task fed by a bounded queue of fixed-size report
+// records. Producers (loop(), manual triggers) enqueue and return at once;
+// the SMTP connect/TLS handshake and send happen on the mail task.
+// On the ESP32 this is a FreeRTOS task and queue, on the native build a
+// std::thread over a fixed ring of records.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAIL_QUEUE_LENGTH 8
+#define MAIL_BODY_SIZE 1024 // A report for four sensors
+#define MAIL_ATTACHMENT_PATH_SIZE 24
+#define MAIL_IDLE_POLL_MS 1000 // How often the idle function runs with nothing queued
+
+struct MailReport
+{
+    char body[MAIL_BODY_SIZE];
+    char attachment[MAIL_ATTACHMENT_PATH_SIZE]; // File on flash, "" for none
+    uint32_t queuedAtMs;
+};
+
+struct MailQueueStats
+{
+    uint32_t enqueued;
+    uint32_t dropped; // Rejected because the queue was full
+    uint32_t sent;
+    uint32_t failed;
+    uint32_t depth;
+    uint32_t maxDepth;
+    uint32_t lastSendMs;
+    uint32_t maxSendMs;
+    uint32_t totalSendMs; // Sum over sent + failed, for the mean
+    uint32_t maxQueueWaitMs; // Longest time a report sat in the queue
+};
+
+class MailQueue
+{
+public:
+    // Sends one report. 'attachmentPath' is nullptr when there is none.
+    // Runs on the mail task; returns true on success.
+    typedef bool (*SendFunction)(const char *body, const char *attachmentPath);
+    // Housekeeping on the mail task while the queue is empty (e.g. closing
+    // an idle SMTP session).
+    typedef void (*IdleFunction)();
+
+    // Creates the queue and starts the mail task.
+    bool begin(SendFunction send, IdleFunction idle = nullptr);
+    // Copies 'body' (and the attachment's path, not its contents) into a
+    // report record. Never blocks; returns false and counts a drop if the
+    // queue is full.
+    bool enqueue(const char *body, const char *attachmentPath = nullptr);
+    MailQueueStats stats();
+    // Lets the mail task finish what is queued and stops it (native only;
+    // the ESP32 task runs forever).
+    void end();
+};
+
+extern MailQueue mailQueue;
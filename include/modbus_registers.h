@@ -0,0 +1,105 @@
+// --- Modbus Register Map ---
+// What the Modbus RTU slave (modbus_slave.h) serves. The register images
+// are rebuilt every MODBUS_REFRESH_MS from what is already in RAM (the
+// last readings, the history, the alert states and counters), so a poll
+// never waits on the sensors. 32-bit values are two registers, high word
+// first.
+//
+// Input registers (0x04):
+//   0      sensors fitted, a bit per channel    1      alert rules
+//   2-3    uptime, s                            4-5    UTC time, s (0 unsynced)
+//   6      time: 0 unsynced, 1 synced, 2 holdover
+//   7      free heap, KiB                       8-9    measurement passes
+//   10-11  sensor failures                      12-13  alerts raised
+//   14-15  alerts cleared                       16-17  flash log records
+//   18-19  Modbus requests                      20-21  Modbus CRC errors
+//   32 + 16 * channel:
+//   +0     1 if a sensor is fitted
+//   +1     temperature, centi-degrees C (signed; 0x8000 without a reading)
+//   +2     humidity, centi-% RH (0xFFFF without a reading)
+//   +3     age of the reading, s
+//   +4/+5  temperature min/max over 24 h       +6/+7  humidity min/max over 24 h
+//   +8     alert rules active, a bit per rule  +9     alert rules pending
+//   +10-11 sensor failures
+// Holding registers (0x03 to read, 0x06 / 0x10 to write):
+//   0      report minute (0xFFFF if report_cron is not "M H,H * * *")
+//   1-2    report hours, a bit per hour (bit 0 midnight)
+//   3      digest_hours       4  duty_s           5  sensor_mps
+//   6      filter_median      7  filter_ema_pct   8  heater_rh
+//   16 + 5 * rule, for up to ALERT_MAX_RULES alert rules:
+//   +0     kind: bit 0 rh (else temp), bit 1 rate of change, bit 2 '>'
+//          (else '<'); 0xFFFF for no rule
+//   +1     threshold x 100 (signed; degrees F or % RH, per minute for a rate)
+//   +2     hysteresis band x 100
+//   +3-4   duration, s
+// A write goes through the same checks as 'cfg set' and is saved at once;
+// a refused value answers exception 3, and the settings before it in the
+// same frame stay written. Other registers read 0 and refuse writes.
+#pragma once
+
+#include "config.h"
+#include "modbus_slave.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MODBUS_REFRESH_MS 1000UL
+
+#define MB_IN_SENSORS 0
+#define MB_IN_RULES 1
+#define MB_IN_UPTIME 2
+#define MB_IN_EPOCH 4
+#define MB_IN_TIME_QUALITY 6
+#define MB_IN_FREE_HEAP 7
+#define MB_IN_PASSES 8
+#define MB_IN_FAILURES 10
+#define MB_IN_RAISED 12
+#define MB_IN_CLEARED 14
+#define MB_IN_LOG_RECORDS 16
+#define MB_IN_REQUESTS 18
+#define MB_IN_CRC_ERRORS 20
+#define MB_IN_CHANNELS 32
+#define MB_IN_CHANNEL_SIZE 16
+
+#define MB_HOLD_REPORT_MINUTE 0
+#define MB_HOLD_REPORT_HOURS 1
+#define MB_HOLD_SETTINGS 3 // digest_hours to heater_rh, one register each
+#define MB_HOLD_RULES 16
+#define MB_HOLD_RULE_SIZE 5
+#define MB_RULE_RH 0x01
+#define MB_RULE_RATE 0x02
+#define MB_RULE_ABOVE 0x04
+#define MB_RULE_NONE 0xFFFF
+
+class ModbusRegisterMap
+{
+public:
+    // Checks and applies one setting as 'cfg set' does; false with a
+    // reason in 'error'.
+    typedef bool (*SettingFunction)(const ConfigField &field, const char *value, char *error, size_t errorSize);
+    // Stores the settings; called once per write that changed any.
+    typedef void (*SaveFunction)();
+
+    void begin(ModbusSlave &slave, SettingFunction apply, SaveFunction save);
+    // Rebuilds both images. Runs every MODBUS_REFRESH_MS and after a
+    // write; nothing here touches the bus.
+    void refresh();
+    // The slave's ModbusSlave::WriteHandler.
+    static ModbusException onWrite(const uint16_t *holding, uint16_t first, uint16_t count);
+
+    // report_cron as "M H,H,... * * *" (or "M * * * *") to a minute and an
+    // hour mask; false for any other schedule.
+    static bool reportHours(const char *cron, uint16_t &minute, uint32_t &hours);
+    // The other way: "M 8-11,14 * * *"; runs of three hours or more as ranges.
+    static void formatReportCron(char *buffer, size_t size, uint16_t minute, uint32_t hours);
+
+private:
+    ModbusException write(const uint16_t *holding, uint16_t first, uint16_t count);
+    bool changed(const uint16_t *holding, uint16_t first, uint16_t count, uint16_t address, uint16_t size) const;
+
+    ModbusSlave *slave = nullptr;
+    SettingFunction apply = nullptr;
+    SaveFunction save = nullptr;
+};
+
+extern ModbusRegisterMap modbusRegisters;
@@ -0,0 +1,121 @@
+// --- Modbus RTU Slave ---
+// Answers a SCADA master polling the RS-232 port. The registers are two
+// images kept in RAM, already in wire order: the application refreshes
+// them on its own schedule (setInput() / setHolding()), and a poll is
+// answered by copying from them, so no request ever waits on a sensor.
+//
+//   0x03  read holding registers   up to MODBUS_MAX_READ in one frame
+//   0x04  read input registers     up to MODBUS_MAX_READ in one frame
+//   0x06  write single register
+//   0x10  write multiple registers up to MODBUS_MAX_WRITE in one frame
+// Anything else gets exception 1 (illegal function); a range past the end
+// of an image exception 2, a bad count or a value the application refuses
+// exception 3. Writes to unit 0 (broadcast) are applied without a reply.
+//
+// Framing is by silence, as RTU requires: a frame ends once the line has
+// been quiet for t3.5 (3.5 characters of 11 bits, fixed at 1750 us above
+// 19200 baud), and the reply goes out after that as one write, so the
+// UART sends it without gaps. The receiver sees bytes only through the
+// UART driver, which cannot time the gaps inside a frame; t1.5 is not
+// checked, and a frame torn by one fails its CRC instead. Frames with a
+// bad CRC, and frames for other units, are dropped without a reply.
+#pragma once
+
+#include "hal.h"
+#include "histogram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MODBUS_FRAME_MAX 256 // RTU ADU limit: address, PDU, CRC
+#define MODBUS_INPUT_REGISTERS 96
+#define MODBUS_HOLDING_REGISTERS 56
+#define MODBUS_MAX_READ 125
+#define MODBUS_MAX_WRITE 123
+#define MODBUS_MAX_UNIT 247
+#define MODBUS_BROADCAST 0
+#define MODBUS_MIN_BAUD 1200
+#define MODBUS_MAX_BAUD 115200
+
+enum ModbusException : uint8_t
+{
+    MODBUS_OK,
+    MODBUS_ILLEGAL_FUNCTION,
+    MODBUS_ILLEGAL_ADDRESS,
+    MODBUS_ILLEGAL_VALUE,
+    MODBUS_DEVICE_FAILURE,
+};
+
+struct ModbusStats
+{
+    uint32_t requests;   // Good frames for this unit (or broadcast)
+    uint32_t responses;  // Replies handed to the UART, exceptions included
+    uint32_t exceptions;
+    uint32_t crcErrors;  // Frames with a bad CRC or too short to hold one
+    uint32_t foreign;    // Good frames for other units
+    uint32_t overruns;   // Frames longer than MODBUS_FRAME_MAX, dropped
+    uint32_t txOverruns; // Replies dropped because the TX buffer was full
+    uint32_t writes;     // Holding registers written
+    Histogram turnaroundUs; // Last request byte received to the reply handed to the UART
+};
+
+class ModbusSlave
+{
+public:
+    // Applies a write. 'holding' is the whole holding image with the new
+    // values already in place at [first, first + count). Returns
+    // MODBUS_OK, after which they are kept in the image, or the exception
+    // to reply with.
+    typedef ModbusException (*WriteHandler)(const uint16_t *holding, uint16_t first, uint16_t count);
+
+    // 'idleBaud' is restored when the slave stops.
+    void begin(hal::SerialPort &port, long idleBaud);
+    // Switches the port to 'baud' and answers as 'unit' (1-247).
+    bool start(uint8_t unit, long baud, WriteHandler onWrite);
+    void stop();
+    bool active() const { return running; }
+    uint8_t unit() const { return unitId; }
+    long baud() const { return lineBaud; }
+    // Collects request bytes, and answers a frame once the line has been
+    // quiet for t3.5. Call from loop(), as often as it comes round.
+    void poll();
+
+    // 32-bit values take two registers, high word first.
+    void setInput(uint16_t address, uint16_t value);
+    void setInput32(uint16_t address, uint32_t value);
+    void setHolding(uint16_t address, uint16_t value);
+    void setHolding32(uint16_t address, uint32_t value);
+    uint16_t holding(uint16_t address) const;
+    const ModbusStats &stats() const { return counters; }
+
+    // Answers one complete frame (CRC included) into 'response', which
+    // has room for MODBUS_FRAME_MAX bytes. Returns the reply's length, 0
+    // for none. poll() uses it; shared with the bench.
+    size_t handle(const uint8_t *request, size_t length, uint8_t *response);
+    // CRC-16/MODBUS: poly 0xA001 (reflected), init 0xFFFF; sent low byte first.
+    static uint16_t crc(const uint8_t *data, size_t length);
+    // t3.5 at 'baud'.
+    static uint32_t frameGapUs(long baud);
+
+private:
+    ModbusException read(const uint8_t *images, uint16_t size, const uint8_t *data, size_t length,
+                         uint8_t *response, size_t &used);
+    ModbusException write(uint16_t first, uint16_t count, const uint8_t *values);
+
+    hal::SerialPort *port = nullptr;
+    long idleBaud = 0;
+    long lineBaud = 0;
+    bool running = false;
+    uint8_t unitId = 0;
+    WriteHandler onWrite = nullptr;
+    uint32_t gapUs = 0;
+    uint32_t lastByteUs = 0;
+    size_t length = 0; // Bytes of the frame being received; past MODBUS_FRAME_MAX it is dropped
+    uint8_t frame[MODBUS_FRAME_MAX];
+    // Big-endian, as sent.
+    uint8_t inputs[MODBUS_INPUT_REGISTERS * 2] = {};
+    uint8_t holdings[MODBUS_HOLDING_REGISTERS * 2] = {};
+    ModbusStats counters = {};
+};
+
+extern ModbusSlave modbus;
@@ -0,0 +1,147 @@
+// --- MQTT Telemetry Publisher ---
+// Sends readings to an MQTT broker in batches, over one persistent
+// connection owned by a background task (FreeRTOS on the ESP32, a
+// std::thread on the native build). loop() only appends to a RAM backlog;
+// the task connects, publishes and keeps the session alive.
+//
+// Each PUBLISH carries up to MQTT_BATCH_MAX samples as compact JSON:
+//   {"t0":1714557600,"dt":[0,0,60],"c":[2155,2203,2158],"rh":[4512,4430,4511],"ch":[0,1,0]}
+// t0 is the Unix time of the first sample, dt the offsets in seconds, c and
+// rh hundredths of a degree Celsius and of a percent, ch the sensor channel
+// (see hal.h); readings of several sensors share a dt. A batch is due once
+// it spans mqtt_interval_s or is full; a backlog left by an outage drains
+// back-to-back.
+//
+// QoS 0 sends and forgets. QoS 1 waits for the broker's PUBACK; a batch
+// leaves the backlog only once it has been acknowledged, so a lost
+// connection means a resend (flagged DUP) and consumers should drop
+// batches whose t0 they have already seen. While the broker cannot be
+// reached the backlog keeps MQTT_BACKLOG_SAMPLES, dropping the oldest
+// beyond that, and connects back off from 5 s to 5 min with jitter.
+//
+// The MQTT 3.1.1 packets (CONNECT, PUBLISH, PINGREQ and their answers)
+// are encoded here over hal::mqttSocket(); nothing is allocated.
+#pragma once
+
+#include "hal.h"
+#include "histogram.h"
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MQTT_BACKLOG_SAMPLES 720   // 12 h at one a minute, 8 bytes each
+#define MQTT_BATCH_MAX 60          // Samples per PUBLISH
+#define MQTT_PACKET_MAX 2048       // A full batch is about 1.1 KB, 1.9 KB at worst
+#define MQTT_KEEPALIVE_S 60
+#define MQTT_TIMEOUT_MS 5000       // Connect, CONNACK, PUBACK, PINGRESP
+#define MQTT_POLL_MS 1000          // Task wake-up with nothing due
+#define MQTT_BACKOFF_BASE_MS 5000UL
+#define MQTT_BACKOFF_MAX_MS 300000UL
+
+enum MqttState : uint8_t
+{
+    MQTT_OFF, // No broker configured, or not enabled yet
+    MQTT_DISCONNECTED,
+    MQTT_CONNECTED,
+    MQTT_BACKOFF,
+};
+
+// Points at the settings buffers; they must outlive the publisher.
+struct MqttSettings
+{
+    const char *host;
+    uint16_t port;
+    const char *topic;
+    const char *user; // "" for none
+    const char *password;
+    uint8_t qos;
+    uint32_t intervalS;
+};
+
+struct MqttStats
+{
+    uint32_t samples;          // Added to the backlog
+    uint32_t dropped;          // Evicted from a full backlog
+    uint32_t published;        // Batches sent (QoS 0) or acknowledged (QoS 1)
+    uint32_t publishedSamples;
+    uint32_t failures;         // Publishes that were not acknowledged
+    uint32_t connects;
+    uint32_t connectFailures;
+    uint32_t pings;
+    uint32_t backlog;
+    uint32_t maxBacklog;
+    uint64_t bytes;            // Sent, all packets
+    Histogram publishUs;       // Batch encode until sent (QoS 0) or PUBACK (QoS 1)
+};
+
+class MqttPublisher
+{
+public:
+    // Starts the task. Nothing connects until setEnabled(true).
+    bool begin(const MqttSettings &settings);
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    // Publishes everything buffered at once rather than waiting for a full
+    // batch or the interval (a duty-cycled board about to sleep).
+    void setDraining(bool draining) { this->draining = draining; }
+    bool configured() const { return settings.host && settings.host[0]; }
+
+    // Appends a reading to the backlog; never blocks on the network.
+    void add(uint32_t epoch, uint8_t channel, float temperatureC, float humidity);
+    // One pass of the task: reconnects, pings, publishes what is due (or
+    // everything buffered with 'force'). Returns true if a batch went out.
+    // Public for the native benchmark, which drives it after end().
+    bool step(bool force = false);
+    // Stops the task (native only; the ESP32 task runs forever).
+    void end();
+
+    MqttState state() const { return (MqttState)currentState.load(); }
+    MqttStats stats();
+    static const char *stateName(MqttState state);
+
+private:
+    struct Record
+    {
+        uint32_t epoch;
+        int16_t centiC;
+        uint16_t centiRH : 14; // At most 10000
+        uint16_t channel : 2;
+    };
+
+    bool connect();
+    void fail(bool connecting);
+    bool due(bool force);
+    bool publish();
+    bool ping();
+    size_t encodeBatch(const Record *records, size_t count, bool dup, size_t &start);
+    bool sendPacket(size_t start, size_t len);
+    bool readPacket(uint8_t type, uint8_t *body, size_t len);
+
+    MqttSettings settings = {};
+    char clientId[24] = "";
+    std::atomic<bool> enabled{false};
+    std::atomic<bool> draining{false};
+    std::atomic<uint8_t> currentState{MQTT_OFF};
+    uint32_t backoffUntilMs = 0;
+    uint32_t consecutiveFailures = 0;
+    uint32_t lastSentMs = 0;
+    uint32_t random = 0;
+    uint16_t packetId = 0;
+    uint32_t resendSequence = UINT32_MAX; // First sample of a batch that failed
+
+    // Backlog ring, shared with add(); 'sequence' numbers every sample so a
+    // batch can be retired even if add() evicted part of it meanwhile.
+    Record backlog[MQTT_BACKLOG_SAMPLES];
+    size_t head = 0;
+    size_t count = 0;
+    uint32_t headSequence = 0;
+    MqttStats counters = {};
+    std::mutex lock;
+
+    // Task-side buffers.
+    Record batch[MQTT_BATCH_MAX];
+    uint8_t packet[MQTT_PACKET_MAX];
+};
+
+extern MqttPublisher mqttPublisher;
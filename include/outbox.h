@@ -0,0 +1,72 @@
+// --- Persistent Outbox ---
+// Reports that cannot be handed to SMTP (the relay is backing off, the
+// mail queue is full, or a send failed) are kept on LittleFS instead of
+// being dropped, and sent in order once the relay is reachable again.
+//
+// The outbox is a ring of OUTBOX_SLOTS fixed-size records, one file per
+// slot (/outbox_NN.bin, NN = sequence % OUTBOX_SLOTS):
+//   header  magic u32 "OBX1", sequence u32, queued epoch u32, length u16,
+//           crc u16 (CRC-16 over the header before it and the body)
+//   body    'length' bytes of report text, at most MAIL_BODY_SIZE - 1
+// The read cursor is the oldest sequence still on flash, the write cursor
+// one past the newest; both are rebuilt from the slot headers at boot, so
+// nothing else has to be written to keep them. A record is written in one
+// go and removed once sent. A power cut mid-write leaves a slot with a bad
+// CRC or length, which is skipped and counted. When the ring is full the
+// new report takes the oldest one's slot (oldest-first eviction).
+//
+// push() may be called from loop() and the mail task; peek() and pop()
+// from the mail task only.
+#pragma once
+
+#include "mail_queue.h"
+
+#include <mutex>
+#include <stdint.h>
+
+#define OUTBOX_SLOTS 16 // Four days of the three daily reports, plus alerts
+#define OUTBOX_MAGIC 0x3158424FUL // "OBX1"
+
+struct OutboxReport
+{
+    uint32_t seq;
+    uint32_t queuedEpoch; // UTC seconds, 0 if the clock was not set
+    char body[MAIL_BODY_SIZE];
+};
+
+struct OutboxStats
+{
+    uint32_t queued;
+    uint32_t flushed;     // Sent from the outbox
+    uint32_t evicted;     // Oldest reports overwritten by newer ones
+    uint32_t damaged;     // Slots with a bad header, length or CRC
+    uint32_t writeErrors;
+    uint32_t pending;
+    uint32_t maxPending;
+};
+
+class Outbox
+{
+public:
+    // Rebuilds the cursors from the slots on flash. Call after the file
+    // system is mounted.
+    bool begin();
+    // Stores a report, evicting the oldest one if the ring is full.
+    bool push(uint32_t epoch, const char *body);
+    // Reads the oldest report without removing it; damaged slots on the way
+    // are dropped. Returns false if there is none.
+    bool peek(OutboxReport &report);
+    // Removes report 'seq' once it has been sent (a no-op if it was evicted
+    // meanwhile).
+    void pop(uint32_t seq);
+    uint32_t pending();
+    OutboxStats stats();
+
+private:
+    uint32_t readSeq = 0;  // Oldest record
+    uint32_t writeSeq = 0; // Next record
+    OutboxStats counters = {};
+    std::mutex lock;
+};
+
+extern Outbox outbox;
@@ -0,0 +1,115 @@
+// --- Hot-Path Profiler ---
+// Fixed-memory timing of the code paths that decide how responsive the
+// device is: each loop() pass, the serial drains, time keeping, manual and
+// report reads, and the email send on the mail task. A ProfileScope reads
+// the CPU cycle counter when it is created and when it goes out of scope
+// and records the difference, in microseconds, into that point's log2
+// histogram (see histogram.h). Two cycle-counter reads and one
+// histogram update cost well under a microsecond on the ESP32, so it
+// stays on in production builds; build with -DPROFILER_ENABLED=0 to
+// compile every scope away.
+//
+// Alongside the histograms the profiler keeps a list of the application's
+// tasks, so the 'stats prof' command can show each one's stack high-water
+// mark next to the free and lowest free heap. 'stats reset' clears the
+// histograms; the heap and stack marks are kept by the system since boot.
+//
+// Each point is recorded from one task only (the mail send on the mail
+// task, everything else on loop()), so recording needs no lock. A dump
+// running while the mail task records may show that one histogram a
+// sample out of step.
+#pragma once
+
+#include "histogram.h"
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <esp_cpu.h>
+#else
+#include <chrono>
+#endif
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_MAX_TASKS 6
+
+enum ProfilePoint : uint8_t
+{
+    PROF_LOOP,          // One loop() pass
+    PROF_SERIAL,        // Log and telemetry drains to the UARTs
+    PROF_TIME,          // Time service poll and its events (was syncTime())
+    PROF_READ_PRINT,    // performSensorReadingAndPrint()
+    PROF_READ_REPORT,   // readAndReportSensor()
+    PROF_SEND_EMAIL,    // sendSensorEmail() on the mail task, in ms
+    PROF_POINTS,
+};
+
+struct ProfileTask
+{
+    const char *name;
+    void *handle; // hal::System::currentTask()
+};
+
+class Profiler
+{
+public:
+    // Reads the CPU clock rate for cycle conversions.
+    void begin();
+    // Registers the calling task for stack reporting; call from the task.
+    void addTask(const char *name);
+
+    void record(ProfilePoint point, uint32_t value) { histograms[point].record(value); }
+    void recordCycles(ProfilePoint point, uint32_t cycles) { record(point, cycles / cyclesPerUs); }
+    void reset();
+
+    const Histogram &histogram(ProfilePoint point) const { return histograms[point]; }
+    static const char *pointName(ProfilePoint point);
+    static const char *unitName(ProfilePoint point);
+    size_t taskCount() const { return tasks.load(); }
+    const ProfileTask &task(size_t index) const { return taskList[index]; }
+
+    static uint32_t cycles()
+    {
+#ifdef ARDUINO
+        return (uint32_t)esp_cpu_get_cycle_count();
+#else
+        // Nanoseconds stand in for cycles on the host.
+        using namespace std::chrono;
+        return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    // Milliseconds of real time, for the points too long for the 32-bit
+    // cycle counter (it wraps after ~18 s at 240 MHz).
+    static uint32_t wallMs();
+
+private:
+    Histogram histograms[PROF_POINTS] = {};
+    uint32_t cyclesPerUs = 1000;
+    ProfileTask taskList[PROFILER_MAX_TASKS] = {};
+    std::atomic<size_t> tasks{0}; // Entries below this are complete
+    std::mutex taskLock;
+};
+
+extern Profiler profiler;
+
+// Times the enclosing block into 'point'.
+class ProfileScope
+{
+public:
+#if PROFILER_ENABLED
+    explicit ProfileScope(ProfilePoint point) : point(point), start(Profiler::cycles()) {}
+    ~ProfileScope() { profiler.recordCycles(point, Profiler::cycles() - start); }
+
+private:
+    ProfilePoint point;
+    uint32_t start;
+#else
+    explicit ProfileScope(ProfilePoint) {}
+#endif
+};
@@ -0,0 +1,95 @@
+// --- Fixed-Point Readings ---
+// Integer arithmetic from the SHT31's raw 16-bit ticks to decimal text, for
+// every line that shows a reading (serial, email, CSV, JSON). Values are
+// carried as hundredths (centi-degrees, centi-percent) and written with
+// formatFixed(), so no output path needs the float printf machinery,
+// which costs thousands of cycles per %.2f on the ESP32's newlib.
+//
+// The unit of the human-readable temperature lines is chosen at compile
+// time with -DREADING_TEMPERATURE_UNIT=READING_UNIT_CELSIUS (default
+// Fahrenheit, as the reports have always been). Alert rules keep their
+// own unit (°F, see alerts.h); the CSV and JSON exports always carry
+// Celsius (and the CSV Fahrenheit too).
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define READING_UNIT_CELSIUS 0
+#define READING_UNIT_FAHRENHEIT 1
+
+#ifndef READING_TEMPERATURE_UNIT
+#define READING_TEMPERATURE_UNIT READING_UNIT_FAHRENHEIT
+#endif
+
+#if READING_TEMPERATURE_UNIT == READING_UNIT_FAHRENHEIT
+#define READING_TEMPERATURE_SUFFIX "F"
+#else
+#define READING_TEMPERATURE_SUFFIX "C"
+#endif
+
+// Longest formatFixed() output, terminator included: "-21474836.48".
+#define READING_TEXT_MAX 13
+
+// SHT31 datasheet conversions, rounded to the nearest hundredth:
+//   T = -45 + 175 * ticks / 65535 °C  (= -49 + 315 * ticks / 65535 °F)
+//   RH = 100 * ticks / 65535 %
+// The products stay below 2^32.
+inline int32_t sht31CentiC(uint16_t ticks)
+{
+    return (int32_t)((17500u * ticks + 32767u) / 65535u) - 4500;
+}
+
+inline int32_t sht31CentiF(uint16_t ticks)
+{
+    return (int32_t)((31500u * ticks + 32767u) / 65535u) - 4900;
+}
+
+inline int32_t sht31CentiRH(uint16_t ticks)
+{
+    return (int32_t)((10000u * ticks + 32767u) / 65535u);
+}
+
+// 'value' / 'divisor', rounded half away from zero.
+inline int32_t roundedDiv(int32_t value, int32_t divisor)
+{
+    return value >= 0 ? (value + divisor / 2) / divisor : (value - divisor / 2) / divisor;
+}
+
+inline int32_t centiCToCentiF(int32_t centiC)
+{
+    return roundedDiv(centiC * 9, 5) + 3200;
+}
+
+// Hundredths of a degree in the compile-time unit.
+inline int32_t centiTemperature(int32_t centiC)
+{
+#if READING_TEMPERATURE_UNIT == READING_UNIT_FAHRENHEIT
+    return centiCToCentiF(centiC);
+#else
+    return centiC;
+#endif
+}
+
+// Writes value / 10^decimals (decimals 0-3) as text with that many
+// decimals, e.g. (-1234, 2) -> "-12.34", and a terminator. 'out' needs
+// READING_TEXT_MAX bytes. Returns the length.
+size_t formatFixed(char *out, int32_t value, uint8_t decimals);
+
+// Hundredths with two decimals: "21.55".
+inline size_t formatCenti(char *out, int32_t centi)
+{
+    return formatFixed(out, centi, 2);
+}
+
+// Hundredths rounded to one decimal: "45.1".
+inline size_t formatCentiTenths(char *out, int32_t centi)
+{
+    return formatFixed(out, roundedDiv(centi, 10), 1);
+}
+
+// A Celsius reading in the compile-time unit, two decimals.
+inline size_t formatTemperature(char *out, int32_t centiC)
+{
+    return formatCenti(out, centiTemperature(centiC));
+}
@@ -0,0 +1,41 @@
+// --- Sample Filters ---
+// Fixed-memory smoothing of the raw SHT31 ticks, applied per sensor and
+// quantity before any consumer (alerts, history, logs, reports) sees a
+// reading. Two stages:
+//   median  over the last 'median' readings (1 = off): a single glitched
+//           reading never gets through, a real change is delayed by
+//           about half the window
+//   EMA     exponential moving average giving the new value 'emaPercent'
+//           of the weight (100 = off), to even out sensor noise
+// Everything is integer arithmetic on the 16-bit ticks, kept with 8
+// fraction bits in the EMA; at most FILTER_MEDIAN_MAX ticks per filter.
+#pragma once
+
+#include <stdint.h>
+
+#define FILTER_MEDIAN_MAX 9
+
+struct FilterSettings
+{
+    uint8_t median;     // Window, 1 to FILTER_MEDIAN_MAX
+    uint8_t emaPercent; // 1 to 100
+};
+
+class TickFilter
+{
+public:
+    // Forgets the history; the next reading passes unchanged.
+    void reset()
+    {
+        used = 0;
+        next = 0;
+    }
+    // Feeds one reading and returns the filtered value.
+    uint16_t apply(uint16_t ticks, const FilterSettings &settings);
+
+private:
+    uint16_t window[FILTER_MEDIAN_MAX];
+    uint8_t used = 0; // Readings in 'window'
+    uint8_t next = 0; // Where the next one goes
+    uint32_t ema = 0; // Ticks << 8
+};
@@ -0,0 +1,112 @@
+// --- Job Scheduler ---
+// Runs loop()'s periodic work (sensor checks, reports, health checks, time
+// resync, log flushes) from one hashed timer wheel instead of a millis()
+// poller per job. Every armed job has an absolute due time in millis() and
+// is filed under slot (due / SCHEDULER_TICK_MS) % SCHEDULER_WHEEL_SLOTS, so
+// poll() only walks the slots whose tick has come round since the last
+// call. Jobs due further out than one turn of the wheel stay in their slot
+// and are passed over until their time comes.
+//
+// Interval jobs re-arm from their previous due time, so they don't drift by
+// however late loop() got to them; runs missed entirely (a long stall) are
+// skipped and counted. Cron jobs follow a local-time schedule such as
+// "0 9,13,16 * * *" and are re-armed from the wall clock after each run; they
+// wait, unarmed, until the clock has been synced, and retime() re-arms them
+// after it is set or stepped. Each run records how late it started.
+//
+// Cron expressions have the usual five fields, minute hour day-of-month
+// month day-of-week, each '*', a number, a range 'a-b' or a list of them,
+// optionally with a '/step' ("*/15", "8-18/2"). Day-of-week is 0-7 with
+// 0 and 7 both Sunday; if both day fields are restricted either may match.
+#pragma once
+
+#include "histogram.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define SCHEDULER_MAX_JOBS 12 // Eight used with every feature on
+#define SCHEDULER_WHEEL_SLOTS 32
+#define SCHEDULER_TICK_MS 1000 // One turn of the wheel is 32 s
+#define SCHEDULER_CRON_MAX 40  // Longest cron expression, with terminator
+
+struct CronSchedule
+{
+    uint64_t minutes;  // Bit n: minute n
+    uint32_t hours;    // Bit n: hour n
+    uint32_t days;     // Bit n: day of month n (1-31)
+    uint16_t months;   // Bit n: month n (1-12)
+    uint8_t weekdays;  // Bit n: day n of the week (0 = Sunday)
+    bool anyDay;       // Day of month was '*'
+    bool anyWeekday;   // Day of week was '*'
+
+    // Returns false, leaving the schedule unchanged, for a bad expression.
+    bool parse(const char *text);
+    // The first matching minute after 'after' in local time, or 0 if there
+    // is none in the next eight years (e.g. "0 0 31 2 *").
+    time_t next(time_t after) const;
+};
+
+struct SchedulerJobStats
+{
+    uint32_t runs;
+    uint32_t skipped; // Interval runs missed entirely during a stall
+    uint32_t maxRunMs;
+    Histogram lateMs; // Start time minus due time
+};
+
+class Scheduler
+{
+public:
+    typedef void (*JobFunction)();
+
+    // Registers a job, initially unarmed. Returns its id, or -1 when the
+    // table is full. The calls below ignore an id that add() did not
+    // return (cron() returns false, the queries report an unarmed job).
+    int add(const char *name, JobFunction run);
+    // Runs the job every intervalMs, the first time in firstInMs.
+    void every(int job, uint32_t intervalMs, uint32_t firstInMs);
+    // Runs the job on a cron schedule. Returns false for a bad expression.
+    bool cron(int job, const char *expression);
+    void cancel(int job);
+    // Re-arms every cron job from the wall clock; call after it has been
+    // set or stepped.
+    void retime();
+    // Runs the jobs that are due. Call from loop().
+    void poll();
+
+    int jobCount() const { return jobsUsed; }
+    const char *name(int job) const { return valid(job) ? jobs[job].name : "?"; }
+    bool armed(int job) const { return valid(job) && jobs[job].armed; }
+    bool isCron(int job) const { return valid(job) && jobs[job].isCron; }
+    uint32_t dueInMs(int job) const;
+    const SchedulerJobStats &stats(int job) const;
+
+private:
+    struct Job
+    {
+        const char *name;
+        JobFunction run;
+        uint32_t dueMs;
+        uint32_t intervalMs;
+        time_t dueEpoch; // Cron jobs: the minute they are armed for
+        bool armed;
+        bool isCron;
+        CronSchedule schedule;
+        Job *next; // Next job in the same wheel slot
+        SchedulerJobStats counters;
+    };
+
+    bool valid(int job) const { return job >= 0 && job < jobsUsed; }
+    void arm(Job &job, uint32_t dueMs);
+    void unlink(Job &job);
+    void armCron(Job &job);
+    void runDue(uint32_t slot, uint32_t nowMs);
+
+    Job jobs[SCHEDULER_MAX_JOBS] = {};
+    int jobsUsed = 0;
+    Job *wheel[SCHEDULER_WHEEL_SLOTS] = {};
+    uint32_t lastTick = 0;
+};
+
+extern Scheduler scheduler;
@@ -0,0 +1,111 @@
+// --- SMTP Connection Manager ---
+// Owns the SMTP session for the mail task: when to connect, log in,
+// keep or close the session, and how long to wait after a failure.
+//
+//   IDLE --send()/poll()--> CONNECTING --ok--> READY --policy--> IDLE
+//                               |  fail                |  send fails
+//                               v                      v
+//                            BACKOFF <-----------------+
+//
+// BACKOFF waits a jittered exponential delay (5 s doubling up to 15 min)
+// before the next attempt; sends during it fail at once instead of
+// hammering the relay. The policy decides what happens after a send:
+//   persistent - keep the session open, reconnect proactively from poll()
+//   ondemand   - close after every send, or after the last of a run (see send())
+//   idle       - keep it open, close after idleCloseMs without a send
+// Handshake (TCP + TLS + EHLO), auth and send times go into histograms so
+// the cheapest policy for a relay can be read off 'stats'. ESP Mail Client
+// does not expose TLS session resumption on the ESP32, so the persistent
+// and idle policies are how handshakes are saved.
+//
+// send() and poll() must only be called from the mail task; state() and
+// stats() may be read from anywhere.
+#pragma once
+
+#include "hal.h"
+#include "histogram.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+#define SMTP_BACKOFF_BASE_MS 5000UL
+#define SMTP_BACKOFF_MAX_MS 900000UL // The old fixed 15-minute retry
+
+enum SmtpPolicy : uint8_t
+{
+    SMTP_PERSISTENT,
+    SMTP_ON_DEMAND,
+    SMTP_CLOSE_AFTER_IDLE,
+};
+
+enum SmtpState : uint8_t
+{
+    SMTP_IDLE,
+    SMTP_CONNECTING,
+    SMTP_READY,
+    SMTP_BACKOFF,
+};
+
+struct SmtpStats
+{
+    uint32_t connects;
+    uint32_t connectFailures; // Handshake or login failed
+    uint32_t sends;
+    uint32_t sendFailures;
+    uint32_t reused;       // Sends on an already open session
+    uint32_t idleCloses;
+    uint32_t backoffRejects; // Sends refused while backing off
+    uint32_t consecutiveFailures;
+    Histogram handshakeMs;
+    Histogram authMs;
+    Histogram sendMs;
+};
+
+class SmtpManager
+{
+public:
+    void begin(hal::MailTransport &transport, const hal::MailServerConfig &server,
+               SmtpPolicy policy, uint32_t idleCloseMs);
+    // Nothing connects until enabled (TLS needs the clock to be set).
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+
+    // Connects if needed and sends. Returns false, without touching the
+    // network, while backing off. 'more' says another message follows at
+    // once, so the session stays open for it whatever the policy.
+    bool send(const hal::MailMessage &message, bool more = false);
+    // Applies the policy while no mail is waiting: closes an idle session
+    // or reconnects a persistent one.
+    void poll();
+
+    // False while disabled or backing off, i.e. mail queued now would fail.
+    bool available() const { return enabled && state() != SMTP_BACKOFF; }
+    SmtpState state() const { return (SmtpState)currentState.load(); }
+    SmtpPolicy policy() const { return sessionPolicy; }
+    uint32_t backoffRemainingMs() const;
+    SmtpStats stats();
+
+    static bool parsePolicy(const char *text, SmtpPolicy &policy);
+    static const char *policyName(SmtpPolicy policy);
+    static const char *stateName(SmtpState state);
+
+private:
+    bool connect();
+    void close();
+    void fail();
+    void setState(SmtpState state) { currentState = state; }
+
+    hal::MailTransport *transport = nullptr;
+    hal::MailServerConfig server = {};
+    SmtpPolicy sessionPolicy = SMTP_ON_DEMAND;
+    uint32_t idleCloseMs = 0;
+    std::atomic<bool> enabled{false};
+    std::atomic<uint8_t> currentState{SMTP_IDLE};
+    std::atomic<uint32_t> backoffUntilMs{0};
+    uint32_t lastUseMs = 0;
+    uint32_t random = 0;
+    SmtpStats counters = {};
+    std::mutex lock; // Guards counters against stats() readers
+};
+
+extern SmtpManager smtpManager;
@@ -0,0 +1,73 @@
+// --- Binary Telemetry Streaming ---
+// Continuous framed readings on the RS-232 port for data loggers. Frames
+// are only handed to the UART when its driver TX buffer has room for the
+// whole frame, so streaming never blocks sampling; a frame that does not
+// fit is dropped and counted (the receiver sees a sequence gap). With
+// several sensors fitted, successive polls take turns over them.
+//
+// Frame (little-endian, 20 bytes):
+//   0xA5 0x5A             sync
+//   type   u8             TELEMETRY_TYPE_READING
+//   length u8             payload bytes (14)
+//   seq    u16            increments per frame, wraps
+//   uptime u32            ms since boot when the sample was measured
+//   epoch  u32            UTC seconds, 0 if time is not synced
+//   temp   i16            centi-degrees C
+//   rh     u16            centi-percent RH (bits 0-13), sensor channel (bits 14-15)
+//   crc    u16            CRC-16/CCITT-FALSE over type..rh
+// tools/telemetry_decode.py decodes the stream on a host.
+#pragma once
+
+#include "acquisition.h"
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_SYNC0 0xA5
+#define TELEMETRY_SYNC1 0x5A
+#define TELEMETRY_TYPE_READING 0x01
+#define TELEMETRY_FRAME_BYTES 20
+#define TELEMETRY_MAX_RATE_HZ 1000
+#define TELEMETRY_MAX_BAUD 921600
+// Frames reuse a reading up to this old rather than measuring every frame;
+// one SHT31 conversion takes ~15 ms.
+#define TELEMETRY_MIN_SAMPLE_MS 100
+
+struct TelemetryStats
+{
+    uint32_t frames;   // Frames handed to the UART
+    uint32_t overruns; // Frames dropped because the TX buffer was full
+    uint32_t skipped;  // Frame slots skipped after a long stall in loop()
+    uint32_t sensorErrors;
+    uint32_t bytes;
+};
+
+class TelemetryStream
+{
+public:
+    // 'idleBaud' is restored when streaming stops.
+    void begin(hal::SerialPort &port, long idleBaud);
+    // Switches the port to 'baud' and starts emitting 'rateHz' frames per second.
+    bool start(uint16_t rateHz, long baud);
+    void stop();
+    bool active() const { return streaming; }
+    // Emits any frames that are due. Call from loop().
+    void poll();
+    const TelemetryStats &stats() const { return counters; }
+
+    // Builds one frame into 'out' (TELEMETRY_FRAME_BYTES); shared with tools.
+    static size_t encode(uint8_t *out, uint16_t seq, const Sample &sample, uint32_t epoch);
+
+private:
+    hal::SerialPort *port = nullptr;
+    long idleBaud = 0;
+    bool streaming = false;
+    uint32_t periodUs = 0;
+    uint32_t nextDueUs = 0;
+    uint16_t seq = 0;
+    uint8_t channel = 0; // Next frame's sensor
+    TelemetryStats counters = {};
+};
+
+extern TelemetryStream telemetry;
@@ -0,0 +1,107 @@
+// --- Time Service ---
+// Keeps the wall clock without ever blocking loop(). SNTP runs in the
+// background (see hal::Clock::onTimeSync) and reports each exchange through
+// a callback. poll() picks the result up on loop(). Nothing waits for an
+// answer.
+//
+// Each sync is compared with where the board's own oscillator would have
+// put the clock. That gives the clock offset since the previous sync and,
+// over syncs at least TIME_DRIFT_MIN_INTERVAL_S apart, the oscillator's
+// drift in ppm. Between syncs correct() slews the estimated drift out of
+// the clock a little at a time. When syncs stop (WiFi or NTP down), the
+// service enters holdover. The clock keeps running drift-corrected, and
+// samples, reports and the scheduler keep using it. Only a clock that was
+// never set is unusable.
+#pragma once
+
+#include "histogram.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+#define TIME_SYNC_INTERVAL_MS 900000UL   // SNTP exchange every 15 minutes
+#define TIME_HOLDOVER_AFTER_S 1860       // Two syncs missed (plus a minute): holdover
+#define TIME_CORRECT_INTERVAL_MS 60000UL // How often correct() should run
+#define TIME_DRIFT_MIN_INTERVAL_S 600    // Closer syncs are too coarse (1 ms steps) for a drift estimate
+#define TIME_DRIFT_MAX_PPM 500           // A bigger offset is a step, not drift
+#define TIME_DRIFT_GAIN 0.25f            // Weight of each new drift measurement
+
+enum TimeQuality : uint8_t
+{
+    TIME_UNSYNCED, // Never set since boot
+    TIME_SYNCED,   // Set by NTP within TIME_HOLDOVER_AFTER_S
+    TIME_HOLDOVER, // Running on the drift-corrected oscillator
+};
+
+enum TimeEvent : uint8_t
+{
+    TIME_EVENT_NONE,
+    TIME_EVENT_FIRST_SYNC,
+    TIME_EVENT_SYNC,     // Later syncs (the clock may have been stepped)
+    TIME_EVENT_HOLDOVER, // Syncs stopped
+};
+
+struct TimeStats
+{
+    uint32_t syncs;
+    uint32_t requests;     // requestSync() calls
+    bool driftKnown;
+    float driftPpm;        // Oscillator rate error, positive = fast
+    int32_t lastOffsetMs;  // At the last sync: NTP minus the drift-corrected clock
+    int32_t rawOffsetMs;   // At the last sync: NTP minus the uncorrected oscillator
+    int32_t maxOffsetMs;   // Largest |lastOffsetMs|
+    int32_t slewedMs;      // Correction applied since the last sync
+    uint32_t holdovers;
+    uint32_t longestHoldoverS;
+    Histogram answerMs;    // begin() or requestSync() until the answer
+};
+
+class TimeService
+{
+public:
+    // Starts SNTP with the POSIX time zone. Returns at once; call again
+    // after a reconnect is harmless.
+    void begin(const char *timeZone);
+    bool started() const { return running; }
+    // Call from loop(): picks up SNTP results and notices holdover.
+    TimeEvent poll();
+    // Slews the drift accumulated since the last sync out of the clock.
+    // Run every TIME_CORRECT_INTERVAL_MS.
+    void correct();
+    // Asks for an NTP exchange now (e.g. after WiFi came back).
+    void requestSync();
+
+    TimeQuality quality() const;
+    bool valid() const { return quality() != TIME_UNSYNCED; }
+    // UTC seconds, drift-corrected; meaningless while !valid().
+    time_t now() const;
+    // Local time; false while !valid().
+    bool localTime(struct tm &info) const;
+    uint32_t secondsSinceSync() const;
+    const TimeStats &stats() const { return counters; }
+    static const char *qualityName(TimeQuality quality);
+
+private:
+    static void onSync(int64_t epochUs);
+    uint64_t localMs() const; // millis() extended to 64 bits
+
+    // Written by the SNTP task, read by poll().
+    std::atomic<bool> pending{false};
+    std::atomic<uint32_t> pendingSeconds{0};
+    std::atomic<uint32_t> pendingMicros{0};
+    std::atomic<uint32_t> pendingAtMs{0};
+
+    bool running = false;
+    bool inHoldover = false;
+    bool awaiting = false;     // An answer to begin() or requestSync() is due
+    uint32_t requestedAtMs = 0;
+    uint64_t extendedMs = 0; // localMs() as of the last poll()
+    uint32_t lastMillis = 0;
+    int64_t syncEpochUs = 0; // NTP time at the last sync
+    uint64_t syncLocalMs = 0; // localMs() at the last sync
+    int64_t slewedUs = 0;
+    TimeStats counters = {};
+};
+
+extern TimeService timeService;
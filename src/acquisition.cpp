@@ -0,0 +1,208 @@
+// --- Sensor Acquisition ---
+#include "acquisition.h"
+
+#include "reading_format.h"
+
+SensorAcquisition acquisition;
+
+bool SensorAcquisition::startMode(uint8_t channel)
+{
+    modeStartUs = hal::clock().micros();
+    fetchedSinceStart &= ~(1u << channel);
+    return hal::sensor(channel).setPeriodic(current.mps, current.repeatability);
+}
+
+void SensorAcquisition::configure(const AcquisitionSettings &settings)
+{
+    current = settings;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        temperatureFilters[channel].reset();
+        humidityFilters[channel].reset();
+        if (!present(channel))
+            continue;
+        if (heating(channel))
+            hal::sensor(channel).setHeater(false);
+        heaterPhase[channel] = HEATER_OFF;
+        startMode(channel);
+    }
+    cached = 0;
+    lastPassMs = hal::clock().millis();
+}
+
+int SensorAcquisition::discover()
+{
+    int found = 0;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        if (present(channel) || !hal::sensor(channel).begin())
+            continue;
+        fitted |= 1u << channel;
+        if (current.mps)
+            startMode(channel);
+        found++;
+    }
+    return found;
+}
+
+bool SensorAcquisition::read(uint8_t channel, Sample &sample, uint32_t maxAgeMs)
+{
+    uint8_t bit = 1u << channel;
+    if (current.mps)
+    {
+        // Nothing newer than the last fetch exists until the next period.
+        if (hal::clock().millis() - lastPassMs >= fetchIntervalMs() || !(cached & bit))
+            measure();
+        else
+            counters.hits++;
+        sample = last[channel];
+        return cached & bit;
+    }
+    if ((cached & bit) && (heating(channel) || hal::clock().millis() - last[channel].takenAtMs <= maxAgeMs))
+    {
+        counters.hits++;
+        sample = last[channel];
+        return true;
+    }
+    measure();
+    sample = last[channel];
+    return cached & bit;
+}
+
+void SensorAcquisition::poll()
+{
+    if (fitted == 0)
+        return;
+    uint32_t now = hal::clock().millis();
+    if (current.mps && now - lastPassMs >= fetchIntervalMs())
+        measure();
+    if (current.heaterRH == 0)
+        return;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        if (present(channel))
+            runHeater(channel, now);
+}
+
+void SensorAcquisition::runHeater(uint8_t channel, uint32_t nowMs)
+{
+    uint8_t bit = 1u << channel;
+    switch (heaterPhase[channel])
+    {
+    case HEATER_OFF:
+        if (!(measured & bit) || last[channel].centiRH < current.heaterRH * 100u ||
+            ((heated & bit) && nowMs - heatedAtMs[channel] < SENSOR_HEATER_INTERVAL_MS))
+            return;
+        if (!hal::sensor(channel).setHeater(true))
+            return;
+        heaterPhase[channel] = HEATER_ON;
+        heatedAtMs[channel] = nowMs;
+        heated |= bit;
+        counters.heaterCycles++;
+        break;
+    case HEATER_ON:
+        // Retried every poll until the sensor takes the command.
+        if (nowMs - heaterSinceMs[channel] < SENSOR_HEATER_ON_MS || !hal::sensor(channel).setHeater(false))
+            return;
+        heaterPhase[channel] = HEATER_SETTLING;
+        break;
+    case HEATER_SETTLING:
+        if (nowMs - heaterSinceMs[channel] < SENSOR_HEATER_SETTLE_MS)
+            return;
+        heaterPhase[channel] = HEATER_OFF;
+        // What the filters hold predates the heating.
+        temperatureFilters[channel].reset();
+        humidityFilters[channel].reset();
+        break;
+    }
+    heaterSinceMs[channel] = nowMs;
+}
+
+void SensorAcquisition::store(uint8_t channel, uint16_t temperatureTicks, uint16_t humidityTicks)
+{
+    temperatureTicks = temperatureFilters[channel].apply(temperatureTicks, current.filter);
+    humidityTicks = humidityFilters[channel].apply(humidityTicks, current.filter);
+    // Floats for the alert rules and the RAM history, hundredths for text.
+    Sample &sample = last[channel];
+    sample.temperatureC = -45 + 175.0f * temperatureTicks / 65535;
+    sample.humidity = 100.0f * humidityTicks / 65535;
+    sample.centiC = (int16_t)sht31CentiC(temperatureTicks);
+    sample.centiRH = (uint16_t)sht31CentiRH(humidityTicks);
+    sample.channel = channel;
+    sample.takenAtMs = hal::clock().millis();
+    cached |= 1u << channel;
+    measured |= 1u << channel;
+}
+
+int SensorAcquisition::measure()
+{
+    hal::Clock &clock = hal::clock();
+    counters.misses++;
+    // A heating sensor keeps serving its last reading from before.
+    uint8_t held = 0;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        if (heating(channel))
+            held |= 1u << channel;
+    cached &= held;
+    uint8_t wanted = fitted & ~held;
+
+    uint32_t start = clock.micros();
+    uint8_t started = 0;
+    if (current.mps)
+    {
+        // Just after a sensor entered periodic mode its first conversion
+        // is still running; wait for it once.
+        uint32_t sinceStart = start - modeStartUs;
+        if ((wanted & ~fetchedSinceStart) && sinceStart < SENSOR_CONVERSION_US)
+            clock.delay((SENSOR_CONVERSION_US - sinceStart + 999) / 1000);
+        started = wanted;
+    }
+    else
+    {
+        // Start every conversion, then wait once for the last one started.
+        uint32_t lastStartUs = start;
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        {
+            if (!(wanted & (1u << channel)))
+                continue;
+            if (hal::sensor(channel).start())
+                started |= 1u << channel;
+            lastStartUs = clock.micros();
+        }
+        if (started)
+        {
+            uint32_t waited = clock.micros() - lastStartUs;
+            if (waited < SENSOR_CONVERSION_US)
+                clock.delay((SENSOR_CONVERSION_US - waited + 999) / 1000);
+        }
+    }
+
+    int good = 0;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        uint8_t bit = 1u << channel;
+        if (!(wanted & bit))
+            continue;
+        uint16_t temperatureTicks, humidityTicks;
+        hal::Sensor &sensor = hal::sensor(channel);
+        bool ok = (started & bit) && (current.mps ? sensor.fetch(temperatureTicks, humidityTicks)
+                                                  : sensor.collect(temperatureTicks, humidityTicks));
+        if (!ok)
+        {
+            counters.failures++;
+            counters.channelFailures[channel]++;
+            continue;
+        }
+        fetchedSinceStart |= bit;
+        store(channel, temperatureTicks, humidityTicks);
+        good++;
+    }
+
+    uint32_t elapsed = clock.micros() - start;
+    counters.lastI2cUs = elapsed;
+    if (elapsed > counters.maxI2cUs)
+        counters.maxI2cUs = elapsed;
+    counters.totalI2cUs += elapsed;
+    counters.i2cUs.record(elapsed);
+    lastPassMs = clock.millis();
+    return good;
+}
@@ -0,0 +1,234 @@
+// --- Alert Rules ---
+#include "alerts.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+AlertEngine alerts;
+
+// --- Rule Lists ---
+
+static void setError(char *error, size_t size, const char *rules, const char *at, const char *what)
+{
+    if (error && size)
+        snprintf(error, size, "%s at character %u", what, (unsigned)(at - rules + 1));
+}
+
+static bool isSeparator(char c)
+{
+    return c == ',' || c == ';' || c == ' ';
+}
+
+bool AlertEngine::configure(const char *text, char *error, size_t errorSize)
+{
+    AlertRule parsed[ALERT_MAX_RULES];
+    int parsedCount = 0;
+    const char *p = text;
+    for (;;)
+    {
+        while (isSeparator(*p))
+            p++;
+        if (!*p)
+            break;
+        if (parsedCount == ALERT_MAX_RULES)
+        {
+            setError(error, errorSize, text, p, "Too many rules");
+            return false;
+        }
+        AlertRule rule = {};
+        if (*p == 'd')
+        {
+            rule.rate = true;
+            p++;
+        }
+        if (strncmp(p, "temp", 4) == 0)
+        {
+            rule.metric = ALERT_TEMPERATURE;
+            p += 4;
+        }
+        else if (strncmp(p, "rh", 2) == 0)
+        {
+            rule.metric = ALERT_HUMIDITY;
+            p += 2;
+        }
+        else
+        {
+            setError(error, errorSize, text, p, "Expected temp or rh");
+            return false;
+        }
+        if (*p != '>' && *p != '<')
+        {
+            setError(error, errorSize, text, p, "Expected > or <");
+            return false;
+        }
+        rule.above = *p++ == '>';
+
+        char *end;
+        rule.threshold = strtof(p, &end);
+        if (end == p)
+        {
+            setError(error, errorSize, text, p, "Expected a threshold");
+            return false;
+        }
+        p = end;
+        if (*p == '~')
+        {
+            rule.band = strtof(++p, &end);
+            if (end == p || rule.band < 0)
+            {
+                setError(error, errorSize, text, p, "Expected a hysteresis band");
+                return false;
+            }
+            p = end;
+        }
+        if (*p == '@')
+        {
+            unsigned long n = strtoul(++p, &end, 10);
+            unsigned long scale = *end == 's' ? 1 : *end == 'h' ? 3600 : 60; // Minutes by default
+            if (end == p || n > 7 * 86400UL / scale)
+            {
+                setError(error, errorSize, text, p, "Expected a duration (90s, 5m, 1h)");
+                return false;
+            }
+            rule.minDurationSec = (uint32_t)(n * scale);
+            p = *end == 's' || *end == 'm' || *end == 'h' ? end + 1 : end;
+        }
+        if (*p && !isSeparator(*p))
+        {
+            setError(error, errorSize, text, p, "Unexpected character");
+            return false;
+        }
+        parsed[parsedCount++] = rule;
+    }
+
+    memcpy(rules, parsed, sizeof(parsed[0]) * parsedCount);
+    count = parsedCount;
+    memset(states, 0, sizeof(states));
+    return true;
+}
+
+void AlertEngine::formatRule(const AlertRule &rule, char *buffer, size_t size)
+{
+    int len = snprintf(buffer, size, "%s%s %c %g %s", rule.metric == ALERT_TEMPERATURE ? "temp" : "rh",
+                       rule.rate ? " rate" : "", rule.above ? '>' : '<', rule.threshold, unit(rule));
+    if (rule.band > 0 && len > 0 && (size_t)len < size)
+        len += snprintf(buffer + len, size - len, " ~%g", rule.band);
+    uint32_t seconds = rule.minDurationSec;
+    if (seconds && len > 0 && (size_t)len < size)
+    {
+        if (seconds % 3600 == 0)
+            snprintf(buffer + len, size - len, " @%luh", (unsigned long)(seconds / 3600));
+        else if (seconds % 60 == 0)
+            snprintf(buffer + len, size - len, " @%lum", (unsigned long)(seconds / 60));
+        else
+            snprintf(buffer + len, size - len, " @%lus", (unsigned long)seconds);
+    }
+}
+
+const char *AlertEngine::unit(const AlertRule &rule)
+{
+    if (rule.metric == ALERT_TEMPERATURE)
+        return rule.rate ? "F/min" : "F";
+    return rule.rate ? "%/min" : "%";
+}
+
+// --- Evaluation ---
+
+// Keeps the oldest sample that is at least a window older than the newest,
+// so the rate spans one window (plus up to one sample period). Each sample
+// is added and dropped once: constant work per sample.
+void AlertEngine::RateWindow::add(uint32_t seconds, float value)
+{
+    if (size == ALERT_RATE_SAMPLES)
+    {
+        tail = (tail + 1) % ALERT_RATE_SAMPLES; // Sampling faster than the ring: shorter window
+        size--;
+    }
+    values[head] = value;
+    times[head] = seconds;
+    head = (head + 1) % ALERT_RATE_SAMPLES;
+    size++;
+    while (size > 2 && seconds - times[(tail + 1) % ALERT_RATE_SAMPLES] >= ALERT_RATE_WINDOW_S)
+    {
+        tail = (tail + 1) % ALERT_RATE_SAMPLES;
+        size--;
+    }
+    uint32_t span = seconds - times[tail];
+    valid = span >= ALERT_RATE_WINDOW_S / 2;
+    if (valid)
+        perMinute = (value - values[tail]) * 60.0f / span;
+}
+
+bool AlertEngine::rate(uint8_t channel, AlertMetric metric, float &perMinute) const
+{
+    const RateWindow &window = windows[channel][metric];
+    perMinute = window.perMinute;
+    return window.valid;
+}
+
+void AlertEngine::update(uint32_t seconds, uint8_t channel, float temperatureF, float humidity,
+                         EventHandler handler, void *context)
+{
+    counters.samples++;
+    const float values[2] = {temperatureF, humidity};
+    RateWindow *rates = windows[channel];
+    rates[ALERT_TEMPERATURE].add(seconds, temperatureF);
+    rates[ALERT_HUMIDITY].add(seconds, humidity);
+
+    for (int i = 0; i < count; i++)
+    {
+        const AlertRule &rule = rules[i];
+        RuleState &state = states[channel][i];
+        float value = values[rule.metric];
+        if (rule.rate)
+        {
+            if (!rates[rule.metric].valid)
+                continue;
+            value = rates[rule.metric].perMinute;
+        }
+        bool beyond = rule.above ? value > rule.threshold : value < rule.threshold;
+
+        AlertEvent event;
+        event.rule = i;
+        event.channel = channel;
+        event.value = value;
+        event.atSec = seconds;
+        switch (state.state)
+        {
+        case ALERT_NORMAL:
+        case ALERT_PENDING:
+            if (!beyond)
+            {
+                state.state = ALERT_NORMAL;
+                break;
+            }
+            if (state.state == ALERT_NORMAL)
+            {
+                state.state = ALERT_PENDING;
+                state.sinceSec = seconds;
+            }
+            if (seconds - state.sinceSec < rule.minDurationSec)
+                break;
+            event.raised = true;
+            event.sinceSec = state.sinceSec;
+            state.state = ALERT_ACTIVE;
+            state.sinceSec = seconds;
+            counters.raised++;
+            handler(event, context);
+            break;
+        case ALERT_ACTIVE:
+        {
+            bool cleared = rule.above ? value < rule.threshold - rule.band : value > rule.threshold + rule.band;
+            if (!cleared)
+                break;
+            event.raised = false;
+            event.sinceSec = state.sinceSec;
+            state.state = ALERT_NORMAL;
+            counters.cleared++;
+            handler(event, context);
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+// --- Staged Boot ---
+#include "boot.h"
+
+#include "hal.h"
+
+#ifdef ARDUINO
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+BootSequence boot;
+
+static BootSequence::NetworkFunction networkFunction = nullptr;
+
+void BootSequence::start(BootPhase phase)
+{
+    phases[phase].startMs = hal::clock().millis();
+    phases[phase].ran = true;
+}
+
+void BootSequence::finish(BootPhase phase, bool ok)
+{
+    phases[phase].endMs = hal::clock().millis();
+    phases[phase].ok = ok;
+}
+
+const char *BootSequence::phaseName(BootPhase phase)
+{
+    static const char *const names[BOOT_PHASES] = {"serial", "sensor", "first reading", "storage",
+                                                   "history log", "services", "wifi", "time"};
+    return names[phase];
+}
+
+bool BootSequence::poll(bool &connected)
+{
+    if (networkReported || networkRunning.load())
+        return false;
+    networkReported = true;
+    connected = networkResult.load();
+    return true;
+}
+
+#ifdef ARDUINO
+
+// WiFiManager's portal (web server + DNS) needs a generous stack.
+static const uint32_t NETWORK_TASK_STACK = 8192;
+
+static void networkTask(void *)
+{
+    boot.networkFinished(networkFunction());
+    vTaskDelete(nullptr);
+}
+
+bool BootSequence::startNetwork(NetworkFunction fn)
+{
+    networkFunction = fn;
+    networkRunning = true;
+    networkReported = false;
+    if (xTaskCreate(networkTask, "boot-net", NETWORK_TASK_STACK, nullptr, 1, nullptr) != pdPASS)
+    {
+        networkRunning = false;
+        networkReported = true;
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool BootSequence::startNetwork(NetworkFunction fn)
+{
+    networkFunction = fn;
+    networkRunning = true;
+    networkReported = false;
+    // Runs to completion on its own; nothing waits for it.
+    std::thread([this] { networkFinished(networkFunction()); }).detach();
+    return true;
+}
+
+#endif
+
+void BootSequence::networkFinished(bool connected)
+{
+    networkResult = connected;
+    networkRunning = false; // Publishes the lane's phase timings too
+}
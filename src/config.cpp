@@ -0,0 +1,380 @@
+// --- Configuration ---
+#include "config.h"
+
+#include "crc16.h"
+#include "feature_flags.h"
+#include "logger.h"
+
+#if FEATURE_JSON_CONFIG
+#include <ArduinoJson.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+ConfigStore configStore;
+
+char timeZoneInfo[50];
+char mail_server[50];
+char mail_port[6];
+char mail_from[50];
+char mail_pass[50];
+char mail_to[50];
+char mail_subject[50];
+char mail_name[50];
+char stream_rate[6];
+char stream_baud[8];
+char digest_hours[4];
+char smtp_policy[12];
+char smtp_idle_s[6];
+char mqtt_host[50];
+char mqtt_port[6];
+char mqtt_topic[64];
+char mqtt_user[32];
+char mqtt_pass[50];
+char mqtt_qos[2];
+char mqtt_interval_s[6];
+char report_cron[SCHEDULER_CRON_MAX];
+char alert_rules[96];
+char http_port[6];
+char sensor_mps[3];
+char sensor_repeat[8];
+char filter_median[2];
+char filter_ema_pct[4];
+char heater_rh[4];
+char duty_s[5];
+char modbus_addr[4];
+char modbus_baud[7];
+
+// The one list of settings. Ids are stored in the blob: append new fields
+// with new ids, never renumber.
+static constexpr ConfigField FIELDS[] = {
+    {1, "timeZoneInfo", timeZoneInfo, sizeof(timeZoneInfo), CONFIG_TEXT, 0, 0, "PST8PDT,M3.2.0,M11.1.0", "tz", "Time Zone String"},
+    {2, "mail_server", mail_server, sizeof(mail_server), CONFIG_TEXT, 0, 0, "smtp.gmail.com", "server", "SMTP Server"},
+    {3, "mail_port", mail_port, sizeof(mail_port), CONFIG_NUMBER, 1, 65535, "587", "port", "SMTP Port"},
+    {4, "mail_from", mail_from, sizeof(mail_from), CONFIG_TEXT, 0, 0, "your_email@gmail.com", "from", "Mail From Address"},
+    {5, "mail_pass", mail_pass, sizeof(mail_pass), CONFIG_SECRET, 0, 0, "your_app_password", "pass", "Mail App Password"},
+    {6, "mail_to", mail_to, sizeof(mail_to), CONFIG_TEXT, 0, 0, "your_email@gmail.com", "to", "Mail To Address"},
+    {7, "mail_subject", mail_subject, sizeof(mail_subject), CONFIG_TEXT, 0, 0, "SHT31-D Sensor Readings", "subject", "Mail Subject"},
+    {8, "mail_name", mail_name, sizeof(mail_name), CONFIG_TEXT, 0, 0, "Name of Sender", "name", "Mail Sender Name"},
+    {9, "stream_rate", stream_rate, sizeof(stream_rate), CONFIG_NUMBER, 1, 1000, "10", "srate", "RS-232 Stream Rate (Hz)"},
+    {10, "stream_baud", stream_baud, sizeof(stream_baud), CONFIG_NUMBER, 1200, 921600, "115200", "sbaud", "RS-232 Stream Baud"},
+    {11, "digest_hours", digest_hours, sizeof(digest_hours), CONFIG_NUMBER, 0, 24, "0", "digest", "Digest Email Every N Hours (0 = off)"},
+    {12, "smtp_policy", smtp_policy, sizeof(smtp_policy), CONFIG_TEXT, 0, 0, "ondemand", "spolicy", "SMTP Session (persistent/ondemand/idle)"},
+    {13, "smtp_idle_s", smtp_idle_s, sizeof(smtp_idle_s), CONFIG_NUMBER, 1, 86400, "120", "sidle", "SMTP Idle Close (seconds)"},
+    {17, "mqtt_host", mqtt_host, sizeof(mqtt_host), CONFIG_TEXT, 0, 0, "", "mhost", "MQTT Broker (empty = off)"},
+    {18, "mqtt_port", mqtt_port, sizeof(mqtt_port), CONFIG_NUMBER, 1, 65535, "1883", "mport", "MQTT Port"},
+    {19, "mqtt_topic", mqtt_topic, sizeof(mqtt_topic), CONFIG_TEXT, 0, 0, "sensors/esp32", "mtopic", "MQTT Topic"},
+    {20, "mqtt_user", mqtt_user, sizeof(mqtt_user), CONFIG_TEXT, 0, 0, "", "muser", "MQTT User (empty = anonymous)"},
+    {21, "mqtt_pass", mqtt_pass, sizeof(mqtt_pass), CONFIG_SECRET, 0, 0, "", "mpass", "MQTT Password"},
+    {22, "mqtt_qos", mqtt_qos, sizeof(mqtt_qos), CONFIG_NUMBER, 0, 1, "1", "mqos", "MQTT QoS (0/1)"},
+    {23, "mqtt_interval_s", mqtt_interval_s, sizeof(mqtt_interval_s), CONFIG_NUMBER, 10, 86400, "300", "mint", "MQTT Publish Interval (seconds)"},
+    {14, "report_cron", report_cron, sizeof(report_cron), CONFIG_TEXT, 0, 0, "0 9,13,16 * * *", "cron", "Report Times (cron: min hour day month weekday)"},
+    {15, "alert_rules", alert_rules, sizeof(alert_rules), CONFIG_TEXT, 0, 0, "temp>82~1", "alerts", "Alert Rules (e.g. temp>82~1, rh>70~5@30m)"},
+    {16, "http_port", http_port, sizeof(http_port), CONFIG_NUMBER, 0, 65535, "80", "hport", "HTTP Metrics Port (0 = off)"},
+    {24, "sensor_mps", sensor_mps, sizeof(sensor_mps), CONFIG_NUMBER, 0, 10, "1", "smps", "Sensor Measurements/s (0 = single shot, 1/2/4/10)"},
+    {25, "sensor_repeat", sensor_repeat, sizeof(sensor_repeat), CONFIG_TEXT, 0, 0, "high", "srep", "Sensor Repeatability (high/medium/low)"},
+    {26, "filter_median", filter_median, sizeof(filter_median), CONFIG_NUMBER, 1, 9, "5", "fmed", "Median Filter Window (1 = off)"},
+    {27, "filter_ema_pct", filter_ema_pct, sizeof(filter_ema_pct), CONFIG_NUMBER, 1, 100, "30", "fema", "EMA Filter Weight % (100 = off)"},
+    {28, "heater_rh", heater_rh, sizeof(heater_rh), CONFIG_NUMBER, 0, 100, "0", "heatrh", "Sensor Heater at % RH (0 = off)"},
+    {29, "duty_s", duty_s, sizeof(duty_s), CONFIG_NUMBER, 0, 3600, "0", "duty", "Deep Sleep Between Samples, s (0 = always on)"},
+    {30, "modbus_addr", modbus_addr, sizeof(modbus_addr), CONFIG_NUMBER, 0, 247, "0", "mbaddr", "Modbus RTU Unit on RS-232 (0 = off)"},
+    {31, "modbus_baud", modbus_baud, sizeof(modbus_baud), CONFIG_NUMBER, 1200, 115200, "19200", "mbbaud", "Modbus RTU Baud"},
+};
+static constexpr size_t FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+struct ConfigHeader
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t fields;
+    uint16_t length; // Payload bytes after the header
+    uint32_t sequence;
+    uint16_t crc;
+} __attribute__((packed));
+
+// Largest blob the table can produce: every field full.
+static constexpr size_t blobMax()
+{
+    size_t bytes = sizeof(ConfigHeader);
+    for (const ConfigField &field : FIELDS)
+        bytes += 2 + field.size - 1;
+    return bytes;
+}
+static constexpr size_t BLOB_MAX = blobMax();
+
+static constexpr bool tableIsValid()
+{
+    for (size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        if (FIELDS[i].id == 0 || FIELDS[i].size < 2)
+            return false;
+        for (size_t j = 0; j < i; j++)
+            if (FIELDS[j].id == FIELDS[i].id)
+                return false;
+        size_t len = 0;
+        while (FIELDS[i].defaultValue[len])
+            len++;
+        if (len >= FIELDS[i].size)
+            return false;
+    }
+    return true;
+}
+static_assert(tableIsValid(), "config field ids must be unique and non-zero, defaults must fit");
+static_assert(BLOB_MAX < 1024, "config blob is read onto the stack");
+
+static constexpr size_t valuesSize()
+{
+    size_t bytes = 0;
+    for (const ConfigField &field : FIELDS)
+        bytes += field.size;
+    return bytes;
+}
+static_assert(valuesSize() <= CONFIG_VALUES_MAX, "raise CONFIG_VALUES_MAX");
+
+// Copies at most size - 1 bytes and terminates. Returns false if 'value'
+// did not fit.
+static bool copyValue(const ConfigField &field, const char *value, size_t len)
+{
+    bool fits = len < field.size;
+    if (!fits)
+        len = field.size - 1;
+    memcpy(field.value, value, len);
+    field.value[len] = '\0';
+    return fits;
+}
+
+static uint16_t blobCrc(const ConfigHeader &header, const char *payload)
+{
+    return crc16(payload, header.length, crc16(&header, offsetof(ConfigHeader, crc)));
+}
+
+// --- Load and Save ---
+
+bool ConfigStore::readSlot(const char *path, char *blob, size_t capacity, uint32_t &sequence, long &length)
+{
+    hal::Storage &fs = hal::storage();
+    if (!fs.exists(path))
+        return false;
+    length = fs.readFile(path, blob, capacity);
+    ConfigHeader header;
+    if (length >= (long)sizeof(header))
+        memcpy(&header, blob, sizeof(header));
+    if (length < (long)sizeof(header) || header.magic != CONFIG_MAGIC ||
+        length != (long)(sizeof(header) + header.length) || blobCrc(header, blob + sizeof(header)) != header.crc)
+    {
+        counters.badSlots++;
+        return false;
+    }
+    sequence = header.sequence;
+    return true;
+}
+
+void ConfigStore::apply(const char *blob, long length)
+{
+    ConfigHeader header;
+    memcpy(&header, blob, sizeof(header));
+    const char *p = blob + sizeof(header);
+    const char *end = blob + length;
+    while (end - p >= 2)
+    {
+        uint8_t id = (uint8_t)p[0];
+        uint8_t len = (uint8_t)p[1];
+        p += 2;
+        if (end - p < len)
+            break;
+        for (const ConfigField &field : FIELDS)
+        {
+            if (field.id == id && !copyValue(field, p, len))
+                counters.truncated++;
+        }
+        p += len;
+    }
+    counters.source = CONFIG_FROM_BLOB;
+    counters.version = header.version;
+    counters.bytes = (uint16_t)length;
+    counters.sequence = header.sequence;
+}
+
+void ConfigStore::load()
+{
+    uint32_t start = hal::clock().micros();
+    counters = {};
+    for (const ConfigField &field : FIELDS)
+        copyValue(field, field.defaultValue, strlen(field.defaultValue));
+
+    char blob[BLOB_MAX];
+    uint32_t sequenceA = 0, sequenceB = 0;
+    long lengthA = 0, lengthB = 0;
+    bool validA = readSlot(CONFIG_SLOT_A, blob, sizeof(blob), sequenceA, lengthA);
+    bool validB = readSlot(CONFIG_SLOT_B, blob, sizeof(blob), sequenceB, lengthB);
+    if (validA && (!validB || (int32_t)(sequenceA - sequenceB) > 0))
+    {
+        // Reading B, valid or not, has overwritten A in the buffer.
+        if (hal::storage().exists(CONFIG_SLOT_B))
+            readSlot(CONFIG_SLOT_A, blob, sizeof(blob), sequenceA, lengthA);
+        apply(blob, lengthA);
+    }
+    else if (validB)
+        apply(blob, lengthB);
+    else if (migrateLegacy())
+    {
+        counters.source = CONFIG_FROM_LEGACY_JSON;
+        if (save())
+            hal::storage().remove(CONFIG_LEGACY_PATH);
+    }
+    else
+        save(); // First boot: store the defaults
+    counters.loadUs = hal::clock().micros() - start;
+}
+
+// The one place JSON is still parsed: settings saved by earlier firmware.
+bool ConfigStore::migrateLegacy()
+{
+    hal::Storage &fs = hal::storage();
+    if (!fs.exists(CONFIG_LEGACY_PATH))
+        return false;
+#if !FEATURE_JSON_CONFIG
+    logger.info("%s is from earlier firmware; this build cannot read it. Using the defaults.", CONFIG_LEGACY_PATH);
+    return false;
+#else
+    char buffer[1024];
+    long len = fs.readFile(CONFIG_LEGACY_PATH, buffer, sizeof(buffer));
+    if (len < 0)
+        return false;
+    JsonDocument json;
+    if (deserializeJson(json, buffer, len))
+    {
+        logger.debug("Failed to parse %s, using default configuration", CONFIG_LEGACY_PATH);
+        return false;
+    }
+    for (const ConfigField &field : FIELDS)
+    {
+        const char *value = json[field.key] | (const char *)nullptr;
+        if (value && !copyValue(field, value, strlen(value)))
+            counters.truncated++;
+    }
+    logger.debug("Migrated settings from %s.", CONFIG_LEGACY_PATH);
+    return true;
+#endif
+}
+
+bool ConfigStore::save()
+{
+    char blob[BLOB_MAX];
+    ConfigHeader header;
+    header.magic = CONFIG_MAGIC;
+    header.version = CONFIG_VERSION;
+    header.fields = (uint8_t)FIELD_COUNT;
+    header.sequence = counters.sequence + 1;
+
+    char *p = blob + sizeof(header);
+    for (const ConfigField &field : FIELDS)
+    {
+        size_t len = strnlen(field.value, field.size - 1);
+        *p++ = (char)field.id;
+        *p++ = (char)len;
+        memcpy(p, field.value, len);
+        p += len;
+    }
+    header.length = (uint16_t)(p - blob - sizeof(header));
+    header.crc = blobCrc(header, blob + sizeof(header));
+    memcpy(blob, &header, sizeof(header));
+
+    // Odd saves go to A, even ones to B: the other slot keeps the last good copy.
+    const char *path = header.sequence & 1 ? CONFIG_SLOT_A : CONFIG_SLOT_B;
+    if (!hal::storage().writeFile(path, blob, p - blob))
+        return false;
+    counters.sequence = header.sequence;
+    counters.bytes = (uint16_t)(p - blob);
+    counters.version = CONFIG_VERSION;
+    return true;
+}
+
+// --- Fields ---
+
+size_t ConfigStore::fieldCount() const
+{
+    return FIELD_COUNT;
+}
+
+const ConfigField &ConfigStore::field(size_t index) const
+{
+    return FIELDS[index];
+}
+
+const ConfigField *ConfigStore::find(const char *key) const
+{
+    for (const ConfigField &field : FIELDS)
+    {
+        if (strcmp(field.key, key) == 0)
+            return &field;
+    }
+    return nullptr;
+}
+
+bool ConfigStore::validate(const ConfigField &field, const char *value, char *error, size_t errorSize)
+{
+    size_t len = strlen(value);
+    if (len >= field.size)
+    {
+        snprintf(error, errorSize, "Value too long for %s (max %u characters)", field.key,
+                 (unsigned)field.size - 1);
+        return false;
+    }
+    if (field.type == CONFIG_NUMBER)
+    {
+        char *end;
+        unsigned long number = strtoul(value, &end, 10);
+        if (len == 0 || *end || value[0] < '0' || value[0] > '9' || number < field.min || number > field.max)
+        {
+            snprintf(error, errorSize, "%s must be a number from %lu to %lu", field.key,
+                     (unsigned long)field.min, (unsigned long)field.max);
+            return false;
+        }
+    }
+    return true;
+}
+
+void ConfigStore::set(const ConfigField &field, const char *value)
+{
+    copyValue(field, value, strlen(value));
+}
+
+size_t ConfigStore::portalParams(hal::PortalParam *params, size_t capacity, char *values, size_t valuesSize) const
+{
+    size_t count = 0;
+    for (const ConfigField &field : FIELDS)
+    {
+        if (count == capacity || valuesSize < field.size)
+            break;
+        memcpy(values, field.value, field.size);
+        params[count++] = {field.portalId, field.label, values, field.size};
+        values += field.size;
+        valuesSize -= field.size;
+    }
+    return count;
+}
+
+// The params are in table order (see portalParams()).
+void ConfigStore::applyPortal(const hal::PortalParam *params, size_t count)
+{
+    for (size_t i = 0; i < count && i < FIELD_COUNT; i++)
+    {
+        const ConfigField &field = FIELDS[i];
+        params[i].value[params[i].capacity - 1] = '\0';
+        char error[96];
+        if (!validate(field, params[i].value, error, sizeof(error)))
+        {
+            logger.error("ERROR: Portal value for %s refused: %s. Keeping '%s'.", field.key, error, field.value);
+            continue;
+        }
+        set(field, params[i].value);
+    }
+}
+
+const char *ConfigStore::sourceName(ConfigSource source)
+{
+    static const char *const names[] = {"defaults", "binary store", "migrated /config.json"};
+    return names[source];
+}
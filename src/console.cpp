@@ -0,0 +1,144 @@
+// --- Serial Command Console ---
+#include "console.h"
+
+#include "logger.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+
+void Console::begin(hal::SerialPort &port, int logSink, const ConsoleCommand *commands, size_t count)
+{
+    this->port = &port;
+    sink = logSink;
+    table = commands;
+    tableSize = count;
+    length = 0;
+    discarding = false;
+}
+
+void Console::poll()
+{
+    if (!port)
+        return;
+    uint32_t burst = 0;
+    for (int budget = CONSOLE_POLL_BYTES; budget > 0 && port->available() > 0; budget--)
+    {
+        char c = (char)port->read();
+        bool wasCr = lastWasCr;
+        lastWasCr = c == '\r';
+        if (c == '\n' && wasCr)
+            continue; // Second half of CR LF
+        if (c == '\r' || c == '\n')
+        {
+            if (discarding)
+            {
+                discarding = false;
+                counters.overflows++;
+                reply("ERROR: Command too long (max %d characters).", CONSOLE_LINE_MAX - 1);
+            }
+            else if (length > 0)
+            {
+                line[length] = '\0';
+                length = 0;
+                burst++;
+                execute(line);
+            }
+            continue;
+        }
+        if (discarding)
+            continue;
+        if (c == '\b' || c == 0x7F)
+        {
+            if (length > 0)
+                length--; // Terminal backspace
+            continue;
+        }
+        if (length + 1 >= sizeof(line))
+        {
+            discarding = true;
+            length = 0;
+            continue;
+        }
+        line[length++] = c;
+    }
+    if (burst > counters.maxBurst)
+        counters.maxBurst = burst;
+}
+
+int Console::tokenize(char *line, char **argv, int maxArgs)
+{
+    int argc = 0;
+    char *p = line;
+    while (true)
+    {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\0')
+            return argc;
+        if (argc == maxArgs)
+            return -1;
+        if (*p == '"')
+        {
+            argv[argc++] = ++p;
+            while (*p && *p != '"')
+                p++;
+        }
+        else
+        {
+            argv[argc++] = p;
+            while (*p && *p != ' ' && *p != '\t')
+                p++;
+        }
+        if (*p)
+            *p++ = '\0';
+    }
+}
+
+const ConsoleCommand *Console::find(const char *name) const
+{
+    for (size_t i = 0; i < tableSize; i++)
+    {
+        if (strcasecmp(table[i].name, name) == 0) // "READ" works too
+            return &table[i];
+    }
+    return nullptr;
+}
+
+void Console::execute(char *line)
+{
+    char *argv[CONSOLE_MAX_ARGS];
+    int argc = tokenize(line, argv, CONSOLE_MAX_ARGS);
+    if (argc == 0)
+        return;
+    counters.lines++;
+    if (argc < 0)
+    {
+        counters.usage++;
+        reply("ERROR: Too many arguments.");
+        return;
+    }
+
+    const ConsoleCommand *command = find(argv[0]);
+    if (!command)
+    {
+        counters.unknown++;
+        reply("ERROR: Unknown command '%s'. Type 'help' for a list.", argv[0]);
+        return;
+    }
+    if (argc - 1 < command->minArgs || argc - 1 > command->maxArgs)
+    {
+        counters.usage++;
+        reply("Usage: %s %s", command->name, command->usage);
+        return;
+    }
+    command->run(*this, argc, argv);
+}
+
+void Console::reply(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logger.vlogTo(sink, LOG_INFO, format, args);
+    va_end(args);
+}
@@ -0,0 +1,14 @@
+// --- CRC-16/CCITT-FALSE ---
+#include "crc16.h"
+
+uint16_t crc16(const void *data, size_t len, uint16_t crc)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    while (len--)
+    {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
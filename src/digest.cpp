@@ -0,0 +1,148 @@
+// --- Digest Email ---
+#include "digest.h"
+
+#include "hal.h"
+#include "reading_format.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+DigestBuilder digest;
+
+static const char CSV_HEADER[] = LOG_CSV_HEADER;
+
+bool DigestBuilder::begin(uint32_t fromEpoch, uint32_t toEpoch)
+{
+    if (state != IDLE)
+    {
+        counters.busy++;
+        return false;
+    }
+    hal::storage().remove(DIGEST_CSV_PATH);
+    if (!hal::storage().writeFile(DIGEST_CSV_PATH, CSV_HEADER, sizeof(CSV_HEADER) - 1))
+    {
+        counters.writeErrors++;
+        return false;
+    }
+    totals = {};
+    totals.fromEpoch = fromEpoch;
+    totals.toEpoch = toEpoch;
+    nextEpoch = fromEpoch;
+    skipAtNext = 0;
+    endEpoch = toEpoch;
+    counters.bytes += sizeof(CSV_HEADER) - 1;
+    state = BUILDING;
+    return true;
+}
+
+bool DigestBuilder::addRow(const LogRecord &record, void *context)
+{
+    DigestBuilder &self = *(DigestBuilder *)context;
+    if (record.epoch == self.nextEpoch && self.skipAtNext > 0)
+    {
+        self.skipAtNext--; // Written by the previous chunk
+        return true;
+    }
+    if (self.chunkUsed + LOG_CSV_ROW_MAX > sizeof(self.chunk))
+    {
+        self.chunkFull = true;
+        return false; // Resume from this record next poll()
+    }
+
+    self.chunkUsed += formatCsvRow(record, self.chunk + self.chunkUsed);
+
+    self.totals.count++;
+    DigestChannel &s = self.totals.channels[record.channel];
+    if (s.count == 0)
+    {
+        s.minCentiC = s.maxCentiC = record.centiC;
+        s.minCentiRH = s.maxCentiRH = record.centiRH;
+    }
+    s.count++;
+    s.sumCentiC += record.centiC;
+    s.sumCentiRH += record.centiRH;
+    if (record.centiC < s.minCentiC)
+        s.minCentiC = record.centiC;
+    if (record.centiC > s.maxCentiC)
+        s.maxCentiC = record.centiC;
+    if (record.centiRH < s.minCentiRH)
+        s.minCentiRH = record.centiRH;
+    if (record.centiRH > s.maxCentiRH)
+        s.maxCentiRH = record.centiRH;
+
+    if (record.epoch == self.nextEpoch)
+        self.skipAtNext++;
+    else
+    {
+        self.nextEpoch = record.epoch;
+        self.skipAtNext = 1;
+    }
+    return true;
+}
+
+bool DigestBuilder::poll()
+{
+    if (state != BUILDING)
+        return false;
+
+    chunkUsed = 0;
+    chunkFull = false;
+    historyLog.query(nextEpoch, endEpoch, addRow, this);
+    if (chunkUsed > 0)
+    {
+        if (!hal::storage().appendFile(DIGEST_CSV_PATH, chunk, chunkUsed))
+        {
+            counters.writeErrors++;
+            release();
+            return false;
+        }
+        counters.bytes += chunkUsed;
+    }
+    if (chunkFull)
+        return false;
+
+    counters.rows += totals.count;
+    counters.built++;
+    state = READY;
+    return true;
+}
+
+void DigestBuilder::formatBody(char *buffer, size_t size) const
+{
+    char from[20], to[20];
+    time_t t = totals.fromEpoch;
+    struct tm local;
+    localtime_r(&t, &local);
+    strftime(from, sizeof(from), "%Y-%m-%d %H:%M", &local);
+    t = totals.toEpoch;
+    localtime_r(&t, &local);
+    strftime(to, sizeof(to), "%Y-%m-%d %H:%M", &local);
+
+    int len = snprintf(buffer, size, "Digest for %s to %s\nReadings: %u (attached as CSV)", from, to,
+                       (unsigned)totals.count);
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        const DigestChannel &s = totals.channels[channel];
+        if (s.count == 0 || len < 0 || (size_t)len >= size)
+            continue;
+        char low[READING_TEXT_MAX], mean[READING_TEXT_MAX], high[READING_TEXT_MAX];
+        char lowRH[READING_TEXT_MAX], meanRH[READING_TEXT_MAX], highRH[READING_TEXT_MAX];
+        formatTemperature(low, s.minCentiC);
+        formatTemperature(mean, (int32_t)(s.sumCentiC / s.count));
+        formatTemperature(high, s.maxCentiC);
+        formatCentiTenths(lowRH, s.minCentiRH);
+        formatCentiTenths(meanRH, (int32_t)(s.sumCentiRH / s.count));
+        formatCentiTenths(highRH, s.maxCentiRH);
+        len += snprintf(buffer + len, size - len,
+                        "\nch%u temperature: %s / %s / %s " READING_TEMPERATURE_SUFFIX " (min/mean/max)"
+                        "\nch%u humidity: %s / %s / %s %% (min/mean/max)",
+                        (unsigned)channel, low, mean, high, (unsigned)channel, lowRH, meanRH, highRH);
+    }
+}
+
+void DigestBuilder::release()
+{
+    hal::storage().remove(DIGEST_CSV_PATH);
+    state = IDLE;
+}
@@ -0,0 +1,301 @@
+// --- Duty Cycle ---
+#include "duty_cycle.h"
+
+#include "crc16.h"
+#include "history.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+DutyCycle dutyCycle;
+
+// A buffered reading, packed like a flash log record.
+struct DutyReading
+{
+    uint32_t epoch;
+    int16_t centiC;
+    uint16_t centiRH : 14;
+    uint16_t channel : 2;
+};
+
+struct DutyEvent
+{
+    AlertEvent event;
+    Sample sample; // The reading that caused it
+};
+
+struct DutyCycle::State
+{
+    uint32_t magic;
+    uint16_t crc; // CRC-16 of the fields after it, up to the used readings
+    uint16_t readingCount;
+    uint32_t intervalS;
+    uint32_t nextReportEpoch; // 0: none
+    uint32_t retryEpoch;      // No uplink for reports and alerts before this
+    uint64_t uptimeAtSleepMs;
+    uint32_t sleepMs;
+    bool fastConnectValid;
+    hal::FastConnectInfo fastConnect;
+    DutyStats counters;
+    uint8_t eventCount;
+    DutyEvent events[DUTY_EVENTS_MAX];
+    uint8_t alerts[sizeof(AlertEngine)];
+    DutyReading readings[DUTY_READINGS_MAX];
+};
+
+DutyCycle::State *DutyCycle::state()
+{
+    static_assert(sizeof(State) <= HAL_RETAINED_BYTES, "duty cycle state does not fit the RTC memory");
+    static_assert(std::is_trivially_copyable<AlertEngine>::value, "the alert engine is kept as bytes");
+    return (State *)hal::system().retainedMemory();
+}
+
+const DutyCycle::State *DutyCycle::state() const
+{
+    return (const State *)hal::system().retainedMemory();
+}
+
+uint16_t DutyCycle::checksum(const State &state)
+{
+    size_t from = offsetof(State, readingCount);
+    size_t to = offsetof(State, readings) + state.readingCount * sizeof(DutyReading);
+    return crc16((const uint8_t *)&state + from, to - from);
+}
+
+void DutyCycle::clear()
+{
+    memset(state(), 0, sizeof(State));
+    state()->magic = DUTY_MAGIC;
+}
+
+void DutyCycle::seal()
+{
+    State *s = state();
+    s->crc = checksum(*s);
+}
+
+bool DutyCycle::resume()
+{
+    State *s = state();
+    waking = hal::system().wokeFromSleep() && s->magic == DUTY_MAGIC && s->readingCount <= DUTY_READINGS_MAX &&
+             s->eventCount <= DUTY_EVENTS_MAX && s->crc == checksum(*s);
+    if (!waking)
+    {
+        clear();
+        return false;
+    }
+    wakeStartMs = asleepUntilMs;
+    asleepUntilMs = 0;
+    // Uptime carries on from before the sleep.
+    setUptimeBase(0);
+    uint64_t sinceStart = uptimeMillis();
+    uint64_t carried = s->uptimeAtSleepMs + s->sleepMs;
+    setUptimeBase(carried > sinceStart ? carried - sinceStart : 0);
+
+    s->counters.wakes++;
+    memset(s->counters.lastWakeMs, 0, sizeof(s->counters.lastWakeMs));
+    s->counters.lastWakeMs[DUTY_PHASE_BOOT] = hal::clock().millis() - wakeStartMs + DUTY_BOOT_EXTRA_MS;
+    phasesRun = 0;
+    mark(DUTY_PHASE_SENSOR);
+    return true;
+}
+
+void DutyCycle::mark(DutyPhase phase)
+{
+    phaseStartMs[phase] = hal::clock().millis();
+    phasesRun |= 1u << phase;
+}
+
+void DutyCycle::restoreAlerts(AlertEngine &engine) const
+{
+    memcpy((void *)&engine, state()->alerts, sizeof(AlertEngine));
+}
+
+void DutyCycle::saveAlerts(const AlertEngine &engine)
+{
+    memcpy(state()->alerts, (const void *)&engine, sizeof(AlertEngine));
+}
+
+bool DutyCycle::store(uint32_t epoch, const Sample &sample)
+{
+    State *s = state();
+    if (s->readingCount >= DUTY_READINGS_MAX)
+        return false;
+    DutyReading &reading = s->readings[s->readingCount++];
+    reading.epoch = epoch;
+    reading.centiC = sample.centiC;
+    reading.centiRH = sample.centiRH;
+    reading.channel = sample.channel;
+    s->counters.readings++;
+    return true;
+}
+
+void DutyCycle::addEvent(const AlertEvent &event, const Sample &sample)
+{
+    State *s = state();
+    if (s->eventCount >= DUTY_EVENTS_MAX)
+    {
+        s->counters.lostEvents++;
+        return;
+    }
+    s->events[s->eventCount].event = event;
+    s->events[s->eventCount].sample = sample;
+    s->eventCount++;
+    s->counters.events++;
+}
+
+uint8_t DutyCycle::uplinkReasons(uint32_t nowEpoch) const
+{
+    const State *s = state();
+    uint8_t reasons = 0;
+    // No room for another pass over every sensor.
+    if (s->readingCount + SENSOR_CHANNELS > DUTY_READINGS_MAX)
+        reasons |= DUTY_UPLINK_FULL;
+    if ((int32_t)(nowEpoch - s->retryEpoch) < 0)
+        return reasons;
+    if (s->eventCount)
+        reasons |= DUTY_UPLINK_ALERT;
+    // The RTC timer is only good to a few percent: a report nearer than
+    // the next sample is due now.
+    if (s->nextReportEpoch && nowEpoch + s->intervalS / 2 >= s->nextReportEpoch)
+        reasons |= DUTY_UPLINK_REPORT;
+    return reasons;
+}
+
+size_t DutyCycle::drainReadings(ReadingVisitor visit, void *context)
+{
+    State *s = state();
+    size_t count = s->readingCount;
+    for (size_t i = 0; i < count; i++)
+    {
+        const DutyReading &reading = s->readings[i];
+        visit(reading.epoch, reading.channel, reading.centiC / 100.0f, reading.centiRH / 100.0f, context);
+    }
+    s->readingCount = 0;
+    return count;
+}
+
+bool DutyCycle::takeEvent(AlertEvent &event, Sample &sample)
+{
+    State *s = state();
+    if (s->eventCount == 0)
+        return false;
+    event = s->events[0].event;
+    sample = s->events[0].sample;
+    s->eventCount--;
+    memmove(s->events, s->events + 1, s->eventCount * sizeof(DutyEvent));
+    return true;
+}
+
+bool DutyCycle::fastConnect(hal::FastConnectInfo &info) const
+{
+    if (!state()->fastConnectValid)
+        return false;
+    info = state()->fastConnect;
+    return true;
+}
+
+void DutyCycle::setFastConnect(const hal::FastConnectInfo &info)
+{
+    state()->fastConnect = info;
+    state()->fastConnectValid = true;
+}
+
+void DutyCycle::countFastConnect(bool ok)
+{
+    if (ok)
+        state()->counters.fastConnects++;
+    else
+        state()->counters.fastConnectFailures++;
+}
+
+void DutyCycle::uplinkFailed(uint32_t nowEpoch)
+{
+    state()->retryEpoch = nowEpoch + DUTY_UPLINK_RETRY_S;
+    state()->counters.timeouts++;
+}
+
+uint32_t DutyCycle::nextReportEpoch() const
+{
+    return state()->nextReportEpoch;
+}
+
+uint32_t DutyCycle::intervalS() const
+{
+    return state()->intervalS;
+}
+
+void DutyCycle::sleep(uint32_t intervalS, uint32_t nextReport, uint32_t nowEpoch)
+{
+    State *s = state();
+    uint32_t now = hal::clock().millis();
+    uint32_t awakeMs = 0;
+    if (waking)
+    {
+        // Each phase runs until the next one that started, or until now.
+        for (int p = DUTY_PHASE_SENSOR; p < DUTY_PHASES; p++)
+        {
+            if (!(phasesRun & (1u << p)))
+                continue;
+            uint32_t end = now;
+            for (int q = p + 1; q < DUTY_PHASES; q++)
+            {
+                if (phasesRun & (1u << q))
+                {
+                    end = phaseStartMs[q];
+                    break;
+                }
+            }
+            int32_t ms = (int32_t)(end - phaseStartMs[p]);
+            s->counters.lastWakeMs[p] = ms > 0 ? (uint32_t)ms : 0;
+        }
+        for (int p = 0; p < DUTY_PHASES; p++)
+        {
+            s->counters.phaseMs[p] += s->counters.lastWakeMs[p];
+            awakeMs += s->counters.lastWakeMs[p];
+        }
+        if (phasesRun & (1u << DUTY_PHASE_LOCAL))
+            s->counters.uplinks++;
+    }
+
+    // The next sample intervalS after this wake began, unless a report
+    // comes first.
+    uint64_t sleepMs = (uint64_t)intervalS * 1000 > awakeMs + 1000 ? (uint64_t)intervalS * 1000 - awakeMs : 1000;
+    if ((int32_t)(nextReport - nowEpoch) > 0 && (uint64_t)(nextReport - nowEpoch) * 1000 < sleepMs)
+        sleepMs = (uint64_t)(nextReport - nowEpoch) * 1000;
+
+    s->intervalS = intervalS;
+    s->nextReportEpoch = nextReport;
+    s->counters.sleptMs += sleepMs;
+    s->uptimeAtSleepMs = uptimeMillis();
+    s->sleepMs = (uint32_t)sleepMs;
+    seal();
+    waking = false;
+    asleepUntilMs = now + (uint32_t)sleepMs;
+    hal::system().deepSleep((uint32_t)sleepMs);
+}
+
+const DutyStats &DutyCycle::stats() const
+{
+    return state()->counters;
+}
+
+uint32_t DutyCycle::averageMicroAmps() const
+{
+    const DutyStats &counters = state()->counters;
+    double charge = (double)counters.sleptMs * DUTY_SLEEP_UA;
+    uint64_t totalMs = counters.sleptMs;
+    for (int p = 0; p < DUTY_PHASES; p++)
+    {
+        charge += (double)counters.phaseMs[p] * (p >= DUTY_PHASE_WIFI ? DUTY_RADIO_UA : DUTY_ACTIVE_UA);
+        totalMs += counters.phaseMs[p];
+    }
+    return counters.wakes && totalMs ? (uint32_t)(charge / totalMs + 0.5) : 0;
+}
+
+const char *DutyCycle::phaseName(DutyPhase phase)
+{
+    static const char *const names[DUTY_PHASES] = {"boot", "sensor", "local", "wifi", "uplink"};
+    return names[phase];
+}
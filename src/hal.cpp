@@ -0,0 +1,36 @@
+// --- Shared HAL helpers (all targets) ---
+#include "hal.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace hal
+{
+
+size_t SerialPort::print(const char *text)
+{
+    return write(text, strlen(text));
+}
+
+size_t SerialPort::println(const char *text)
+{
+    size_t n = print(text);
+    return n + write("\r\n", 2);
+}
+
+size_t SerialPort::printf(const char *format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (len < 0)
+        return 0;
+    if ((size_t)len >= sizeof(buffer))
+        len = sizeof(buffer) - 1; // Truncate anything longer than the buffer
+    return write(buffer, len);
+}
+
+} // namespace hal
@@ -0,0 +1,774 @@
+// --- ESP32 HAL implementation ---
+// Wraps the Arduino core, Adafruit SHT31, WiFiManager, ESP Mail Client,
+// WiFiClient, lwIP sockets and LittleFS behind the interfaces in hal.h.
+// A build without a feature (see feature_flags.h) gets a stand-in that never
+// connects instead, so the library is not linked at all.
+#ifdef ARDUINO
+
+#include "feature_flags.h"
+#include "hal.h"
+
+#include <Wire.h>
+#include <Adafruit_Sensor.h>
+#include <Adafruit_SHT31.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include <esp_sleep.h>
+#if FEATURE_NETWORK
+#include <WiFi.h>
+#include <esp_sntp.h>
+#include <esp_wifi.h>
+#include <lwip/sockets.h>
+#endif
+#if FEATURE_PORTAL
+#include <WiFiManager.h>
+#endif
+#if FEATURE_EMAIL
+#include <ESP_Mail_Client.h>
+#endif
+#include <errno.h>
+#include <sys/time.h>
+
+#include <memory>
+#include <vector>
+
+// Define pins for Serial2 (UART2) for the RS-232 TTL to RS232 Module
+// IMPORTANT: Ensure these pins are not otherwise used and are safe to use for UART.
+// GPIO 17 (TX2) and GPIO 16 (RX2) are common choices for UART2.
+static const int Serial2_TX_Pin = 17;
+static const int Serial2_RX_Pin = 16;
+static const size_t SERIAL_TX_BUFFER = 1024;
+// The second I2C controller (Wire1) has no default pins on the esp32dev.
+static const int I2C1_SDA_Pin = 18;
+static const int I2C1_SCL_Pin = 19;
+
+namespace hal
+{
+namespace
+{
+
+// The Adafruit driver resets and checks the sensor; measurements are
+// done here, so the raw ticks reach the fixed-point pipeline unconverted:
+// single shots split in two so the conversions of several sensors
+// overlap, or periodic acquisition read with Fetch Data.
+class Sht31Sensor : public Sensor
+{
+public:
+    Sht31Sensor(TwoWire &wire, uint8_t address) : wire(wire), address(address), sht31(&wire) {}
+
+    bool begin() override
+    {
+        // Default I2C pins for ESP32 are GPIO 21 (SDA) and GPIO 22 (SCL).
+        // Starting a bus that is already up does nothing.
+        if (&wire == &Wire1)
+            wire.begin(I2C1_SDA_Pin, I2C1_SCL_Pin);
+        else
+            wire.begin();
+        periodicCommand = 0; // The reset ends periodic mode
+        return sht31.begin(address);
+    }
+    bool start() override
+    {
+        // Single shot, high repeatability, no clock stretching.
+        return command(0x2400);
+    }
+    bool collect(uint16_t &temperatureTicks, uint16_t &humidityTicks) override
+    {
+        return readMeasurement(temperatureTicks, humidityTicks);
+    }
+    bool setPeriodic(uint8_t mps, SensorRepeatability repeatability) override
+    {
+        // Periodic data acquisition commands (datasheet table 10), by
+        // rate and then high/medium/low repeatability.
+        static const uint16_t COMMANDS[][3] = {
+            {0x2130, 0x2126, 0x212D}, // 1 mps
+            {0x2236, 0x2220, 0x222B}, // 2 mps
+            {0x2334, 0x2322, 0x2329}, // 4 mps
+            {0x2737, 0x2721, 0x272A}, // 10 mps
+        };
+        int rate = mps >= 10 ? 3 : mps >= 4 ? 2 : mps >= 2 ? 1 : 0;
+        if (periodicCommand && !stopPeriodic())
+            return false;
+        periodicCommand = 0;
+        if (mps == 0)
+            return true;
+        if (!command(COMMANDS[rate][repeatability]))
+            return false;
+        periodicCommand = COMMANDS[rate][repeatability];
+        return true;
+    }
+    bool fetch(uint16_t &temperatureTicks, uint16_t &humidityTicks) override
+    {
+        // Fetch Data; the read is NACKed when there is nothing new.
+        return command(0xE000) && readMeasurement(temperatureTicks, humidityTicks);
+    }
+    bool setHeater(bool on) override
+    {
+        // Periodic mode only takes Fetch and Break: stop, switch, restart.
+        uint16_t resume = periodicCommand;
+        if (resume && !stopPeriodic())
+            return false;
+        bool ok = command(on ? 0x306D : 0x3066);
+        if (resume)
+            ok = command(resume) && ok;
+        return ok;
+    }
+
+private:
+    bool command(uint16_t code)
+    {
+        wire.beginTransmission(address);
+        wire.write((uint8_t)(code >> 8));
+        wire.write((uint8_t)code);
+        return wire.endTransmission() == 0;
+    }
+    bool stopPeriodic()
+    {
+        // Break; the sensor takes up to 1 ms to return to single shot mode.
+        bool ok = command(0x3093);
+        delay(1);
+        return ok;
+    }
+    bool readMeasurement(uint16_t &temperatureTicks, uint16_t &humidityTicks)
+    {
+        // The sensor NACKs its address until the conversion is done.
+        uint8_t data[6];
+        if (wire.requestFrom(address, (uint8_t)sizeof(data)) != sizeof(data))
+            return false;
+        for (uint8_t &b : data)
+            b = wire.read();
+        if (crc8(data) != data[2] || crc8(data + 3) != data[5])
+            return false;
+        temperatureTicks = (uint16_t)(data[0] << 8 | data[1]);
+        humidityTicks = (uint16_t)(data[3] << 8 | data[4]);
+        return true;
+    }
+
+    // Sensirion CRC-8 over one 16-bit word: polynomial 0x31, init 0xFF.
+    static uint8_t crc8(const uint8_t *word)
+    {
+        uint8_t crc = 0xFF;
+        for (int i = 0; i < 2; i++)
+        {
+            crc ^= word[i];
+            for (int bit = 0; bit < 8; bit++)
+                crc = crc & 0x80 ? (uint8_t)(crc << 1 ^ 0x31) : (uint8_t)(crc << 1);
+        }
+        return crc;
+    }
+
+    TwoWire &wire;
+    uint8_t address;
+    Adafruit_SHT31 sht31;
+    uint16_t periodicCommand = 0; // Running periodic mode, 0 in single shot
+};
+
+class UsbSerialPort : public SerialPort
+{
+public:
+    void begin(long baud) override
+    {
+        // A driver-side TX buffer lets the log drain without waiting on the UART.
+        Serial.setTxBufferSize(SERIAL_TX_BUFFER);
+        Serial.begin(baud);
+    }
+    int available() override { return Serial.available(); }
+    int read() override { return Serial.read(); }
+    int availableForWrite() override { return Serial.availableForWrite(); }
+    size_t write(const char *data, size_t len) override
+    {
+        return Serial.write((const uint8_t *)data, len);
+    }
+};
+
+class Rs232SerialPort : public SerialPort
+{
+public:
+    void begin(long baud) override
+    {
+        Serial2.setTxBufferSize(SERIAL_TX_BUFFER);
+        // Format: Serial2.begin(baudrate, SERIAL_8N1, TX_pin, RX_pin);
+        Serial2.begin(baud, SERIAL_8N1, Serial2_TX_Pin, Serial2_RX_Pin);
+    }
+    int available() override { return Serial2.available(); }
+    int read() override { return Serial2.read(); }
+    int availableForWrite() override { return Serial2.availableForWrite(); }
+    size_t write(const char *data, size_t len) override
+    {
+        return Serial2.write((const uint8_t *)data, len);
+    }
+    void setRxLowLatency(bool on) override
+    {
+        // The driver otherwise waits for 120 bytes or 2 idle characters.
+        Serial2.setRxFIFOFull(on ? 1 : 120);
+        Serial2.setRxTimeout(on ? 1 : 2);
+    }
+};
+
+class Esp32Clock : public Clock
+{
+public:
+    uint32_t millis() override { return ::millis(); }
+    uint32_t micros() override { return ::micros(); }
+    time_t now() override { return time(nullptr); }
+    void delay(uint32_t ms) override { ::delay(ms); }
+    void configTzTime(const char *tz, const char *server1,
+                      const char *server2, const char *server3) override
+    {
+#if FEATURE_NETWORK
+        ::configTzTime(tz, server1, server2, server3);
+#else
+        setenv("TZ", tz, 1);
+        tzset();
+#endif
+    }
+    bool getLocalTime(struct tm *info, uint32_t timeoutMs) override
+    {
+        return ::getLocalTime(info, timeoutMs);
+    }
+    void onTimeSync(SyncCallback fn, uint32_t intervalMs) override
+    {
+        syncCallback = fn;
+#if FEATURE_NETWORK
+        sntp_set_sync_interval(intervalMs);
+        sntp_set_time_sync_notification_cb([](struct timeval *tv) {
+            if (syncCallback)
+                syncCallback((int64_t)tv->tv_sec * 1000000 + tv->tv_usec);
+        });
+#else
+        (void)intervalMs;
+#endif
+    }
+    void requestSync() override
+    {
+#if FEATURE_NETWORK
+        sntp_restart();
+#endif
+    }
+    void adjust(int32_t deltaUs) override
+    {
+        struct timeval delta = {deltaUs / 1000000, deltaUs % 1000000};
+        adjtime(&delta, nullptr);
+    }
+
+private:
+    static SyncCallback syncCallback;
+};
+
+Clock::SyncCallback Esp32Clock::syncCallback = nullptr;
+
+#if FEATURE_NETWORK
+
+// Without the portal (FEATURE_PORTAL 0) the station joins the network
+// given at build time, or the one it last joined.
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 30000
+#endif
+#if defined(WIFI_SSID) && !defined(WIFI_PASSWORD)
+#define WIFI_PASSWORD "" // An open network
+#endif
+
+class WiFiStationNetwork : public Network
+{
+public:
+#if FEATURE_PORTAL
+    bool autoConnect(const char *apName, PortalParam *params, size_t count,
+                     bool &paramsSaved) override
+    {
+        WiFiManager wm;
+        bool saved = false;
+        // Called when WiFiManager saves its configuration
+        wm.setSaveConfigCallback([&saved]() {
+            Serial.println("Should save config");
+            saved = true;
+        });
+
+        // Add custom parameters to the WiFiManager portal
+        std::vector<std::unique_ptr<WiFiManagerParameter>> fields;
+        fields.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            fields.emplace_back(new WiFiManagerParameter(params[i].id, params[i].label,
+                                                         params[i].value, params[i].capacity - 1));
+            wm.addParameter(fields.back().get());
+        }
+
+        // It is a blocking function.
+        bool connected = wm.autoConnect(apName);
+
+        if (saved)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                strncpy(params[i].value, fields[i]->getValue(), params[i].capacity - 1);
+                params[i].value[params[i].capacity - 1] = '\0';
+            }
+        }
+        paramsSaved = saved;
+        return connected;
+    }
+    void resetSettings() override
+    {
+        WiFiManager wm;
+        wm.resetSettings(); // Erase saved WiFi credentials
+    }
+#else
+    bool autoConnect(const char *, PortalParam *, size_t, bool &paramsSaved) override
+    {
+        paramsSaved = false;
+        WiFi.mode(WIFI_STA);
+#ifdef WIFI_SSID
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+#else
+        WiFi.begin(); // The credentials saved in NVS
+#endif
+        uint32_t start = millis();
+        while (WiFi.status() != WL_CONNECTED && millis() - start < WIFI_CONNECT_TIMEOUT_MS)
+            ::delay(50);
+        return WiFi.status() == WL_CONNECTED;
+    }
+    void resetSettings() override { WiFi.disconnect(true, true); }
+#endif
+    bool isConnected() override { return WiFi.status() == WL_CONNECTED; }
+    void reconnect() override { WiFi.reconnect(); }
+    const char *localIP() override
+    {
+        WiFi.localIP().toString().toCharArray(ipBuffer, sizeof(ipBuffer));
+        return ipBuffer;
+    }
+    bool fastConnectInfo(FastConnectInfo &info) override
+    {
+        const uint8_t *bssid = WiFi.BSSID();
+        if (!isConnected() || !bssid)
+            return false;
+        memcpy(info.bssid, bssid, sizeof(info.bssid));
+        info.channel = (uint8_t)WiFi.channel();
+        info.ip = WiFi.localIP();
+        info.gateway = WiFi.gatewayIP();
+        info.subnet = WiFi.subnetMask();
+        info.dns = WiFi.dnsIP();
+        return true;
+    }
+    bool connectFast(const FastConnectInfo &info, uint32_t timeoutMs) override
+    {
+        // The credentials WiFiManager left in the driver's NVS.
+        WiFi.mode(WIFI_STA);
+        wifi_config_t saved;
+        if (esp_wifi_get_config(WIFI_IF_STA, &saved) != ESP_OK || saved.sta.ssid[0] == '\0')
+            return false;
+        WiFi.config(IPAddress(info.ip), IPAddress(info.gateway), IPAddress(info.subnet), IPAddress(info.dns));
+        WiFi.begin((const char *)saved.sta.ssid, (const char *)saved.sta.password, info.channel, info.bssid, true);
+        uint32_t start = millis();
+        while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs)
+            ::delay(5);
+        if (WiFi.status() == WL_CONNECTED)
+            return true;
+        WiFi.disconnect();
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // Back to DHCP
+        return false;
+    }
+
+private:
+    char ipBuffer[16];
+};
+
+#else
+
+class NoNetwork : public Network
+{
+public:
+    bool autoConnect(const char *, PortalParam *, size_t, bool &paramsSaved) override
+    {
+        paramsSaved = false;
+        return false;
+    }
+    void resetSettings() override {}
+    bool isConnected() override { return false; }
+    void reconnect() override {}
+    const char *localIP() override { return "0.0.0.0"; }
+    bool fastConnectInfo(FastConnectInfo &) override { return false; }
+    bool connectFast(const FastConnectInfo &, uint32_t) override { return false; }
+};
+
+#endif // FEATURE_NETWORK
+
+#if FEATURE_EMAIL
+
+class EspMailTransport : public MailTransport
+{
+public:
+    void setDebug(int level) override
+    {
+        /** 0 for no debugging, 1 for basic level debugging
+         * Debug port can be changed via ESP_MAIL_DEFAULT_DEBUG_PORT in ESP_Mail_FS.h
+         */
+        smtp.debug(level);
+    }
+    void setNetworkReconnect(bool enable) override { MailClient.networkReconnect(enable); }
+    bool connect(const MailServerConfig &server) override
+    {
+        // The smtp object stores a reference to this persistent config object.
+        config.server.host_name = server.host;
+        config.server.port = server.port;
+        config.login.email = server.email;
+        config.login.password = server.password;
+        config.login.user_domain = ""; // Blank For Gmail
+        return smtp.connect(&config, false); // Log in separately, see login()
+    }
+    bool login() override { return smtp.loginWithPassword(config.login.email, config.login.password); }
+    bool isLoggedIn() override { return smtp.isLoggedIn(); }
+    void close() override { smtp.closeSession(); }
+    bool send(const MailMessage &mail, bool closeAfter) override
+    {
+        message.clear();
+        message.sender.name = mail.senderName;
+        message.sender.email = mail.senderEmail;
+        message.subject = mail.subject;
+        message.addRecipient("", mail.recipient);
+        message.text.content = mail.body;
+        message.text.charSet = "us-ascii"; // Set character set for email content
+        message.text.transfer_encoding = Content_Transfer_Encoding::enc_7bit;
+        if (mail.attachmentPath)
+        {
+            // Read from flash in chunks while sending; ESP Mail Client's
+            // default flash file system on the ESP32 is the LittleFS we mount.
+            SMTP_Attachment attachment;
+            attachment.descr.filename = mail.attachmentName;
+            attachment.descr.mime = mail.attachmentMime;
+            attachment.file.path = mail.attachmentPath;
+            attachment.file.storage_type = esp_mail_file_storage_type_flash;
+            attachment.descr.transfer_encoding = Content_Transfer_Encoding::enc_base64;
+            message.addAttachment(attachment);
+        }
+        return MailClient.sendMail(&smtp, &message, closeAfter);
+    }
+    const char *errorReason() override
+    {
+        lastError = smtp.errorReason();
+        return lastError.c_str();
+    }
+
+private:
+    SMTPSession smtp;
+    SMTP_Message message;
+    Session_Config config;
+    String lastError;
+};
+
+#else
+
+class NoMailTransport : public MailTransport
+{
+public:
+    void setDebug(int) override {}
+    void setNetworkReconnect(bool) override {}
+    bool connect(const MailServerConfig &) override { return false; }
+    bool login() override { return false; }
+    bool isLoggedIn() override { return false; }
+    void close() override {}
+    bool send(const MailMessage &, bool) override { return false; }
+    const char *errorReason() override { return "email is not built in"; }
+};
+
+#endif // FEATURE_EMAIL
+
+#if FEATURE_NETWORK
+
+class LwipTcpServer : public TcpServer
+{
+public:
+    // Plain lwIP sockets rather than WiFiServer/WiFiClient: their write()
+    // waits for the peer when the send buffer is full.
+    bool begin(uint16_t port) override
+    {
+        if (listenFd >= 0)
+            return true;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 4) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        listenFd = fd;
+        return true;
+    }
+    bool listening() override { return listenFd >= 0; }
+    int accept() override
+    {
+        if (listenFd < 0)
+            return -1;
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+            return -1;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        return fd;
+    }
+    int read(int connection, char *buffer, size_t capacity) override
+    {
+        int n = recv(connection, buffer, capacity, MSG_DONTWAIT);
+        if (n > 0)
+            return n;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    int write(int connection, const char *data, size_t len) override
+    {
+        int n = send(connection, data, len, MSG_DONTWAIT);
+        if (n >= 0)
+            return n;
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    void close(int connection) override { ::close(connection); }
+
+private:
+    int listenFd = -1;
+};
+
+class WiFiTcpClient : public TcpClient
+{
+public:
+    bool connect(const char *host, uint16_t port, uint32_t timeoutMs) override
+    {
+        return client.connect(host, port, (int32_t)timeoutMs) == 1;
+    }
+    bool connected() override { return client.connected(); }
+    bool write(const uint8_t *data, size_t len) override { return client.write(data, len) == len; }
+    bool read(uint8_t *buffer, size_t len, uint32_t timeoutMs) override
+    {
+        uint32_t start = millis();
+        size_t got = 0;
+        while (got < len)
+        {
+            int n = client.read(buffer + got, len - got);
+            if (n > 0)
+            {
+                got += n;
+                continue;
+            }
+            if (!client.connected() || millis() - start >= timeoutMs)
+                return false;
+            ::delay(1);
+        }
+        return true;
+    }
+    void close() override { client.stop(); }
+
+private:
+    WiFiClient client;
+};
+
+#else
+
+class NoTcpServer : public TcpServer
+{
+public:
+    bool begin(uint16_t) override { return false; }
+    bool listening() override { return false; }
+    int accept() override { return -1; }
+    int read(int, char *, size_t) override { return -1; }
+    int write(int, const char *, size_t) override { return -1; }
+    void close(int) override {}
+};
+
+class NoTcpClient : public TcpClient
+{
+public:
+    bool connect(const char *, uint16_t, uint32_t) override { return false; }
+    bool connected() override { return false; }
+    bool write(const uint8_t *, size_t) override { return false; }
+    bool read(uint8_t *, size_t, uint32_t) override { return false; }
+    void close() override {}
+};
+
+#endif // FEATURE_NETWORK
+
+class LittleFsStorage : public Storage
+{
+public:
+    bool begin() override { return LittleFS.begin(true, "/littlefs", 5, "spiffs"); }
+    bool format() override { return LittleFS.format(); }
+    bool exists(const char *path) override { return LittleFS.exists(path); }
+    long readFile(const char *path, char *buffer, size_t capacity) override
+    {
+        File file = LittleFS.open(path, "r");
+        if (!file)
+            return -1;
+        long n = file.read((uint8_t *)buffer, capacity);
+        file.close();
+        return n;
+    }
+    bool writeFile(const char *path, const char *data, size_t len) override
+    {
+        return writeMode(path, "w", data, len);
+    }
+    long readFileAt(const char *path, size_t offset, char *buffer, size_t capacity) override
+    {
+        File file = LittleFS.open(path, "r");
+        if (!file)
+            return -1;
+        long n = file.seek(offset) ? (long)file.read((uint8_t *)buffer, capacity) : 0;
+        file.close();
+        return n;
+    }
+    bool appendFile(const char *path, const char *data, size_t len) override
+    {
+        return writeMode(path, "a", data, len);
+    }
+    long fileSize(const char *path) override
+    {
+        if (!LittleFS.exists(path))
+            return -1;
+        File file = LittleFS.open(path, "r");
+        long size = file ? (long)file.size() : -1;
+        file.close();
+        return size;
+    }
+    bool remove(const char *path) override { return LittleFS.remove(path); }
+    void listFiles(FileVisitor fn, void *context) override
+    {
+        File root = LittleFS.open("/");
+        File file = root.openNextFile();
+        while (file)
+        {
+            if (!file.isDirectory())
+                fn(file.path(), file.size(), context);
+            file = root.openNextFile();
+        }
+    }
+    size_t totalBytes() override { return LittleFS.totalBytes(); }
+    size_t usedBytes() override { return LittleFS.usedBytes(); }
+
+private:
+    bool writeMode(const char *path, const char *mode, const char *data, size_t len)
+    {
+        File file = LittleFS.open(path, mode);
+        if (!file)
+            return false;
+        bool ok = file.write((const uint8_t *)data, len) == len;
+        file.close();
+        return ok;
+    }
+};
+
+class Esp32System : public System
+{
+public:
+    bool pinHeldLow(uint8_t pin) override
+    {
+        pinMode(pin, INPUT_PULLUP);
+        return digitalRead(pin) == LOW;
+    }
+    void restart() override { ESP.restart(); }
+    void halt() override
+    {
+        while (1)
+            ::delay(1000);
+    }
+    uint32_t freeHeap() override { return ESP.getFreeHeap(); }
+    uint32_t minFreeHeap() override { return ESP.getMinFreeHeap(); }
+    uint32_t largestFreeBlock() override { return ESP.getMaxAllocHeap(); }
+    void *currentTask() override { return xTaskGetCurrentTaskHandle(); }
+    // ESP-IDF counts stack in bytes.
+    uint32_t stackHighWater(void *task) override { return uxTaskGetStackHighWaterMark((TaskHandle_t)task); }
+    uint8_t *retainedMemory() override { return retained; }
+    bool wokeFromSleep() override { return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER; }
+    void deepSleep(uint32_t ms) override
+    {
+        // The RTC keeps the system time running; WiFi is simply cut.
+        esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+        esp_deep_sleep_start();
+    }
+
+private:
+    alignas(8) static uint8_t retained[HAL_RETAINED_BYTES];
+};
+
+RTC_DATA_ATTR uint8_t Esp32System::retained[HAL_RETAINED_BYTES];
+
+} // namespace
+
+Sensor &sensor(uint8_t channel)
+{
+    static Sht31Sensor instances[SENSOR_CHANNELS] = {
+        {Wire, SENSOR_ADDRESS_LOW},
+        {Wire, SENSOR_ADDRESS_HIGH},
+        {Wire1, SENSOR_ADDRESS_LOW},
+        {Wire1, SENSOR_ADDRESS_HIGH},
+    };
+    return instances[channel];
+}
+SerialPort &usbSerial()
+{
+    static UsbSerialPort instance;
+    return instance;
+}
+SerialPort &rs232Serial()
+{
+    static Rs232SerialPort instance;
+    return instance;
+}
+Clock &clock()
+{
+    static Esp32Clock instance;
+    return instance;
+}
+Network &network()
+{
+#if FEATURE_NETWORK
+    static WiFiStationNetwork instance;
+#else
+    static NoNetwork instance;
+#endif
+    return instance;
+}
+MailTransport &mail()
+{
+#if FEATURE_EMAIL
+    static EspMailTransport instance;
+#else
+    static NoMailTransport instance;
+#endif
+    return instance;
+}
+TcpServer &tcpServer()
+{
+#if FEATURE_NETWORK
+    static LwipTcpServer instance;
+#else
+    static NoTcpServer instance;
+#endif
+    return instance;
+}
+TcpClient &mqttSocket()
+{
+#if FEATURE_NETWORK
+    static WiFiTcpClient instance;
+#else
+    static NoTcpClient instance;
+#endif
+    return instance;
+}
+Storage &storage()
+{
+    static LittleFsStorage instance;
+    return instance;
+}
+System &system()
+{
+    static Esp32System instance;
+    return instance;
+}
+
+} // namespace hal
+
+#endif // ARDUINO
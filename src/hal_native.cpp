@@ -0,0 +1,800 @@
+// --- Native (host) HAL implementation ---
+#ifndef ARDUINO
+
+#include "hal_native.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <map>
+#include <thread>
+
+namespace hal
+{
+namespace native
+{
+
+bool FakeSensor::start()
+{
+    fakeClock().advanceMicros(startUs);
+    if (!present)
+        return false;
+    startedAtUs = fakeClock().nowUs;
+    started = true;
+    return true;
+}
+
+bool FakeSensor::collect(uint16_t &temperatureTicks, uint16_t &humidityTicks)
+{
+    fakeClock().advanceMicros(collectUs);
+    if (!present || !started || fakeClock().nowUs - startedAtUs < conversionUs)
+        return false; // NACK: nothing to read yet
+    started = false;
+    return measurement(temperatureTicks, humidityTicks);
+}
+
+bool FakeSensor::setPeriodic(uint8_t mps, SensorRepeatability)
+{
+    fakeClock().advanceMicros(startUs);
+    if (!present)
+        return false;
+    periodicMps = mps;
+    periodicSinceUs = fakeClock().nowUs;
+    fetched = 0;
+    return true;
+}
+
+bool FakeSensor::fetch(uint16_t &temperatureTicks, uint16_t &humidityTicks)
+{
+    fakeClock().advanceMicros(fetchUs);
+    uint64_t elapsedUs = fakeClock().nowUs - periodicSinceUs;
+    if (!present || periodicMps == 0 || elapsedUs < conversionUs)
+        return false;
+    uint64_t done = (elapsedUs - conversionUs) * periodicMps / 1000000 + 1;
+    if (done == fetched)
+        return false; // NACK: no new measurement
+    fetched = done;
+    return measurement(temperatureTicks, humidityTicks);
+}
+
+bool FakeSensor::setHeater(bool on)
+{
+    fakeClock().advanceMicros(startUs);
+    if (!present)
+        return false;
+    heaterOn = on;
+    return true;
+}
+
+bool FakeSensor::measurement(uint16_t &temperatureTicks, uint16_t &humidityTicks)
+{
+    reads++;
+    if (failReads)
+        return false;
+    float temperatureC = this->temperatureC;
+    float humidity = this->humidity;
+    if (waveAmplitude != 0.0f)
+    {
+        double day = fakeClock().millis() / 86400000.0;
+        float noise = ((uint32_t)(reads * 2654435761u) >> 24) / 2550.0f - 0.05f; // +-0.05
+        temperatureC += waveAmplitude * (float)sin(2 * M_PI * day) + noise;
+        humidity -= 2 * waveAmplitude * (float)sin(2 * M_PI * day) + noise;
+    }
+    if (heaterOn)
+    {
+        temperatureC += heaterRiseC;
+        humidity *= 0.75f;
+    }
+    // Inverse of the datasheet conversion, clamped to the sensor's range.
+    float t = (temperatureC + 45) * 65535 / 175;
+    float h = humidity * 65535 / 100;
+    temperatureTicks = (uint16_t)lroundf(t < 0 ? 0 : t > 65535 ? 65535 : t);
+    humidityTicks = (uint16_t)lroundf(h < 0 ? 0 : h > 65535 ? 65535 : h);
+    return true;
+}
+
+int FakeSerialPort::available()
+{
+    if (ptyFd >= 0 && inputPos >= input.size())
+    {
+        char buffer[256];
+        ssize_t n = ::read(ptyFd, buffer, sizeof(buffer));
+        if (n > 0)
+            input.append(buffer, (size_t)n);
+    }
+    return (int)(input.size() - inputPos);
+}
+
+int FakeSerialPort::read()
+{
+    if (inputPos >= input.size() && available() == 0)
+        return -1;
+    int c = (unsigned char)input[inputPos++];
+    if (inputPos == input.size())
+    {
+        input.clear();
+        inputPos = 0;
+    }
+    return c;
+}
+
+size_t FakeSerialPort::write(const char *data, size_t len)
+{
+    if (echo)
+        fwrite(data, 1, len, stdout);
+    if (ptyFd >= 0)
+    {
+        ssize_t n = ::write(ptyFd, data, len);
+        if (n < 0)
+            n = (errno == EAGAIN) ? 0 : (ssize_t)len;
+        bytesDropped += len - (size_t)n;
+        len = (size_t)n;
+    }
+    bytesWritten += len;
+    return len;
+}
+
+const char *FakeSerialPort::openPty()
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+        return nullptr;
+    // Raw 8-bit link, like a UART: no echo, no line editing, no CR/LF mapping.
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    ptyFd = fd;
+    return ptsname(fd);
+}
+
+void FakeClock::wait(uint32_t ms)
+{
+    if (std::this_thread::get_id() == driver)
+    {
+        advance(ms);
+        return;
+    }
+    uint64_t until = nowUs + (uint64_t)ms * 1000;
+    while (nowUs < until)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+void FakeClock::advance(uint32_t ms)
+{
+    nowUs += (uint64_t)ms * 1000;
+    if (std::this_thread::get_id() == driver)
+        service();
+}
+
+void FakeClock::service()
+{
+    if (!sntpRunning || nowUs < nextSyncUs)
+        return;
+    if (!ntpReachable)
+    {
+        nextSyncUs = nowUs + (uint64_t)syncRetryMs * 1000;
+        return;
+    }
+    int64_t epochUs = trueUs();
+    offsetUs = epochUs - (int64_t)nowUs; // Stepped, like SNTP's immediate mode
+    slewedUs = 0;
+    syncs++;
+    nextSyncUs = nowUs + (uint64_t)syncIntervalMs * 1000;
+    if (syncCallback)
+        syncCallback(epochUs);
+}
+
+void FakeClock::configTzTime(const char *tz, const char *, const char *, const char *)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+    sntpRunning = true;
+    nextSyncUs = nowUs + (uint64_t)syncDelayMs * 1000;
+}
+
+void FakeClock::onTimeSync(SyncCallback fn, uint32_t intervalMs)
+{
+    syncCallback = fn;
+    syncIntervalMs = intervalMs;
+}
+
+void FakeClock::requestSync()
+{
+    if (sntpRunning)
+        nextSyncUs = nowUs + (uint64_t)syncDelayMs * 1000;
+}
+
+void FakeClock::adjust(int32_t deltaUs)
+{
+    offsetUs += deltaUs;
+    slewedUs += deltaUs;
+}
+
+bool FakeClock::getLocalTime(struct tm *info, uint32_t timeoutMs)
+{
+    time_t t = now();
+    if (t < 1672531200) // Not synced yet
+    {
+        wait(timeoutMs); // A real miss blocks for the whole timeout
+        return false;
+    }
+    localtime_r(&t, info);
+    return true;
+}
+
+bool FakeNetwork::autoConnect(const char *, PortalParam *, size_t, bool &paramsSaved)
+{
+    paramsSaved = false;
+    fakeClock().wait(connectDelayMs);
+    connected = reachable;
+    return connected;
+}
+
+bool FakeNetwork::fastConnectInfo(FastConnectInfo &info)
+{
+    if (!connected)
+        return false;
+    static const uint8_t BSSID[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    memcpy(info.bssid, BSSID, sizeof(info.bssid));
+    info.channel = 6;
+    info.ip = 0x0100007F; // 127.0.0.1
+    info.gateway = 0x0100007F;
+    info.subnet = 0x000000FF;
+    info.dns = 0x0100007F;
+    return true;
+}
+
+bool FakeNetwork::connectFast(const FastConnectInfo &, uint32_t timeoutMs)
+{
+    fastConnects++;
+    if (!reachable || !fastConnectWorks)
+    {
+        fakeClock().wait(timeoutMs);
+        return false;
+    }
+    fakeClock().wait(fastConnectDelayMs);
+    connected = true;
+    return true;
+}
+
+bool FakeMailTransport::connect(const MailServerConfig &)
+{
+    close();
+    connects++;
+    if (!relayHost)
+    {
+        if (connectDelayMs)
+            std::this_thread::sleep_for(std::chrono::milliseconds(connectDelayMs));
+        sessionOpen = relayUp;
+        error = relayUp ? "" : "connection refused";
+        return sessionOpen;
+    }
+
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)relayPort);
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(relayHost, port, &hints, &result) != 0)
+    {
+        error = "cannot resolve relay host";
+        return false;
+    }
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next)
+    {
+        socketFd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (socketFd >= 0 && ::connect(socketFd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        if (socketFd >= 0)
+            ::close(socketFd);
+        socketFd = -1;
+    }
+    freeaddrinfo(result);
+    if (socketFd < 0)
+    {
+        error = "connection refused";
+        return false;
+    }
+    if (readReply() != 220 || !command("EHLO native\r\n", 250))
+    {
+        error = "handshake failed";
+        close();
+        return false;
+    }
+    sessionOpen = true;
+    return true;
+}
+
+bool FakeMailTransport::login()
+{
+    if (!sessionOpen || !relayUp)
+    {
+        error = "not connected";
+        return false;
+    }
+    logins++;
+    // The stand-in relay takes mail without AUTH; in memory only the time is simulated.
+    if (!relayHost && loginDelayMs)
+        std::this_thread::sleep_for(std::chrono::milliseconds(loginDelayMs));
+    loggedIn = true;
+    return true;
+}
+
+void FakeMailTransport::close()
+{
+    if (socketFd >= 0)
+    {
+        command("QUIT\r\n", 221);
+        ::close(socketFd);
+        socketFd = -1;
+    }
+    sessionOpen = false;
+    loggedIn = false;
+}
+
+int FakeMailTransport::readReply()
+{
+    // Multi-line replies use "250-..." for every line but the last ("250 ...").
+    char line[512];
+    size_t len = 0;
+    for (;;)
+    {
+        char c;
+        if (recv(socketFd, &c, 1, 0) != 1)
+            return -1;
+        if (c != '\n')
+        {
+            if (len < sizeof(line) - 1)
+                line[len++] = c;
+            continue;
+        }
+        line[len] = '\0';
+        if (len >= 4 && line[3] == '-')
+        {
+            len = 0;
+            continue;
+        }
+        return atoi(line);
+    }
+}
+
+bool FakeMailTransport::sendAll(const char *data, size_t len)
+{
+    return ::send(socketFd, data, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+bool FakeMailTransport::command(const char *line, int expectedCode)
+{
+    return sendAll(line, strlen(line)) && readReply() == expectedCode;
+}
+
+// Streams a stored file as base64 lines, a few hundred bytes at a time, the
+// way the ESP32 mail client reads attachments from flash.
+bool FakeMailTransport::sendAttachment(const char *path)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned char in[57 * 8]; // 57 input bytes per 76-character line
+    char out[78 * 8];
+    size_t offset = 0;
+    for (;;)
+    {
+        long got = fakeStorage().readFileAt(path, offset, (char *)in, sizeof(in));
+        if (got <= 0)
+            return got == 0;
+        offset += (size_t)got;
+        size_t o = 0;
+        for (long i = 0; i < got; i += 3)
+        {
+            uint32_t v = in[i] << 16 | (i + 1 < got ? in[i + 1] << 8 : 0) | (i + 2 < got ? in[i + 2] : 0);
+            out[o++] = alphabet[v >> 18];
+            out[o++] = alphabet[(v >> 12) & 63];
+            out[o++] = i + 1 < got ? alphabet[(v >> 6) & 63] : '=';
+            out[o++] = i + 2 < got ? alphabet[v & 63] : '=';
+            if ((i / 3 + 1) % 19 == 0 || i + 3 >= got)
+            {
+                out[o++] = '\r';
+                out[o++] = '\n';
+            }
+        }
+        if (!sendAll(out, o))
+            return false;
+    }
+}
+
+bool FakeMailTransport::send(const MailMessage &message, bool closeAfter)
+{
+    bool ok = transmit(message);
+    if (closeAfter)
+        close();
+    return ok;
+}
+
+bool FakeMailTransport::transmit(const MailMessage &message)
+{
+    if (!loggedIn || !relayUp)
+    {
+        error = "not connected";
+        return false;
+    }
+    if (!relayHost)
+    {
+        if (sendDelayMs)
+            std::this_thread::sleep_for(std::chrono::milliseconds(sendDelayMs));
+        sent++;
+        lastBody = message.body;
+        lastAttachmentBytes = message.attachmentPath ? fakeStorage().fileSize(message.attachmentPath) : -1;
+        return true;
+    }
+
+    std::string line = std::string("MAIL FROM:<") + message.senderEmail + ">\r\n";
+    if (!command(line.c_str(), 250))
+    {
+        error = "MAIL FROM rejected";
+        return false;
+    }
+    line = std::string("RCPT TO:<") + message.recipient + ">\r\n";
+    if (!command(line.c_str(), 250))
+    {
+        error = "RCPT TO rejected";
+        return false;
+    }
+    if (!command("DATA\r\n", 354))
+    {
+        error = "DATA rejected";
+        return false;
+    }
+    static const char boundary[] = "==native-boundary==";
+    std::string data = std::string("From: ") + message.senderName + " <" + message.senderEmail +
+                       ">\r\nTo: <" + message.recipient + ">\r\nSubject: " + message.subject + "\r\n";
+    if (message.attachmentPath)
+        data += std::string("MIME-Version: 1.0\r\nContent-Type: multipart/mixed; boundary=\"") + boundary +
+                "\"\r\n\r\n--" + boundary + "\r\nContent-Type: text/plain; charset=us-ascii\r\n";
+    data += "\r\n";
+    // Normalise line endings and dot-stuff the body.
+    bool lineStart = true;
+    for (const char *p = message.body; *p; p++)
+    {
+        if (lineStart && *p == '.')
+            data += '.';
+        if (*p == '\n')
+            data += '\r';
+        data += *p;
+        lineStart = *p == '\n';
+    }
+    if (message.attachmentPath)
+    {
+        data += std::string("\r\n--") + boundary + "\r\nContent-Type: " + message.attachmentMime +
+                "\r\nContent-Disposition: attachment; filename=\"" + message.attachmentName +
+                "\"\r\nContent-Transfer-Encoding: base64\r\n\r\n";
+        if (!sendAll(data.c_str(), data.size()) || !sendAttachment(message.attachmentPath))
+        {
+            error = "attachment failed";
+            return false;
+        }
+        data = std::string("--") + boundary + "--";
+    }
+    data += "\r\n.\r\n";
+    if (!command(data.c_str(), 250))
+    {
+        error = "message rejected";
+        return false;
+    }
+    sent++;
+    lastBody = message.body;
+    lastAttachmentBytes = message.attachmentPath ? fakeStorage().fileSize(message.attachmentPath) : -1;
+    return true;
+}
+
+bool LoopbackTcpServer::begin(uint16_t port)
+{
+    if (listenFd >= 0)
+        return true;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 64) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    listenFd = fd;
+    return true;
+}
+
+int LoopbackTcpServer::accept()
+{
+    if (listenFd < 0)
+        return -1;
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd < 0)
+        return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    accepted++;
+    return fd;
+}
+
+int LoopbackTcpServer::read(int connection, char *buffer, size_t capacity)
+{
+    ssize_t n = recv(connection, buffer, capacity, MSG_DONTWAIT);
+    if (n > 0)
+        return (int)n;
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+int LoopbackTcpServer::write(int connection, const char *data, size_t len)
+{
+    ssize_t n = send(connection, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n >= 0)
+    {
+        bytesSent += (unsigned long)n;
+        return (int)n;
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+}
+
+void LoopbackTcpServer::close(int connection)
+{
+    ::close(connection);
+}
+
+bool SocketTcpClient::connect(const char *host, uint16_t port, uint32_t)
+{
+    close();
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    struct addrinfo hints = {}, *result = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, service, &hints, &result) != 0)
+        return false;
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next)
+    {
+        socketFd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (socketFd >= 0 && ::connect(socketFd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        if (socketFd >= 0)
+            ::close(socketFd);
+        socketFd = -1;
+    }
+    freeaddrinfo(result);
+    if (socketFd < 0)
+        return false;
+    int yes = 1;
+    setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    connects++;
+    return true;
+}
+
+bool SocketTcpClient::write(const uint8_t *data, size_t len)
+{
+    if (socketFd < 0 || ::send(socketFd, data, len, MSG_NOSIGNAL) != (ssize_t)len)
+    {
+        close();
+        return false;
+    }
+    bytesSent += len;
+    return true;
+}
+
+bool SocketTcpClient::read(uint8_t *buffer, size_t len, uint32_t timeoutMs)
+{
+    size_t got = 0;
+    while (got < len && socketFd >= 0)
+    {
+        struct pollfd p = {socketFd, POLLIN, 0};
+        if (poll(&p, 1, (int)timeoutMs) <= 0)
+            return false;
+        ssize_t n = recv(socketFd, buffer + got, len - got, 0);
+        if (n <= 0)
+        {
+            close();
+            return false;
+        }
+        got += (size_t)n;
+    }
+    return got == len;
+}
+
+void SocketTcpClient::close()
+{
+    if (socketFd >= 0)
+        ::close(socketFd);
+    socketFd = -1;
+}
+
+void FakeSystem::restart()
+{
+    fprintf(stderr, "[native] restart requested, exiting\n");
+    exit(0);
+}
+
+void FakeSystem::deepSleep(uint32_t ms)
+{
+    fakeNetwork().connected = false;
+    fakeClock().advance(ms);
+    sleeps++;
+    sleptMs += ms;
+    woke = true;
+}
+
+void FakeSystem::halt()
+{
+    fprintf(stderr, "[native] halted\n");
+    exit(1);
+}
+
+// std::less<> looks paths up without building a std::string, so reads
+// don't show up in the allocation counts.
+static std::map<std::string, std::string, std::less<>> &files()
+{
+    static std::map<std::string, std::string, std::less<>> instance;
+    return instance;
+}
+
+bool FakeStorage::format()
+{
+    files().clear();
+    return true;
+}
+
+bool FakeStorage::exists(const char *path)
+{
+    return files().count(path) != 0;
+}
+
+long FakeStorage::readFile(const char *path, char *buffer, size_t capacity)
+{
+    return readFileAt(path, 0, buffer, capacity);
+}
+
+long FakeStorage::readFileAt(const char *path, size_t offset, char *buffer, size_t capacity)
+{
+    auto it = files().find(path);
+    if (it == files().end())
+        return -1;
+    if (offset >= it->second.size())
+        return 0;
+    size_t n = it->second.size() - offset;
+    if (n > capacity)
+        n = capacity;
+    it->second.copy(buffer, n, offset);
+    return (long)n;
+}
+
+bool FakeStorage::appendFile(const char *path, const char *data, size_t len)
+{
+    files()[path].append(data, len);
+    appends++;
+    bytesAppended += len;
+    return true;
+}
+
+long FakeStorage::fileSize(const char *path)
+{
+    auto it = files().find(path);
+    return it == files().end() ? -1 : (long)it->second.size();
+}
+
+bool FakeStorage::remove(const char *path)
+{
+    return files().erase(path) != 0;
+}
+
+void FakeStorage::listFiles(FileVisitor fn, void *context)
+{
+    for (const auto &file : files())
+        fn(file.first.c_str(), file.second.size(), context);
+}
+
+size_t FakeStorage::usedBytes()
+{
+    size_t used = 0;
+    for (const auto &file : files())
+        used += file.second.size();
+    return used;
+}
+
+bool FakeStorage::writeFile(const char *path, const char *data, size_t len)
+{
+    files()[path].assign(data, len);
+    return true;
+}
+
+FakeSensor &fakeSensor(uint8_t channel)
+{
+    // Only channel 0 is fitted unless told otherwise; each further sensor
+    // reads half a degree warmer.
+    static FakeSensor instances[SENSOR_CHANNELS] = {
+        {true, 24.0f},
+        {false, 24.5f},
+        {false, 25.0f},
+        {false, 25.5f},
+    };
+    return instances[channel];
+}
+FakeSerialPort &fakeUsbSerial()
+{
+    static FakeSerialPort instance("usb");
+    return instance;
+}
+FakeSerialPort &fakeRs232Serial()
+{
+    static FakeSerialPort instance("rs232");
+    return instance;
+}
+FakeClock &fakeClock()
+{
+    static FakeClock instance;
+    return instance;
+}
+FakeNetwork &fakeNetwork()
+{
+    static FakeNetwork instance;
+    return instance;
+}
+FakeMailTransport &fakeMail()
+{
+    static FakeMailTransport instance;
+    return instance;
+}
+LoopbackTcpServer &fakeTcpServer()
+{
+    static LoopbackTcpServer instance;
+    return instance;
+}
+SocketTcpClient &fakeMqttSocket()
+{
+    static SocketTcpClient instance;
+    return instance;
+}
+FakeStorage &fakeStorage()
+{
+    static FakeStorage instance;
+    return instance;
+}
+FakeSystem &fakeSystem()
+{
+    static FakeSystem instance;
+    return instance;
+}
+
+} // namespace native
+
+Sensor &sensor(uint8_t channel) { return native::fakeSensor(channel); }
+SerialPort &usbSerial() { return native::fakeUsbSerial(); }
+SerialPort &rs232Serial() { return native::fakeRs232Serial(); }
+Clock &clock() { return native::fakeClock(); }
+Network &network() { return native::fakeNetwork(); }
+MailTransport &mail() { return native::fakeMail(); }
+TcpServer &tcpServer() { return native::fakeTcpServer(); }
+TcpClient &mqttSocket() { return native::fakeMqttSocket(); }
+Storage &storage() { return native::fakeStorage(); }
+System &system() { return native::fakeSystem(); }
+
+} // namespace hal
+
+#endif // !ARDUINO
@@ -0,0 +1,55 @@
+// --- Heap Monitor ---
+#include "heap_monitor.h"
+
+#include "hal.h"
+
+HeapMonitor heapMonitor;
+
+static const uint32_t CHECKS_PER_HOUR = 3600000UL / HEAP_CHECK_INTERVAL_MS;
+
+uint8_t HeapMonitor::fragmentation(uint32_t freeBytes, uint32_t largestBlock)
+{
+    if (freeBytes == 0 || largestBlock >= freeBytes)
+        return 0;
+    return (uint8_t)(100 - (uint64_t)largestBlock * 100 / freeBytes);
+}
+
+bool HeapMonitor::check()
+{
+    hal::System &system = hal::system();
+    counters.freeBytes = system.freeHeap();
+    counters.largestBlock = system.largestFreeBlock();
+    counters.fragmentation = fragmentation(counters.freeBytes, counters.largestBlock);
+    if (counters.fragmentation > counters.maxFragmentation)
+        counters.maxFragmentation = counters.fragmentation;
+    if (counters.checks == 0 || counters.largestBlock < counters.minLargestBlock)
+        counters.minLargestBlock = counters.largestBlock;
+    if (counters.checks % CHECKS_PER_HOUR == 0)
+    {
+        hourlyFree[nextHour] = counters.freeBytes;
+        nextHour = (uint8_t)((nextHour + 1) % HEAP_TREND_HOURS);
+        if (hoursKept < HEAP_TREND_HOURS)
+            hoursKept++;
+    }
+    counters.checks++;
+
+    if (counters.largestBlock >= HEAP_BLOCK_FLOOR)
+    {
+        counters.belowFloor = 0;
+        return false;
+    }
+    counters.belowFloor++;
+    if (counters.belowFloor != HEAP_DEGRADED_CHECKS)
+        return false;
+    counters.degradedEvents++;
+    return true;
+}
+
+int32_t HeapMonitor::freeTrendPerHour() const
+{
+    if (hoursKept < 2)
+        return 0;
+    uint8_t newest = (uint8_t)((nextHour + HEAP_TREND_HOURS - 1) % HEAP_TREND_HOURS);
+    uint8_t oldest = hoursKept < HEAP_TREND_HOURS ? 0 : nextHour;
+    return ((int32_t)hourlyFree[newest] - (int32_t)hourlyFree[oldest]) / (hoursKept - 1);
+}
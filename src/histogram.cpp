@@ -0,0 +1,45 @@
+// --- Latency Histogram ---
+#include "histogram.h"
+
+#include <string.h>
+
+void Histogram::record(uint32_t value)
+{
+    // Bucket = bit length of the value: 0 -> 0, 1 -> 1, 2-3 -> 2, ...
+    uint8_t bucket = value ? 32 - __builtin_clz(value) : 0;
+    if (bucket > HISTOGRAM_BUCKETS - 1)
+        bucket = HISTOGRAM_BUCKETS - 1;
+    buckets[bucket]++;
+    if (count == 0 || value < min)
+        min = value;
+    if (value > max)
+        max = value;
+    count++;
+    total += value;
+}
+
+void Histogram::clear()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+uint32_t Histogram::percentile(uint8_t percent) const
+{
+    if (count == 0)
+        return 0;
+    // Nearest rank, as in SampleHistory::percentile().
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    if (rank == 0)
+        rank = 1;
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += buckets[bucket];
+        if (seen >= rank)
+        {
+            uint32_t upper = bucket == HISTOGRAM_BUCKETS - 1 ? max : (1u << bucket) - 1;
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
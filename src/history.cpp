@@ -0,0 +1,267 @@
+// --- In-RAM Sample History ---
+#include "history.h"
+
+#include "hal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+SampleHistory history[SENSOR_CHANNELS];
+
+static uint64_t uptimeBaseMs = 0;
+
+uint64_t uptimeMillis()
+{
+    // Extend millis() to 64 bits by counting wraps; called at least once a
+    // minute from loop(), far more often than the 49-day wrap.
+    static uint32_t lastMs = 0;
+    static uint64_t wrapped = 0;
+    uint32_t now = hal::clock().millis();
+    if (now < lastMs)
+        wrapped += 1ULL << 32;
+    lastMs = now;
+    return uptimeBaseMs + wrapped + now;
+}
+
+uint32_t uptimeSeconds()
+{
+    return (uint32_t)(uptimeMillis() / 1000);
+}
+
+void setUptimeBase(uint64_t ms)
+{
+    uptimeBaseMs = ms;
+}
+
+bool parseSpan(const char *text, uint32_t &seconds)
+{
+    char *end;
+    unsigned long n = strtoul(text, &end, 10);
+    if (end == text || n == 0)
+        return false;
+    unsigned long scale = 60;
+    if (*end == 's')
+        scale = 1;
+    else if (*end == 'h')
+        scale = 3600;
+    else if (*end == 'd')
+        scale = 86400;
+    else if (*end != 'm' && *end != '\0')
+        return false;
+    if (*end && end[1] != '\0')
+        return false;
+    if (n > 400UL * 86400 / scale)
+        return false;
+    seconds = (uint32_t)(n * scale);
+    return true;
+}
+
+static int16_t toCentiC(float c)
+{
+    float v = roundf(c * 100.0f);
+    if (v > 32767.0f)
+        return 32767;
+    if (v < -32768.0f)
+        return -32768;
+    return (int16_t)v;
+}
+
+static uint16_t toCentiRH(float rh)
+{
+    float v = roundf(rh * 100.0f);
+    if (v > 10000.0f)
+        return 10000;
+    if (v < 0.0f)
+        return 0;
+    return (uint16_t)v;
+}
+
+void SampleHistory::clear()
+{
+    current = 0;
+    used = 0;
+    total = 0;
+}
+
+void SampleHistory::append(uint32_t timestampSec, float temperatureC, float humidity)
+{
+    Block *b = used ? &blocks[current] : nullptr;
+    bool startNew = !b || b->count == HISTORY_BLOCK_SAMPLES ||
+                    timestampSec - b->endSec > UINT16_MAX;
+    if (startNew)
+    {
+        if (b)
+            current = (current + 1) % HISTORY_BLOCKS;
+        b = &blocks[current];
+        if (used == HISTORY_BLOCKS)
+            total -= b->count; // Recycle the oldest block
+        else
+            used++;
+        b->count = 0;
+        b->startSec = timestampSec;
+        b->endSec = timestampSec;
+    }
+
+    PackedSample &s = b->s[b->count];
+    s.deltaSec = (uint16_t)(timestampSec - b->endSec);
+    s.centiC = toCentiC(temperatureC);
+    s.centiRH = toCentiRH(humidity);
+
+    if (b->count == 0)
+    {
+        b->minCentiC = b->maxCentiC = s.centiC;
+        b->minCentiRH = b->maxCentiRH = s.centiRH;
+        b->sumCentiC = 0;
+        b->sumCentiRH = 0;
+    }
+    else
+    {
+        if (s.centiC < b->minCentiC)
+            b->minCentiC = s.centiC;
+        if (s.centiC > b->maxCentiC)
+            b->maxCentiC = s.centiC;
+        if (s.centiRH < b->minCentiRH)
+            b->minCentiRH = s.centiRH;
+        if (s.centiRH > b->maxCentiRH)
+            b->maxCentiRH = s.centiRH;
+    }
+    b->sumCentiC += s.centiC;
+    b->sumCentiRH += s.centiRH;
+    b->endSec = timestampSec;
+    b->count++;
+    total++;
+}
+
+// A sample at 'ts' is inside the window if it is less than spanSec old.
+static bool inWindow(uint32_t ts, uint32_t nowSec, uint32_t spanSec)
+{
+    return ts <= nowSec && nowSec - ts < spanSec;
+}
+
+bool SampleHistory::window(uint32_t nowSec, uint32_t spanSec, WindowStats &stats) const
+{
+    memset(&stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < used; i++)
+    {
+        const Block &b = blocks[(current + HISTORY_BLOCKS - i) % HISTORY_BLOCKS];
+        if (!inWindow(b.endSec, nowSec, spanSec))
+            break; // This block and everything older is outside the window
+
+        int32_t minC, maxC, minRH, maxRH;
+        int64_t sumC, sumRH;
+        uint32_t n;
+        if (inWindow(b.startSec, nowSec, spanSec))
+        {
+            // Whole block: use the running aggregates.
+            n = b.count;
+            minC = b.minCentiC;
+            maxC = b.maxCentiC;
+            minRH = b.minCentiRH;
+            maxRH = b.maxCentiRH;
+            sumC = b.sumCentiC;
+            sumRH = b.sumCentiRH;
+        }
+        else
+        {
+            // Straddles the window start: decode it.
+            n = 0;
+            minC = INT32_MAX;
+            maxC = INT32_MIN;
+            minRH = INT32_MAX;
+            maxRH = INT32_MIN;
+            sumC = sumRH = 0;
+            uint32_t ts = b.startSec;
+            for (uint16_t k = 0; k < b.count; k++)
+            {
+                ts += b.s[k].deltaSec;
+                if (!inWindow(ts, nowSec, spanSec))
+                    continue;
+                const PackedSample &s = b.s[k];
+                n++;
+                minC = s.centiC < minC ? s.centiC : minC;
+                maxC = s.centiC > maxC ? s.centiC : maxC;
+                minRH = s.centiRH < minRH ? s.centiRH : minRH;
+                maxRH = s.centiRH > maxRH ? s.centiRH : maxRH;
+                sumC += s.centiC;
+                sumRH += s.centiRH;
+            }
+            if (n == 0)
+                continue;
+        }
+
+        if (stats.count == 0)
+        {
+            stats.minCentiC = minC;
+            stats.maxCentiC = maxC;
+            stats.minCentiRH = minRH;
+            stats.maxCentiRH = maxRH;
+        }
+        else
+        {
+            stats.minCentiC = minC < stats.minCentiC ? minC : stats.minCentiC;
+            stats.maxCentiC = maxC > stats.maxCentiC ? maxC : stats.maxCentiC;
+            stats.minCentiRH = minRH < stats.minCentiRH ? minRH : stats.minCentiRH;
+            stats.maxCentiRH = maxRH > stats.maxCentiRH ? maxRH : stats.maxCentiRH;
+        }
+        stats.count += n;
+        stats.sumCentiC += sumC;
+        stats.sumCentiRH += sumRH;
+    }
+    return stats.count > 0;
+}
+
+bool SampleHistory::percentile(uint32_t nowSec, uint32_t spanSec, HistoryMetric metric,
+                               uint8_t percent, int32_t &value) const
+{
+    WindowStats stats;
+    if (!window(nowSec, spanSec, stats))
+        return false;
+    if (percent > 100)
+        percent = 100;
+
+    // Nearest rank: the smallest value v with at least 'rank' samples <= v.
+    uint32_t rank = (stats.count * percent + 99) / 100;
+    if (rank == 0)
+        rank = 1;
+    int32_t lo = metric == HISTORY_TEMPERATURE ? stats.minCentiC : stats.minCentiRH;
+    int32_t hi = metric == HISTORY_TEMPERATURE ? stats.maxCentiC : stats.maxCentiRH;
+
+    // Binary search on the value; each step counts samples <= mid, skipping
+    // whole blocks whose min/max already decide the answer.
+    while (lo < hi)
+    {
+        int32_t mid = lo + (hi - lo) / 2;
+        uint32_t atOrBelow = 0;
+        for (uint8_t i = 0; i < used; i++)
+        {
+            const Block &b = blocks[(current + HISTORY_BLOCKS - i) % HISTORY_BLOCKS];
+            if (!inWindow(b.endSec, nowSec, spanSec))
+                break;
+            int32_t bMin = metric == HISTORY_TEMPERATURE ? b.minCentiC : b.minCentiRH;
+            int32_t bMax = metric == HISTORY_TEMPERATURE ? b.maxCentiC : b.maxCentiRH;
+            bool whole = inWindow(b.startSec, nowSec, spanSec);
+            if (bMin > mid)
+                continue;
+            if (whole && bMax <= mid)
+            {
+                atOrBelow += b.count;
+                continue;
+            }
+            uint32_t ts = b.startSec;
+            for (uint16_t k = 0; k < b.count; k++)
+            {
+                ts += b.s[k].deltaSec;
+                int32_t v = metric == HISTORY_TEMPERATURE ? b.s[k].centiC : b.s[k].centiRH;
+                if (v <= mid && (whole || inWindow(ts, nowSec, spanSec)))
+                    atOrBelow++;
+            }
+        }
+        if (atOrBelow >= rank)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    value = lo;
+    return true;
+}
@@ -0,0 +1,330 @@
+// --- Persistent History Log ---
+#include "history_log.h"
+
+#include "crc16.h"
+#include "hal.h"
+#include "reading_format.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+HistoryLog historyLog;
+
+static const uint32_t SEGMENT_MAGIC = 0x314C4854; // "THL1"
+
+struct SegmentHeader
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t firstEpoch;
+    uint16_t recordSize;
+    uint16_t crc; // CRC16 of the fields above
+} __attribute__((packed));
+
+static void segmentPath(char *buffer, size_t size, uint32_t seq)
+{
+    snprintf(buffer, size, "/hist_%08lu.bin", (unsigned long)seq);
+}
+
+static bool recordValid(const LogRecord &record)
+{
+    return crc16(&record, offsetof(LogRecord, crc)) == record.crc;
+}
+
+static size_t recordOffset(uint32_t index)
+{
+    return sizeof(SegmentHeader) + (size_t)index * sizeof(LogRecord);
+}
+
+bool HistoryLog::readRecord(const Segment &segment, uint32_t index, LogRecord &record)
+{
+    char path[24];
+    segmentPath(path, sizeof(path), segment.seq);
+    return hal::storage().readFileAt(path, recordOffset(index), (char *)&record, sizeof(record)) ==
+               (long)sizeof(record) &&
+           recordValid(record);
+}
+
+// --- Boot-time Index ---
+
+struct SegmentScan
+{
+    uint32_t seqs[HISTORY_LOG_MAX_SEGMENTS * 2];
+    size_t count;
+};
+
+static void collectSegment(const char *path, size_t, void *context)
+{
+    SegmentScan &scan = *(SegmentScan *)context;
+    if (strncmp(path, "/hist_", 6) != 0 || scan.count >= sizeof(scan.seqs) / sizeof(scan.seqs[0]))
+        return;
+    scan.seqs[scan.count++] = strtoul(path + 6, nullptr, 10);
+}
+
+static int compareSeq(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+bool HistoryLog::begin()
+{
+    hal::Storage &fs = hal::storage();
+    SegmentScan scan;
+    scan.count = 0;
+    fs.listFiles(collectSegment, &scan);
+    qsort(scan.seqs, scan.count, sizeof(scan.seqs[0]), compareSeq);
+
+    // Keep the newest HISTORY_LOG_MAX_SEGMENTS; anything older is stale.
+    char path[24];
+    size_t first = scan.count > HISTORY_LOG_MAX_SEGMENTS ? scan.count - HISTORY_LOG_MAX_SEGMENTS : 0;
+    for (size_t i = 0; i < first; i++)
+    {
+        segmentPath(path, sizeof(path), scan.seqs[i]);
+        fs.remove(path);
+    }
+
+    segmentCount = 0;
+    appendable = false;
+    for (size_t i = first; i < scan.count; i++)
+    {
+        segmentPath(path, sizeof(path), scan.seqs[i]);
+        SegmentHeader header;
+        long size = fs.fileSize(path);
+        if (fs.readFileAt(path, 0, (char *)&header, sizeof(header)) != (long)sizeof(header) ||
+            header.magic != SEGMENT_MAGIC || header.recordSize != sizeof(LogRecord) ||
+            crc16(&header, offsetof(SegmentHeader, crc)) != header.crc)
+        {
+            fs.remove(path); // Not one of ours, or the header itself was torn
+            continue;
+        }
+
+        Segment &segment = segments[segmentCount];
+        segment.seq = scan.seqs[i];
+        segment.firstEpoch = header.firstEpoch;
+        segment.records = (uint32_t)((size - sizeof(SegmentHeader)) / sizeof(LogRecord));
+        bool aligned = (size - sizeof(SegmentHeader)) % sizeof(LogRecord) == 0;
+
+        // Only the tail can be damaged (power lost mid-append): walk back
+        // from the last record to the newest one with a good CRC.
+        LogRecord last;
+        bool torn = !aligned;
+        while (segment.records > 0 && !readRecord(segment, segment.records - 1, last))
+        {
+            segment.records--;
+            torn = true;
+        }
+        if (torn)
+            counters.tornTails++;
+        segment.lastEpoch = segment.records ? last.epoch : segment.firstEpoch;
+        segmentCount++;
+        // Never append after a damaged tail; the next flush opens a new segment.
+        appendable = !torn;
+    }
+
+    lastEpoch = segmentCount ? segments[segmentCount - 1].lastEpoch : 0;
+    counters.segments = segmentCount;
+    return true;
+}
+
+// --- Writing ---
+
+bool HistoryLog::startSegment(uint32_t firstEpoch)
+{
+    hal::Storage &fs = hal::storage();
+    char path[24];
+    if (segmentCount == HISTORY_LOG_MAX_SEGMENTS)
+    {
+        segmentPath(path, sizeof(path), segments[0].seq);
+        fs.remove(path);
+        memmove(&segments[0], &segments[1], sizeof(Segment) * (segmentCount - 1));
+        segmentCount--;
+    }
+
+    Segment &segment = segments[segmentCount];
+    segment.seq = segmentCount ? segments[segmentCount - 1].seq + 1 : 1;
+    segment.firstEpoch = firstEpoch;
+    segment.lastEpoch = firstEpoch;
+    segment.records = 0;
+
+    SegmentHeader header;
+    header.magic = SEGMENT_MAGIC;
+    header.seq = segment.seq;
+    header.firstEpoch = firstEpoch;
+    header.recordSize = sizeof(LogRecord);
+    header.crc = crc16(&header, offsetof(SegmentHeader, crc));
+    segmentPath(path, sizeof(path), segment.seq);
+    if (!fs.writeFile(path, (const char *)&header, sizeof(header)))
+        return false;
+
+    if (segmentCount)
+        counters.rotations++;
+    segmentCount++;
+    counters.segments = segmentCount;
+    counters.bytesWritten += sizeof(header);
+    appendable = true;
+    return true;
+}
+
+bool HistoryLog::append(uint32_t epoch, uint8_t channel, float temperatureC, float humidity)
+{
+    if (epoch < lastEpoch)
+    {
+        counters.outOfOrder++;
+        return false;
+    }
+    if (pageUsed == RECORDS_PER_PAGE && !flush())
+    {
+        counters.writeErrors++; // Page still full: the flash write keeps failing
+        return false;
+    }
+    LogRecord &record = page[pageUsed++];
+    record.epoch = epoch;
+    record.centiC = (int16_t)lroundf(temperatureC * 100.0f);
+    record.centiRH = (uint16_t)lroundf(humidity * 100.0f);
+    record.channel = channel;
+    record.crc = crc16(&record, offsetof(LogRecord, crc));
+    lastEpoch = epoch;
+    counters.appended++;
+
+    if (pageUsed == RECORDS_PER_PAGE)
+        flush(); // On failure the page stays buffered and is retried next append
+    return true;
+}
+
+bool HistoryLog::flush()
+{
+    if (pageUsed == 0)
+        return true;
+
+    size_t bytes = pageUsed * sizeof(LogRecord);
+    Segment *segment = segmentCount ? &segments[segmentCount - 1] : nullptr;
+    if (!appendable || !segment || recordOffset(segment->records) + bytes > HISTORY_LOG_SEGMENT_BYTES)
+    {
+        if (!startSegment(page[0].epoch))
+            return false;
+        segment = &segments[segmentCount - 1];
+    }
+
+    char path[24];
+    segmentPath(path, sizeof(path), segment->seq);
+    if (!hal::storage().appendFile(path, (const char *)page, bytes))
+    {
+        counters.writeErrors++;
+        appendable = false; // Don't trust this segment's tail any more
+        return false;
+    }
+    segment->records += pageUsed;
+    segment->lastEpoch = page[pageUsed - 1].epoch;
+    counters.bytesWritten += bytes;
+    counters.flushes++;
+    pageUsed = 0;
+    return true;
+}
+
+// --- Queries ---
+
+size_t HistoryLog::querySegment(const Segment &segment, uint32_t fromEpoch, uint32_t toEpoch,
+                                RecordVisitor visit, void *context, bool &stop)
+{
+    // Binary search for the first record at or after fromEpoch.
+    uint32_t lo = 0, hi = segment.records;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        LogRecord record;
+        if (readRecord(segment, mid, record) && record.epoch < fromEpoch)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // Then stream forward one page at a time.
+    char path[24];
+    segmentPath(path, sizeof(path), segment.seq);
+    LogRecord chunk[RECORDS_PER_PAGE];
+    size_t visited = 0;
+    for (uint32_t index = lo; index < segment.records;)
+    {
+        uint32_t want = segment.records - index;
+        if (want > RECORDS_PER_PAGE)
+            want = RECORDS_PER_PAGE;
+        long got = hal::storage().readFileAt(path, recordOffset(index), (char *)chunk,
+                                             want * sizeof(LogRecord));
+        if (got <= 0)
+            break;
+        uint32_t n = (uint32_t)got / sizeof(LogRecord);
+        for (uint32_t k = 0; k < n; k++)
+        {
+            if (!recordValid(chunk[k]))
+            {
+                counters.crcErrors++;
+                continue;
+            }
+            if (chunk[k].epoch >= toEpoch)
+                return visited;
+            if (chunk[k].epoch < fromEpoch)
+                continue;
+            visited++;
+            if (!visit(chunk[k], context))
+            {
+                stop = true;
+                return visited;
+            }
+        }
+        index += n;
+    }
+    return visited;
+}
+
+size_t HistoryLog::query(uint32_t fromEpoch, uint32_t toEpoch, RecordVisitor visit, void *context)
+{
+    size_t visited = 0;
+    bool stop = false;
+    for (uint8_t i = 0; i < segmentCount && !stop; i++)
+    {
+        const Segment &segment = segments[i];
+        if (segment.records == 0 || segment.lastEpoch < fromEpoch || segment.firstEpoch >= toEpoch)
+            continue;
+        visited += querySegment(segment, fromEpoch, toEpoch, visit, context, stop);
+    }
+    for (uint8_t k = 0; k < pageUsed && !stop; k++)
+    {
+        if (page[k].epoch < fromEpoch || page[k].epoch >= toEpoch)
+            continue;
+        visited++;
+        stop = !visit(page[k], context);
+    }
+    return visited;
+}
+
+HistoryLogStats HistoryLog::stats() const
+{
+    HistoryLogStats s = counters;
+    s.pending = pageUsed;
+    return s;
+}
+
+size_t formatCsvRow(const LogRecord &record, char *out)
+{
+    time_t t = record.epoch;
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    size_t len = strftime(out, LOG_CSV_ROW_MAX, "%Y-%m-%dT%H:%M:%SZ", &utc);
+    // ",C,F,RH,channel\n": at most 3 * 7 + 2 characters after the timestamp.
+    out[len++] = ',';
+    len += formatCenti(out + len, record.centiC);
+    out[len++] = ',';
+    len += formatCenti(out + len, centiCToCentiF(record.centiC));
+    out[len++] = ',';
+    len += formatCenti(out + len, record.centiRH);
+    out[len++] = ',';
+    out[len++] = (char)('0' + record.channel);
+    out[len++] = '\n';
+    out[len] = '\0';
+    return len;
+}
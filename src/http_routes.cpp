@@ -0,0 +1,351 @@
+// --- HTTP Routes ---
+#include "http_routes.h"
+
+#include "feature_flags.h"
+
+#if FEATURE_NETWORK
+#include "acquisition.h"
+#include "alerts.h"
+#include "duty_cycle.h"
+#include "hal.h"
+#include "heap_monitor.h"
+#include "history.h"
+#include "history_log.h"
+#include "mail_queue.h"
+#include "modbus_slave.h"
+#include "mqtt_publisher.h"
+#include "outbox.h"
+#include "profiler.h"
+#include "reading_format.h"
+#include "smtp_manager.h"
+#include "time_service.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Metric
+{
+    const char *name;
+    const char *type; // "gauge" or "counter"
+    const char *help;
+    double (*value)(); // NAN: leave the metric out of this scrape
+};
+
+// One series per sensor channel, labelled channel="N".
+struct ChannelMetric
+{
+    const char *name;
+    const char *type;
+    const char *help;
+    double (*value)(uint8_t channel); // NAN: no series for this channel
+};
+
+static double latestValue(uint8_t channel, bool temperature)
+{
+    Sample sample;
+    if (!acquisition.latest(channel, sample))
+        return NAN;
+    return temperature ? sample.temperatureC : sample.humidity;
+}
+
+static const ChannelMetric CHANNEL_METRICS[] = {
+    {"temperature_celsius", "gauge", "Last temperature reading", [](uint8_t channel) { return latestValue(channel, true); }},
+    {"humidity_percent", "gauge", "Last relative humidity reading", [](uint8_t channel) { return latestValue(channel, false); }},
+    {"sample_age_seconds", "gauge", "Age of the last reading",
+     [](uint8_t channel) {
+         Sample sample;
+         return acquisition.latest(channel, sample) ? (hal::clock().millis() - sample.takenAtMs) / 1000.0 : NAN;
+     }},
+    {"sensor_failures_total", "counter", "Readings the sensor could not deliver",
+     [](uint8_t channel) { return acquisition.present(channel) ? (double)acquisition.stats().channelFailures[channel] : NAN; }},
+    {"history_samples", "gauge", "Samples held in RAM",
+     [](uint8_t channel) { return acquisition.present(channel) ? (double)history[channel].size() : NAN; }},
+};
+static const size_t CHANNEL_METRIC_COUNT = sizeof(CHANNEL_METRICS) / sizeof(CHANNEL_METRICS[0]);
+
+static const Metric METRICS[] = {
+    {"sensors", "gauge", "SHT31 sensors found", [] { return (double)acquisition.count(); }},
+    {"sensor_measurements_total", "counter", "Measurement passes over every sensor", [] { return (double)acquisition.stats().misses; }},
+    {"sensor_cache_hits_total", "counter", "Readings served from the cache", [] { return (double)acquisition.stats().hits; }},
+    {"sensor_heater_cycles_total", "counter", "SHT31 heater runs against condensation", [] { return (double)acquisition.stats().heaterCycles; }},
+    {"log_records_total", "counter", "Readings appended to the flash log", [] { return (double)historyLog.stats().appended; }},
+    {"log_write_errors_total", "counter", "Failed flash log writes", [] { return (double)historyLog.stats().writeErrors; }},
+    {"alerts_raised_total", "counter", "Alert rules raised", [] { return (double)alerts.stats().raised; }},
+#if FEATURE_EMAIL
+    {"mail_sent_total", "counter", "Emails sent", [] { return (double)mailQueue.stats().sent; }},
+    {"mail_failed_total", "counter", "Emails that could not be sent", [] { return (double)mailQueue.stats().failed; }},
+    {"mail_dropped_total", "counter", "Emails dropped on a full queue", [] { return (double)mailQueue.stats().dropped; }},
+    {"mail_queue_depth", "gauge", "Emails waiting to be sent", [] { return (double)mailQueue.stats().depth; }},
+    {"outbox_queued_total", "counter", "Reports stored in the flash outbox", [] { return (double)outbox.stats().queued; }},
+    {"outbox_flushed_total", "counter", "Reports sent from the flash outbox", [] { return (double)outbox.stats().flushed; }},
+    {"outbox_evicted_total", "counter", "Oldest reports overwritten in a full outbox", [] { return (double)outbox.stats().evicted; }},
+    {"outbox_pending", "gauge", "Reports waiting in the flash outbox", [] { return (double)outbox.stats().pending; }},
+#endif
+    {"mqtt_published_samples_total", "counter", "Samples published to MQTT", [] { return (double)mqttPublisher.stats().publishedSamples; }},
+    {"mqtt_dropped_samples_total", "counter", "Samples dropped from a full MQTT backlog", [] { return (double)mqttPublisher.stats().dropped; }},
+    {"mqtt_backlog_samples", "gauge", "Samples waiting for the MQTT broker", [] { return (double)mqttPublisher.stats().backlog; }},
+    {"mqtt_connected", "gauge", "1 while connected to the MQTT broker",
+     [] { return mqttPublisher.configured() ? (mqttPublisher.state() == MQTT_CONNECTED ? 1.0 : 0.0) : NAN; }},
+    {"time_synced", "gauge", "1 while NTP syncs are current, 0 unsynced or in holdover",
+     [] { return timeService.quality() == TIME_SYNCED ? 1.0 : 0.0; }},
+    {"time_since_sync_seconds", "gauge", "Time since the last NTP answer", [] { return (double)timeService.secondsSinceSync(); }},
+    {"ntp_syncs_total", "counter", "NTP answers", [] { return (double)timeService.stats().syncs; }},
+    {"ntp_offset_milliseconds", "gauge", "NTP minus the drift-corrected clock at the last sync",
+     [] { return (double)timeService.stats().lastOffsetMs; }},
+    {"clock_drift_ppm", "gauge", "Estimated oscillator drift", [] { return (double)timeService.stats().driftPpm; }},
+    {"free_heap_bytes", "gauge", "Free heap", [] { return (double)hal::system().freeHeap(); }},
+    {"min_free_heap_bytes", "gauge", "Lowest free heap since boot", [] { return (double)hal::system().minFreeHeap(); }},
+    {"heap_largest_free_block_bytes", "gauge", "Largest heap block that can be allocated",
+     [] { return (double)hal::system().largestFreeBlock(); }},
+    {"heap_fragmentation_percent", "gauge", "Free heap not in the largest block",
+     [] { return (double)HeapMonitor::fragmentation(hal::system().freeHeap(), hal::system().largestFreeBlock()); }},
+    {"uptime_seconds", "counter", "Time since boot", [] { return (double)uptimeSeconds(); }},
+    {"duty_wakes_total", "counter", "Timer wakes from deep sleep", [] { return (double)dutyCycle.stats().wakes; }},
+    {"duty_uplinks_total", "counter", "Timer wakes that went on to WiFi", [] { return (double)dutyCycle.stats().uplinks; }},
+    {"duty_average_current_microamps", "gauge", "Estimated average current draw over the duty cycle",
+     [] { return dutyCycle.stats().wakes ? (double)dutyCycle.averageMicroAmps() : NAN; }},
+    {"http_connections_total", "counter", "HTTP connections accepted", [] { return (double)httpServer.stats().accepted; }},
+#if FEATURE_MODBUS
+    {"modbus_requests_total", "counter", "Modbus requests for this unit", [] { return (double)modbus.stats().requests; }},
+    {"modbus_exceptions_total", "counter", "Modbus exception responses", [] { return (double)modbus.stats().exceptions; }},
+    {"modbus_crc_errors_total", "counter", "Modbus frames with a bad CRC", [] { return (double)modbus.stats().crcErrors; }},
+#endif
+};
+static const size_t METRIC_COUNT = sizeof(METRICS) / sizeof(METRICS[0]);
+
+struct MetricHistogram
+{
+    const char *name;
+    const char *help;
+    Histogram (*value)(); // A copy, so every line comes from the same moment
+};
+
+static const MetricHistogram HISTOGRAMS[] = {
+    {"sensor_i2c_microseconds", "Measurement pass over every sensor", [] { return acquisition.stats().i2cUs; }},
+#if FEATURE_EMAIL
+    {"smtp_handshake_milliseconds", "SMTP TCP + TLS + greeting time", [] { return smtpManager.stats().handshakeMs; }},
+    {"smtp_auth_milliseconds", "SMTP AUTH time", [] { return smtpManager.stats().authMs; }},
+    {"smtp_send_milliseconds", "SMTP message send time", [] { return smtpManager.stats().sendMs; }},
+#endif
+    {"mqtt_publish_microseconds", "MQTT batch encode to send (QoS 0) or PUBACK (QoS 1)", [] { return mqttPublisher.stats().publishUs; }},
+    {"ntp_answer_milliseconds", "NTP request to answer", [] { return timeService.stats().answerMs; }},
+    {"http_response_milliseconds", "HTTP request to last chunk", [] { return httpServer.stats().responseMs; }},
+#if FEATURE_MODBUS
+    {"modbus_turnaround_microseconds", "Modbus request received to response queued", [] { return modbus.stats().turnaroundUs; }},
+#endif
+    {"loop_microseconds", "One loop() pass", [] { return profiler.histogram(PROF_LOOP); }},
+};
+static const size_t HISTOGRAM_COUNT = sizeof(HISTOGRAMS) / sizeof(HISTOGRAMS[0]);
+
+// snprintf() onto the end of 'buffer'; false once it no longer fits.
+static bool appendf(char *buffer, size_t capacity, size_t &used, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+static bool appendf(char *buffer, size_t capacity, size_t &used, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer + used, capacity - used, format, args);
+    va_end(args);
+    if (len < 0 || (size_t)len >= capacity - used)
+        return false;
+    used += len;
+    return true;
+}
+
+static const char *openMetrics(HttpStream &, const char *)
+{
+    return "text/plain; version=0.0.4";
+}
+
+// One metric per piece: stream.step walks CHANNEL_METRICS, METRICS, then
+// HISTOGRAMS.
+static int writeMetrics(HttpStream &stream, char *buffer, size_t capacity)
+{
+    size_t used = 0;
+    if (stream.step < CHANNEL_METRIC_COUNT)
+    {
+        const ChannelMetric &metric = CHANNEL_METRICS[stream.step];
+        bool fits = appendf(buffer, capacity, used, "# HELP " METRIC_PREFIX "%s %s\n# TYPE " METRIC_PREFIX "%s %s\n",
+                            metric.name, metric.help, metric.name, metric.type);
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS && fits; channel++)
+        {
+            double value = metric.value(channel);
+            if (!isnan(value))
+                fits = appendf(buffer, capacity, used, METRIC_PREFIX "%s{channel=\"%u\"} %.10g\n", metric.name,
+                               (unsigned)channel, value);
+        }
+        if (!fits)
+            return -1;
+        stream.step++;
+        return (int)used;
+    }
+    for (; stream.step - CHANNEL_METRIC_COUNT < METRIC_COUNT; stream.step++)
+    {
+        const Metric &metric = METRICS[stream.step - CHANNEL_METRIC_COUNT];
+        double value = metric.value();
+        if (isnan(value))
+            continue;
+        if (!appendf(buffer, capacity, used, "# HELP " METRIC_PREFIX "%s %s\n# TYPE " METRIC_PREFIX "%s %s\n" METRIC_PREFIX "%s %.10g\n",
+                     metric.name, metric.help, metric.name, metric.type, metric.name, value))
+            return -1;
+        stream.step++;
+        return (int)used;
+    }
+    if (stream.step - CHANNEL_METRIC_COUNT - METRIC_COUNT >= HISTOGRAM_COUNT)
+        return 0;
+
+    const MetricHistogram &metric = HISTOGRAMS[stream.step - CHANNEL_METRIC_COUNT - METRIC_COUNT];
+    Histogram h = metric.value();
+    bool fits = appendf(buffer, capacity, used, "# HELP " METRIC_PREFIX "%s %s\n# TYPE " METRIC_PREFIX "%s histogram\n",
+                        metric.name, metric.help, metric.name);
+    // Bucket i counts values below 2^i: integers up to 2^i - 1.
+    uint32_t cumulative = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS - 1 && fits; i++)
+    {
+        cumulative += h.buckets[i];
+        fits = appendf(buffer, capacity, used, METRIC_PREFIX "%s_bucket{le=\"%lu\"} %lu\n", metric.name,
+                       (unsigned long)((1UL << i) - 1), (unsigned long)cumulative);
+    }
+    fits = fits && appendf(buffer, capacity, used,
+                           METRIC_PREFIX "%s_bucket{le=\"+Inf\"} %lu\n" METRIC_PREFIX "%s_sum %llu\n" METRIC_PREFIX "%s_count %lu\n",
+                           metric.name, (unsigned long)h.count, metric.name, (unsigned long long)h.total,
+                           metric.name, (unsigned long)h.count);
+    if (!fits)
+        return -1;
+    stream.step++;
+    return (int)used;
+}
+
+enum ReadingsFormat : uint8_t
+{
+    READINGS_JSON,
+    READINGS_CSV,
+};
+
+#define READINGS_ROW_MAX 84 // ",{"time":1700000000,"channel":3,"temperature_c":-12.34,"humidity_pct":100.00}\n"
+
+static const char *openReadings(HttpStream &stream, const char *query)
+{
+    char value[16];
+    stream.format = READINGS_JSON;
+    if (HttpServer::queryParam(query, "format", value, sizeof(value)))
+    {
+        if (strcmp(value, "csv") == 0)
+            stream.format = READINGS_CSV;
+        else if (strcmp(value, "json") != 0)
+            return nullptr;
+    }
+    uint32_t span = 86400;
+    if (HttpServer::queryParam(query, "since", value, sizeof(value)))
+    {
+        char *end;
+        unsigned long epoch = strtoul(value, &end, 10);
+        if (end != value && *end == '\0' && epoch >= 1000000000UL)
+            stream.fromEpoch = (uint32_t)epoch;
+        else if (!parseSpan(value, span))
+            return nullptr;
+    }
+    if (stream.fromEpoch == 0 && timeService.valid())
+    {
+        uint32_t now = (uint32_t)timeService.now();
+        stream.fromEpoch = now > span ? now - span : 0;
+    }
+    return stream.format == READINGS_CSV ? "text/csv" : "application/json";
+}
+
+// Where one piece of /readings is being written. The stream resumes after
+// the last record sent: stream.fromEpoch is its time and stream.skip the
+// number of records already sent with that time.
+struct ReadingsPiece
+{
+    HttpStream *stream;
+    char *buffer;
+    size_t capacity;
+    size_t used;
+    uint32_t toSkip;
+    bool full;
+};
+
+static bool addReading(const LogRecord &record, void *context)
+{
+    ReadingsPiece &piece = *(ReadingsPiece *)context;
+    HttpStream &stream = *piece.stream;
+    if (record.epoch == stream.fromEpoch && piece.toSkip > 0)
+    {
+        piece.toSkip--; // Sent in an earlier piece
+        return true;
+    }
+    if (piece.capacity - piece.used < READINGS_ROW_MAX)
+    {
+        piece.full = true;
+        return false;
+    }
+    char *out = piece.buffer + piece.used;
+    if (stream.format == READINGS_CSV)
+        piece.used += formatCsvRow(record, out);
+    else
+    {
+        char temperature[READING_TEXT_MAX], humidity[READING_TEXT_MAX];
+        formatCenti(temperature, record.centiC);
+        formatCenti(humidity, record.centiRH);
+        piece.used += snprintf(out, READINGS_ROW_MAX,
+                               "%s{\"time\":%lu,\"channel\":%u,\"temperature_c\":%s,\"humidity_pct\":%s}",
+                               stream.index ? ",\n" : "\n", (unsigned long)record.epoch, (unsigned)record.channel,
+                               temperature, humidity);
+    }
+    stream.index++;
+    if (record.epoch == stream.fromEpoch)
+        stream.skip++;
+    else
+    {
+        stream.fromEpoch = record.epoch;
+        stream.skip = 1;
+    }
+    return true;
+}
+
+// stream.step: 0 head, 1 records, 2 JSON tail.
+static int writeReadings(HttpStream &stream, char *buffer, size_t capacity)
+{
+    bool csv = stream.format == READINGS_CSV;
+    if (stream.step == 0)
+    {
+        const char *head = csv ? LOG_CSV_HEADER : "{\"readings\":[";
+        size_t len = strlen(head);
+        if (len > capacity)
+            return -1;
+        memcpy(buffer, head, len);
+        stream.step = 1;
+        return (int)len;
+    }
+    if (stream.step == 1)
+    {
+        ReadingsPiece piece = {&stream, buffer, capacity, 0, stream.skip, false};
+        historyLog.query(stream.fromEpoch, UINT32_MAX, addReading, &piece);
+        if (piece.full)
+            return piece.used ? (int)piece.used : -1;
+        stream.step = 2;
+        if (piece.used)
+            return (int)piece.used;
+    }
+    if (stream.step == 2 && !csv)
+    {
+        if (capacity < 4)
+            return -1;
+        memcpy(buffer, "\n]}\n", 4);
+        stream.step = 3;
+        return 4;
+    }
+    return 0;
+}
+
+const HttpRoute HTTP_ROUTES[] = {
+    {"/metrics", openMetrics, writeMetrics},
+    {"/readings", openReadings, writeReadings},
+};
+const size_t HTTP_ROUTE_COUNT = sizeof(HTTP_ROUTES) / sizeof(HTTP_ROUTES[0]);
+
+#endif // FEATURE_NETWORK
@@ -0,0 +1,267 @@
+// --- HTTP Endpoint ---
+#include "http_server.h"
+
+#include "hal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+HttpServer httpServer;
+
+bool HttpServer::begin(uint16_t port, const HttpRoute *routes, size_t count)
+{
+    if (!hal::tcpServer().begin(port))
+        return false;
+    this->routes = routes;
+    routeCount = count;
+    return true;
+}
+
+void HttpServer::poll()
+{
+    if (!running())
+        return;
+    hal::TcpServer &tcp = hal::tcpServer();
+    uint32_t now = hal::clock().millis();
+
+    uint8_t active = 0;
+    for (Client &client : clients)
+    {
+        if (client.state == FREE)
+        {
+            int connection = tcp.accept();
+            if (connection < 0)
+                continue;
+            client.state = READING;
+            client.connection = connection;
+            client.activeAtMs = now;
+            client.requestUsed = 0;
+            counters.accepted++;
+        }
+        active++;
+    }
+    if (active > counters.maxActive)
+        counters.maxActive = active;
+
+    for (Client &client : clients)
+    {
+        if (client.state != FREE)
+            serve(client);
+    }
+}
+
+void HttpServer::serve(Client &client)
+{
+    uint32_t now = hal::clock().millis();
+    if (client.state == READING)
+    {
+        int n = hal::tcpServer().read(client.connection, client.request + client.requestUsed,
+                                      sizeof(client.request) - 1 - client.requestUsed);
+        if (n < 0)
+        {
+            finish(client); // Closed before asking for anything
+            return;
+        }
+        if (n > 0)
+        {
+            client.requestUsed += n;
+            client.request[client.requestUsed] = '\0';
+            client.activeAtMs = now;
+            if (strstr(client.request, "\r\n\r\n"))
+                handleRequest(client);
+            else if (client.requestUsed == sizeof(client.request) - 1)
+            {
+                counters.badRequests++;
+                respond(client, "431 Request Header Fields Too Large", "Request too long");
+            }
+        }
+    }
+
+    for (int chunks = 0; client.state == SENDING || client.state == CLOSING;)
+    {
+        if (!flush(client))
+            break;
+        if (client.state == CLOSING)
+        {
+            finish(client);
+            return;
+        }
+        if (chunks++ == HTTP_CHUNKS_PER_POLL)
+            break;
+        fillChunk(client);
+    }
+
+    if (client.state != FREE && now - client.activeAtMs > HTTP_IDLE_TIMEOUT_MS)
+    {
+        counters.timeouts++;
+        finish(client);
+    }
+}
+
+// --- Requests ---
+
+void HttpServer::handleRequest(Client &client)
+{
+    // "GET /path?query HTTP/1.1"; the headers are not needed.
+    char *line = client.request;
+    *strstr(line, "\r\n") = '\0';
+    char *target = strchr(line, ' ');
+    char *version = target ? strchr(target + 1, ' ') : nullptr;
+    if (!version || strncmp(version + 1, "HTTP/1.", 7) != 0)
+    {
+        counters.badRequests++;
+        respond(client, "400 Bad Request", "Bad request");
+        return;
+    }
+    *target++ = '\0';
+    *version = '\0';
+    if (strcmp(line, "GET") != 0)
+    {
+        counters.badRequests++;
+        respond(client, "405 Method Not Allowed", "Only GET is supported");
+        return;
+    }
+
+    const char *query = "";
+    char *mark = strchr(target, '?');
+    if (mark)
+    {
+        *mark = '\0';
+        query = mark + 1;
+    }
+    client.route = nullptr;
+    for (size_t i = 0; i < routeCount; i++)
+    {
+        if (strcmp(routes[i].path, target) == 0)
+            client.route = &routes[i];
+    }
+    if (!client.route)
+    {
+        counters.notFound++;
+        respond(client, "404 Not Found", "Not found");
+        return;
+    }
+
+    client.stream = {};
+    const char *contentType = client.route->open(client.stream, query);
+    if (!contentType)
+    {
+        counters.badRequests++;
+        respond(client, "400 Bad Request", "Bad query");
+        return;
+    }
+    client.outStart = 0;
+    client.outEnd = snprintf(client.out, sizeof(client.out),
+                             "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n"
+                             "Cache-Control: no-store\r\nConnection: close\r\n\r\n",
+                             contentType);
+    client.requestAtMs = hal::clock().millis();
+    client.state = SENDING;
+}
+
+void HttpServer::respond(Client &client, const char *status, const char *body)
+{
+    client.outStart = 0;
+    client.outEnd = snprintf(client.out, sizeof(client.out),
+                             "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %u\r\n"
+                             "Connection: close\r\n\r\n%s\n",
+                             status, (unsigned)strlen(body) + 1, body);
+    client.state = CLOSING;
+}
+
+// --- Responses ---
+
+// Fills 'out' with the next chunk of the body, framed, and the closing
+// zero chunk once the route is done.
+void HttpServer::fillChunk(Client &client)
+{
+    static const size_t BODY = 8;
+    char *body = client.out + BODY;
+    size_t used = 0;
+    bool done = false;
+    while (!done)
+    {
+        int n = client.route->write(client.stream, body + used, HTTP_CHUNK_BYTES - used);
+        if (n < 0)
+        {
+            // Doesn't fit. In an empty chunk it never will: end the body.
+            done = used == 0;
+            break;
+        }
+        done = n == 0;
+        used += n;
+    }
+
+    client.outStart = BODY;
+    client.outEnd = BODY;
+    if (used > 0)
+    {
+        char size[8];
+        int len = snprintf(size, sizeof(size), "%x\r\n", (unsigned)used);
+        client.outStart -= len;
+        memcpy(client.out + client.outStart, size, len);
+        memcpy(body + used, "\r\n", 2);
+        client.outEnd += used + 2;
+        counters.chunks++;
+    }
+    if (done)
+    {
+        memcpy(client.out + client.outEnd, "0\r\n\r\n", 5);
+        client.outEnd += 5;
+        client.state = CLOSING;
+        counters.responses++;
+        counters.responseMs.record(hal::clock().millis() - client.requestAtMs);
+    }
+}
+
+// Sends what is left of 'out'. Returns true once it has all gone.
+bool HttpServer::flush(Client &client)
+{
+    while (client.outStart < client.outEnd)
+    {
+        int n = hal::tcpServer().write(client.connection, client.out + client.outStart,
+                                       client.outEnd - client.outStart);
+        if (n < 0)
+        {
+            counters.aborted++;
+            finish(client);
+            return false;
+        }
+        if (n == 0)
+            return false; // Send buffer full; try again next poll()
+        client.outStart += n;
+        client.activeAtMs = hal::clock().millis();
+        counters.bytes += n;
+    }
+    return true;
+}
+
+void HttpServer::finish(Client &client)
+{
+    hal::tcpServer().close(client.connection);
+    client.state = FREE;
+    client.connection = -1;
+}
+
+bool HttpServer::queryParam(const char *query, const char *name, char *value, size_t size)
+{
+    size_t nameLen = strlen(name);
+    for (const char *p = query; *p;)
+    {
+        const char *end = strchr(p, '&');
+        if (!end)
+            end = p + strlen(p);
+        if ((size_t)(end - p) > nameLen && strncmp(p, name, nameLen) == 0 && p[nameLen] == '=')
+        {
+            const char *v = p + nameLen + 1;
+            size_t len = end - v;
+            if (len >= size)
+                return false;
+            memcpy(value, v, len);
+            value[len] = '\0';
+            return true;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return false;
+}
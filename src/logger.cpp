@@ -0,0 +1,178 @@
+// --- Log Fan-Out ---
+#include "logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+Logger logger;
+
+int Logger::attach(LogSink &sink, LogLevel minLevel)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (sinkCount >= LOG_MAX_SINKS)
+        return -1;
+    Slot &slot = slots[sinkCount];
+    memset(&slot.stats, 0, sizeof(slot.stats));
+    slot.sink = &sink;
+    slot.minLevel = minLevel;
+    slot.head = 0;
+    slot.used = 0;
+    return sinkCount++;
+}
+
+void Logger::setLevel(int sinkId, LogLevel minLevel)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (sinkId >= 0 && sinkId < sinkCount)
+        slots[sinkId].minLevel = minLevel;
+}
+
+#define LOG_ALL_SINKS 0xFFFFFFFFu
+
+void Logger::debug(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LOG_ALL_SINKS, LOG_DEBUG, format, args);
+    va_end(args);
+}
+
+void Logger::info(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LOG_ALL_SINKS, LOG_INFO, format, args);
+    va_end(args);
+}
+
+void Logger::warn(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LOG_ALL_SINKS, LOG_WARN, format, args);
+    va_end(args);
+}
+
+void Logger::error(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LOG_ALL_SINKS, LOG_ERROR, format, args);
+    va_end(args);
+}
+
+void Logger::logTo(int sinkId, LogLevel level, const char *format, ...)
+{
+    if (sinkId < 0)
+        return;
+    va_list args;
+    va_start(args, format);
+    vlog(1u << sinkId, level, format, args);
+    va_end(args);
+}
+
+void Logger::vlogTo(int sinkId, LogLevel level, const char *format, va_list args)
+{
+    if (sinkId >= 0)
+        vlog(1u << sinkId, level, format, args);
+}
+
+void Logger::vlog(uint32_t sinkMask, LogLevel level, const char *format, va_list args)
+{
+    // Format once, on the stack, then copy into each interested ring.
+    char line[LOG_LINE_MAX + 2];
+    int len = vsnprintf(line, LOG_LINE_MAX + 1, format, args);
+    if (len < 0)
+        return;
+    if (len > LOG_LINE_MAX)
+        len = LOG_LINE_MAX; // Truncated
+    line[len++] = '\r';
+    line[len++] = '\n';
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (int i = 0; i < sinkCount; i++)
+    {
+        Slot &slot = slots[i];
+        if (!(sinkMask & (1u << i)))
+            continue;
+        if (level < slot.minLevel)
+        {
+            slot.stats.filtered++;
+            continue;
+        }
+        if (LOG_SINK_BUFFER - slot.used < (size_t)len)
+        {
+            slot.stats.overflows++;
+            continue;
+        }
+        size_t tail = (slot.head + slot.used) % LOG_SINK_BUFFER;
+        size_t first = LOG_SINK_BUFFER - tail;
+        if (first > (size_t)len)
+            first = len;
+        memcpy(slot.ring + tail, line, first);
+        memcpy(slot.ring, line + first, len - first);
+        slot.used += len;
+        slot.stats.lines++;
+        if (slot.used > slot.stats.maxPending)
+            slot.stats.maxPending = slot.used;
+        drain(slot); // Opportunistic: most lines go straight out
+    }
+}
+
+void Logger::drain(Slot &slot)
+{
+    while (slot.used > 0)
+    {
+        size_t room = slot.sink->availableForWrite();
+        if (room == 0)
+            return;
+        size_t chunk = LOG_SINK_BUFFER - slot.head; // Contiguous bytes
+        if (chunk > slot.used)
+            chunk = slot.used;
+        if (chunk > room)
+            chunk = room;
+        size_t written = slot.sink->write(slot.ring + slot.head, chunk);
+        if (written == 0)
+            return;
+        slot.head = (slot.head + written) % LOG_SINK_BUFFER;
+        slot.used -= written;
+        slot.stats.bytesOut += written;
+    }
+}
+
+void Logger::poll()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (int i = 0; i < sinkCount; i++)
+        drain(slots[i]);
+}
+
+void Logger::flush(uint32_t timeoutMs)
+{
+    hal::Clock &clock = hal::clock();
+    uint32_t start = clock.millis();
+    for (;;)
+    {
+        bool pending = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (int i = 0; i < sinkCount; i++)
+            {
+                drain(slots[i]);
+                pending |= slots[i].used > 0;
+            }
+        }
+        if (!pending || clock.millis() - start >= timeoutMs)
+            return;
+        clock.delay(1);
+    }
+}
+
+bool Logger::sinkStats(int sinkId, LogSinkStats &stats)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (sinkId < 0 || sinkId >= sinkCount)
+        return false;
+    stats = slots[sinkId].stats;
+    return true;
+}
@@ -0,0 +1,252 @@
+// --- Asynchronous Email Delivery ---
+#include "mail_queue.h"
+
+#include "profiler.h"
+
+#include <atomic>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+MailQueue mailQueue;
+
+static MailQueue::SendFunction sendFunction = nullptr;
+static MailQueue::IdleFunction idleFunction = nullptr;
+
+// Counters are written from both the producers and the mail task.
+static std::atomic<uint32_t> enqueuedCount(0);
+static std::atomic<uint32_t> droppedCount(0);
+static std::atomic<uint32_t> sentCount(0);
+static std::atomic<uint32_t> failedCount(0);
+static std::atomic<uint32_t> maxDepth(0);
+static std::atomic<uint32_t> lastSendMs(0);
+static std::atomic<uint32_t> maxSendMs(0);
+static std::atomic<uint32_t> totalSendMs(0);
+static std::atomic<uint32_t> maxQueueWaitMs(0);
+
+static void raiseTo(std::atomic<uint32_t> &value, uint32_t candidate)
+{
+    uint32_t current = value.load();
+    while (candidate > current && !value.compare_exchange_weak(current, candidate))
+    {
+    }
+}
+
+#ifdef ARDUINO
+
+// TLS and the ESP Mail Client need a generous stack.
+static const uint32_t MAIL_TASK_STACK = 12288;
+
+static QueueHandle_t queue = nullptr;
+
+static uint32_t nowMs()
+{
+    return millis();
+}
+
+static uint32_t queueDepth()
+{
+    return queue ? uxQueueMessagesWaiting(queue) : 0;
+}
+
+#else
+
+// Fixed ring of records guarded by a mutex; the same memory bound as the
+// FreeRTOS queue.
+static MailReport slots[MAIL_QUEUE_LENGTH];
+static size_t head = 0;
+static size_t count = 0;
+static bool stopping = false;
+static std::mutex lock;
+static std::condition_variable ready;
+static std::thread worker;
+
+static uint32_t nowMs()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t queueDepth()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+}
+
+#endif
+
+static void copyAttachment(MailReport &report, const char *path)
+{
+    report.attachment[0] = '\0';
+    if (path)
+    {
+        strncpy(report.attachment, path, sizeof(report.attachment) - 1);
+        report.attachment[sizeof(report.attachment) - 1] = '\0';
+    }
+}
+
+static void deliver(const MailReport &report)
+{
+    uint32_t start = nowMs();
+    raiseTo(maxQueueWaitMs, start - report.queuedAtMs);
+
+    bool ok = sendFunction(report.body, report.attachment[0] ? report.attachment : nullptr);
+
+    uint32_t elapsed = nowMs() - start;
+    lastSendMs = elapsed;
+    raiseTo(maxSendMs, elapsed);
+    totalSendMs += elapsed;
+    if (ok)
+        sentCount++;
+    else
+        failedCount++;
+}
+
+#ifdef ARDUINO
+
+static void mailTask(void *)
+{
+    profiler.addTask("mail");
+    MailReport report;
+    for (;;)
+    {
+        if (xQueueReceive(queue, &report, pdMS_TO_TICKS(MAIL_IDLE_POLL_MS)) == pdTRUE)
+            deliver(report);
+        else if (idleFunction)
+            idleFunction();
+    }
+}
+
+bool MailQueue::begin(SendFunction send, IdleFunction idle)
+{
+    sendFunction = send;
+    idleFunction = idle;
+    queue = xQueueCreate(MAIL_QUEUE_LENGTH, sizeof(MailReport));
+    if (!queue)
+        return false;
+    return xTaskCreate(mailTask, "mail", MAIL_TASK_STACK, nullptr, 1, nullptr) == pdPASS;
+}
+
+bool MailQueue::enqueue(const char *body, const char *attachmentPath)
+{
+    if (!queue)
+        return false;
+    MailReport report;
+    strncpy(report.body, body, sizeof(report.body) - 1);
+    report.body[sizeof(report.body) - 1] = '\0';
+    copyAttachment(report, attachmentPath);
+    report.queuedAtMs = nowMs();
+    // Zero timeout: never block the caller.
+    if (xQueueSend(queue, &report, 0) != pdTRUE)
+    {
+        droppedCount++;
+        return false;
+    }
+    enqueuedCount++;
+    raiseTo(maxDepth, queueDepth());
+    return true;
+}
+
+void MailQueue::end()
+{
+}
+
+#else
+
+static void mailTask()
+{
+    profiler.addTask("mail");
+    MailReport report;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait_for(guard, std::chrono::milliseconds(MAIL_IDLE_POLL_MS),
+                           [] { return count > 0 || stopping; });
+            if (count == 0 && stopping)
+                return; // Stopping and drained
+            if (count == 0)
+            {
+                guard.unlock();
+                if (idleFunction)
+                    idleFunction();
+                continue;
+            }
+            report = slots[head];
+            head = (head + 1) % MAIL_QUEUE_LENGTH;
+            count--;
+        }
+        deliver(report);
+    }
+}
+
+bool MailQueue::begin(SendFunction send, IdleFunction idle)
+{
+    sendFunction = send;
+    idleFunction = idle;
+    stopping = false;
+    worker = std::thread(mailTask);
+    return true;
+}
+
+bool MailQueue::enqueue(const char *body, const char *attachmentPath)
+{
+    uint32_t depth;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!worker.joinable() || count == MAIL_QUEUE_LENGTH)
+        {
+            droppedCount++;
+            return false;
+        }
+        MailReport &report = slots[(head + count) % MAIL_QUEUE_LENGTH];
+        strncpy(report.body, body, sizeof(report.body) - 1);
+        report.body[sizeof(report.body) - 1] = '\0';
+        copyAttachment(report, attachmentPath);
+        report.queuedAtMs = nowMs();
+        depth = ++count;
+    }
+    ready.notify_one();
+    enqueuedCount++;
+    raiseTo(maxDepth, depth);
+    return true;
+}
+
+void MailQueue::end()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+#endif
+
+MailQueueStats MailQueue::stats()
+{
+    MailQueueStats s;
+    s.enqueued = enqueuedCount;
+    s.dropped = droppedCount;
+    s.sent = sentCount;
+    s.failed = failedCount;
+    s.depth = queueDepth();
+    s.maxDepth = maxDepth;
+    s.lastSendMs = lastSendMs;
+    s.maxSendMs = maxSendMs;
+    s.totalSendMs = totalSendMs;
+    s.maxQueueWaitMs = maxQueueWaitMs;
+    return s;
+}
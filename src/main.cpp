@@ -1,628 +1,1923 @@
 // --- Library Includes ---
-// Wire.h is for I2C communication, required by the SHT31-D sensor.
-#include <Wire.h>
-#include <Adafruit_Sensor.h>
-#include <Adafruit_SHT31.h>
-#include <WiFi.h>
+// All board access (SHT31-D, UARTs, clock, WiFi, SMTP, LittleFS) goes
+// through the HAL so this file also builds for the native environment.
+#include "acquisition.h"
+#include "alerts.h"
+#include "boot.h"
+#include "config.h"
+#include "console.h"
+#include "digest.h"
+#include "duty_cycle.h"
+#include "feature_flags.h"
+#include "hal.h"
+#include "heap_monitor.h"
+#include "history.h"
+#include "history_log.h"
+#include "http_routes.h"
+#include "http_server.h"
+#include "logger.h"
+#include "mail_queue.h"
+#include "modbus_registers.h"
+#include "modbus_slave.h"
+#include "mqtt_publisher.h"
+#include "outbox.h"
+#include "profiler.h"
+#include "reading_format.h"
+#include "scheduler.h"
+#include "smtp_manager.h"
+#include "telemetry.h"
+#include "time_service.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-// For WiFiManager
-#include <WiFiManager.h>
-#include <ArduinoJson.h>
-#include <FS.h>
-#include <LittleFS.h>
-// For SMTP Email Sending
-#include <ESP_Mail_Client.h>
-
 // --- Pin for Reset Trigger ---
 // To reset, connect this pin to GND and then power on/reset the ESP32.
 #define RESET_PIN 23
 
-// --- Variable Declarations ---
-const char *MAIL_CONTENT = "Temperature and Humidity Readings from SHT31-D Sensor";
-// --- Configuration Variables ---
-// We use char arrays to store settings that can be changed.
-char timeZoneInfo[50] = "PST8PDT,M3.2.0,M11.1.0";
-char mail_server[50] = "smtp.gmail.com";
-char mail_port[6] = "587";
-char mail_from[50] = "your_email@gmail.com";
-char mail_pass[50] = "your_app_password";
-char mail_to[50] = "your_email@gmail.com";
-char mail_subject[50] = "SHT31-D Sensor Readings";
-char mail_name[50] = "Name of Sender";
-
 // --- Global Application Variables ---
-bool timeSet = false;
 int lastEmailHour = -1;
-bool smtpReady = false;
-char emailContentBuffer[256];
+char emailContentBuffer[MAIL_BODY_SIZE];
 
 // --- Global Objects ---
-SMTPSession smtp;
-SMTP_Message message;
-Session_Config config;
-Adafruit_SHT31 sht31 = Adafruit_SHT31();
-// Define pins for Serial2 (UART2) for the RS-232 TTL to RS232 Module
-// IMPORTANT: Ensure these pins are not otherwise used and are safe to use for UART.
-// GPIO 17 (TX2) and GPIO 16 (RX2) are common choices for UART2.
-const int Serial2_TX_Pin = 17;
-const int Serial2_RX_Pin = 16;
+// usb is the IDE monitor (Serial), rs232 is the RS-232 module on Serial2 (GPIO 17 TX / 16 RX).
+hal::SerialPort &usb = hal::usbSerial();
+hal::SerialPort &rs232 = hal::rs232Serial();
+hal::Clock &sysClock = hal::clock();
+hal::Network &net = hal::network();
+hal::MailTransport &smtp = hal::mail();
+// Log sinks: every status line is formatted once and fanned out to both ports.
+SerialLogSink usbSink(usb);
+SerialLogSink rs232Sink(rs232);
+int usbLog = -1;
+int rs232Log = -1;
+Console usbConsole;
+Console rs232Console;
 const long BAUD_RATE = 9600; // Match this to your PuTTY setting
 
-// Flag to indicate that settings were changed and we should restart
-bool shouldSaveConfig = false;
-// Callback function that gets called when WiFiManager saves its configuration
-void saveConfigCallback() {
-  Serial.println("Should save config");
-  shouldSaveConfig = true;
+#if FEATURE_EMAIL
+// Builds the SMTP server settings from the current configuration.
+hal::MailServerConfig mailServerConfig()
+{
+    hal::MailServerConfig server;
+    server.host = mail_server;
+    server.port = atoi(mail_port);
+    server.email = mail_from;
+    server.password = mail_pass;
+    return server;
 }
+#endif
+
 void saveConfiguration() {
-  Serial.println("Saving configuration...");
-  DynamicJsonDocument json(1024);
-  json["timeZoneInfo"] = timeZoneInfo;
-  json["mail_server"] = mail_server;
-  json["mail_port"] = mail_port;
-  json["mail_from"] = mail_from;
-  json["mail_pass"] = mail_pass;
-  json["mail_to"] = mail_to;
-  json["mail_subject"] = mail_subject;
-  json["mail_name"] = mail_name;
-
-  File configFile = LittleFS.open("/config.json", "w");
-  if (!configFile) {
-    Serial.println("Failed to open config file for writing");
+  logger.debug("Saving configuration...");
+  if (!configStore.save()) {
+    logger.debug("Failed to write the config store");
     return;
   }
-
-  serializeJson(json, configFile);
-  configFile.close();
-  Serial.println("Configuration saved.");
+  logger.debug("Configuration saved.");
 }
 
-// Loads the custom configuration from a file on LittleFS
+// Loads the settings from the config store on LittleFS (see config.h)
 void loadConfiguration() {
-  if (LittleFS.begin(true, "/littlefs", 5, "spiffs")) {
-    Serial.println("Mounted LittleFS on 'spiffs' partition.");
-    if (LittleFS.exists("/config.json")) {
-      Serial.println("Reading config file...");
-      File configFile = LittleFS.open("/config.json", "r");
-      if (configFile) {
-        DynamicJsonDocument json(1024);
-        DeserializationError error = deserializeJson(json, configFile);
-        if (error) {
-          Serial.println("Failed to parse config file, using default configuration");
-        } else {
-          Serial.println("Successfully parsed config file");
-          // Load values from JSON, using default if a key is missing
-          strcpy(timeZoneInfo, json["timeZoneInfo"] | "PST8PDT,M3.2.0,M11.1.0");
-          strcpy(mail_server, json["mail_server"] | "smtp.gmail.com");
-          strcpy(mail_port, json["mail_port"] | "587");
-          strcpy(mail_from, json["mail_from"] | "your_email@gmail.com");
-          strcpy(mail_pass, json["mail_pass"] | "your_app_password");
-          strcpy(mail_to, json["mail_to"] | "your_email@gmail.com");
-          strcpy(mail_subject, json["mail_subject"] | "SHT31-D Sensor Readings");
-          strcpy(mail_name, json["mail_name"] | "Name of Sender");
-        }
-        configFile.close();
-      }
-    } else {
-        Serial.println("Config file not found, using default configuration and creating file.");
-        saveConfiguration(); // Create the file with default values
-    }
+  if (hal::storage().begin()) {
+    logger.debug("Mounted LittleFS on 'spiffs' partition.");
+    configStore.load();
+    const ConfigStats &config = configStore.stats();
+    logger.debug("Configuration from %s (%u bytes, %lu us, %u bad slots, %u truncated)",
+                 ConfigStore::sourceName(config.source), (unsigned)config.bytes,
+                 (unsigned long)config.loadUs, (unsigned)config.badSlots, (unsigned)config.truncated);
   } else {
-    Serial.println("Failed to mount file system");
+    logger.debug("Failed to mount file system");
   }
 }
 
-bool syncTime()
+// Appends "chN <label>: T min/mean/max ... F, RH min-max %" for the last
+// spanSec of the channel's history to 'buffer'. Appends nothing if there
+// are no samples yet.
+void appendHistorySummary(char *buffer, size_t size, uint8_t channel, const char *label, uint32_t spanSec)
 {
-    Serial.println("Starting time synchronization...");
-    Serial2.println("Starting time synchronization...");
-
-    // 1. Configure the ESP32 to use the correct time zone and NTP servers.
-    //    The timeZoneInfo string is critical for getting local time, not just UTC.
-    configTzTime(timeZoneInfo, "pool.ntp.org", "time.nist.gov", "time.google.com");
+    WindowStats stats;
+    if (!history[channel].window(uptimeSeconds(), spanSec, stats))
+        return;
+    char low[READING_TEXT_MAX], mean[READING_TEXT_MAX], high[READING_TEXT_MAX];
+    char lowRH[READING_TEXT_MAX], highRH[READING_TEXT_MAX];
+    formatTemperature(low, stats.minCentiC);
+    formatTemperature(mean, (int32_t)(stats.sumCentiC / stats.count));
+    formatTemperature(high, stats.maxCentiC);
+    formatCentiTenths(lowRH, stats.minCentiRH);
+    formatCentiTenths(highRH, stats.maxCentiRH);
+    size_t len = strlen(buffer);
+    snprintf(buffer + len, size - len, "\nch%u %s: %s / %s / %s " READING_TEMPERATURE_SUFFIX " (min/mean/max), RH %s-%s %%",
+             (unsigned)channel, label, low, mean, high, lowRH, highRH);
+}
 
-    // 2. Wait for the time to be synced.
-    struct tm timeinfo;
+// Appends "chN Temperature: ... F | Humidity: ... %" for the reading, on a
+// line of its own unless 'buffer' is empty.
+void appendReading(char *buffer, size_t size, const Sample &sample)
+{
+    char temperature[READING_TEXT_MAX], humidity[READING_TEXT_MAX];
+    formatTemperature(temperature, sample.centiC);
+    formatCenti(humidity, sample.centiRH);
+    size_t len = strlen(buffer);
+    snprintf(buffer + len, size - len, "%sch%u Temperature: %s " READING_TEMPERATURE_SUFFIX " | Humidity: %s %%",
+             len ? "\n" : "", (unsigned)sample.channel, temperature, humidity);
+}
 
-    // getLocalTime() needs to be called to trigger the sync.
-    // We check the return value and the year to confirm sync.
-    // tm_year is years since 1900.
-    if (!getLocalTime(&timeinfo, 10000))
-    { // Give it up to 10 seconds to get an initial response
-        Serial.println("Failed to get initial time response.");
-        Serial2.println("Failed to get initial time response.");
+// Puts the sensors in the configured mode (see acquisition.h): periodic
+// rate, repeatability, filters and heater threshold. Returns false, leaving
+// the mode as it was, for a rate or repeatability the SHT31 doesn't have.
+bool applyAcquisitionSettings(char *error, size_t errorSize)
+{
+    static const char *const REPEATABILITY[] = {"high", "medium", "low"};
+    AcquisitionSettings settings = {};
+    settings.mps = (uint8_t)atoi(sensor_mps);
+    if (settings.mps != 0 && settings.mps != 1 && settings.mps != 2 && settings.mps != 4 && settings.mps != 10)
+    {
+        snprintf(error, errorSize, "sensor_mps must be 0, 1, 2, 4 or 10");
         return false;
     }
-
-    // Loop until the year is valid, indicating a successful sync.
-    int retry_count = 0;
-    const int max_retries = 10;
-    while (timeinfo.tm_year < (2023 - 1900) && retry_count < max_retries)
+    int repeatability = 0;
+    while (repeatability < 3 && strcmp(sensor_repeat, REPEATABILITY[repeatability]) != 0)
+        repeatability++;
+    if (repeatability == 3)
     {
-        Serial.printf("Waiting for NTP sync... (Attempt %d/%d)\n", retry_count + 1, max_retries);
-        Serial2.printf("Waiting for NTP sync... (Attempt %d/%d)\n", retry_count + 1, max_retries);
-        delay(2000); // Wait 2 seconds between checks
-        if (!getLocalTime(&timeinfo))
-        {
-            Serial.println("Failed to get time on retry.");
-            Serial2.println("Failed to get time on retry.");
-        }
-        retry_count++;
+        snprintf(error, errorSize, "sensor_repeat must be high, medium or low");
+        return false;
     }
+    settings.repeatability = (SensorRepeatability)repeatability;
+    settings.filter.median = (uint8_t)atoi(filter_median);
+    settings.filter.emaPercent = (uint8_t)atoi(filter_ema_pct);
+    settings.heaterRH = (uint8_t)atoi(heater_rh);
+    acquisition.configure(settings);
+    return true;
+}
 
-    // 3. Check the final result.
-    if (timeinfo.tm_year < (2023 - 1900))
+// Logs which sensor positions answered, e.g. "SHT31-D sensors: ch0 ch2".
+void logSensors(const char *prefix)
+{
+    char list[SENSOR_CHANNELS * 4 + 1] = "";
+    size_t len = 0;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        if (acquisition.present(channel))
+            len += snprintf(list + len, sizeof(list) - len, " ch%u", (unsigned)channel);
+    logger.info("%s%s", prefix, list);
+}
+
+// --- Email (FEATURE_EMAIL) ---
+#if FEATURE_EMAIL
+
+// Runs on the mail task (see mail_queue.h), never on loop(). The SMTP
+// manager connects, logs in and closes the session as its policy says;
+// 'more' keeps it open for a message that follows at once.
+bool sendMessage(const char *emailBody, const char *attachmentPath, bool more = false)
+{
+    // Build the headers.
+    hal::MailMessage message;
+    message.senderName = mail_name;
+    message.senderEmail = mail_from;
+    message.recipient = mail_to;
+    message.subject = mail_subject;
+    message.body = emailBody;
+    if (attachmentPath)
     {
-        Serial.println("ERROR: Could not synchronize time with NTP server after multiple attempts.");
-        Serial2.println("ERROR: Could not synchronize time with NTP server after multiple attempts.");
-        return false;
+        message.attachmentPath = attachmentPath;
+        message.attachmentName = "readings.csv";
+        message.attachmentMime = "text/csv";
     }
 
-    // SUCCESS!
-    Serial.println("\nSUCCESS: NTP has synced.");
-    Serial2.println("\nSUCCESS: NTP has synced.");
-    char timeBuffer[50];
-    strftime(timeBuffer, sizeof(timeBuffer), "%A, %B %d %Y %H:%M:%S %Z", &timeinfo);
-    Serial.printf("Current California Time: %s\n", timeBuffer);
-    Serial2.printf("Current California Time: %s\n", timeBuffer);
-
+    // Send the email.
+    logger.debug("Sending email...");
+    if (!smtpManager.send(message, more))
+        return false;
+    logger.info("Email sent successfully!");
     return true;
 }
 
-void resyncTime()
+// The mail queue's send function. A report that fails is kept in the
+// outbox for the next flush (a digest is not: it is rebuilt from the log).
+bool sendSensorEmail(const char *emailBody, const char *attachmentPath)
 {
-    Serial.println("[System Check] Performing lightweight time resync...");
-    Serial2.println("[System Check] Performing lightweight time resync...");
+    uint32_t start = Profiler::wallMs();
+    bool ok = sendMessage(emailBody, attachmentPath);
+    if (attachmentPath)
+        digest.release(); // Sent or not, the digest file is done with
+    else if (!ok && outbox.push(timeService.valid() ? (uint32_t)timeService.now() : 0, emailBody))
+        logger.info("Email kept in the outbox (%u waiting).", (unsigned)outbox.pending());
+    profiler.record(PROF_SEND_EMAIL, Profiler::wallMs() - start);
+    return ok;
+}
 
-    // The configuration is already set from the initial syncTime() call.
-    // We just need to trigger an update.
-    struct tm timeinfo;
+// The mail queue's idle function: applies the SMTP policy, then sends what
+// waits in the outbox, oldest first, over one session. A failure leaves
+// the rest queued; the SMTP backoff decides when the next pass tries.
+void mailIdle()
+{
+    smtpManager.poll();
+    if (outbox.pending() == 0 || !smtpManager.available())
+        return;
+    static OutboxReport report; // Only the mail task flushes
+    uint32_t sent = 0;
+    while (outbox.peek(report))
+    {
+        if (!sendMessage(report.body, nullptr, outbox.pending() > 1))
+            break;
+        outbox.pop(report.seq);
+        sent++;
+    }
+    if (sent)
+        logger.info("Outbox: %u queued reports sent, %u left.", (unsigned)sent, (unsigned)outbox.pending());
+}
 
-    // getLocalTime() will trigger a new NTP request.
-    // We give it a short timeout (e.g., 2 seconds) to avoid blocking the loop for long.
-    if (!getLocalTime(&timeinfo, 2000))
+// Hands the report in emailContentBuffer to the mail task, or stores it in
+// the outbox while SMTP is unavailable, the mail queue is full or earlier
+// reports are still waiting there (so that they all go out in order).
+// Returns false only if the report could be neither queued nor stored.
+bool queueReport(const char *what)
+{
+    if (smtpManager.available() && outbox.pending() == 0 && mailQueue.enqueue(emailContentBuffer))
     {
-        Serial.println("[System Check] Lightweight resync failed to get a response.");
-        Serial2.println("[System Check] Lightweight resync failed to get a response.");
+        logger.debug("%s queued for sending.", what);
+        return true;
     }
-    else
+    if (outbox.push(timeService.valid() ? (uint32_t)timeService.now() : 0, emailContentBuffer))
     {
-        // We can optionally check if the year is still valid, just in case.
-        if (timeinfo.tm_year < (2023 - 1900))
-        {
-            Serial.println("[System Check] Resync resulted in an invalid time. Marking time as not set.");
-            Serial2.println("[System Check] Resync resulted in an invalid time. Marking time as not set.");
-            timeSet = false; // The time is now invalid, trigger a full recovery on the next check.
-        }
-        else
-        {
-            Serial.println("[System Check] Time successfully resynchronized.");
-            Serial2.println("[System Check] Time successfully resynchronized.");
-
-            // No need to set timeSet = true, as it was already true.
-        }
+        logger.info("%s kept in the outbox (%u waiting).", what, (unsigned)outbox.pending());
+        return true;
     }
+    logger.error("ERROR: Outbox write failed. %s dropped.", what);
+    return false;
 }
 
-void sendSensorEmail(const char *emailBody)
+// Starts building a digest of the last spanSec of logged readings; loop()
+// sends it once the CSV attachment is complete.
+bool startDigest(uint32_t spanSec)
 {
-    if (!smtp.isLoggedIn())
+    uint32_t now = (uint32_t)timeService.now();
+    if (!digest.begin(now - spanSec, now))
     {
-        Serial.println("SMTP session is not active. Attempting to reconnect...");
-        Serial2.println("SMTP session is not active. Attempting to reconnect...");
-        smtp.closeSession();
-
-        // Reconnect using the already-known GLOBAL config.
-        if (smtp.connect(&config))
-        {
-            Serial.println("SUCCESS: SMTP reconnected.");
-            Serial2.println("SUCCESS: SMTP reconnected.");
-        }
-        else
-        {
-            Serial.println("ERROR: SMTP reconnect failed. Aborting send. Last Error: ");
-            Serial.println(smtp.errorReason());
-            Serial2.println("ERROR: SMTP reconnect failed. Aborting send. Last Error: ");
-            Serial2.println(smtp.errorReason());
-            return;
-        }
+        logger.error("ERROR: Previous digest is still being sent. Digest skipped.");
+        return false;
     }
+    logger.info("Building digest email for the last %lu h.", (unsigned long)(spanSec / 3600));
+    return true;
+}
 
-    message.clear();
-
-    // 2. build the headers.
-    message.sender.name = mail_name;
-    message.sender.email = mail_from;
-    message.subject = mail_subject;
-    message.addRecipient("", mail_to);
-    message.text.content = emailBody;
-
-    // 3. Send the email.
-    Serial.println("Sending email...");
-    if (!MailClient.sendMail(&smtp, &message, true))
+void sendDigest()
+{
+    if (!smtpManager.available())
     {
-        Serial.println("ERROR: Failed to send email. Last Error: ");
-        Serial2.println("ERROR: Failed to send email. Last Error: ");
-        Serial.println(smtp.errorReason());
-        Serial2.println(smtp.errorReason());
+        logger.info("Skipping digest: SMTP server is not available.");
+        digest.release();
+        return;
+    }
+    digest.formatBody(emailContentBuffer, sizeof(emailContentBuffer));
+    if (mailQueue.enqueue(emailContentBuffer, DIGEST_CSV_PATH))
+    {
+        logger.debug("Digest queued for sending (%u readings).", (unsigned)digest.summary().count);
     }
     else
     {
-        Serial.println("Email sent successfully!");
-        Serial2.println("Email sent successfully!");
+        logger.error("ERROR: Mail queue is full. Digest dropped.");
+        digest.release();
     }
 }
 
-void readAndReportSensor(const struct tm &timeinfo)
+// Scheduled reports always go out; manual reads send at most one email per
+// hour.
+void readAndReportSensor(const struct tm &timeinfo, bool scheduled = false)
 {
-    if (!smtpReady)
+    ProfileScope profile(PROF_READ_REPORT);
+    // Usually cache hits: the caller has just read the sensors.
+    emailContentBuffer[0] = '\0';
+    int readings = 0;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
     {
-        Serial.println("Skipping email: SMTP server is not connected.");
-        Serial2.println("Skipping email: SMTP server is not connected.");
-        return; // Exit the function immediately
+        Sample sample;
+        if (!acquisition.present(channel) || !acquisition.read(channel, sample))
+            continue;
+        appendReading(emailContentBuffer, sizeof(emailContentBuffer), sample);
+        readings++;
     }
-    float temperatureC = sht31.readTemperature();
-    float humidity = sht31.readHumidity();
-
-    if (isnan(temperatureC) || isnan(humidity))
+    if (readings == 0)
     {
-        Serial.println("ERROR: Failed to read from SHT31 sensor!");
-        Serial2.println("ERROR: Failed to read from SHT31 sensor!");
+        logger.error("ERROR: Failed to read from SHT31 sensor!");
         return;
     }
 
-    float temperatureF = (temperatureC * 9 / 5) + 32;
     // Only send email if time is set and we haven't sent one this hour
-    if (timeSet && timeinfo.tm_hour != lastEmailHour)
+    if (timeService.valid() && (scheduled || timeinfo.tm_hour != lastEmailHour))
     {
         // Create the dynamic content string
         char timeBuffer[30];
         strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
-        snprintf(emailContentBuffer, sizeof(emailContentBuffer),
-                 "Temperature: %.2f F | Humidity: %.2f %%\nTime of reading: %s",
-                 temperatureF, sht31.readHumidity(), timeBuffer);
-
-        // Call our new robust sending function with the content
-        sendSensorEmail(emailContentBuffer);
-
-        // If the email was sent successfully (which sendSensorEmail now handles internally), update the hour.
-        // We might need to make smtpReady global to check this here, or just assume it worked for the timer.
-        if (smtpReady)
+        size_t len = strlen(emailContentBuffer);
+        snprintf(emailContentBuffer + len, sizeof(emailContentBuffer) - len, "\nTime of reading: %s", timeBuffer);
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
         {
-            lastEmailHour = timeinfo.tm_hour;
+            if (!acquisition.present(channel))
+                continue;
+            appendHistorySummary(emailContentBuffer, sizeof(emailContentBuffer), channel, "Last hour", 3600);
+            appendHistorySummary(emailContentBuffer, sizeof(emailContentBuffer), channel, "Last 24 h", 86400);
         }
+
+        // Hand the report to the mail task (or the outbox); this returns
+        // immediately.
+        if (queueReport("Email"))
+            lastEmailHour = timeinfo.tm_hour;
     }
 }
+#endif // FEATURE_EMAIL
+
 void performSensorReadingAndPrint()
 {
-    float temperatureC = sht31.readTemperature();
-    float humidity = sht31.readHumidity();
-
-    if (isnan(temperatureC) || isnan(humidity))
+    ProfileScope profile(PROF_READ_PRINT);
+    int readings = 0;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
     {
-        Serial.println("ERROR: Failed to read from SHT31 sensor!");
-        Serial2.println("ERROR: Failed to read from SHT31 sensor!");
+        Sample sample;
+        if (!acquisition.present(channel) || !acquisition.read(channel, sample))
+            continue;
+        readings++;
+        char temperature[READING_TEXT_MAX], humidity[READING_TEXT_MAX];
+        formatTemperature(temperature, sample.centiC);
+        formatCenti(humidity, sample.centiRH);
+        logger.info("MANUAL READ -> ch%u Temp: %s " READING_TEMPERATURE_SUFFIX ", Humidity: %s %%",
+                    (unsigned)channel, temperature, humidity);
+        char summary[100] = "";
+        appendHistorySummary(summary, sizeof(summary), channel, "Last hour", 3600);
+        if (summary[0])
+            logger.info("%s", summary + 1); // Skip the leading newline
+    }
+    if (readings == 0)
+    {
+        logger.error("ERROR: Failed to read from SHT31 sensor!");
         return;
     }
-
-    float temperatureF = (temperatureC * 9 / 5) + 32;
-
-    Serial.printf("MANUAL READ -> Temp: %.2f F, Humidity: %.2f %%\n", temperatureF, humidity);
-    Serial2.printf("MANUAL READ -> Temp: %.2f F, Humidity: %.2f %%\n", temperatureF, humidity);
+#if FEATURE_EMAIL
     // Now check if we should also send an email
     // This part WILL NOT WORK if WiFi is down, which is expected.
-    if (timeSet)
+    if (timeService.valid())
     {
         struct tm timeinfo;
-        getLocalTime(&timeinfo);
+        timeService.localTime(timeinfo);
         // We can call your original function here to handle the email logic
         readAndReportSensor(timeinfo);
     }
     else
     {
-        Serial.println("Cannot send email: WiFi is not connected or time is not set.");
-        Serial2.println("Cannot send email: WiFi is not connected or time is not set.");
+        logger.info("Cannot send email: WiFi is not connected or time is not set.");
     }
+#endif
 }
 
-void setup()
+#if FEATURE_STREAMING
+// Starts binary streaming on RS-232. Text logging to that port is muted
+// while streaming so it cannot corrupt the frames.
+bool startStreaming()
 {
-   Serial.begin(BAUD_RATE); 
-   Serial.println("\n\nBooting...");
+    if (telemetry.active())
+        return true;
+#if FEATURE_MODBUS
+    if (modbus.active())
+    {
+        logger.error("ERROR: RS-232 is the Modbus link (modbus_addr %s). Set modbus_addr to 0 to stream.", modbus_addr);
+        return false;
+    }
+#endif
+    long baud = atol(stream_baud);
+    int rate = atoi(stream_rate);
+    logger.info("Starting telemetry streaming: %d Hz at %ld baud.", rate, baud);
+    logger.flush(); // Let the announcement out before the baud rate changes
+    logger.setLevel(rs232Log, LOG_OFF);
+    if (!telemetry.start(rate, baud))
+    {
+        logger.setLevel(rs232Log, LOG_INFO);
+        logger.error("ERROR: Invalid stream settings (rate %d Hz, baud %ld).", rate, baud);
+        return false;
+    }
+    return true;
+}
 
-    // --- Check for Factory Reset Trigger ---
-    pinMode(RESET_PIN, INPUT_PULLUP);
-    // Hold the reset pin to GND during boot to trigger this.
-    if (digitalRead(RESET_PIN) == LOW) {
-        Serial.println("Reset pin activated! Clearing all settings...");
-        LittleFS.begin(true, "/littlefs", 5, "spiffs");
-        LittleFS.format(); // Erase the entire filesystem
-        WiFiManager wm;
-        wm.resetSettings(); // Erase saved WiFi credentials
-        Serial.println("Settings cleared. Please restart the device.");
-        while(1) delay(1000); // Halt execution
+void stopStreaming()
+{
+    if (!telemetry.active())
+        return;
+    telemetry.stop();
+    logger.setLevel(rs232Log, LOG_INFO);
+    logger.info("Telemetry streaming stopped (%u frames, %u overruns).",
+                (unsigned)telemetry.stats().frames, (unsigned)telemetry.stats().overruns);
+}
+#endif
+
+// Binary telemetry is going out on RS-232.
+bool streaming()
+{
+#if FEATURE_STREAMING
+    return telemetry.active();
+#else
+    return false;
+#endif
+}
+
+// RS-232 answers Modbus RTU rather than commands (see "Modbus Registers").
+bool modbusLink()
+{
+#if FEATURE_MODBUS
+    return modbus.active();
+#else
+    return false;
+#endif
+}
+
+// --- Scheduled Jobs ---
+// loop()'s periodic work, run by the scheduler (see scheduler.h).
+#define SENSOR_CHECK_INTERVAL_MS 60000UL  // 1 minute
+#define SYSTEM_CHECK_INTERVAL_MS 900000UL // 15 minutes
+#define LOG_FLUSH_INTERVAL_MS 3600000UL   // Caps what a power cut can take from the flash log
+
+int sensorJob = -1;
+int reportJob = -1;
+int digestJob = -1;
+int systemJob = -1;
+int clockJob = -1;
+int flushJob = -1;
+int heapJob = -1;
+int modbusJob = -1;
+
+// Registers a job at boot. A full table is a build mistake (raise
+// SCHEDULER_MAX_JOBS), not something to run on without.
+int addJob(const char *name, Scheduler::JobFunction run)
+{
+    int job = scheduler.add(name, run);
+    if (job < 0)
+    {
+        logger.error("ERROR: No room for the '%s' job (SCHEDULER_MAX_JOBS %d). Halting.", name, SCHEDULER_MAX_JOBS);
+        logger.flush();
+        hal::system().halt();
     }
+    return job;
+}
 
-    // --- Load Custom Configuration ---
-    loadConfiguration();
+// Logs an alert rule being raised or cleared and emails it, with the
+// sample that caused it.
+void onAlert(const AlertEvent &event, void *context)
+{
+    const Sample &sample = *(const Sample *)context;
+    char rule[48];
+    AlertEngine::formatRule(alerts.rule(event.rule), rule, sizeof(rule));
+    const char *unit = AlertEngine::unit(alerts.rule(event.rule));
+    unsigned long minutes = (event.atSec - event.sinceSec) / 60;
+    char value[READING_TEXT_MAX];
+    formatCenti(value, lroundf(event.value * 100));
+    if (event.raised)
+        logger.info("ALERT: ch%u %s (now %s %s, for %lu min).", (unsigned)event.channel, rule, value, unit, minutes);
+    else
+        logger.info("Alert cleared: ch%u %s (now %s %s, after %lu min).", (unsigned)event.channel, rule, value, unit,
+                    minutes);
 
-    // --- Configure and Start WiFiManager ---
-    WiFiManager wm;
-    
-    // Set a callback that will be called when settings are saved.
-    wm.setSaveConfigCallback(saveConfigCallback);
-
-    // Add custom parameters to the WiFiManager portal
-    WiFiManagerParameter custom_tz("tz", "Time Zone String", timeZoneInfo, 48);
-    WiFiManagerParameter custom_mail_server("server", "SMTP Server", mail_server, 48);
-    WiFiManagerParameter custom_mail_port("port", "SMTP Port", mail_port, 5);
-    WiFiManagerParameter custom_mail_from("from", "Mail From Address", mail_from, 48);
-    WiFiManagerParameter custom_mail_pass("pass", "Mail App Password", mail_pass, 48);
-    WiFiManagerParameter custom_mail_to("to", "Mail To Address", mail_to, 48);
-    WiFiManagerParameter custom_mail_subject("subject", "Mail Subject", mail_subject, 48);
-    WiFiManagerParameter custom_mail_name("name", "Mail Sender Name", mail_name, 48);
-
-    wm.addParameter(&custom_tz);
-    wm.addParameter(&custom_mail_server);
-    wm.addParameter(&custom_mail_port);
-    wm.addParameter(&custom_mail_from);
-    wm.addParameter(&custom_mail_pass);
-    wm.addParameter(&custom_mail_to);
-    wm.addParameter(&custom_mail_subject);
-    wm.addParameter(&custom_mail_name);
-
-    // autoConnect() will start an access point "AutoConnectAP" if it can't connect to saved WiFi.
-    // It is a blocking function.
-    if (!wm.autoConnect("TempSensorAP")) {
-        Serial.println("Failed to connect and hit timeout");
-        ESP.restart(); // Restart if it fails to connect
-    }
-
-        Serial.println("\nWiFi connected!");
-        Serial2.println("\nWiFi connected!");
-        Serial.print("IP address: ");
-        Serial2.print("IP address: ");
-        Serial.println(WiFi.localIP());
-        Serial2.println(WiFi.localIP());
-
-    // --- Handle saving custom parameters if they were changed ---
-    if (shouldSaveConfig) {
-        // Read the new values from the WiFiManager parameters
-        strcpy(timeZoneInfo, custom_tz.getValue());
-        strcpy(mail_server, custom_mail_server.getValue());
-        strcpy(mail_port, custom_mail_port.getValue());
-        strcpy(mail_from, custom_mail_from.getValue());
-        strcpy(mail_pass, custom_mail_pass.getValue());
-        strcpy(mail_to, custom_mail_to.getValue());
-        strcpy(mail_subject, custom_mail_subject.getValue());
-        strcpy(mail_name, custom_mail_name.getValue());
-        
-        // Save these new values to our config file and restart
-        saveConfiguration();
-        Serial.println("New settings saved. Restarting device to apply changes.");
-        delay(2000);
-        ESP.restart();
+#if FEATURE_EMAIL
+    if (!timeService.valid())
+    {
+        logger.info("Skipping alert email: the clock is not set.");
+        return;
     }
+    struct tm timeinfo;
+    timeService.localTime(timeinfo);
+    char timeBuffer[30];
+    strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    int len = snprintf(emailContentBuffer, sizeof(emailContentBuffer), "%s: ch%u %s (now %s %s, %s %lu min)\n",
+                       event.raised ? "ALERT" : "CLEARED", (unsigned)event.channel, rule, value, unit,
+                       event.raised ? "for" : "after", minutes);
+    appendReading(emailContentBuffer + len, sizeof(emailContentBuffer) - len, sample);
+    len += strlen(emailContentBuffer + len);
+    snprintf(emailContentBuffer + len, sizeof(emailContentBuffer) - len, "\nTime of reading: %s", timeBuffer);
+    appendHistorySummary(emailContentBuffer, sizeof(emailContentBuffer), sample.channel, "Last hour", 3600);
+    queueReport("Alert email");
+#else
+    (void)sample;
+#endif
+}
 
-    // Set the network reconnection option
-    MailClient.networkReconnect(true);
+// Every check records a sample of each sensor, with or without WiFi/Time,
+// and runs it through the alert rules. The first read measures every
+// sensor in one pass; the others are cache hits.
+void checkSensor()
+{
+    if (acquisition.count() == 0)
+    {
+        if (acquisition.discover() == 0)
+            return;
+        logSensors("SHT31-D sensors found:");
+    }
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        Sample sample;
+        if (!acquisition.present(channel) || !acquisition.read(channel, sample))
+            continue;
+        history[channel].append(uptimeSeconds(), sample.temperatureC, sample.humidity);
+        alerts.update(uptimeSeconds(), channel, (sample.temperatureC * 9 / 5) + 32, sample.humidity, onAlert,
+                      &sample);
+        // Flash records and MQTT batches need wall-clock time, so only once
+        // NTP has synced.
+        if (timeService.valid())
+        {
+            uint32_t now = (uint32_t)timeService.now();
+            historyLog.append(now, channel, sample.temperatureC, sample.humidity);
+#if FEATURE_NETWORK
+            mqttPublisher.add(now, channel, sample.temperatureC, sample.humidity);
+#endif
+        }
+    }
+}
 
-    /** Enable the debug via Serial port
-     * 0 for no debugging
-     * 1 for basic level debugging
-     *
-     * Debug port can be changed via ESP_MAIL_DEFAULT_DEBUG_PORT in ESP_Mail_FS.h
-     */
-    smtp.debug(1);
-    // Initialize Serial2 (UART2) for communication with the RS-232 TTL to RS232 Module
-    // Format: Serial2.begin(baudrate, SERIAL_8N1, TX_pin, RX_pin);
-    Serial2.begin(BAUD_RATE, SERIAL_8N1, Serial2_TX_Pin, Serial2_RX_Pin);
+#if FEATURE_EMAIL
+void sendScheduledReport()
+{
+    if (!timeService.valid())
+        return;
+    logger.info("Scheduled time reached. Triggering automatic email.");
+    struct tm timeinfo;
+    timeService.localTime(timeinfo);
+    readAndReportSensor(timeinfo, true);
+}
+
+void sendScheduledDigest()
+{
+    if (timeService.valid())
+        startDigest(atoi(digest_hours) * 3600UL);
+}
+
+#endif
+
+// Arms the report job on report_cron, or in digest mode the digest job on
+// the window boundaries counted from local midnight.
+void applyReportSchedule()
+{
+#if FEATURE_EMAIL
+    int digestHours = atoi(digest_hours);
+    if (digestHours > 24)
+        digestHours = 24;
+    if (digestHours > 0)
+    {
+        scheduler.cancel(reportJob);
+        char expression[20];
+        snprintf(expression, sizeof(expression), "0 */%d * * *", digestHours);
+        scheduler.cron(digestJob, expression);
+        return;
+    }
+    scheduler.cancel(digestJob);
+    if (!scheduler.cron(reportJob, report_cron))
+        logger.error("ERROR: Bad report schedule '%s'. Scheduled emails are off.", report_cron);
+#endif
+}
+
+void startHttpServer(); // See "HTTP Endpoint"
+void applyModbus();     // See "Modbus Registers"
+
+// --- PERIODIC SYSTEM HEALTH & RECOVERY TASK ---
+void checkSystem()
+{
+#if FEATURE_NETWORK
+    // A) CHECK WIFI CONNECTION
+    // Left to the network lane while the boot is still connecting.
+    if (!boot.networkDone())
+    {
+        logger.info("[System Check] Still connecting (boot network stage).");
+    }
+    else if (!net.isConnected())
+    {
+        logger.info("[System Check] WiFi is disconnected. Attempting to reconnect...");
+        net.reconnect();
+    }
+    // B) IF WIFI IS CONNECTED BUT THE CLOCK IS NOT BEING SYNCED, ASK AGAIN
+    // SNTP keeps retrying by itself; this covers a boot without WiFi and
+    // gets a fresh exchange as soon as the network is back. Never waits.
+    else if (!timeService.started())
+    {
+        logger.info("[System Check] WiFi is back. Starting NTP.");
+        timeService.begin(timeZoneInfo);
+    }
+    else if (timeService.quality() != TIME_SYNCED)
+    {
+        logger.info("[System Check] Time %s. Requesting an NTP sync.",
+                    TimeService::qualityName(timeService.quality()));
+        timeService.requestSync();
+    }
+
+    // The HTTP endpoint listens and MQTT connects once there is a network
+    // (no-ops after that).
+    if (boot.networkDone() && net.isConnected())
+    {
+        startHttpServer();
+        mqttPublisher.setEnabled(true);
+    }
+#endif
+
+#if FEATURE_EMAIL
+    // C) REPORT MAIL QUEUE HEALTH
+    MailQueueStats mail = mailQueue.stats();
+    uint32_t attempts = mail.sent + mail.failed;
+    logger.debug("[System Check] Mail queue: depth %u (max %u), sent %u, failed %u, dropped %u, send ms last %u / avg %u / max %u",
+               (unsigned)mail.depth, (unsigned)mail.maxDepth, (unsigned)mail.sent, (unsigned)mail.failed,
+               (unsigned)mail.dropped, (unsigned)mail.lastSendMs,
+               (unsigned)(attempts ? mail.totalSendMs / attempts : 0), (unsigned)mail.maxSendMs);
+    OutboxStats queued = outbox.stats();
+    if (queued.pending)
+        logger.debug("[System Check] Outbox: %u waiting, %u queued, %u flushed, %u evicted",
+                     (unsigned)queued.pending, (unsigned)queued.queued, (unsigned)queued.flushed,
+                     (unsigned)queued.evicted);
+
+    SmtpStats smtpStats = smtpManager.stats();
+    logger.debug("[System Check] SMTP: %s, %u connects (%u failed), handshake ms mean %u / max %u, auth ms mean %u, send ms mean %u",
+                 SmtpManager::stateName(smtpManager.state()), (unsigned)smtpStats.connects,
+                 (unsigned)smtpStats.connectFailures, (unsigned)smtpStats.handshakeMs.mean(),
+                 (unsigned)smtpStats.handshakeMs.max, (unsigned)smtpStats.authMs.mean(),
+                 (unsigned)smtpStats.sendMs.mean());
+#endif
+
+    // D) REPORT HISTORY LOG WRITES
+    HistoryLogStats log = historyLog.stats();
+    logger.debug("[System Check] History log: %u records, %u page writes, %u bytes, %u segments, %u pending",
+                 (unsigned)log.appended, (unsigned)log.flushes, (unsigned)log.bytesWritten,
+                 (unsigned)log.segments, (unsigned)log.pending);
+
+    // E) LOOK FOR NEWLY FITTED SENSORS, REPORT ACQUISITION COST
+    if (acquisition.count() > 0 && acquisition.discover() > 0)
+        logSensors("[System Check] SHT31-D sensors now:");
+    const AcquisitionStats &sensor = acquisition.stats();
+    logger.debug("[System Check] Sensors: %d, cache hits %u, passes %u, failures %u, pass us last %u / max %u",
+                 acquisition.count(), (unsigned)sensor.hits, (unsigned)sensor.misses, (unsigned)sensor.failures,
+                 (unsigned)sensor.lastI2cUs, (unsigned)sensor.maxI2cUs);
+
+#if FEATURE_STREAMING
+    // F) REPORT TELEMETRY STREAMING
+    if (telemetry.active())
+    {
+        const TelemetryStats &stream = telemetry.stats();
+        logger.debug("[System Check] Telemetry: %u frames, %u overruns, %u skipped, %u sensor errors",
+                     (unsigned)stream.frames, (unsigned)stream.overruns, (unsigned)stream.skipped,
+                     (unsigned)stream.sensorErrors);
+    }
+#endif
+
+#if FEATURE_MODBUS
+    // G) REPORT MODBUS
+    if (modbus.active())
+    {
+        const ModbusStats &bus = modbus.stats();
+        logger.debug("[System Check] Modbus: %u requests, %u exceptions, %u CRC errors, %u overruns, turnaround us p99 <=%u",
+                     (unsigned)bus.requests, (unsigned)bus.exceptions, (unsigned)bus.crcErrors,
+                     (unsigned)(bus.overruns + bus.txOverruns), (unsigned)bus.turnaroundUs.percentile(99));
+    }
+#endif
+
+    // H) REPORT HEAP FRAGMENTATION (sampled by checkHeap())
+    const HeapStats &heap = heapMonitor.stats();
+    logger.debug("[System Check] Heap: %u free, largest block %u (min %u), fragmentation %u%% (max %u%%), trend %ld bytes/h",
+                 (unsigned)heap.freeBytes, (unsigned)heap.largestBlock, (unsigned)heap.minLargestBlock,
+                 (unsigned)heap.fragmentation, (unsigned)heap.maxFragmentation,
+                 (long)heapMonitor.freeTrendPerHour());
+}
+
+void correctClock()
+{
+    timeService.correct();
+}
+
+void flushHistoryLog()
+{
+    historyLog.flush();
+}
+
+static bool uplinkIdle(); // See "Duty Cycle"
+
+// Samples the heap (see heap_monitor.h). A build with HEAP_RESTART_DEGRADED
+// restarts once it is degraded and nothing is on its way out.
+void checkHeap()
+{
+    if (heapMonitor.check())
+        logger.error("ERROR: Heap degraded: the largest free block has been under %u bytes for %u min (%u free).",
+                     (unsigned)HEAP_BLOCK_FLOOR, (unsigned)(HEAP_DEGRADED_CHECKS * HEAP_CHECK_INTERVAL_MS / 60000),
+                     (unsigned)heapMonitor.stats().freeBytes);
+#if HEAP_RESTART_DEGRADED
+    if (heapMonitor.degraded() && uplinkIdle() && !streaming())
+    {
+        logger.error("ERROR: Restarting to defragment the heap.");
+        historyLog.flush();
+        logger.flush();
+        hal::system().restart();
+    }
+#endif
+}
+
+// --- Duty Cycle ---
+// See duty_cycle.h. dutyOn follows duty_s; the rest is about this wake.
+bool dutyOn = false;
+uint8_t dutyReasons = 0;         // DUTY_UPLINK_* this uplink wake is for
+bool dutyWorkDone = false;       // Its alert and report emails are queued
+uint32_t dutyAwakeSinceMs = 0;   // Power-on: boot or the last console command
+uint32_t dutyConsoleLines = 0;
+
+void stagePortal();    // See "Network Lane"
+bool bringUpNetwork();
+
+// Timer wakes keep alert transitions for the uplink instead of emailing them.
+static void bufferAlert(const AlertEvent &event, void *context)
+{
+    dutyCycle.addEvent(event, *(const Sample *)context);
+}
+
+// All of a timer wake that needs no uplink: one measurement pass into the
+// RTC buffer and the alert rules, with no serial ports, settings or flash.
+// Returns true to go straight back to sleep.
+bool sampleWake()
+{
+    dutyCycle.restoreAlerts(alerts);
+    if (acquisition.count() == 0)
+        acquisition.discover();
+    acquisition.measure();
+    uint32_t now = (uint32_t)sysClock.now();
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        Sample sample;
+        if (!acquisition.present(channel) || !acquisition.read(channel, sample))
+            continue;
+        dutyCycle.store(now, sample);
+        alerts.update(uptimeSeconds(), channel, (sample.temperatureC * 9 / 5) + 32, sample.humidity, bufferAlert,
+                      &sample);
+    }
+    dutyCycle.saveAlerts(alerts);
+    dutyReasons = dutyCycle.uplinkReasons(now);
+    return dutyReasons == 0;
+}
 
-    // Inside setup(), after WiFi is connected...
+// Sleeps through every timer wake that needs no uplink. Never returns on
+// the board; the native build carries on here with the wake that does.
+void dutySleep(uint32_t intervalS, uint32_t nextReport)
+{
+    do
+        dutyCycle.sleep(intervalS, nextReport, (uint32_t)sysClock.now());
+    while (dutyCycle.resume() && sampleWake());
+}
+
+static void keepReading(uint32_t epoch, uint8_t channel, float temperatureC, float humidity, void *)
+{
+    historyLog.append(epoch, channel, temperatureC, humidity);
+#if FEATURE_NETWORK
+    mqttPublisher.add(epoch, channel, temperatureC, humidity);
+#endif
+}
+
+// 'context' is the current epoch. Log records go back into the RAM history
+// on the uptime timeline.
+static bool rebuildHistory(const LogRecord &record, void *context)
+{
+    uint32_t age = *(const uint32_t *)context - record.epoch;
+    uint32_t uptime = uptimeSeconds();
+    if (age <= uptime)
+        history[record.channel].append(uptime - age, record.centiC / 100.0f, record.centiRH / 100.0f);
+    return true;
+}
+
+// Runs at the end of setup() on an uplink wake: the buffered readings go
+// to the flash log and MQTT, and the RAM history (empty after a deep
+// sleep) is rebuilt from the log for the report and alert emails.
+void beginUplink()
+{
+    uint32_t now = (uint32_t)sysClock.now();
+    size_t readings = dutyCycle.drainReadings(keepReading, nullptr);
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        history[channel].clear();
+    historyLog.query(now - 86400, now, rebuildHistory, &now);
+#if FEATURE_NETWORK
+    mqttPublisher.setDraining(true);
+#endif
+    dutyWorkDone = false;
+    logger.info("Duty cycle: uplink for%s%s%s, %u readings buffered, wake %lu.",
+                dutyReasons & DUTY_UPLINK_REPORT ? " report" : "", dutyReasons & DUTY_UPLINK_ALERT ? " alerts" : "",
+                dutyReasons & DUTY_UPLINK_FULL ? " full buffer" : "", (unsigned)readings,
+                (unsigned long)dutyCycle.stats().wakes);
+}
+
+// The next report or digest after 'now' (UTC), 0 for none.
+static uint32_t nextReportAfter(uint32_t now)
+{
+#if FEATURE_EMAIL
+    char expression[20];
+    const char *text = report_cron;
+    int digestHours = atoi(digest_hours);
+    if (digestHours > 0)
+    {
+        snprintf(expression, sizeof(expression), "0 */%d * * *", digestHours > 24 ? 24 : digestHours);
+        text = expression;
+    }
+    CronSchedule schedule;
+    return schedule.parse(text) ? (uint32_t)schedule.next(now) : 0;
+#else
+    (void)now;
+    return 0;
+#endif
+}
 
-    if (WiFi.status() == WL_CONNECTED)
+// Leaves the full boot for the timer wakes. 'reported' says whether this
+// wake saw to the report due, if any; otherwise it stays due.
+void enterSleep(bool reported)
+{
+    uint32_t now = (uint32_t)sysClock.now();
+    uint32_t nextReport = dutyCycle.nextReportEpoch();
+    if (reported || nextReport == 0)
+        nextReport = nextReportAfter(now);
+    historyLog.flush();
+    dutyCycle.saveAlerts(alerts);
+    // Periodic mode would keep the sensors converting through the sleep.
+    AcquisitionSettings settings = acquisition.settings();
+    settings.mps = 0;
+    settings.heaterRH = 0;
+    acquisition.configure(settings);
+#if FEATURE_NETWORK
+    mqttPublisher.setDraining(false);
+#endif
+    // The timer wakes take over the readings and reports.
+    scheduler.cancel(sensorJob);
+#if FEATURE_EMAIL
+    scheduler.cancel(reportJob);
+    scheduler.cancel(digestJob);
+#endif
+    uint32_t intervalS = (uint32_t)atol(duty_s);
+    logger.info("Duty cycle: sleeping, a sample every %lu s, next report in %ld s.", (unsigned long)intervalS,
+                nextReport ? (long)(nextReport - now) : -1L);
+    logger.flush();
+
+    dutySleep(intervalS, nextReport);
+
+    // Native build only: an uplink wake, with everything still running.
+    dutyAwakeSinceMs = sysClock.millis();
+    if (!dutyCycle.resumed())
+        return;
+    dutyCycle.mark(DUTY_PHASE_LOCAL);
+#if FEATURE_NETWORK
+    if (boot.networkDone())
     {
+        stagePortal();
+        boot.startNetwork(bringUpNetwork);
+    }
+#endif
+    beginUplink();
+}
 
-        timeSet = syncTime(); // Attempt to sync time with NTP server
+// No mail, outbox report or MQTT batch left that could still go out now.
+static bool uplinkIdle()
+{
+#if FEATURE_EMAIL
+    MailQueueStats mail = mailQueue.stats();
+    if (mail.depth || mail.sent + mail.failed < mail.enqueued || !digest.idle() ||
+        (outbox.pending() && smtpManager.available()))
+        return false;
+#endif
+#if FEATURE_NETWORK
+    return mqttPublisher.stats().backlog == 0 || mqttPublisher.state() != MQTT_CONNECTED;
+#else
+    return true;
+#endif
+}
+
+// Called from loop(): decides when the board goes back to sleep.
+void pollDutyCycle()
+{
+    if (!dutyOn)
+        return;
+    uint32_t nowMs = sysClock.millis();
+    if (!dutyCycle.resumed())
+    {
+        // Power-on: the consoles get DUTY_FIRST_SLEEP_MS after each command.
+        uint32_t lines = usbConsole.stats().lines + rs232Console.stats().lines;
+        if (lines != dutyConsoleLines)
+        {
+            dutyConsoleLines = lines;
+            dutyAwakeSinceMs = nowMs;
+        }
+        if (nowMs - dutyAwakeSinceMs >= DUTY_FIRST_SLEEP_MS && timeService.valid() && !streaming() &&
+            !modbusLink() && uplinkIdle())
+            enterSleep(true);
+        return;
+    }
 
-        // 3. ONLY NOW, ATTEMPT TO CONNECT TO SMTP
-        //    (This requires time to be set correctly)
-        Serial.println("Connecting to SMTP Server...");
-        Serial2.println("Connecting to SMTP Server...");
-        smtp.debug(1); // Enable debug
-        if (timeSet)
+    if (!dutyWorkDone && timeService.valid())
+    {
+        dutyWorkDone = true;
+        AlertEvent event;
+        Sample sample;
+        while (dutyCycle.takeEvent(event, sample))
+            onAlert(event, &sample);
+#if FEATURE_EMAIL
+        if (dutyReasons & DUTY_UPLINK_REPORT)
         {
-            Serial.println("Populating global SMTP configuration...");
-            // NO "Session_Config config;" HERE. We are using the global one.
-            config.server.host_name = mail_server;
-            config.server.port = atoi(mail_port);
-            config.login.email = mail_from;
-            config.login.password = mail_pass;
-            config.login.user_domain = ""; // Blank For Gmail
-
-            // Now, connect using the global config object.
-            // The smtp object will store a reference to this persistent object.
-            if (smtp.connect(&config))
-            {
-                Serial.println("SUCCESS: Connected to SMTP Server.");
-                Serial2.println("SUCCESS: Connected to SMTP Server.");
-                smtpReady = true;
-            }
+            if (atoi(digest_hours) > 0)
+                sendScheduledDigest();
             else
-            {
-                Serial.println("ERROR: Failed to connect. Last Error: ");
-                Serial2.println("ERROR: Failed to connect. Last Error: ");
-                Serial.println(smtp.errorReason());
-                Serial2.println(smtp.errorReason());
-                smtpReady = false;
-            }
+                sendScheduledReport();
         }
-        else
+#endif
+    }
+    bool failed = boot.networkDone() && !net.isConnected();
+    if (dutyWorkDone && !failed && boot.networkDone() && uplinkIdle())
+    {
+        enterSleep(true);
+    }
+    else if (failed || dutyCycle.awakeMs() >= DUTY_AWAKE_MAX_MS)
+    {
+        logger.error("ERROR: Duty cycle: uplink %s. Retrying in %u s.", failed ? "without WiFi" : "timed out",
+                     (unsigned)DUTY_UPLINK_RETRY_S);
+        dutyCycle.uplinkFailed((uint32_t)sysClock.now());
+        enterSleep(dutyWorkDone);
+    }
+}
+
+// --- Serial Commands ---
+struct LogWindow
+{
+    uint32_t count;
+    int32_t minCentiC, maxCentiC, minCentiRH, maxCentiRH;
+    int64_t sumCentiC;
+};
+
+// 'context' is a LogWindow per channel.
+static bool accumulateRecord(const LogRecord &record, void *context)
+{
+    LogWindow &w = ((LogWindow *)context)[record.channel];
+    if (w.count == 0)
+    {
+        w.minCentiC = w.maxCentiC = record.centiC;
+        w.minCentiRH = w.maxCentiRH = record.centiRH;
+    }
+    w.count++;
+    w.sumCentiC += record.centiC;
+    w.minCentiC = record.centiC < w.minCentiC ? record.centiC : w.minCentiC;
+    w.maxCentiC = record.centiC > w.maxCentiC ? record.centiC : w.maxCentiC;
+    w.minCentiRH = record.centiRH < w.minCentiRH ? record.centiRH : w.minCentiRH;
+    w.maxCentiRH = record.centiRH > w.maxCentiRH ? record.centiRH : w.maxCentiRH;
+    return true;
+}
+
+static void cmdHelp(Console &console, int, char **)
+{
+    console.reply("Commands:");
+    for (size_t i = 0; i < console.commandCount(); i++)
+        console.reply("  %s %s", console.commands()[i].name, console.commands()[i].usage);
+}
+
+static void cmdRead(Console &, int, char **)
+{
+    performSensorReadingAndPrint();
+}
+
+#if FEATURE_NETWORK
+static void replyHistogram(Console &console, const char *label, const Histogram &h)
+{
+    if (h.count == 0)
+        return;
+    console.reply("%s: n %u, min %u, p50 <=%u, p95 <=%u, max %u, mean %u", label, (unsigned)h.count,
+                  (unsigned)h.min, (unsigned)h.percentile(50), (unsigned)h.percentile(95),
+                  (unsigned)h.max, (unsigned)h.mean());
+}
+#endif
+
+// 'stats prof': the hot-path histograms, heap and task stacks (see
+// profiler.h); kept apart from the rest so each fits the log ring.
+static void replyProfile(Console &console)
+{
+    for (int p = 0; p < PROF_POINTS; p++)
+    {
+        const Histogram &h = profiler.histogram((ProfilePoint)p);
+        console.reply("%s %s: n %u, p50 <=%u, p99 <=%u, max %u, mean %u", Profiler::pointName((ProfilePoint)p),
+                      Profiler::unitName((ProfilePoint)p), (unsigned)h.count, (unsigned)h.percentile(50),
+                      (unsigned)h.percentile(99), (unsigned)h.max, (unsigned)h.mean());
+    }
+    console.reply("Heap: %u free, %u lowest", (unsigned)hal::system().freeHeap(),
+                  (unsigned)hal::system().minFreeHeap());
+    for (size_t t = 0; t < profiler.taskCount(); t++)
+    {
+        const ProfileTask &task = profiler.task(t);
+        uint32_t free = hal::system().stackHighWater(task.handle);
+        if (free)
+            console.reply("Stack %s: %u bytes never used", task.name, (unsigned)free);
+    }
+}
+
+static void cmdStats(Console &console, int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "prof") == 0)
+            replyProfile(console);
+        else if (strcmp(argv[1], "reset") == 0)
         {
-            Serial.println("Skipping SMTP connection: time is not set.");
-            Serial2.println("Skipping SMTP connection: time is not set.");
-            smtpReady = false;
+            profiler.reset();
+            console.reply("Profile histograms cleared.");
         }
+        else
+            console.reply("Usage: stats [prof|reset]");
+        return;
+    }
+    const AcquisitionStats &sensor = acquisition.stats();
+    console.reply("Sensors: %d, cache hits %u, passes %u, failures %u, pass us last %u / max %u",
+                  acquisition.count(), (unsigned)sensor.hits, (unsigned)sensor.misses, (unsigned)sensor.failures,
+                  (unsigned)sensor.lastI2cUs, (unsigned)sensor.maxI2cUs);
+    const AcquisitionSettings &mode = acquisition.settings();
+    console.reply("  mode: %s %s mps, %s repeatability; median %u, EMA %u%%; heater at %u%% RH (0 = off), %u cycles",
+                  mode.mps ? "periodic" : "single shot", sensor_mps, sensor_repeat, (unsigned)mode.filter.median,
+                  (unsigned)mode.filter.emaPercent, (unsigned)mode.heaterRH, (unsigned)sensor.heaterCycles);
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        if (!acquisition.present(channel))
+            continue;
+        console.reply("  ch%u: bus %u address 0x%02X, %u failures, %u samples in RAM (%u slots)%s", (unsigned)channel,
+                      (unsigned)(channel / 2), (unsigned)(SENSOR_ADDRESS_LOW + channel % 2),
+                      (unsigned)sensor.channelFailures[channel], (unsigned)history[channel].size(),
+                      (unsigned)SampleHistory::CAPACITY, acquisition.heating(channel) ? ", heating" : "");
+    }
+    HistoryLogStats log = historyLog.stats();
+    console.reply("History log: %u records, %u page writes, %u segments, %u pending, %u write errors",
+                  (unsigned)log.appended, (unsigned)log.flushes, (unsigned)log.segments,
+                  (unsigned)log.pending, (unsigned)log.writeErrors);
+#if FEATURE_EMAIL
+    MailQueueStats mail = mailQueue.stats();
+    console.reply("Mail queue: depth %u (max %u), sent %u, failed %u, dropped %u",
+                  (unsigned)mail.depth, (unsigned)mail.maxDepth, (unsigned)mail.sent,
+                  (unsigned)mail.failed, (unsigned)mail.dropped);
+    OutboxStats queued = outbox.stats();
+    console.reply("Outbox: %u waiting (max %u of %u), %u queued, %u flushed, %u evicted, %u damaged, %u write errors",
+                  (unsigned)queued.pending, (unsigned)queued.maxPending, (unsigned)OUTBOX_SLOTS,
+                  (unsigned)queued.queued, (unsigned)queued.flushed, (unsigned)queued.evicted,
+                  (unsigned)queued.damaged, (unsigned)queued.writeErrors);
+    SmtpStats smtpStats = smtpManager.stats();
+    console.reply("SMTP: %s, %s sessions, %u connects (%u failed), %u sends (%u reused, %u failed), %u idle closes, %u refused in backoff",
+                  SmtpManager::stateName(smtpManager.state()), SmtpManager::policyName(smtpManager.policy()),
+                  (unsigned)smtpStats.connects, (unsigned)smtpStats.connectFailures, (unsigned)smtpStats.sends,
+                  (unsigned)smtpStats.reused, (unsigned)smtpStats.sendFailures, (unsigned)smtpStats.idleCloses,
+                  (unsigned)smtpStats.backoffRejects);
+    replyHistogram(console, "SMTP handshake ms", smtpStats.handshakeMs);
+    replyHistogram(console, "SMTP auth ms", smtpStats.authMs);
+    replyHistogram(console, "SMTP send ms", smtpStats.sendMs);
+#endif
+#if FEATURE_NETWORK
+    MqttStats mqtt = mqttPublisher.stats();
+    console.reply("MQTT: %s, %u batches (%u samples), %u failed, backlog %u (max %u), %u dropped, %u connects (%u failed), %lu bytes",
+                  MqttPublisher::stateName(mqttPublisher.state()), (unsigned)mqtt.published,
+                  (unsigned)mqtt.publishedSamples, (unsigned)mqtt.failures, (unsigned)mqtt.backlog,
+                  (unsigned)mqtt.maxBacklog, (unsigned)mqtt.dropped, (unsigned)mqtt.connects,
+                  (unsigned)mqtt.connectFailures, (unsigned long)mqtt.bytes);
+    replyHistogram(console, "MQTT publish us", mqtt.publishUs);
+#endif
+#if FEATURE_EMAIL
+    const DigestStats &digests = digest.stats();
+    console.reply("Digests: %u built, %u rows, %u CSV bytes, %u skipped, %u write errors",
+                  (unsigned)digests.built, (unsigned)digests.rows, (unsigned)digests.bytes,
+                  (unsigned)digests.busy, (unsigned)digests.writeErrors);
+#endif
+    const AlertStats &alertCounts = alerts.stats();
+    console.reply("Alerts: %d rules, %u samples, %u raised, %u cleared", alerts.ruleCount(),
+                  (unsigned)alertCounts.samples, (unsigned)alertCounts.raised, (unsigned)alertCounts.cleared);
+    for (int job = 0; job < scheduler.jobCount(); job++)
+    {
+        const SchedulerJobStats &run = scheduler.stats(job);
+        char next[16] = "off";
+        if (scheduler.armed(job))
+            snprintf(next, sizeof(next), "in %lu s", (unsigned long)(scheduler.dueInMs(job) / 1000));
+        console.reply("Job %s: next %s, %u runs, %u skipped, longest %u ms, late ms p50 <=%u / p95 <=%u / max %u",
+                      scheduler.name(job), next, (unsigned)run.runs, (unsigned)run.skipped,
+                      (unsigned)run.maxRunMs, (unsigned)run.lateMs.percentile(50),
+                      (unsigned)run.lateMs.percentile(95), (unsigned)run.lateMs.max);
+    }
+#if FEATURE_STREAMING
+    const TelemetryStats &stream = telemetry.stats();
+    console.reply("Telemetry: %s, %u frames, %u overruns", telemetry.active() ? "on" : "off",
+                  (unsigned)stream.frames, (unsigned)stream.overruns);
+#endif
+#if FEATURE_MODBUS
+    const ModbusStats &bus = modbus.stats();
+    if (modbus.active() || bus.requests)
+    {
+        console.reply("Modbus: %s, %u requests, %u responses (%u exceptions), %u CRC errors, %u for other units, %u overruns, %u registers written",
+                      modbus.active() ? "on" : "off", (unsigned)bus.requests, (unsigned)bus.responses,
+                      (unsigned)bus.exceptions, (unsigned)bus.crcErrors, (unsigned)bus.foreign,
+                      (unsigned)(bus.overruns + bus.txOverruns), (unsigned)bus.writes);
+        console.reply("  turnaround us: p50 <=%u, p99 <=%u, max %u", (unsigned)bus.turnaroundUs.percentile(50),
+                      (unsigned)bus.turnaroundUs.percentile(99), (unsigned)bus.turnaroundUs.max);
     }
+#endif
+    LogSinkStats usbStats = {}, rs232Stats = {};
+    logger.sinkStats(usbLog, usbStats);
+    logger.sinkStats(rs232Log, rs232Stats);
+    console.reply("Log overflows: usb %u, rs232 %u", (unsigned)usbStats.overflows,
+                  (unsigned)rs232Stats.overflows);
+    const ConsoleStats &commands = console.stats();
+    console.reply("Console: %u lines, %u unknown, %u too long, max %u per pass",
+                  (unsigned)commands.lines, (unsigned)commands.unknown,
+                  (unsigned)commands.overflows, (unsigned)commands.maxBurst);
+    const BootPhaseTiming &first = boot.timing(BOOT_FIRST_READING);
+    const BootPhaseTiming &wifi = boot.timing(BOOT_WIFI);
+    const BootPhaseTiming &ntp = boot.timing(BOOT_TIME);
+    if (boot.networkDone())
+        console.reply("Boot: first reading at %lu ms, local stages done at %lu ms, WiFi %lu ms, time %lu ms",
+                      first.ok ? (unsigned long)first.endMs : 0UL, (unsigned long)boot.timing(BOOT_SERVICES).endMs,
+                      (unsigned long)(wifi.endMs - wifi.startMs),
+                      ntp.ok ? (unsigned long)(ntp.endMs - ntp.startMs) : 0UL);
     else
+        console.reply("Boot: first reading at %lu ms, local stages done at %lu ms, network still connecting",
+                      first.ok ? (unsigned long)first.endMs : 0UL, (unsigned long)boot.timing(BOOT_SERVICES).endMs);
+    const DutyStats &duty = dutyCycle.stats();
+    if (dutyOn || duty.wakes)
     {
-        Serial.println("\nWiFi connection failed. Continuing without WiFi.");
-        Serial2.println("\nWiFi connection failed. Continuing without WiFi.");
-        
+        console.reply("Duty cycle: every %s s, %u wakes, %u uplinks, %u readings buffered, %u alerts (%u lost), %u fast connects (%u failed), %u timeouts, average %lu uA",
+                      duty_s, (unsigned)duty.wakes, (unsigned)duty.uplinks, (unsigned)duty.readings,
+                      (unsigned)duty.events, (unsigned)duty.lostEvents, (unsigned)duty.fastConnects,
+                      (unsigned)duty.fastConnectFailures, (unsigned)duty.timeouts,
+                      (unsigned long)dutyCycle.averageMicroAmps());
+        char phases[96];
+        size_t len = 0;
+        for (int p = 0; p < DUTY_PHASES; p++)
+            len += snprintf(phases + len, sizeof(phases) - len, " %s %lu", DutyCycle::phaseName((DutyPhase)p),
+                            (unsigned long)duty.lastWakeMs[p]);
+        console.reply("  last wake ms:%s", phases);
     }
+    const TimeStats &time = timeService.stats();
+    console.reply("Time: %s, last sync %lu s ago, %u syncs, drift %.2f ppm%s, offset %ld ms (uncorrected %ld ms, max %ld), slewed %ld ms, %u holdovers (longest %lu s)",
+                  TimeService::qualityName(timeService.quality()), (unsigned long)timeService.secondsSinceSync(),
+                  (unsigned)time.syncs, time.driftPpm, time.driftKnown ? "" : " (estimating)",
+                  (long)time.lastOffsetMs, (long)time.rawOffsetMs, (long)time.maxOffsetMs, (long)time.slewedMs,
+                  (unsigned)time.holdovers, (unsigned long)time.longestHoldoverS);
+#if FEATURE_NETWORK
+    const HttpStats &http = httpServer.stats();
+    if (httpServer.running())
+        console.reply("HTTP: %u connections (max %u at once), %u responses, %u not found, %u bad, %u timeouts, %u aborted, %llu bytes",
+                      (unsigned)http.accepted, (unsigned)http.maxActive, (unsigned)http.responses,
+                      (unsigned)http.notFound, (unsigned)http.badRequests, (unsigned)http.timeouts,
+                      (unsigned)http.aborted, (unsigned long long)http.bytes);
+    replyHistogram(console, "HTTP response ms", http.responseMs);
+#endif
+    const ConfigStats &config = configStore.stats();
+    console.reply("Config: %s, %u bytes, save #%lu, loaded in %lu us, %u bad slots",
+                  ConfigStore::sourceName(config.source), (unsigned)config.bytes,
+                  (unsigned long)config.sequence, (unsigned long)config.loadUs, (unsigned)config.badSlots);
+    const HeapStats &heap = heapMonitor.stats();
+    console.reply("Heap: largest block %u (min %u), fragmentation %u%% (max %u%%), trend %ld bytes/h, %u degraded",
+                  (unsigned)hal::system().largestFreeBlock(), (unsigned)heap.minLargestBlock,
+                  (unsigned)HeapMonitor::fragmentation(hal::system().freeHeap(), hal::system().largestFreeBlock()),
+                  (unsigned)heap.maxFragmentation, (long)heapMonitor.freeTrendPerHour(),
+                  (unsigned)heap.degradedEvents);
+    const Histogram &pass = profiler.histogram(PROF_LOOP);
+    console.reply("loop() us: p50 <=%u, p99 <=%u, max %u; heap %u free (lowest %u); 'stats prof' for more",
+                  (unsigned)pass.percentile(50), (unsigned)pass.percentile(99), (unsigned)pass.max,
+                  (unsigned)hal::system().freeHeap(), (unsigned)hal::system().minFreeHeap());
+}
 
-    Serial.println("--- ESP32 (IDE Monitor) ---");
-    Serial.println("ESP32 Temperature and Humidity Sensor Ready (SHT31-D).");
-    Serial.println("Type 'r' or 'R' in Serial Monitor to current get readings.");
-
-    
-    Serial2.println("--- ESP32 (RS-232 Module) ---");
-    Serial2.println("RS-232 Serial Link Active (SHT31-D Readings will appear here).");
-    Serial2.println("Type 'r' or 'R' in Serial session to current get readings.");
-
-    // Initialize I2C communication for the SHT31-D sensor
-    // Default I2C pins for ESP32 are GPIO 21 (SDA) and GPIO 22 (SCL).
-    Wire.begin();
-
-    // Check if the SHT31-D sensor is found and initialized
-    if (!sht31.begin(0x44))
-    {                                                          // SHT31-D's default I2C address is 0x44
-        Serial.println("ERROR: Couldn't find SHT31 sensor!");  // Output to IDE Monitor
-        Serial2.println("ERROR: Couldn't find SHT31 sensor!"); // Output to RS-232 Module
-        while (1)
-            delay(1); // Halt execution if sensor not found
-    }
-    Serial.println("SHT31-D sensor found and initialized!"); // Output to IDE Monitor
-    // Set the message headers
-    message.sender.name = mail_name;
-    message.sender.email = mail_from;
-    message.subject = mail_subject;
-    message.addRecipient("", mail_to); // Add recipient
-    message.text.content = MAIL_CONTENT;
-    message.text.charSet = "us-ascii"; // Set character set for email content
-    message.text.transfer_encoding = Content_Transfer_Encoding::enc_7bit;
+static void cmdHistory(Console &console, int, char **argv)
+{
+    uint32_t span;
+    if (!parseSpan(argv[1], span))
+    {
+        console.reply("ERROR: Bad range '%s' (e.g. 30m, 6h, 7d).", argv[1]);
+        return;
+    }
+    // The RAM history covers the last day; older ranges come from flash.
+    if (span <= 86400)
+    {
+        int shown = 0;
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        {
+            WindowStats stats;
+            int32_t p95 = 0;
+            if (!history[channel].window(uptimeSeconds(), span, stats))
+                continue;
+            history[channel].percentile(uptimeSeconds(), span, HISTORY_TEMPERATURE, 95, p95);
+            char low[READING_TEXT_MAX], mean[READING_TEXT_MAX], high[READING_TEXT_MAX], p95Text[READING_TEXT_MAX];
+            char lowRH[READING_TEXT_MAX], highRH[READING_TEXT_MAX];
+            formatTemperature(low, stats.minCentiC);
+            formatTemperature(mean, (int32_t)(stats.sumCentiC / stats.count));
+            formatTemperature(high, stats.maxCentiC);
+            formatTemperature(p95Text, p95);
+            formatCentiTenths(lowRH, stats.minCentiRH);
+            formatCentiTenths(highRH, stats.maxCentiRH);
+            console.reply("ch%u last %s: %u readings, %s / %s / %s " READING_TEMPERATURE_SUFFIX " (min/mean/max), p95 %s "
+                          READING_TEMPERATURE_SUFFIX ", RH %s-%s %%",
+                          (unsigned)channel, argv[1], (unsigned)stats.count, low, mean, high, p95Text, lowRH, highRH);
+            shown++;
+        }
+        if (shown == 0)
+            console.reply("No readings in the last %s.", argv[1]);
+        return;
+    }
+    if (!timeService.valid())
+    {
+        console.reply("ERROR: Ranges over 24h need the clock to be synced.");
+        return;
+    }
+    uint32_t now = (uint32_t)timeService.now();
+    LogWindow windows[SENSOR_CHANNELS] = {};
+    if (historyLog.query(now - span, now + 1, accumulateRecord, windows) == 0)
+    {
+        console.reply("No logged readings in the last %s.", argv[1]);
+        return;
+    }
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        const LogWindow &w = windows[channel];
+        if (w.count == 0)
+            continue;
+        char low[READING_TEXT_MAX], mean[READING_TEXT_MAX], high[READING_TEXT_MAX];
+        char lowRH[READING_TEXT_MAX], highRH[READING_TEXT_MAX];
+        formatTemperature(low, w.minCentiC);
+        formatTemperature(mean, (int32_t)(w.sumCentiC / w.count));
+        formatTemperature(high, w.maxCentiC);
+        formatCentiTenths(lowRH, w.minCentiRH);
+        formatCentiTenths(highRH, w.maxCentiRH);
+        console.reply("ch%u last %s: %u logged readings, %s / %s / %s " READING_TEMPERATURE_SUFFIX
+                      " (min/mean/max), RH %s-%s %%",
+                      (unsigned)channel, argv[1], (unsigned)w.count, low, mean, high, lowRH, highRH);
+    }
 }
-void loop()
+
+// Checks a new value for a setting and applies it, at once where the
+// firmware can (report schedule, alert rules, acquisition mode, duty cycle,
+// Modbus). Returns false, with the reason in 'error' and the old value
+// kept, if it is refused. Saving it is up to the caller.
+bool applySetting(const ConfigField &field, const char *value, char *error, size_t errorSize)
 {
-    // --- 1. Handle IMMEDIATE Manual Triggers ---
-    if (Serial.available() > 0)
+    if (!ConfigStore::validate(field, value, error, errorSize))
+        return false;
+    CronSchedule schedule;
+    if (field.value == report_cron && !schedule.parse(value))
+    {
+        snprintf(error, errorSize, "Bad schedule '%s' (e.g. \"0 9,13,16 * * *\", \"*/30 8-18 * * 1-5\")", value);
+        return false;
+    }
+    char why[64];
+    if (field.value == alert_rules && !alerts.configure(value, why, sizeof(why)))
+    {
+        snprintf(error, errorSize, "Bad alert rules: %s", why); // Applied at once otherwise
+        return false;
+    }
+    bool acquisitionField = field.value == sensor_mps || field.value == sensor_repeat ||
+                            field.value == filter_median || field.value == filter_ema_pct ||
+                            field.value == heater_rh;
+    char previous[8] = "";
+    if (acquisitionField)
+        snprintf(previous, sizeof(previous), "%s", field.value);
+    ConfigStore::set(field, value);
+    if (field.value == report_cron || field.value == digest_hours)
+        applyReportSchedule(); // Takes effect at once
+    if (field.value == duty_s)
     {
-        char incomingChar = Serial.read(); // Read the character ONCE
-        if (incomingChar == 'r' || incomingChar == 'R')
+        dutyOn = atol(duty_s) > 0;
+        // An uplink wake told to stay up takes on the always-on work.
+        if (!dutyOn && !scheduler.armed(sensorJob))
         {
-            Serial.println("Manual trigger received from Serial Monitor.");
-            performSensorReadingAndPrint(); // ACT ON IT NOW
+            scheduler.every(sensorJob, SENSOR_CHECK_INTERVAL_MS, SENSOR_CHECK_INTERVAL_MS);
+            applyReportSchedule();
+            applyAcquisitionSettings(error, errorSize);
+#if FEATURE_NETWORK
+            mqttPublisher.setDraining(false);
+#endif
         }
     }
-    if (Serial2.available() > 0)
+    if (field.value == modbus_addr || field.value == modbus_baud)
+        applyModbus();
+    if (acquisitionField && !applyAcquisitionSettings(error, errorSize))
+    {
+        ConfigStore::set(field, previous);
+        return false;
+    }
+    return true;
+}
+
+// alert_rules is the longest setting; quoted, since rules may hold spaces.
+static_assert(sizeof("cfg set alert_rules \"\"") - 1 + sizeof(alert_rules) - 1 < CONSOLE_LINE_MAX,
+              "a full alert_rules value must fit on one console line");
+
+static void cmdCfg(Console &console, int argc, char **argv)
+{
+    if (strcmp(argv[1], "list") == 0 && argc == 2)
     {
-        char incomingChar2 = Serial2.read(); // Read the character ONCE
-        if (incomingChar2 == 'r' || incomingChar2 == 'R')
+        for (size_t i = 0; i < configStore.fieldCount(); i++)
         {
-            Serial.println("Manual trigger received from RS-232.");
-            performSensorReadingAndPrint(); // ACT ON IT NOW
+            const ConfigField &field = configStore.field(i);
+            console.reply("  %s = %s", field.key, field.type == CONFIG_SECRET ? "********" : field.value);
         }
+        return;
+    }
+    if (strcmp(argv[1], "save") == 0 && argc == 2)
+    {
+        saveConfiguration();
+        console.reply("Configuration saved. Restart to apply WiFi, time zone and mail settings.");
+        return;
+    }
+    bool get = strcmp(argv[1], "get") == 0 && argc == 3;
+    bool set = strcmp(argv[1], "set") == 0 && argc == 4;
+    if (!get && !set)
+    {
+        console.reply("Usage: cfg list | get <key> | set <key> <value> | save");
+        return;
+    }
+    const ConfigField *field = configStore.find(argv[2]);
+    if (!field)
+    {
+        console.reply("ERROR: Unknown setting '%s'. Type 'cfg list'.", argv[2]);
+        return;
     }
+    if (get)
+    {
+        console.reply("%s = %s", field->key, field->type == CONFIG_SECRET ? "********" : field->value);
+        return;
+    }
+    char error[96];
+    if (!applySetting(*field, argv[3], error, sizeof(error)))
+    {
+        console.reply("ERROR: %s.", error);
+        return;
+    }
+    console.reply("%s set. Use 'cfg save' to keep it across restarts.", field->key);
+}
+
+#if FEATURE_EMAIL
+static void cmdDigest(Console &console, int argc, char **argv)
+{
+    uint32_t span = (atoi(digest_hours) > 0 ? atoi(digest_hours) : 24) * 3600UL;
+    if (argc == 2 && !parseSpan(argv[1], span))
+    {
+        console.reply("ERROR: Bad range '%s' (e.g. 6h, 7d).", argv[1]);
+        return;
+    }
+    if (!timeService.valid())
+    {
+        console.reply("ERROR: Digests need the clock to be synced.");
+        return;
+    }
+    startDigest(span);
+}
+#endif
+
+static void cmdAlerts(Console &console, int, char **)
+{
+    static const char *const STATES[] = {"ok", "pending", "ACTIVE"};
+    for (int i = 0; i < alerts.ruleCount(); i++)
+    {
+        char rule[48], states[SENSOR_CHANNELS * 12 + 1] = "";
+        AlertEngine::formatRule(alerts.rule(i), rule, sizeof(rule));
+        size_t len = 0;
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+            if (acquisition.present(channel))
+                len += snprintf(states + len, sizeof(states) - len, " ch%u %s", (unsigned)channel,
+                                STATES[alerts.state(i, channel)]);
+        console.reply("  %d: %-28s%s", i + 1, rule, states);
+    }
+    if (alerts.ruleCount() == 0)
+        console.reply("No alert rules. Set them with 'cfg set alert_rules \"temp>82~1, rh>70~5@30m\"'.");
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        float temperatureRate, humidityRate;
+        if (alerts.rate(channel, ALERT_TEMPERATURE, temperatureRate) &&
+            alerts.rate(channel, ALERT_HUMIDITY, humidityRate))
+            console.reply("ch%u rates: %+.2f F/min, %+.2f %%/min", (unsigned)channel, temperatureRate, humidityRate);
+    }
+    const AlertStats &counts = alerts.stats();
+    console.reply("%u samples, %u raised, %u cleared", (unsigned)counts.samples, (unsigned)counts.raised,
+                  (unsigned)counts.cleared);
+}
 
-    // --- 2. Handle TIMED Automatic Triggers ---
-    static unsigned long lastAutomaticCheck = 0;
-    const unsigned long automaticCheckInterval = 60000; // 1 minute
+#if FEATURE_STREAMING
+static void cmdStream(Console &console, int argc, char **argv)
+{
+    bool on = argc == 1 ? !telemetry.active() : strcmp(argv[1], "on") == 0;
+    if (argc == 2 && !on && strcmp(argv[1], "off") != 0)
+    {
+        console.reply("Usage: stream [on|off]");
+        return;
+    }
+    if (on)
+        startStreaming();
+    else
+        stopStreaming();
+}
+#endif
+
+static const ConsoleCommand COMMANDS[] = {
+    {"help", "", 0, 0, cmdHelp},
+    {"read", "", 0, 0, cmdRead},
+    {"r", "(same as read)", 0, 0, cmdRead},
+    {"stats", "[prof|reset]", 0, 1, cmdStats},
+    {"history", "<range: 30m, 6h, 7d>", 1, 1, cmdHistory},
+    {"cfg", "list | get <key> | set <key> <value> | save", 1, 3, cmdCfg},
+#if FEATURE_EMAIL
+    {"digest", "[range: 6h, 7d]", 0, 1, cmdDigest},
+#endif
+    {"alerts", "", 0, 0, cmdAlerts},
+#if FEATURE_STREAMING
+    {"stream", "[on|off]", 0, 1, cmdStream},
+    {"s", "(same as stream)", 0, 0, cmdStream},
+#endif
+};
+
+// --- Modbus Registers (FEATURE_MODBUS) ---
+// With modbus_addr set, RS-232 is a Modbus RTU link at modbus_baud (see
+// modbus_slave.h and, for the registers, modbus_registers.h): its console
+// and status lines are off and streaming is refused until modbus_addr is 0
+// again.
+#if FEATURE_MODBUS
+void refreshModbus()
+{
+    modbusRegisters.refresh();
+}
 
-    if (millis() - lastAutomaticCheck >= automaticCheckInterval)
+// Starts, moves or stops the slave to match modbus_addr and modbus_baud.
+void applyModbus()
+{
+    int unit = atoi(modbus_addr);
+    long baud = atol(modbus_baud);
+    if (unit == 0)
+    {
+        if (!modbus.active())
+            return;
+        scheduler.cancel(modbusJob);
+        modbus.stop();
+        logger.setLevel(rs232Log, LOG_INFO);
+        logger.info("Modbus RTU stopped (%u requests). RS-232 is the console again.",
+                    (unsigned)modbus.stats().requests);
+        return;
+    }
+    if (modbus.active() && modbus.unit() == unit && modbus.baud() == baud)
+        return;
+#if FEATURE_STREAMING
+    stopStreaming();
+#endif
+    logger.info("Modbus RTU: unit %d at %ld baud on RS-232; its console and status lines are off.", unit, baud);
+    logger.flush(); // Let the announcement out before the baud rate changes
+    logger.setLevel(rs232Log, LOG_OFF);
+    if (!modbus.start((uint8_t)unit, baud, ModbusRegisterMap::onWrite))
     {
-        lastAutomaticCheck = millis();
+        logger.setLevel(rs232Log, LOG_INFO);
+        logger.error("ERROR: Invalid Modbus settings (unit %d, baud %ld).", unit, baud);
+        return;
+    }
+    refreshModbus();
+    scheduler.every(modbusJob, MODBUS_REFRESH_MS, MODBUS_REFRESH_MS);
+}
+#else
+void applyModbus()
+{
+}
+#endif
 
-        // This block only runs if WiFi/Time is working.
-        if (timeSet)
+// --- HTTP Endpoint (FEATURE_NETWORK) ---
+// /metrics and /readings (see http_routes.h).
+#if FEATURE_NETWORK
+// Listens once there is a network to listen on; checkSystem() retries.
+void startHttpServer()
+{
+    uint16_t port = (uint16_t)atol(http_port);
+    if (port == 0 || httpServer.running())
+        return;
+    if (httpServer.begin(port, HTTP_ROUTES, HTTP_ROUTE_COUNT))
+        logger.info("HTTP: metrics at http://%s:%u/metrics, readings at /readings", net.localIP(), (unsigned)port);
+    else
+        logger.error("ERROR: Could not listen for HTTP on port %u.", (unsigned)port);
+}
+
+// Custom parameters shown in the WiFiManager portal, over a copy of the
+// settings taken on the loop task before the network lane starts. If the
+// user saves the form the portal writes the copy, and finishBoot() applies
+// and saves it on the loop task, so 'cfg' and Modbus writes never race it.
+hal::PortalParam portalParams[32];
+size_t portalCount = 0;
+char portalValues[CONFIG_VALUES_MAX];
+bool portalSaved = false; // Published to loop() by the lane finishing (boot.poll())
+
+void stagePortal()
+{
+    portalCount = configStore.portalParams(portalParams, sizeof(portalParams) / sizeof(portalParams[0]),
+                                           portalValues, sizeof(portalValues));
+}
+
+// The network lane of the boot (see boot.h). Runs on its own task while
+// loop() already serves the serial ports and the sensor; finishBoot()
+// picks up the result.
+bool bringUpNetwork()
+{
+    // --- Configure and Start WiFiManager ---
+    boot.start(BOOT_WIFI);
+
+    // A duty-cycle uplink first rejoins the last access point directly.
+    bool connected = false;
+    hal::FastConnectInfo fast;
+    if (dutyCycle.resumed())
+    {
+        dutyCycle.mark(DUTY_PHASE_WIFI);
+        if (dutyCycle.fastConnect(fast))
         {
-            float temperatureF = (sht31.readTemperature() * 9 / 5) + 32;
-
-            struct tm timeinfo;
-            getLocalTime(&timeinfo);
-
-            bool shouldSendEmail = false;
-
-            // Condition 1: High Temperature
-            if (temperatureF > 82.0)
-            {
-                Serial.println("High temperature detected. Triggering automatic email.");
-                Serial2.println("High temperature detected. Triggering automatic email.");
-                shouldSendEmail = true;
-            }
-
-            // Condition 2: Scheduled Time
-            if ((timeinfo.tm_hour == 9 || timeinfo.tm_hour == 13 || timeinfo.tm_hour == 16) && timeinfo.tm_min == 00)
-            {
-                Serial.println("Scheduled time reached. Triggering automatic email.");
-                Serial2.println("Scheduled time reached. Triggering automatic email.");
-                shouldSendEmail = true;
-            }
-
-            if (shouldSendEmail)
-            {
-                readAndReportSensor(timeinfo);
-            }
+            connected = net.connectFast(fast, DUTY_FAST_CONNECT_MS);
+            dutyCycle.countFastConnect(connected);
         }
     }
-    // --- 3. PERIODIC SYSTEM HEALTH & RECOVERY TASK ---
-    static unsigned long lastSystemCheck = 0;
-    const unsigned long systemCheckInterval = 900000; // 15 minutes
 
-    if (millis() - lastSystemCheck >= systemCheckInterval)
+    // autoConnect() will start an access point "TempSensorAP" if it can't connect to saved WiFi.
+    // It is a blocking function, but only this task waits on it.
+    if (!connected)
+        connected = net.autoConnect("TempSensorAP", portalParams, portalCount, portalSaved);
+    boot.finish(BOOT_WIFI, connected);
+    if (connected && dutyOn && net.fastConnectInfo(fast))
+        dutyCycle.setFastConnect(fast);
+    if (dutyCycle.resumed())
+        dutyCycle.mark(DUTY_PHASE_UPLINK);
+    if (!connected && dutyCycle.resumed())
+    {
+        // The uplink gives up and tries again later (see pollDutyCycle()).
+        logger.info("\nWiFi connection failed. Back to sleep.");
+        return false;
+    }
+    if (!connected) {
+        logger.debug("Failed to connect and hit timeout");
+        logger.flush();
+        hal::system().restart(); // Restart if it fails to connect
+    }
+
+        logger.info("\nWiFi connected!");
+        logger.info("IP address: %s", net.localIP());
+
+    // New settings from the portal: finishBoot() saves them and restarts.
+    if (portalSaved)
+        return true;
+
+    if (!net.isConnected())
+    {
+        logger.info("\nWiFi connection failed. Continuing without WiFi.");
+        return false;
+    }
+    // SNTP answers in the background; loop() sees it in timeService.poll().
+    boot.start(BOOT_TIME);
+    logger.info("Starting time synchronization...");
+    timeService.begin(timeZoneInfo);
+    return true;
+}
+#endif // FEATURE_NETWORK
+
+void logBootReport()
+{
+    logger.info("Boot timing (ms since power-up):");
+    for (int i = 0; i < BOOT_PHASES; i++)
+    {
+        const BootPhaseTiming &phase = boot.timing((BootPhase)i);
+        if (phase.ran)
+            logger.info("  %-13s %6lu - %6lu  (%lu ms)%s", BootSequence::phaseName((BootPhase)i),
+                        (unsigned long)phase.startMs, (unsigned long)phase.endMs,
+                        (unsigned long)(phase.endMs - phase.startMs), phase.ok ? "" : "  FAILED");
+    }
+}
+
+// Runs on loop() once the network lane is done.
+void finishBoot(bool connected)
+{
+#if FEATURE_NETWORK
+    if (portalSaved)
+    {
+        // Save the new values to our config file and restart
+        ConfigStore::applyPortal(portalParams, portalCount);
+        saveConfiguration();
+        logger.debug("New settings saved. Restarting device to apply changes.");
+        sysClock.delay(2000);
+        logger.flush();
+        hal::system().restart();
+    }
+#endif
+    if (!connected)
     {
-        lastSystemCheck = millis();
+        logBootReport(); // No NTP to wait for
+        return;
+    }
+#if FEATURE_NETWORK
+    startHttpServer();
+    // Connects on its own task; readings wait in its backlog until then.
+    mqttPublisher.setEnabled(true);
+#endif
+}
 
-        // A) CHECK WIFI CONNECTION
-        if (WiFi.status() != WL_CONNECTED)
+// Runs on loop() for every time service event (see time_service.h).
+void onTimeEvent(TimeEvent event)
+{
+    const TimeStats &time = timeService.stats();
+    if (event == TIME_EVENT_FIRST_SYNC)
+    {
+        struct tm timeinfo;
+        timeService.localTime(timeinfo);
+        char timeBuffer[50];
+        strftime(timeBuffer, sizeof(timeBuffer), "%A, %B %d %Y %H:%M:%S %Z", &timeinfo);
+        logger.info("\nSUCCESS: NTP has synced.");
+        logger.info("Current Local Time: %s", timeBuffer);
+#if FEATURE_EMAIL
+        // SMTP needs the time to be set (TLS). The manager connects on the
+        // mail task, when its policy says so.
+        logger.info("SMTP enabled (%s sessions).", SmtpManager::policyName(smtpManager.policy()));
+        smtpManager.setEnabled(true);
+#endif
+        scheduler.retime(); // Cron jobs arm once the clock is set
+        if (boot.timing(BOOT_TIME).ran && !boot.timing(BOOT_TIME).ok)
         {
-            Serial.println("[System Check] WiFi is disconnected. Attempting to reconnect...");
-            Serial2.println("[System Check] WiFi is disconnected. Attempting to reconnect...");
-            WiFi.reconnect();
+            boot.finish(BOOT_TIME);
+            logBootReport();
         }
-        // B) IF WIFI IS CONNECTED, CHECK TIME & SMTP STATUS
-        else
+    }
+    else if (event == TIME_EVENT_SYNC)
+    {
+        logger.debug("NTP sync: offset %ld ms (uncorrected %ld ms), drift %.2f ppm%s",
+                     (long)time.lastOffsetMs, (long)time.rawOffsetMs, time.driftPpm,
+                     time.driftKnown ? "" : " (estimating)");
+        scheduler.retime(); // The clock may have been stepped
+    }
+    else if (event == TIME_EVENT_HOLDOVER)
+    {
+        logger.info("Time: no NTP sync for %lu min. Holding over on the drift-corrected clock (%.2f ppm).",
+                    (unsigned long)(timeService.secondsSinceSync() / 60), time.driftPpm);
+    }
+}
+
+void setup()
+{
+    // --- Duty Cycle Timer Wakes ---
+    // Most of them only take a reading and sleep again (see duty_cycle.h);
+    // the rest go on as an uplink.
+    if (dutyCycle.resume() && sampleWake())
+        dutySleep(dutyCycle.intervalS(), dutyCycle.nextReportEpoch());
+    bool uplink = dutyCycle.resumed();
+    if (uplink)
+        dutyCycle.mark(DUTY_PHASE_LOCAL);
+
+    // --- Local Stages First ---
+    // The serial ports, the sensor and the first reading come up before
+    // anything that can wait on the network (see boot.h).
+    boot.start(BOOT_SERIAL);
+    profiler.begin();
+    profiler.addTask("loop"); // setup() runs on the loop task
+   usb.begin(BAUD_RATE); 
+   usbLog = logger.attach(usbSink, LOG_DEBUG); // Everything goes to the IDE monitor
+   logger.debug("\n\nBooting...");
+
+    // --- Check for Factory Reset Trigger ---
+    // Hold the reset pin to GND during boot to trigger this.
+    if (hal::system().pinHeldLow(RESET_PIN)) {
+        logger.debug("Reset pin activated! Clearing all settings...");
+        hal::storage().begin();
+        hal::storage().format(); // Erase the entire filesystem
+#if FEATURE_NETWORK
+        net.resetSettings(); // Erase saved WiFi credentials
+#endif
+        logger.debug("Settings cleared. Please restart the device.");
+        logger.flush();
+        hal::system().halt(); // Halt execution
+    }
+
+    // Initialize Serial2 (UART2) for communication with the RS-232 TTL to RS232 Module
+    rs232.begin(BAUD_RATE);
+#if FEATURE_RS232_TEXT
+    rs232Log = logger.attach(rs232Sink, LOG_INFO); // Status lines, no debug chatter
+#endif
+#if FEATURE_STREAMING
+    telemetry.begin(rs232, BAUD_RATE);
+#endif
+#if FEATURE_MODBUS
+    modbus.begin(rs232, BAUD_RATE);
+    modbusRegisters.begin(modbus, applySetting, saveConfiguration);
+#endif
+    usbConsole.begin(usb, usbLog, COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+#if FEATURE_RS232_TEXT
+    rs232Console.begin(rs232, rs232Log, COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+#endif
+
+    logger.logTo(usbLog, LOG_INFO, "--- ESP32 (IDE Monitor) ---");
+    logger.logTo(usbLog, LOG_INFO, "ESP32 Temperature and Humidity Sensor Ready (SHT31-D).");
+    logger.logTo(usbLog, LOG_INFO, "Type 'read' (or 'r') and Enter in Serial Monitor to get current readings, 'help' for all commands.");
+
+    
+    logger.logTo(rs232Log, LOG_INFO, "--- ESP32 (RS-232 Module) ---");
+    logger.logTo(rs232Log, LOG_INFO, "RS-232 Serial Link Active (SHT31-D Readings will appear here).");
+    logger.logTo(rs232Log, LOG_INFO, "Type 'read' (or 'r') and Enter in Serial session to get current readings, 'help' for all commands.");
+#if FEATURE_STREAMING
+    logger.logTo(rs232Log, LOG_INFO, "Type 'stream on' / 'stream off' to start/stop binary telemetry streaming.");
+#endif
+    boot.finish(BOOT_SERIAL);
+
+    // Initialize both I2C buses and look for an SHT31-D at each address
+    // (an uplink wake has just read them)
+    boot.start(BOOT_SENSOR);
+    bool sensorFound = uplink ? acquisition.count() > 0 : acquisition.discover() > 0;
+    boot.finish(BOOT_SENSOR, sensorFound);
+    if (sensorFound && !uplink)
+    {
+        logSensors("SHT31-D sensors found:");
+        boot.start(BOOT_FIRST_READING);
+        bool ok = acquisition.measure() > 0;
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
         {
-            // If time was never set, this is our chance to recover from a boot failure.
-            if (!timeSet)
-            {
-                Serial.println("[System Check] Time not set. Attempting initial NTP sync and SMTP connection...");
-                Serial2.println("[System Check] Time not set. Attempting initial NTP sync and SMTP connection...");
-                timeSet = syncTime(); // Attempt to get the time
-                if (timeSet)
-                {
-                    // SUCCESS! Now we can finally try to connect SMTP.
-                    Serial.println("[System Check] Time acquired. Now attempting SMTP connect.");
-                    Serial2.println("[System Check] Time acquired. Now attempting SMTP connect.");
-
-                    // Populate the global config (it was skipped in setup)
-                    config.server.host_name = mail_server;
-                    config.server.port = atoi(mail_port);
-                    config.login.email = mail_from;
-                    config.login.password = mail_pass;
-                    config.login.user_domain = "";
-
-                    if (smtp.connect(&config))
-                    {
-                        Serial.println("[System Check] SUCCESS: Connected to SMTP Server.");
-                        Serial2.println("[System Check] SUCCESS: Connected to SMTP Server.");
-                        smtpReady = true;
-                    }
-                    else
-                    {
-                        Serial.println("[System Check] ERROR: Failed to connect to SMTP. Will retry in 15 mins.");
-                        Serial2.println("[System Check] ERROR: Failed to connect to SMTP. Will retry in 15 mins.");
-                        smtpReady = false;
-                    }
-                }
-                else
-                {
-                    Serial.println("[System Check] NTP sync failed. Will retry in 15 mins.");
-                    Serial2.println("[System Check] NTP sync failed. Will retry in 15 mins.");
-                }
-            }
-            resyncTime(); // Perform a lightweight time resync
+            Sample sample;
+            if (!acquisition.present(channel) || !acquisition.read(channel, sample))
+                continue;
+            history[channel].append(uptimeSeconds(), sample.temperatureC, sample.humidity);
+            char temperature[READING_TEXT_MAX], humidity[READING_TEXT_MAX];
+            formatTemperature(temperature, sample.centiC);
+            formatCenti(humidity, sample.centiRH);
+            logger.info("First reading -> ch%u Temp: %s " READING_TEMPERATURE_SUFFIX ", Humidity: %s %%",
+                        (unsigned)channel, temperature, humidity);
         }
+        boot.finish(BOOT_FIRST_READING, ok);
+    }
+    else if (!sensorFound)
+    {
+        // Keep the ports, WiFi and email running; the sensor check retries.
+        logger.error("ERROR: Couldn't find SHT31 sensor! Retrying every minute.");
+    }
+
+    // --- Load Custom Configuration ---
+    boot.start(BOOT_STORAGE);
+    loadConfiguration();
+
+    dutyOn = atol(duty_s) > 0;
+
+    // --- Switch the Sensors to the Configured Mode ---
+    // An uplink wake leaves them in single shot, for the sleep that follows.
+    char sensorError[48];
+    if (!uplink && !applyAcquisitionSettings(sensorError, sizeof(sensorError)))
+    {
+        logger.error("ERROR: %s (sensor_mps %s, sensor_repeat %s). Using single shots.", sensorError, sensor_mps,
+                     sensor_repeat);
+        snprintf(sensor_mps, sizeof(sensor_mps), "0");
+        snprintf(sensor_repeat, sizeof(sensor_repeat), "high");
+        applyAcquisitionSettings(sensorError, sizeof(sensorError));
+    }
+
+    // --- Load the Alert Rules ---
+    char alertError[48];
+    if (!alerts.configure(alert_rules, alertError, sizeof(alertError)))
+    {
+        logger.error("ERROR: Bad alert rules '%s' (%s). Using temp>82~1.", alert_rules, alertError);
+        alerts.configure("temp>82~1");
+    }
+    if (uplink)
+        dutyCycle.restoreAlerts(alerts); // The rules carry on where the timer wakes left them
+    boot.finish(BOOT_STORAGE);
+
+    // --- Start the Network Lane ---
+    // WiFi and NTP only need the settings; the rest of setup() and loop()
+    // carry on while they connect.
+#if FEATURE_NETWORK
+    stagePortal();
+    if (!boot.startNetwork(bringUpNetwork))
+    {
+        logger.error("ERROR: Could not start the network task. Connecting in place.");
+        boot.networkFinished(bringUpNetwork());
+    }
+#endif
+
+    // --- Open the Persistent History Log (same partition as the config) ---
+    boot.start(BOOT_HISTORY_LOG);
+    historyLog.begin();
+    HistoryLogStats log = historyLog.stats();
+    logger.debug("History log: %u segments, %u torn tails recovered",
+                 (unsigned)log.segments, (unsigned)log.tornTails);
+#if FEATURE_EMAIL
+    outbox.begin();
+    OutboxStats queued = outbox.stats();
+    if (queued.pending || queued.damaged)
+        logger.info("Outbox: %u reports waiting to be sent, %u damaged slots dropped",
+                    (unsigned)queued.pending, (unsigned)queued.damaged);
+#endif
+    boot.finish(BOOT_HISTORY_LOG);
+
+    boot.start(BOOT_SERVICES);
+#if FEATURE_EMAIL
+    // Set the network reconnection option
+    smtp.setNetworkReconnect(true);
+    SmtpPolicy policy = SMTP_ON_DEMAND;
+    if (!SmtpManager::parsePolicy(smtp_policy, policy))
+        logger.error("ERROR: Unknown SMTP policy '%s', using ondemand.", smtp_policy);
+    smtpManager.begin(smtp, mailServerConfig(), policy, atol(smtp_idle_s) * 1000UL);
+
+    /** Enable the debug via Serial port
+     * 0 for no debugging
+     * 1 for basic level debugging
+     *
+     * Debug port can be changed via ESP_MAIL_DEFAULT_DEBUG_PORT in ESP_Mail_FS.h
+     */
+    smtp.setDebug(1);
+
+    // Start the mail task; from here on emails are sent in the background.
+    if (!mailQueue.begin(sendSensorEmail, mailIdle))
+    {
+        logger.error("ERROR: Could not start the mail task.");
+    }
+#endif
+#if FEATURE_NETWORK
+    MqttSettings mqtt = {mqtt_host, (uint16_t)atol(mqtt_port), mqtt_topic, mqtt_user, mqtt_pass,
+                         (uint8_t)atoi(mqtt_qos), (uint32_t)atol(mqtt_interval_s)};
+    if (!mqttPublisher.begin(mqtt))
+        logger.error("ERROR: Could not start the MQTT task.");
+#endif
+
+    // --- Schedule the Periodic Work ---
+    sensorJob = addJob("sensor", checkSensor);
+#if FEATURE_EMAIL
+    reportJob = addJob("report", sendScheduledReport);
+    digestJob = addJob("digest", sendScheduledDigest);
+#endif
+    systemJob = addJob("system", checkSystem);
+    clockJob = addJob("clock", correctClock);
+    flushJob = addJob("flush", flushHistoryLog);
+    heapJob = addJob("heap", checkHeap);
+#if FEATURE_MODBUS
+    modbusJob = addJob("modbus", refreshModbus);
+#endif
+    scheduler.every(systemJob, SYSTEM_CHECK_INTERVAL_MS, SYSTEM_CHECK_INTERVAL_MS);
+    scheduler.every(clockJob, TIME_CORRECT_INTERVAL_MS, TIME_CORRECT_INTERVAL_MS);
+    scheduler.every(flushJob, LOG_FLUSH_INTERVAL_MS, LOG_FLUSH_INTERVAL_MS);
+    scheduler.every(heapJob, HEAP_CHECK_INTERVAL_MS, 0);
+    // An uplink wake has its reading and sends its report itself.
+    if (!uplink)
+    {
+        scheduler.every(sensorJob, SENSOR_CHECK_INTERVAL_MS, SENSOR_CHECK_INTERVAL_MS);
+        applyReportSchedule(); // Cron jobs arm once the clock is set
+    }
+    // RS-232 becomes the Modbus link from here, if modbus_addr is set.
+    applyModbus();
+    boot.finish(BOOT_SERVICES);
+#if FEATURE_NETWORK
+    logger.info("Local stages up in %lu ms; WiFi and time continue in the background.",
+                (unsigned long)boot.timing(BOOT_SERVICES).endMs);
+#else
+    logger.info("Up in %lu ms (built without the network).", (unsigned long)boot.timing(BOOT_SERVICES).endMs);
+    logBootReport();
+#endif
+    if (uplink)
+        beginUplink();
+    else if (dutyOn)
+        logger.info("Duty cycle: sleeping %s s between samples once the clock is set and the consoles have been idle %lu s.",
+                    duty_s, (unsigned long)(DUTY_FIRST_SLEEP_MS / 1000));
+}
+void loop()
+{
+    ProfileScope profile(PROF_LOOP);
+
+    // The network lane of the boot reports back once, when it is done, and
+    // SNTP whenever it has synced.
+    bool connected;
+    if (boot.poll(connected))
+        finishBoot(connected);
+    {
+        ProfileScope profileTime(PROF_TIME);
+        TimeEvent timeEvent = timeService.poll();
+        if (timeEvent != TIME_EVENT_NONE)
+            onTimeEvent(timeEvent);
     }
+
+    // Periodic sensor fetches and heater cycles, when due.
+    acquisition.poll();
+
+    // Push any buffered log output out to the serial ports, then any
+    // telemetry frames that are due, and answer a Modbus poll.
+    {
+        ProfileScope profileSerial(PROF_SERIAL);
+        logger.poll();
+#if FEATURE_STREAMING
+        telemetry.poll();
+#endif
+#if FEATURE_MODBUS
+        modbus.poll();
+#endif
+    }
+
+    // --- 1. Handle Serial Commands ---
+    // Every complete line waiting on either port is run in this pass.
+    usbConsole.poll();
+#if FEATURE_RS232_TEXT
+    if (!modbusLink())
+        rs232Console.poll();
+#endif
+
+#if FEATURE_NETWORK
+    // Scrapes and /readings downloads, a few chunks per connection per pass.
+    httpServer.poll();
+#endif
+
+#if FEATURE_EMAIL
+    // A digest being built writes one chunk of its CSV per pass.
+    if (digest.poll())
+        sendDigest();
+#endif
+
+    // --- 2. Timed Work ---
+    // Sensor checks, reports, health checks, clock drift correction and log flushes,
+    // each when it is due (see "Scheduled Jobs").
+    scheduler.poll();
+
+    // --- 3. Deep Sleep ---
+    // With duty_s set, once this wake's work is out (see duty_cycle.h).
+    pollDutyCycle();
 }
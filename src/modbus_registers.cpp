@@ -0,0 +1,295 @@
+// --- Modbus Register Map ---
+#include "modbus_registers.h"
+
+#include "acquisition.h"
+#include "alerts.h"
+#include "history.h"
+#include "history_log.h"
+#include "logger.h"
+#include "time_service.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+ModbusRegisterMap modbusRegisters;
+
+// Numeric settings, one register each from MB_HOLD_SETTINGS.
+static const char *const MODBUS_SETTINGS[] = {
+    "digest_hours", "duty_s", "sensor_mps", "filter_median", "filter_ema_pct", "heater_rh",
+};
+static const uint16_t MODBUS_SETTING_COUNT = sizeof(MODBUS_SETTINGS) / sizeof(MODBUS_SETTINGS[0]);
+static_assert(MB_HOLD_SETTINGS + MODBUS_SETTING_COUNT <= MB_HOLD_RULES, "settings run into the alert rules");
+static_assert(MB_HOLD_RULES + ALERT_MAX_RULES * MB_HOLD_RULE_SIZE <= MODBUS_HOLDING_REGISTERS,
+              "alert rules past the holding image");
+static_assert(MB_IN_CHANNELS + SENSOR_CHANNELS * MB_IN_CHANNEL_SIZE <= MODBUS_INPUT_REGISTERS,
+              "channels past the input image");
+
+static uint16_t clampCenti(float value, int32_t low, int32_t high)
+{
+    long centi = lroundf(value * 100);
+    return (uint16_t)(centi < low ? low : centi > high ? high : centi);
+}
+
+void ModbusRegisterMap::begin(ModbusSlave &slave, SettingFunction apply, SaveFunction save)
+{
+    this->slave = &slave;
+    this->apply = apply;
+    this->save = save;
+}
+
+bool ModbusRegisterMap::reportHours(const char *cron, uint16_t &minute, uint32_t &hours)
+{
+    char *end;
+    unsigned long m = strtoul(cron, &end, 10);
+    if (end == cron || *end != ' ' || m > 59)
+        return false;
+    const char *p = end + 1;
+    hours = 0;
+    if (*p == '*')
+    {
+        hours = 0xFFFFFF;
+        p++;
+    }
+    else
+        for (;;)
+        {
+            unsigned long h = strtoul(p, &end, 10);
+            if (end == p || h > 23)
+                return false;
+            hours |= 1UL << h;
+            p = end;
+            if (*p != ',')
+                break;
+            p++;
+        }
+    minute = (uint16_t)m;
+    return strcmp(p, " * * *") == 0;
+}
+
+void ModbusRegisterMap::formatReportCron(char *buffer, size_t size, uint16_t minute, uint32_t hours)
+{
+    int len = snprintf(buffer, size, "%u ", (unsigned)minute);
+    if (hours == 0xFFFFFF)
+        len += snprintf(buffer + len, size - len, "*");
+    for (int h = 0; h < 24 && hours != 0xFFFFFF && len < (int)size; h++)
+    {
+        if (!(hours & (1UL << h)))
+            continue;
+        int last = h;
+        while (last < 23 && (hours & (1UL << (last + 1))))
+            last++;
+        const char *comma = buffer[len - 1] == ' ' ? "" : ",";
+        if (last - h >= 2)
+            len += snprintf(buffer + len, size - len, "%s%d-%d", comma, h, last);
+        else if (last > h)
+            len += snprintf(buffer + len, size - len, "%s%d,%d", comma, h, last);
+        else
+            len += snprintf(buffer + len, size - len, "%s%d", comma, h);
+        h = last;
+    }
+    if (len < (int)size)
+        snprintf(buffer + len, size - len, " * * *");
+}
+
+void ModbusRegisterMap::refresh()
+{
+    if (!slave)
+        return;
+    ModbusSlave &modbus = *slave;
+    uint32_t nowSec = uptimeSeconds();
+    uint32_t nowMs = hal::clock().millis();
+    uint16_t fitted = 0;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        if (acquisition.present(channel))
+            fitted |= 1u << channel;
+    const AcquisitionStats &sensor = acquisition.stats();
+    const AlertStats &alertCounts = alerts.stats();
+    modbus.setInput(MB_IN_SENSORS, fitted);
+    modbus.setInput(MB_IN_RULES, (uint16_t)alerts.ruleCount());
+    modbus.setInput32(MB_IN_UPTIME, nowSec);
+    modbus.setInput32(MB_IN_EPOCH, timeService.valid() ? (uint32_t)timeService.now() : 0);
+    modbus.setInput(MB_IN_TIME_QUALITY, timeService.quality());
+    modbus.setInput(MB_IN_FREE_HEAP, (uint16_t)(hal::system().freeHeap() / 1024));
+    modbus.setInput32(MB_IN_PASSES, sensor.misses);
+    modbus.setInput32(MB_IN_FAILURES, sensor.failures);
+    modbus.setInput32(MB_IN_RAISED, alertCounts.raised);
+    modbus.setInput32(MB_IN_CLEARED, alertCounts.cleared);
+    modbus.setInput32(MB_IN_LOG_RECORDS, historyLog.stats().appended);
+    modbus.setInput32(MB_IN_REQUESTS, modbus.stats().requests);
+    modbus.setInput32(MB_IN_CRC_ERRORS, modbus.stats().crcErrors);
+
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+    {
+        uint16_t base = MB_IN_CHANNELS + channel * MB_IN_CHANNEL_SIZE;
+        Sample sample;
+        bool have = acquisition.latest(channel, sample);
+        uint32_t ageSec = have ? (nowMs - sample.takenAtMs) / 1000 : 0xFFFF;
+        modbus.setInput(base, acquisition.present(channel) ? 1 : 0);
+        modbus.setInput(base + 1, have ? (uint16_t)sample.centiC : 0x8000);
+        modbus.setInput(base + 2, have ? sample.centiRH : 0xFFFF);
+        modbus.setInput(base + 3, (uint16_t)(ageSec > 0xFFFF ? 0xFFFF : ageSec));
+        WindowStats day;
+        bool kept = history[channel].window(nowSec, 86400, day);
+        modbus.setInput(base + 4, kept ? (uint16_t)day.minCentiC : 0x8000);
+        modbus.setInput(base + 5, kept ? (uint16_t)day.maxCentiC : 0x8000);
+        modbus.setInput(base + 6, kept ? (uint16_t)day.minCentiRH : 0xFFFF);
+        modbus.setInput(base + 7, kept ? (uint16_t)day.maxCentiRH : 0xFFFF);
+        uint16_t active = 0, pending = 0;
+        for (int i = 0; i < alerts.ruleCount(); i++)
+        {
+            if (alerts.state(i, channel) == ALERT_ACTIVE)
+                active |= 1u << i;
+            else if (alerts.state(i, channel) == ALERT_PENDING)
+                pending |= 1u << i;
+        }
+        modbus.setInput(base + 8, active);
+        modbus.setInput(base + 9, pending);
+        modbus.setInput32(base + 10, sensor.channelFailures[channel]);
+    }
+
+    uint16_t minute;
+    uint32_t hours;
+    if (!reportHours(report_cron, minute, hours))
+    {
+        minute = 0xFFFF;
+        hours = 0;
+    }
+    modbus.setHolding(MB_HOLD_REPORT_MINUTE, minute);
+    modbus.setHolding32(MB_HOLD_REPORT_HOURS, hours);
+    for (uint16_t i = 0; i < MODBUS_SETTING_COUNT; i++)
+        modbus.setHolding(MB_HOLD_SETTINGS + i, (uint16_t)atol(configStore.find(MODBUS_SETTINGS[i])->value));
+    for (int i = 0; i < ALERT_MAX_RULES; i++)
+    {
+        uint16_t base = MB_HOLD_RULES + i * MB_HOLD_RULE_SIZE;
+        if (i >= alerts.ruleCount())
+        {
+            modbus.setHolding(base, MB_RULE_NONE);
+            for (int r = 1; r < MB_HOLD_RULE_SIZE; r++)
+                modbus.setHolding(base + r, 0);
+            continue;
+        }
+        const AlertRule &rule = alerts.rule(i);
+        modbus.setHolding(base, (rule.metric == ALERT_HUMIDITY ? MB_RULE_RH : 0) | (rule.rate ? MB_RULE_RATE : 0) |
+                                    (rule.above ? MB_RULE_ABOVE : 0));
+        modbus.setHolding(base + 1, clampCenti(rule.threshold, INT16_MIN, INT16_MAX));
+        modbus.setHolding(base + 2, clampCenti(rule.band, 0, UINT16_MAX));
+        modbus.setHolding32(base + 3, rule.minDurationSec);
+    }
+}
+
+static bool overlaps(uint16_t first, uint16_t count, uint16_t address, uint16_t size)
+{
+    return address < first + count && first < address + size;
+}
+
+// Any of [address, address + size) written with a new value.
+bool ModbusRegisterMap::changed(const uint16_t *holding, uint16_t first, uint16_t count, uint16_t address,
+                                uint16_t size) const
+{
+    for (uint16_t a = address; a < address + size; a++)
+        if (overlaps(first, count, a, 1) && holding[a] != slave->holding(a))
+            return true;
+    return false;
+}
+
+ModbusException ModbusRegisterMap::onWrite(const uint16_t *holding, uint16_t first, uint16_t count)
+{
+    return modbusRegisters.write(holding, first, count);
+}
+
+ModbusException ModbusRegisterMap::write(const uint16_t *holding, uint16_t first, uint16_t count)
+{
+    if (!slave || !apply)
+        return MODBUS_DEVICE_FAILURE;
+    for (uint16_t a = first; a < first + count; a++)
+        if (a >= MB_HOLD_SETTINGS + MODBUS_SETTING_COUNT && a < MB_HOLD_RULES)
+            return MODBUS_ILLEGAL_ADDRESS;
+
+    char value[SCHEDULER_CRON_MAX > sizeof(alert_rules) ? SCHEDULER_CRON_MAX : sizeof(alert_rules)];
+    char error[96] = "";
+    const char *key = nullptr;
+    bool saved = false;
+    ModbusException result = MODBUS_OK;
+
+    for (uint16_t i = 0; i < MODBUS_SETTING_COUNT && result == MODBUS_OK; i++)
+    {
+        if (!changed(holding, first, count, MB_HOLD_SETTINGS + i, 1))
+            continue;
+        key = MODBUS_SETTINGS[i];
+        snprintf(value, sizeof(value), "%u", (unsigned)holding[MB_HOLD_SETTINGS + i]);
+        if (apply(*configStore.find(key), value, error, sizeof(error)))
+            saved = true;
+        else
+            result = MODBUS_ILLEGAL_VALUE;
+    }
+
+    if (result == MODBUS_OK && changed(holding, first, count, MB_HOLD_REPORT_MINUTE, 3))
+    {
+        key = "report_cron";
+        uint32_t hours = (uint32_t)holding[MB_HOLD_REPORT_HOURS] << 16 | holding[MB_HOLD_REPORT_HOURS + 1];
+        uint16_t minute = holding[MB_HOLD_REPORT_MINUTE];
+        if (minute > 59 || hours == 0 || hours > 0xFFFFFF)
+        {
+            snprintf(error, sizeof(error), "Report minute 0-59 and hours 1 to 0xFFFFFF");
+            result = MODBUS_ILLEGAL_VALUE;
+        }
+        else
+        {
+            formatReportCron(value, sizeof(value), minute, hours);
+            if (apply(*configStore.find(key), value, error, sizeof(error)))
+                saved = true;
+            else
+                result = MODBUS_ILLEGAL_VALUE;
+        }
+    }
+
+    if (result == MODBUS_OK && changed(holding, first, count, MB_HOLD_RULES, ALERT_MAX_RULES * MB_HOLD_RULE_SIZE))
+    {
+        key = "alert_rules";
+        size_t len = 0;
+        for (int i = 0; i < ALERT_MAX_RULES && result == MODBUS_OK; i++)
+        {
+            const uint16_t *r = holding + MB_HOLD_RULES + i * MB_HOLD_RULE_SIZE;
+            if (r[0] == MB_RULE_NONE)
+                continue;
+            if (r[0] & ~(MB_RULE_RH | MB_RULE_RATE | MB_RULE_ABOVE))
+            {
+                snprintf(error, sizeof(error), "Bad kind 0x%04X for rule %d", (unsigned)r[0], i + 1);
+                result = MODBUS_ILLEGAL_VALUE;
+                break;
+            }
+            len += snprintf(value + len, sizeof(value) - len, "%s%s%s%c%g", len ? "," : "",
+                            r[0] & MB_RULE_RATE ? "d" : "", r[0] & MB_RULE_RH ? "rh" : "temp",
+                            r[0] & MB_RULE_ABOVE ? '>' : '<', (int16_t)r[1] / 100.0);
+            if (r[2] && len < sizeof(value))
+                len += snprintf(value + len, sizeof(value) - len, "~%g", r[2] / 100.0);
+            uint32_t seconds = (uint32_t)r[3] << 16 | r[4];
+            if (seconds && len < sizeof(value))
+                len += snprintf(value + len, sizeof(value) - len, "@%lus", (unsigned long)seconds);
+            if (len >= sizeof(value))
+            {
+                snprintf(error, sizeof(error), "Alert rules longer than %u characters", (unsigned)sizeof(alert_rules) - 1);
+                result = MODBUS_ILLEGAL_VALUE;
+            }
+        }
+        if (result == MODBUS_OK)
+        {
+            value[len] = '\0';
+            if (apply(*configStore.find(key), value, error, sizeof(error)))
+                saved = true;
+            else
+                result = MODBUS_ILLEGAL_VALUE;
+        }
+    }
+
+    if (saved && save)
+        save(); // No 'cfg save' over Modbus
+    if (result != MODBUS_OK)
+        logger.error("ERROR: Modbus write to %s refused: %s.", key, error);
+    else if (saved)
+        logger.info("Modbus: registers %u-%u written.", (unsigned)first, (unsigned)(first + count - 1));
+    refresh();
+    return result;
+}
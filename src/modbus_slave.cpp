@@ -0,0 +1,269 @@
+// --- Modbus RTU Slave ---
+#include "modbus_slave.h"
+
+#include <string.h>
+
+ModbusSlave modbus;
+
+enum ModbusFunction : uint8_t
+{
+    FC_READ_HOLDING = 0x03,
+    FC_READ_INPUT = 0x04,
+    FC_WRITE_SINGLE = 0x06,
+    FC_WRITE_MULTIPLE = 0x10,
+};
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+uint16_t ModbusSlave::crc(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    while (length--)
+    {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+    }
+    return crc;
+}
+
+uint32_t ModbusSlave::frameGapUs(long baud)
+{
+    if (baud > 19200)
+        return 1750;
+    // 3.5 characters of 11 bits (start, 8 data, parity or a second stop, stop).
+    return (uint32_t)((38500000L + baud - 1) / baud);
+}
+
+void ModbusSlave::begin(hal::SerialPort &port, long idleBaud)
+{
+    this->port = &port;
+    this->idleBaud = idleBaud;
+}
+
+bool ModbusSlave::start(uint8_t unit, long baud, WriteHandler onWrite)
+{
+    if (!port || unit == MODBUS_BROADCAST || unit > MODBUS_MAX_UNIT || baud < MODBUS_MIN_BAUD ||
+        baud > MODBUS_MAX_BAUD)
+        return false;
+    if (baud != lineBaud || !running)
+        port->begin(baud);
+    // Each byte reaches available() as it arrives, so the gaps are timed
+    // from the line rather than from FIFO batches.
+    port->setRxLowLatency(true);
+    unitId = unit;
+    lineBaud = baud;
+    this->onWrite = onWrite;
+    gapUs = frameGapUs(baud);
+    length = 0;
+    running = true;
+    return true;
+}
+
+void ModbusSlave::stop()
+{
+    if (!running)
+        return;
+    running = false;
+    lineBaud = 0;
+    port->setRxLowLatency(false);
+    port->begin(idleBaud);
+}
+
+void ModbusSlave::poll()
+{
+    if (!running)
+        return;
+
+    uint32_t now = hal::clock().micros();
+    bool received = false;
+    while (port->available() > 0)
+    {
+        int c = port->read();
+        if (c < 0)
+            break;
+        if (length < MODBUS_FRAME_MAX)
+            frame[length] = (uint8_t)c;
+        if (length <= MODBUS_FRAME_MAX)
+            length++;
+        received = true;
+    }
+    if (received)
+    {
+        lastByteUs = now;
+        return;
+    }
+    if (length == 0 || now - lastByteUs < gapUs)
+        return;
+
+    // t3.5 of silence: the frame is complete.
+    size_t size = length;
+    length = 0;
+    if (size > MODBUS_FRAME_MAX)
+    {
+        counters.overruns++;
+        return;
+    }
+    uint8_t response[MODBUS_FRAME_MAX];
+    size_t reply = handle(frame, size, response);
+    if (!reply)
+        return;
+    if (port->availableForWrite() < (int)reply)
+    {
+        counters.txOverruns++;
+        return;
+    }
+    port->write((const char *)response, reply);
+    counters.responses++;
+    counters.turnaroundUs.record(hal::clock().micros() - lastByteUs);
+}
+
+size_t ModbusSlave::handle(const uint8_t *request, size_t size, uint8_t *response)
+{
+    // The CRC goes low byte first, unlike the registers.
+    if (size < 4 || crc(request, size - 2) != (uint16_t)(request[size - 2] | request[size - 1] << 8))
+    {
+        counters.crcErrors++;
+        return 0;
+    }
+    uint8_t address = request[0];
+    if (address != unitId && address != MODBUS_BROADCAST)
+    {
+        counters.foreign++;
+        return 0;
+    }
+    counters.requests++;
+
+    uint8_t function = request[1];
+    const uint8_t *data = request + 2;
+    size_t dataLength = size - 4;
+    response[0] = unitId;
+    response[1] = function;
+    size_t used = 2;
+    ModbusException result = MODBUS_OK;
+    switch (function)
+    {
+    case FC_READ_HOLDING:
+        result = read(holdings, MODBUS_HOLDING_REGISTERS, data, dataLength, response, used);
+        break;
+    case FC_READ_INPUT:
+        result = read(inputs, MODBUS_INPUT_REGISTERS, data, dataLength, response, used);
+        break;
+    case FC_WRITE_SINGLE:
+        if (dataLength != 4)
+            result = MODBUS_ILLEGAL_VALUE;
+        else
+            result = write(get16(data), 1, data + 2);
+        // The reply echoes the request.
+        if (result == MODBUS_OK)
+            memcpy(response + 2, data, 4);
+        used = 6;
+        break;
+    case FC_WRITE_MULTIPLE:
+    {
+        uint16_t count = dataLength >= 5 ? get16(data + 2) : 0;
+        if (count == 0 || count > MODBUS_MAX_WRITE || data[4] != count * 2 || dataLength != 5u + count * 2)
+            result = MODBUS_ILLEGAL_VALUE;
+        else
+            result = write(get16(data), count, data + 5);
+        if (result == MODBUS_OK)
+            memcpy(response + 2, data, 4); // Start and count
+        used = 6;
+        break;
+    }
+    default:
+        result = MODBUS_ILLEGAL_FUNCTION;
+        break;
+    }
+    if (address == MODBUS_BROADCAST)
+        return 0;
+
+    if (result != MODBUS_OK)
+    {
+        response[1] = (uint8_t)(function | 0x80);
+        response[2] = result;
+        used = 3;
+        counters.exceptions++;
+    }
+    uint16_t check = crc(response, used);
+    response[used++] = (uint8_t)check;
+    response[used++] = (uint8_t)(check >> 8);
+    return used;
+}
+
+// Start and count in 'data'; the registers are copied out as stored.
+ModbusException ModbusSlave::read(const uint8_t *images, uint16_t size, const uint8_t *data, size_t length,
+                                  uint8_t *response, size_t &used)
+{
+    if (length != 4)
+        return MODBUS_ILLEGAL_VALUE;
+    uint16_t first = get16(data);
+    uint16_t count = get16(data + 2);
+    if (count == 0 || count > MODBUS_MAX_READ)
+        return MODBUS_ILLEGAL_VALUE;
+    if ((uint32_t)first + count > size)
+        return MODBUS_ILLEGAL_ADDRESS;
+    response[2] = (uint8_t)(count * 2);
+    memcpy(response + 3, images + first * 2, count * 2);
+    used = 3 + count * 2;
+    return MODBUS_OK;
+}
+
+ModbusException ModbusSlave::write(uint16_t first, uint16_t count, const uint8_t *values)
+{
+    if ((uint32_t)first + count > MODBUS_HOLDING_REGISTERS)
+        return MODBUS_ILLEGAL_ADDRESS;
+    if (!onWrite)
+        return MODBUS_ILLEGAL_FUNCTION;
+    uint16_t proposed[MODBUS_HOLDING_REGISTERS];
+    for (uint16_t i = 0; i < MODBUS_HOLDING_REGISTERS; i++)
+        proposed[i] = get16(holdings + i * 2);
+    for (uint16_t i = 0; i < count; i++)
+        proposed[first + i] = get16(values + i * 2);
+    ModbusException result = onWrite(proposed, first, count);
+    if (result != MODBUS_OK)
+        return result;
+    memcpy(holdings + first * 2, values, count * 2);
+    counters.writes += count;
+    return MODBUS_OK;
+}
+
+// --- Register Images ---
+
+void ModbusSlave::setInput(uint16_t address, uint16_t value)
+{
+    if (address < MODBUS_INPUT_REGISTERS)
+        put16(inputs + address * 2, value);
+}
+
+void ModbusSlave::setInput32(uint16_t address, uint32_t value)
+{
+    setInput(address, (uint16_t)(value >> 16));
+    setInput(address + 1, (uint16_t)value);
+}
+
+void ModbusSlave::setHolding(uint16_t address, uint16_t value)
+{
+    if (address < MODBUS_HOLDING_REGISTERS)
+        put16(holdings + address * 2, value);
+}
+
+void ModbusSlave::setHolding32(uint16_t address, uint32_t value)
+{
+    setHolding(address, (uint16_t)(value >> 16));
+    setHolding(address + 1, (uint16_t)value);
+}
+
+uint16_t ModbusSlave::holding(uint16_t address) const
+{
+    return address < MODBUS_HOLDING_REGISTERS ? get16(holdings + address * 2) : 0;
+}
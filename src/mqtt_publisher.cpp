@@ -0,0 +1,498 @@
+// --- MQTT Telemetry Publisher ---
+#include "mqtt_publisher.h"
+
+#include "logger.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#endif
+
+MqttPublisher mqttPublisher;
+
+// Control packet types (first byte of the fixed header).
+static const uint8_t MQTT_CONNECT = 0x10;
+static const uint8_t MQTT_CONNACK = 0x20;
+static const uint8_t MQTT_PUBLISH = 0x30;
+static const uint8_t MQTT_PUBACK = 0x40;
+static const uint8_t MQTT_PINGREQ = 0xC0;
+static const uint8_t MQTT_PINGRESP = 0xD0;
+
+// Fixed header (type + up to 3 length bytes) goes in front of the body,
+// which is always built at this offset in 'packet'.
+static const size_t BODY = 4;
+
+#ifdef ARDUINO
+
+static const uint32_t MQTT_TASK_STACK = 4096; // Buffers live in the publisher, not on the stack
+
+static uint32_t nowMs()
+{
+    return millis();
+}
+
+static uint32_t nowUs()
+{
+    return micros();
+}
+
+#else
+
+static std::thread worker;
+static std::mutex taskLock;
+static std::condition_variable wake;
+static bool stopping = false;
+
+static uint32_t nowMs()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t nowUs()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
+
+// --- Encoding ---
+
+static uint8_t *putString(uint8_t *p, const char *text)
+{
+    size_t len = strlen(text);
+    *p++ = (uint8_t)(len >> 8);
+    *p++ = (uint8_t)len;
+    memcpy(p, text, len);
+    return p + len;
+}
+
+static char *putInt(char *p, int32_t value)
+{
+    char digits[11];
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    int n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+        *p++ = '-';
+    while (n)
+        *p++ = digits[--n];
+    return p;
+}
+
+// Writes the fixed header in front of a body of 'len' bytes at BODY.
+// Returns where the packet starts.
+static size_t frame(uint8_t *packet, uint8_t type, size_t len)
+{
+    uint8_t header[4];
+    size_t used = 0;
+    header[used++] = type;
+    size_t remaining = len;
+    do
+    {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        header[used++] = remaining ? digit | 0x80 : digit;
+    } while (remaining);
+    size_t start = BODY - used;
+    memcpy(packet + start, header, used);
+    return start;
+}
+
+// --- Task ---
+
+#ifdef ARDUINO
+
+static void mqttTask(void *)
+{
+    profiler.addTask("mqtt");
+    for (;;)
+    {
+        mqttPublisher.step();
+        vTaskDelay(pdMS_TO_TICKS(MQTT_POLL_MS));
+    }
+}
+
+#else
+
+// Wakes every MQTT_POLL_MS of real time, or early when add() makes a
+// batch due.
+static void mqttTask()
+{
+    profiler.addTask("mqtt");
+    std::unique_lock<std::mutex> guard(taskLock);
+    while (!stopping)
+    {
+        guard.unlock();
+        mqttPublisher.step();
+        guard.lock();
+        if (!stopping)
+            wake.wait_for(guard, std::chrono::milliseconds(MQTT_POLL_MS));
+    }
+}
+
+#endif
+
+bool MqttPublisher::begin(const MqttSettings &settings)
+{
+    this->settings = settings;
+    if (!configured())
+        return true; // Off: add() ignores readings and there is no task
+    // "th-" and the topic, e.g. th-sensors-esp32: stable, so the broker
+    // replaces a stale session from the same device.
+    snprintf(clientId, sizeof(clientId), "th-%s", settings.topic);
+    for (char *c = clientId; *c; c++)
+    {
+        if (*c == '/' || *c == '#' || *c == '+')
+            *c = '-';
+    }
+    random = nowMs() | 1;
+    currentState = MQTT_DISCONNECTED;
+#ifdef ARDUINO
+    return xTaskCreate(mqttTask, "mqtt", MQTT_TASK_STACK, nullptr, 1, nullptr) == pdPASS;
+#else
+    stopping = false;
+    worker = std::thread(mqttTask);
+    return true;
+#endif
+}
+
+void MqttPublisher::end()
+{
+#ifndef ARDUINO
+    {
+        std::lock_guard<std::mutex> guard(taskLock);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable())
+        worker.join();
+#endif
+}
+
+void MqttPublisher::add(uint32_t epoch, uint8_t channel, float temperatureC, float humidity)
+{
+    if (!configured())
+        return;
+    Record record;
+    record.epoch = epoch;
+    record.centiC = (int16_t)lroundf(fminf(fmaxf(temperatureC, -300.0f), 300.0f) * 100);
+    record.centiRH = (uint16_t)lroundf(fminf(fmaxf(humidity, 0.0f), 100.0f) * 100);
+    record.channel = channel;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (count == MQTT_BACKLOG_SAMPLES)
+        {
+            // Full: the oldest reading goes.
+            head = (head + 1) % MQTT_BACKLOG_SAMPLES;
+            headSequence++;
+            count--;
+            counters.dropped++;
+        }
+        backlog[(head + count) % MQTT_BACKLOG_SAMPLES] = record;
+        count++;
+        counters.samples++;
+        counters.backlog = count;
+        if (count > counters.maxBacklog)
+            counters.maxBacklog = count;
+    }
+#ifndef ARDUINO
+    // Lets a fast simulation publish on time instead of on the next poll.
+    if (due(false))
+        wake.notify_one();
+#endif
+}
+
+bool MqttPublisher::step(bool force)
+{
+    if (!configured() || !enabled)
+        return false;
+    if (state() == MQTT_BACKOFF)
+    {
+        if ((int32_t)(backoffUntilMs - nowMs()) > 0)
+            return false;
+        currentState = MQTT_DISCONNECTED;
+    }
+    if (state() == MQTT_CONNECTED && !hal::mqttSocket().connected())
+    {
+        logger.info("MQTT: broker closed the connection.");
+        currentState = MQTT_DISCONNECTED;
+    }
+    // Persistent: reconnect right away, not when the next batch is due.
+    if (state() == MQTT_DISCONNECTED && !connect())
+        return false;
+
+    bool sent = false;
+    while (due(force || draining))
+    {
+        if (!publish())
+            return sent;
+        sent = true;
+    }
+    if (state() == MQTT_CONNECTED && nowMs() - lastSentMs >= MQTT_KEEPALIVE_S * 1000UL / 2)
+        ping();
+    return sent;
+}
+
+bool MqttPublisher::due(bool force)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (count == 0)
+        return false;
+    if (force || count >= MQTT_BATCH_MAX)
+        return true;
+    const Record &oldest = backlog[head];
+    const Record &newest = backlog[(head + count - 1) % MQTT_BACKLOG_SAMPLES];
+    return newest.epoch - oldest.epoch >= settings.intervalS;
+}
+
+// --- Session ---
+
+bool MqttPublisher::connect()
+{
+    hal::TcpClient &socket = hal::mqttSocket();
+    if (!socket.connect(settings.host, settings.port, MQTT_TIMEOUT_MS))
+    {
+        logger.error("ERROR: MQTT broker %s:%u unreachable.", settings.host, (unsigned)settings.port);
+        fail(true);
+        return false;
+    }
+
+    uint8_t *p = packet + BODY;
+    p = putString(p, "MQTT");
+    *p++ = 4; // Protocol level 3.1.1
+    uint8_t flags = 0x02; // Clean session
+    if (settings.user[0])
+        flags |= 0x80 | (settings.password[0] ? 0x40 : 0);
+    *p++ = flags;
+    *p++ = (uint8_t)(MQTT_KEEPALIVE_S >> 8);
+    *p++ = (uint8_t)MQTT_KEEPALIVE_S;
+    p = putString(p, clientId);
+    if (flags & 0x80)
+        p = putString(p, settings.user);
+    if (flags & 0x40)
+        p = putString(p, settings.password);
+    size_t len = p - (packet + BODY);
+    size_t start = frame(packet, MQTT_CONNECT, len);
+
+    uint8_t ack[2];
+    if (!sendPacket(start, BODY + len - start) || !readPacket(MQTT_CONNACK, ack, sizeof(ack)))
+    {
+        logger.error("ERROR: MQTT broker did not answer CONNECT.");
+        fail(true);
+        return false;
+    }
+    if (ack[1] != 0)
+    {
+        // 4 bad user name or password, 5 not authorized
+        logger.error("ERROR: MQTT broker refused the connection (code %u).", (unsigned)ack[1]);
+        fail(true);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.connects++;
+    }
+    consecutiveFailures = 0;
+    currentState = MQTT_CONNECTED;
+    logger.info("MQTT: connected to %s:%u as %s.", settings.host, (unsigned)settings.port, clientId);
+    return true;
+}
+
+// Drops the connection and backs off: 5 s, 10 s, 20 s ... up to 5 min,
+// each scaled by a random 75-125%, as for SMTP.
+void MqttPublisher::fail(bool connecting)
+{
+    hal::mqttSocket().close();
+    if (connecting)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.connectFailures++;
+    }
+    uint32_t failures = ++consecutiveFailures;
+    uint32_t delay = MQTT_BACKOFF_MAX_MS;
+    if (failures <= 8 && (MQTT_BACKOFF_BASE_MS << (failures - 1)) < MQTT_BACKOFF_MAX_MS)
+        delay = MQTT_BACKOFF_BASE_MS << (failures - 1);
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    delay = delay / 4 * 3 + random % (delay / 2);
+    backoffUntilMs = nowMs() + delay;
+    currentState = MQTT_BACKOFF;
+    logger.info("MQTT: retrying in %lu s.", (unsigned long)(delay / 1000));
+}
+
+bool MqttPublisher::ping()
+{
+    size_t start = frame(packet, MQTT_PINGREQ, 0);
+    bool ok = sendPacket(start, BODY - start) && readPacket(MQTT_PINGRESP, nullptr, 0);
+    if (!ok)
+    {
+        logger.error("ERROR: MQTT broker did not answer a ping.");
+        fail(false);
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    counters.pings++;
+    return true;
+}
+
+// --- Publishing ---
+
+bool MqttPublisher::publish()
+{
+    size_t n;
+    uint32_t first;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        n = count < MQTT_BATCH_MAX ? count : MQTT_BATCH_MAX;
+        for (size_t i = 0; i < n; i++)
+            batch[i] = backlog[(head + i) % MQTT_BACKLOG_SAMPLES];
+        first = headSequence;
+    }
+
+    uint32_t startUs = nowUs();
+    size_t start;
+    size_t len = encodeBatch(batch, n, first == resendSequence, start);
+    bool ok = sendPacket(start, len);
+    if (ok && settings.qos > 0)
+    {
+        uint8_t ack[2];
+        ok = readPacket(MQTT_PUBACK, ack, sizeof(ack)) && ack[0] == (uint8_t)(packetId >> 8) &&
+             ack[1] == (uint8_t)packetId;
+    }
+    uint32_t elapsedUs = nowUs() - startUs;
+    if (!ok)
+    {
+        logger.error("ERROR: MQTT publish of %u samples failed.", (unsigned)n);
+        resendSequence = first;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            counters.failures++;
+        }
+        fail(false);
+        return false;
+    }
+    resendSequence = UINT32_MAX;
+
+    std::lock_guard<std::mutex> guard(lock);
+    // Retire the batch, or what add() has not already evicted of it.
+    uint32_t end = first + (uint32_t)n;
+    int32_t retire = (int32_t)(end - headSequence);
+    if (retire > 0)
+    {
+        head = (head + retire) % MQTT_BACKLOG_SAMPLES;
+        count -= retire;
+        headSequence = end;
+    }
+    counters.published++;
+    counters.publishedSamples += n;
+    counters.backlog = count;
+    counters.publishUs.record(elapsedUs);
+    return true;
+}
+
+// Builds the PUBLISH for 'count' records. Returns its length and where it
+// starts in 'packet'.
+size_t MqttPublisher::encodeBatch(const Record *records, size_t count, bool dup, size_t &start)
+{
+    uint8_t *p = putString(packet + BODY, settings.topic);
+    uint8_t type = MQTT_PUBLISH | (dup ? 0x08 : 0);
+    if (settings.qos > 0)
+    {
+        if (++packetId == 0)
+            packetId = 1;
+        *p++ = (uint8_t)(packetId >> 8);
+        *p++ = (uint8_t)packetId;
+        type |= 0x02;
+    }
+
+    char *out = (char *)p;
+    memcpy(out, "{\"t0\":", 6);
+    out = putInt(out + 6, (int32_t)records[0].epoch);
+    memcpy(out, ",\"dt\":[", 7);
+    out += 7;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            *out++ = ',';
+        out = putInt(out, (int32_t)(records[i].epoch - records[0].epoch));
+    }
+    memcpy(out, "],\"c\":[", 7);
+    out += 7;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            *out++ = ',';
+        out = putInt(out, records[i].centiC);
+    }
+    memcpy(out, "],\"rh\":[", 8);
+    out += 8;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            *out++ = ',';
+        out = putInt(out, records[i].centiRH);
+    }
+    memcpy(out, "],\"ch\":[", 8);
+    out += 8;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            *out++ = ',';
+        *out++ = (char)('0' + records[i].channel);
+    }
+    memcpy(out, "]}", 2);
+    out += 2;
+
+    size_t len = (uint8_t *)out - (packet + BODY);
+    start = frame(packet, type, len);
+    return BODY + len - start;
+}
+
+bool MqttPublisher::sendPacket(size_t start, size_t len)
+{
+    if (!hal::mqttSocket().write(packet + start, len))
+        return false;
+    lastSentMs = nowMs();
+    std::lock_guard<std::mutex> guard(lock);
+    counters.bytes += len;
+    return true;
+}
+
+// Reads one answer, which must be of 'type' with a 'len'-byte body.
+bool MqttPublisher::readPacket(uint8_t type, uint8_t *body, size_t len)
+{
+    uint8_t header[2];
+    hal::TcpClient &socket = hal::mqttSocket();
+    if (!socket.read(header, sizeof(header), MQTT_TIMEOUT_MS) || header[0] != type || header[1] != len)
+        return false;
+    return len == 0 || socket.read(body, len, MQTT_TIMEOUT_MS);
+}
+
+MqttStats MqttPublisher::stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+const char *MqttPublisher::stateName(MqttState state)
+{
+    static const char *const names[] = {"off", "disconnected", "connected", "backoff"};
+    return names[state];
+}
@@ -0,0 +1,1025 @@
+// --- Native (host) entry point ---
+// Runs setup() and then loop() against the in-memory HAL fakes. With
+// --bench it silences the serial echo and reports per-iteration loop()
+// latency and heap allocation counts instead.
+//
+//   .pio/build/native/program [--bench] [--iterations N] [--step-ms MS] [--input TEXT]
+//                             [--smtp HOST:PORT] [--smtp-delay-ms MS] [--wave DEG_C]
+//                             [--rs232-pty] [--stream HZ[:BAUD]] [--modbus UNIT[:BAUD]]
+//                             [--realtime SECONDS[:SPEEDUP]]
+//                             [--digest HOURS] [--set KEY=VALUE]...
+//                             [--smtp-handshake-ms MS] [--smtp-auth-ms MS]
+//                             [--wifi-ms MS[:FAST_MS]] [--no-ntp] [--no-sensor] [--sensors N]
+//                             [--drift-ppm PPM] [--ntp-outage START_H:HOURS]
+//                             [--smtp-outage START_H:HOURS]
+//                             [--http PORT] [--history-days DAYS]
+//                             [--mqtt HOST:PORT] [--mqtt-bench BATCHES]
+//   .pio/build/native/program --replay-alerts TRACE.csv [--alert-rules RULES] [--filter MEDIAN:EMA]
+//   .pio/build/native/program --format-bench PASSES
+//
+// --smtp sends real (plain) SMTP to a local stand-in server; otherwise mail
+// stays in memory and --smtp-handshake-ms / --smtp-auth-ms / --smtp-delay-ms
+// simulate the TCP + TLS handshake, AUTH and send times.
+// --set stores a setting before boot, e.g. smtp_policy=idle. It is written
+// as a legacy /config.json, so setup() also exercises the one-time migration
+// (straight into the config store in a build without FEATURE_JSON_CONFIG).
+// --wifi-ms simulates the WiFi association time, --no-ntp an unreachable
+// NTP server and --no-sensor a missing SHT31, to see the boot's local
+// stages come up regardless (the boot timing is part of the report).
+// FAST_MS is the association time of a duty-cycle uplink rejoining the
+// last access point (--set duty_s=60), 0 to make that fail; --bench then
+// reports the wakes, their phase timings and the average current.
+// --sensors fits N fake SHT31s (channels 0 to N-1, half a degree apart);
+// --bench then also times one measurement pass over 1 to 4 sensors, in
+// single shots and as periodic-mode fetches, and the sensor filters' cost
+// per reading.
+// --drift-ppm makes the board's oscillator run fast (or slow, if negative)
+// against true time and --ntp-outage takes NTP away for HOURS from
+// START_H, to compare the clock error in holdover with and without the
+// drift correction.
+// --smtp-outage takes the SMTP relay away for HOURS from START_H: reports
+// collect in the outbox meanwhile and are flushed once the relay is back
+// (the run waits for that, as the SMTP backoff keeps real time).
+// --http serves /metrics and /readings on 127.0.0.1:PORT (the board's
+// port 80 is off natively otherwise) and implies --realtime 60 unless given,
+// since the server's timeouts follow the simulated clock;
+// tools/http_load.py load-tests it. --history-days fills the flash log with
+// DAYS of readings first, so /readings has something sizeable to stream.
+// --mqtt publishes readings to a broker on HOST:PORT (a local mosquitto, or
+// tools/mqtt_sink.py); mqtt_qos, mqtt_interval_s etc. go through --set.
+// Stopping the broker part-way shows the backlog filling and draining.
+// --mqtt-bench then publishes BATCHES full batches back-to-back on the
+// same connection and reports throughput and publish latency.
+// --wave makes the fake sensors follow a daily temperature swing.
+// --rs232-pty exposes the RS-232 port as a pseudo-terminal (its path is
+// printed to stderr) and --stream starts binary telemetry on it, so
+// tools/telemetry_decode.py can be pointed at it. --modbus makes it a
+// Modbus RTU slave instead (modbus_addr, modbus_baud) for tools/modbus_poll.py;
+// --bench then also times answering the largest reads and a write in
+// handle(), without the line. --realtime runs loop()
+// against the wall clock for SECONDS instead of simulated steps, optionally
+// SPEEDUP times faster (the mail task keeps real time, so e.g. 20:360 sends
+// a digest every 10 s of wall time for comparing SMTP session policies).
+// --digest switches email to one digest (with CSV attachment) per HOURS.
+// --replay-alerts runs a reading trace (the digest CSV format, e.g. from
+// tools/alert_trace.py) through the alert rules, prints every transition
+// and the cost per sample, and exits. --filter also runs it through the
+// sensor filters (median window and EMA weight, e.g. 5:30) and compares
+// the alerts raised with and without them.
+// --format-bench converts and formats every possible SHT31 reading PASSES
+// times, with float arithmetic and printf's %.2f as the firmware used to and
+// with the fixed-point path (reading_format.h), reports the time per value
+// and per report line for each and where their texts differ, and exits.
+// tools/format_size.py compares what the two cost in flash.
+//
+// Left out of `pio test -e native`, whose test programs (test/) bring
+// their own main().
+#if !defined(ARDUINO) && !defined(PIO_UNIT_TESTING)
+
+#include "acquisition.h"
+#include "alerts.h"
+#include "boot.h"
+#include "config.h"
+#include "console.h"
+#include "digest.h"
+#include "duty_cycle.h"
+#include "feature_flags.h"
+#include "hal_native.h"
+#include "history.h"
+#include "history_log.h"
+#include "http_server.h"
+#include "mail_queue.h"
+#include "modbus_slave.h"
+#include "mqtt_publisher.h"
+#include "outbox.h"
+#include "profiler.h"
+#include "reading_format.h"
+#include "sample_filter.h"
+#include "scheduler.h"
+#include "smtp_manager.h"
+#include "telemetry.h"
+#include "time_service.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+void setup();
+void loop();
+extern Console usbConsole;
+
+// --- Allocation Counting ---
+// Every operator new in the process goes through here, so the benchmark
+// can attribute allocations to loop() iterations.
+static unsigned long allocationCount = 0;
+
+void *operator new(size_t size)
+{
+    allocationCount++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static void printAlert(const AlertEvent &event, void *)
+{
+    char rule[48], when[24];
+    AlertEngine::formatRule(alerts.rule(event.rule), rule, sizeof(rule));
+    time_t t = event.atSec;
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    printf("%s %-7s ch%u %-28s value %7.2f  after %lu min\n", when, event.raised ? "ALERT" : "CLEARED",
+           (unsigned)event.channel, rule, event.value, (unsigned long)(event.atSec - event.sinceSec) / 60);
+}
+
+// The trace's values through the firmware's filters, as the sensor ticks
+// they came from.
+static void filterTrace(std::vector<float> &temperatures, std::vector<float> &humidities,
+                        const std::vector<uint8_t> &channels, const FilterSettings &settings)
+{
+    TickFilter temperatureFilters[SENSOR_CHANNELS], humidityFilters[SENSOR_CHANNELS];
+    for (size_t i = 0; i < temperatures.size(); i++)
+    {
+        float c = (temperatures[i] - 32) * 5 / 9;
+        uint16_t t = (uint16_t)lroundf(std::min(65535.0f, std::max(0.0f, (c + 45) * 65535 / 175)));
+        uint16_t h = (uint16_t)lroundf(std::min(65535.0f, std::max(0.0f, humidities[i] * 65535 / 100)));
+        t = temperatureFilters[channels[i]].apply(t, settings);
+        h = humidityFilters[channels[i]].apply(h, settings);
+        temperatures[i] = (-45 + 175.0f * t / 65535) * 9 / 5 + 32;
+        humidities[i] = 100.0f * h / 65535;
+    }
+}
+
+// Feeds "time_utc,temperature_c,temperature_f,humidity_pct[,channel]" rows
+// through the alert engine. With 'filter' ("MEDIAN:EMA_PERCENT") the trace
+// is also replayed through the sensor filters, and the transitions
+// printed are the filtered ones.
+static int replayAlerts(const char *path, const char *rules, const char *filter)
+{
+    FILE *trace = fopen(path, "r");
+    if (!trace)
+    {
+        perror(path);
+        return 1;
+    }
+    char error[48];
+    if (!alerts.configure(rules, error, sizeof(error)))
+    {
+        fprintf(stderr, "alert rules '%s': %s\n", rules, error);
+        fclose(trace);
+        return 2;
+    }
+    std::vector<uint32_t> times;
+    std::vector<float> temperatures, humidities;
+    std::vector<uint8_t> channels;
+    char line[128];
+    while (fgets(line, sizeof(line), trace))
+    {
+        struct tm utc = {};
+        float c, f, rh;
+        unsigned channel = 0;
+        if (sscanf(line, "%d-%d-%dT%d:%d:%dZ,%f,%f,%f,%u", &utc.tm_year, &utc.tm_mon, &utc.tm_mday,
+                   &utc.tm_hour, &utc.tm_min, &utc.tm_sec, &c, &f, &rh, &channel) < 9 ||
+            channel >= SENSOR_CHANNELS)
+            continue; // Header
+        utc.tm_year -= 1900;
+        utc.tm_mon -= 1;
+        times.push_back((uint32_t)timegm(&utc));
+        temperatures.push_back(f);
+        humidities.push_back(rh);
+        channels.push_back((uint8_t)channel);
+    }
+    fclose(trace);
+
+    for (int i = 0; i < alerts.ruleCount(); i++)
+    {
+        char rule[48];
+        AlertEngine::formatRule(alerts.rule(i), rule, sizeof(rule));
+        printf("rule %d: %s\n", i + 1, rule);
+    }
+    AlertStats raw = {};
+    if (filter)
+    {
+        // Unfiltered first, counted but not printed.
+        for (size_t i = 0; i < times.size(); i++)
+            alerts.update(times[i], channels[i], temperatures[i], humidities[i], [](const AlertEvent &, void *) {},
+                          nullptr);
+        raw = alerts.stats();
+        alerts.configure(rules);
+        unsigned median = 1, ema = 100;
+        sscanf(filter, "%u:%u", &median, &ema);
+        FilterSettings settings = {(uint8_t)median, (uint8_t)ema};
+        filterTrace(temperatures, humidities, channels, settings);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < times.size(); i++)
+        alerts.update(times[i], channels[i], temperatures[i], humidities[i], printAlert, nullptr);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    const AlertStats &counts = alerts.stats();
+    if (filter)
+    {
+        printf("unfiltered: %u samples  %u raised  %u cleared\n", (unsigned)raw.samples, (unsigned)raw.raised,
+               (unsigned)raw.cleared);
+        printf("filtered (median:ema %s): %u samples  %u raised  %u cleared\n", filter,
+               (unsigned)(counts.samples - raw.samples), (unsigned)(counts.raised - raw.raised),
+               (unsigned)(counts.cleared - raw.cleared));
+        return 0;
+    }
+    printf("%u samples  %u raised  %u cleared  %.1f ns per sample (including output)\n",
+           (unsigned)counts.samples, (unsigned)counts.raised, (unsigned)counts.cleared,
+           times.empty() ? 0.0 : ns / times.size());
+    return 0;
+}
+
+// Nanoseconds per call of 'body(ticks)' over all 65536 ticks, 'passes' times.
+template <typename Body> static double timeTicks(uint32_t passes, Body body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t pass = 0; pass < passes; pass++)
+        for (uint32_t ticks = 0; ticks <= 0xFFFF; ticks++)
+            body((uint16_t)ticks);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (passes * 65536.0);
+}
+
+// Hundredths between two "%.2f" texts.
+static long textDifference(const char *a, const char *b)
+{
+    return labs(lround(strtod(a, nullptr) * 100) - lround(strtod(b, nullptr) * 100));
+}
+
+static int formatBench(uint32_t passes)
+{
+    // Where the two paths' texts disagree, for every reading the sensor can
+    // return. The float path's errors come from float precision (six to
+    // seven digits) and printf rounding a binary fraction.
+    struct Check
+    {
+        const char *name;
+        unsigned long mismatches;
+        long maxDifference;
+    } checks[] = {{"temperature_c", 0, 0}, {"temperature_f", 0, 0}, {"humidity_pct", 0, 0}};
+    for (uint32_t ticks = 0; ticks <= 0xFFFF; ticks++)
+    {
+        float c = -45 + 175.0f * ticks / 65535;
+        float values[] = {c, c * 9 / 5 + 32, 100.0f * ticks / 65535};
+        int32_t centi[] = {sht31CentiC((uint16_t)ticks), sht31CentiF((uint16_t)ticks),
+                           sht31CentiRH((uint16_t)ticks)};
+        for (int i = 0; i < 3; i++)
+        {
+            char floatText[24], fixedText[READING_TEXT_MAX];
+            snprintf(floatText, sizeof(floatText), "%.2f", values[i]);
+            formatCenti(fixedText, centi[i]);
+            if (strcmp(floatText, fixedText) != 0)
+            {
+                checks[i].mismatches++;
+                checks[i].maxDifference = std::max(checks[i].maxDifference, textDifference(floatText, fixedText));
+            }
+        }
+    }
+
+    volatile size_t sink = 0;
+    char text[64];
+    double floatValue = timeTicks(passes, [&](uint16_t ticks) {
+        float f = (-45 + 175.0f * ticks / 65535) * 9 / 5 + 32;
+        sink += snprintf(text, sizeof(text), "%.2f", f);
+    });
+    double fixedValue = timeTicks(passes, [&](uint16_t ticks) { sink += formatCenti(text, sht31CentiF(ticks)); });
+    double floatLine = timeTicks(passes, [&](uint16_t ticks) {
+        uint16_t humidity = (uint16_t)(ticks * 40503u); // Any other reading
+        float f = (-45 + 175.0f * ticks / 65535) * 9 / 5 + 32;
+        float rh = 100.0f * humidity / 65535;
+        sink += snprintf(text, sizeof(text), "Temp: %.2f F, Humidity: %.2f %%", f, rh);
+    });
+    double fixedLine = timeTicks(passes, [&](uint16_t ticks) {
+        uint16_t humidity = (uint16_t)(ticks * 40503u);
+        char temperature[READING_TEXT_MAX], rh[READING_TEXT_MAX];
+        formatCenti(temperature, sht31CentiF(ticks));
+        formatCenti(rh, sht31CentiRH(humidity));
+        sink += snprintf(text, sizeof(text), "Temp: %s F, Humidity: %s %%", temperature, rh);
+    });
+    (void)sink;
+
+    printf("%u passes over the 65536 SHT31 readings\n", (unsigned)passes);
+    printf("  %-36s %8.1f ns  %6.2f M/s\n", "value, float + snprintf %.2f", floatValue, 1000 / floatValue);
+    printf("  %-36s %8.1f ns  %6.2f M/s  (%.1fx)\n", "value, fixed-point + formatFixed", fixedValue,
+           1000 / fixedValue, floatValue / fixedValue);
+    printf("  %-36s %8.1f ns  %6.2f M/s\n", "report line, float + snprintf", floatLine, 1000 / floatLine);
+    printf("  %-36s %8.1f ns  %6.2f M/s  (%.1fx)\n", "report line, fixed-point + %s", fixedLine,
+           1000 / fixedLine, floatLine / fixedLine);
+    for (const Check &check : checks)
+        printf("  %-14s %5lu of 65536 texts differ, by at most %ld hundredth%s\n", check.name, check.mismatches,
+               check.maxDifference, check.maxDifference == 1 ? "" : "s");
+    return 0;
+}
+
+// Simulated time of one measurement pass over the first 1 to
+// SENSOR_CHANNELS sensors, in single shots against that many one-sensor
+// passes, and as periodic-mode fetches. Runs on its own SensorAcquisition
+// so the application's is left as it was.
+static void benchAcquisition()
+{
+    hal::native::FakeClock &clock = hal::native::fakeClock();
+    bool fitted[SENSOR_CHANNELS];
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        fitted[channel] = hal::native::fakeSensor(channel).present;
+    double single = 0;
+    double periodic[SENSOR_CHANNELS];
+    printf("acquisition pass (simulated bus time):");
+    for (uint8_t sensors = 1; sensors <= SENSOR_CHANNELS; sensors++)
+    {
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+            hal::native::fakeSensor(channel).present = channel < sensors;
+        SensorAcquisition pass;
+        pass.discover();
+        AcquisitionSettings settings = {0, SENSOR_REPEAT_HIGH, {1, 100}, 0};
+        pass.configure(settings);
+        const int passes = 20;
+        uint64_t start = clock.nowUs;
+        for (int p = 0; p < passes; p++)
+            pass.measure();
+        double ms = (clock.nowUs - start) / 1000.0 / passes;
+        if (sensors == 1)
+            single = ms;
+        printf("  %u: %.1f ms (%u x one: %.1f)", (unsigned)sensors, ms, (unsigned)sensors, sensors * single);
+
+        // One fetch per period, once the first conversion is in.
+        settings.mps = 1;
+        pass.configure(settings);
+        clock.advance(1125);
+        uint64_t busUs = 0;
+        for (int p = 0; p < passes; p++)
+        {
+            uint64_t before = clock.nowUs;
+            pass.measure();
+            busUs += clock.nowUs - before;
+            clock.advance(1125);
+        }
+        periodic[sensors - 1] = busUs / 1000.0 / passes;
+    }
+    printf("\nacquisition fetch (periodic mode):");
+    for (uint8_t sensors = 1; sensors <= SENSOR_CHANNELS; sensors++)
+        printf("  %u: %.1f ms", (unsigned)sensors, periodic[sensors - 1]);
+    printf("\n");
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+        hal::native::fakeSensor(channel).present = fitted[channel];
+}
+
+// Nanoseconds per reading through one filter, for a few settings, over a
+// noisy signal with the odd glitch.
+static void benchFilters()
+{
+    static const FilterSettings SETTINGS[] = {{1, 100}, {5, 100}, {1, 30}, {5, 30}, {9, 10}};
+    const int readings = 2000000;
+    std::vector<uint16_t> ticks(4096);
+    for (size_t i = 0; i < ticks.size(); i++)
+        ticks[i] = (uint16_t)(26000 + (i * 2654435761u >> 26) + (i % 97 == 0 ? 3000 : 0));
+    printf("filter ns per reading:");
+    for (const FilterSettings &settings : SETTINGS)
+    {
+        TickFilter filter;
+        uint32_t sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < readings; i++)
+            sum += filter.apply(ticks[i & 4095], settings);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        asm volatile("" : : "r"(sum));
+        printf("  median %u ema %u%%: %.1f", (unsigned)settings.median, (unsigned)settings.emaPercent, ns / readings);
+    }
+    printf("\n");
+}
+
+static size_t modbusRequest(uint8_t *frame, uint8_t function, uint16_t first, uint16_t count)
+{
+    uint8_t body[] = {1, function, (uint8_t)(first >> 8), (uint8_t)first, (uint8_t)(count >> 8), (uint8_t)count};
+    memcpy(frame, body, sizeof(body));
+    uint16_t crc = ModbusSlave::crc(frame, sizeof(body));
+    frame[6] = (uint8_t)crc;
+    frame[7] = (uint8_t)(crc >> 8);
+    return 8;
+}
+
+static ModbusException acceptWrite(const uint16_t *, uint16_t, uint16_t)
+{
+    return MODBUS_OK;
+}
+
+// Nanoseconds to answer a request in ModbusSlave::handle(): what a poll
+// costs the loop on top of the line time. Runs on its own slave and port.
+static void benchModbus()
+{
+    static const struct
+    {
+        const char *name;
+        uint8_t function;
+        uint16_t first, count; // 0x06: the register and its value
+    } REQUESTS[] = {
+        {"read 1 input", 0x04, 0, 1},
+        {"read 96 inputs", 0x04, 0, MODBUS_INPUT_REGISTERS},
+        {"read 56 holding", 0x03, 0, MODBUS_HOLDING_REGISTERS},
+        {"write 1", 0x06, 3, 24},
+    };
+    hal::native::FakeSerialPort port("modbus-bench");
+    port.echo = false;
+    ModbusSlave slave;
+    slave.begin(port, 9600);
+    slave.start(1, 115200, acceptWrite);
+    const int requests = 200000;
+    uint8_t frame[MODBUS_FRAME_MAX], response[MODBUS_FRAME_MAX];
+    printf("modbus ns per request:");
+    for (const auto &request : REQUESTS)
+    {
+        size_t length = modbusRequest(frame, request.function, request.first, request.count);
+        size_t replied = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < requests; i++)
+            replied += slave.handle(frame, length, response);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        printf("  %s: %.0f (%zu bytes)", request.name, ns / requests, replied / requests);
+    }
+    printf("\n");
+}
+
+typedef std::vector<std::pair<std::string, std::string>> Settings;
+
+static void addSetting(Settings &config, const char *key, const char *value)
+{
+    config.emplace_back(key, value);
+}
+
+int main(int argc, char **argv)
+{
+    bool bench = false;
+    unsigned long iterations = 1000;
+    uint32_t stepMs = 1000;
+    const char *input = nullptr;
+    bool rs232Pty = false;
+    const char *stream = nullptr;
+    Settings config; // Stored before boot (see --set)
+    double realtimeSec = 0;
+    double speedup = 1;
+    const char *replay = nullptr;
+    uint32_t formatPasses = 0;
+    const char *alertRules = "temp>82~1";
+    const char *filter = nullptr;
+    double outageStartH = 0, outageHours = 0;
+    double smtpOutageStartH = 0, smtpOutageHours = 0;
+    const char *httpPort = "0";
+    unsigned long historyDays = 0;
+    unsigned long mqttBatches = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench") == 0)
+            bench = true;
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            iterations = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--step-ms") == 0 && i + 1 < argc)
+            stepMs = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+            input = argv[++i];
+        else if (strcmp(argv[i], "--smtp") == 0 && i + 1 < argc)
+        {
+            char *host = argv[++i];
+            char *colon = strrchr(host, ':');
+            if (colon)
+            {
+                *colon = '\0';
+                hal::native::fakeMail().relayPort = (uint16_t)atoi(colon + 1);
+            }
+            hal::native::fakeMail().relayHost = host;
+        }
+        else if (strcmp(argv[i], "--smtp-delay-ms") == 0 && i + 1 < argc)
+            hal::native::fakeMail().sendDelayMs = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--smtp-handshake-ms") == 0 && i + 1 < argc)
+            hal::native::fakeMail().connectDelayMs = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--smtp-auth-ms") == 0 && i + 1 < argc)
+            hal::native::fakeMail().loginDelayMs = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--wifi-ms") == 0 && i + 1 < argc)
+        {
+            unsigned long wifiMs = 0, fastMs = 0;
+            int fields = sscanf(argv[++i], "%lu:%lu", &wifiMs, &fastMs);
+            hal::native::fakeNetwork().connectDelayMs = wifiMs;
+            hal::native::fakeNetwork().fastConnectDelayMs = fastMs;
+            hal::native::fakeNetwork().fastConnectWorks = fields < 2 || fastMs > 0;
+        }
+        else if (strcmp(argv[i], "--no-ntp") == 0)
+            hal::native::fakeClock().ntpReachable = false;
+        else if (strcmp(argv[i], "--drift-ppm") == 0 && i + 1 < argc)
+            hal::native::fakeClock().driftPpm = strtod(argv[++i], nullptr);
+        else if (strcmp(argv[i], "--ntp-outage") == 0 && i + 1 < argc)
+            sscanf(argv[++i], "%lf:%lf", &outageStartH, &outageHours);
+        else if (strcmp(argv[i], "--smtp-outage") == 0 && i + 1 < argc)
+            sscanf(argv[++i], "%lf:%lf", &smtpOutageStartH, &smtpOutageHours);
+        else if (strcmp(argv[i], "--http") == 0 && i + 1 < argc)
+            httpPort = argv[++i];
+        else if (strcmp(argv[i], "--history-days") == 0 && i + 1 < argc)
+            historyDays = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--mqtt") == 0 && i + 1 < argc)
+        {
+            char *host = argv[++i];
+            char *colon = strrchr(host, ':');
+            if (colon)
+            {
+                *colon = '\0';
+                addSetting(config, "mqtt_port", colon + 1);
+            }
+            addSetting(config, "mqtt_host", host);
+        }
+        else if (strcmp(argv[i], "--mqtt-bench") == 0 && i + 1 < argc)
+            mqttBatches = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--no-sensor") == 0)
+            hal::native::fakeSensor(0).present = false;
+        else if (strcmp(argv[i], "--sensors") == 0 && i + 1 < argc)
+        {
+            unsigned long fitted = strtoul(argv[++i], nullptr, 10);
+            for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+                hal::native::fakeSensor(channel).present = channel < fitted;
+        }
+        else if (strcmp(argv[i], "--wave") == 0 && i + 1 < argc)
+        {
+            float amplitude = strtof(argv[++i], nullptr);
+            for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+                hal::native::fakeSensor(channel).waveAmplitude = amplitude;
+        }
+        else if (strcmp(argv[i], "--rs232-pty") == 0)
+            rs232Pty = true;
+        else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+        {
+            stream = argv[++i];
+            char rate[8] = "", baud[8] = "115200";
+            sscanf(stream, "%7[0-9]:%7[0-9]", rate, baud);
+            addSetting(config, "stream_rate", rate);
+            addSetting(config, "stream_baud", baud);
+        }
+        else if (strcmp(argv[i], "--modbus") == 0 && i + 1 < argc)
+        {
+            char unit[8] = "", baud[8] = "19200";
+            sscanf(argv[++i], "%7[0-9]:%7[0-9]", unit, baud);
+            addSetting(config, "modbus_addr", unit);
+            addSetting(config, "modbus_baud", baud);
+        }
+        else if (strcmp(argv[i], "--digest") == 0 && i + 1 < argc)
+            addSetting(config, "digest_hours", argv[++i]);
+        else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc && strchr(argv[i + 1], '='))
+        {
+            char *key = argv[++i];
+            char *value = strchr(key, '=');
+            *value++ = '\0';
+            addSetting(config, key, value);
+        }
+        else if (strcmp(argv[i], "--realtime") == 0 && i + 1 < argc)
+            sscanf(argv[++i], "%lf:%lf", &realtimeSec, &speedup);
+        else if (strcmp(argv[i], "--replay-alerts") == 0 && i + 1 < argc)
+            replay = argv[++i];
+        else if (strcmp(argv[i], "--alert-rules") == 0 && i + 1 < argc)
+            alertRules = argv[++i];
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--format-bench") == 0 && i + 1 < argc)
+            formatPasses = strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [--bench] [--iterations N] [--step-ms MS] [--input TEXT] "
+                            "[--smtp HOST:PORT] [--smtp-delay-ms MS] [--wave DEG_C] "
+                            "[--rs232-pty] [--stream HZ[:BAUD]] [--modbus UNIT[:BAUD]] [--realtime SECONDS[:SPEEDUP]] [--digest HOURS] "
+                            "[--set KEY=VALUE] [--smtp-handshake-ms MS] [--smtp-auth-ms MS] "
+                            "[--wifi-ms MS[:FAST_MS]] [--no-ntp] [--no-sensor] [--sensors N] [--drift-ppm PPM] [--ntp-outage START_H:HOURS]\n"
+                            "       [--smtp-outage START_H:HOURS] [--http PORT] [--history-days DAYS] [--mqtt HOST:PORT] [--mqtt-bench BATCHES]\n"
+                            "       %s --replay-alerts TRACE.csv [--alert-rules RULES] [--filter MEDIAN:EMA]\n"
+                            "       %s --format-bench PASSES\n",
+                    argv[0], argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (replay)
+        return replayAlerts(replay, alertRules, filter);
+    if (formatPasses)
+        return formatBench(formatPasses);
+
+    hal::native::FakeSerialPort &usb = hal::native::fakeUsbSerial();
+    hal::native::FakeSerialPort &rs232 = hal::native::fakeRs232Serial();
+    hal::native::FakeClock &clock = hal::native::fakeClock();
+    usb.echo = !bench;
+    rs232.echo = false;
+    if (rs232Pty)
+    {
+        const char *path = rs232.openPty();
+        if (!path)
+        {
+            perror("rs232 pty");
+            return 1;
+        }
+        fprintf(stderr, "rs232: %s\n", path);
+    }
+    if (!config.empty())
+    {
+#if FEATURE_JSON_CONFIG
+        // Goes through the saved configuration, like the portal would.
+        std::string json;
+        for (const auto &setting : config)
+            json += (json.empty() ? "{\"" : ",\"") + setting.first + "\":\"" + setting.second + "\"";
+        json += "}";
+        hal::native::fakeStorage().writeFile("/config.json", json.data(), json.size());
+#else
+        // No migration without ArduinoJson: straight into the binary store.
+        hal::storage().begin();
+        configStore.load();
+        for (const auto &setting : config)
+        {
+            const ConfigField *field = configStore.find(setting.first.c_str());
+            if (field)
+                ConfigStore::set(*field, setting.second.c_str());
+            else
+                fprintf(stderr, "--set: unknown setting '%s'\n", setting.first.c_str());
+        }
+        configStore.save();
+#endif
+    }
+
+    setup();
+    // loop() starts the endpoint once WiFi is up (see finishBoot()).
+    snprintf(http_port, sizeof(http_port), "%s", httpPort);
+    if (atol(httpPort) != 0 && realtimeSec == 0)
+        realtimeSec = 60;
+    if (historyDays > 0)
+    {
+        // One reading a minute per sensor up to now, on the same daily
+        // swing as --wave.
+        uint32_t now = (uint32_t)(clock.trueUs() / 1000000);
+        uint32_t records = historyDays * 1440;
+        for (uint32_t r = 0; r < records; r++)
+        {
+            uint32_t epoch = now - (records - r) * 60;
+            float swing = 3.0f * (float)sin(2 * M_PI * (epoch % 86400) / 86400.0);
+            for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+                if (hal::native::fakeSensor(channel).present)
+                    historyLog.append(epoch, channel, 22.0f + channel * 0.5f + swing, 45.0f - 2 * swing);
+        }
+        historyLog.flush();
+    }
+
+    if (input)
+        usb.inject(input);
+    if (stream)
+        rs232.inject("stream on\n");
+
+    std::vector<double> latenciesUs;
+    latenciesUs.reserve(iterations);
+    unsigned long allocationsBefore = allocationCount;
+    unsigned long maxAllocations = 0;
+    int64_t holdoverErrorUs = 0, holdoverRawErrorUs = 0;
+
+    auto realStart = std::chrono::steady_clock::now();
+    uint64_t simStartUs = clock.nowUs;
+    if (realtimeSec > 0)
+        iterations = ~0UL;
+
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        if (realtimeSec > 0)
+        {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - realStart).count();
+            if (elapsed >= realtimeSec)
+            {
+                iterations = i;
+                break;
+            }
+            // Follow the wall clock (never backwards: sensor reads add time too).
+            uint64_t wallUs = simStartUs + (uint64_t)(elapsed * speedup * 1e6);
+            if (wallUs > clock.nowUs)
+                clock.nowUs = wallUs;
+            clock.service();
+        }
+        if (outageHours > 0)
+        {
+            double hours = (clock.nowUs - simStartUs) / 3.6e9;
+            clock.ntpReachable = hours < outageStartH || hours >= outageStartH + outageHours;
+        }
+        if (smtpOutageHours > 0)
+        {
+            double hours = (clock.nowUs - simStartUs) / 3.6e9;
+            hal::native::fakeMail().relayUp = hours < smtpOutageStartH || hours >= smtpOutageStartH + smtpOutageHours;
+        }
+        unsigned long allocsAtStart = allocationCount;
+        auto start = std::chrono::steady_clock::now();
+        loop();
+        auto end = std::chrono::steady_clock::now();
+        maxAllocations = std::max(maxAllocations, allocationCount - allocsAtStart);
+        if (timeService.quality() == TIME_HOLDOVER)
+        {
+            // Clock error against true time, as kept and as it would be without the slews.
+            int64_t errorUs = clock.wallUs() - clock.trueUs();
+            holdoverErrorUs = std::max(holdoverErrorUs, std::abs(errorUs));
+            holdoverRawErrorUs = std::max(holdoverRawErrorUs, std::abs(errorUs - clock.slewedUs));
+        }
+        latenciesUs.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        if (realtimeSec > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        else
+        {
+            clock.advance(stepMs);
+            // Give the boot network task (waiting on simulated time) a
+            // chance to run, so its timings are within one step.
+            if (!boot.networkDone())
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    // Give the mail task the time its backoff needs to flush the outbox,
+    // then let it drain before reporting.
+    if (hal::native::fakeMail().relayUp && outbox.pending() > 0)
+    {
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(smtpManager.backoffRemainingMs() + 2 * MAIL_IDLE_POLL_MS);
+        while (outbox.pending() > 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    mailQueue.end();
+    mqttPublisher.end();
+
+    if (bench && !latenciesUs.empty())
+    {
+        unsigned long loopAllocations = allocationCount - allocationsBefore;
+        std::vector<double> sorted(latenciesUs);
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0;
+        for (double v : sorted)
+            total += v;
+        if (realtimeSec > 0)
+            printf("loop() iterations: %lu (real time, %.1f s)\n", iterations, realtimeSec);
+        else
+            printf("loop() iterations: %lu (simulated %lu ms each)\n", iterations, (unsigned long)stepMs);
+        printf("latency us: min %.2f  mean %.2f  p50 %.2f  p99 %.2f  max %.2f\n",
+               sorted.front(), total / sorted.size(), sorted[sorted.size() / 2],
+               sorted[(sorted.size() * 99) / 100], sorted.back());
+        printf("allocations: total %lu  per iteration %.3f  max in one iteration %lu\n",
+               loopAllocations, (double)loopAllocations / iterations, maxAllocations);
+        for (int p = 0; p < PROF_POINTS; p++)
+        {
+            const Histogram &h = profiler.histogram((ProfilePoint)p);
+            printf("profile %-11s %s: n %u  p50 <=%u  p99 <=%u  max %u  mean %u\n", Profiler::pointName((ProfilePoint)p),
+                   Profiler::unitName((ProfilePoint)p), (unsigned)h.count, (unsigned)h.percentile(50),
+                   (unsigned)h.percentile(99), (unsigned)h.max, (unsigned)h.mean());
+        }
+        // What leaving the profiler on costs: an empty timed scope (the
+        // histograms are printed above, so the extra records do no harm).
+        const int scopes = 1000000;
+        auto sStart = std::chrono::steady_clock::now();
+        for (int n = 0; n < scopes; n++)
+        {
+            ProfileScope scope(PROF_SERIAL);
+            asm volatile("" ::: "memory");
+        }
+        auto sEnd = std::chrono::steady_clock::now();
+        profiler.reset();
+        printf("profile scope cost: %.1f ns\n", std::chrono::duration<double, std::nano>(sEnd - sStart).count() / scopes);
+        printf("serial bytes: usb %lu  rs232 %lu (dropped %lu)\n", usb.bytesWritten, rs232.bytesWritten,
+               rs232.bytesDropped);
+        const TelemetryStats &stream = telemetry.stats();
+        printf("telemetry: %u frames  %u bytes  %u overruns  %u skipped  %u sensor errors\n",
+               (unsigned)stream.frames, (unsigned)stream.bytes, (unsigned)stream.overruns,
+               (unsigned)stream.skipped, (unsigned)stream.sensorErrors);
+        const ModbusStats &bus = modbus.stats();
+        if (bus.requests || bus.crcErrors)
+            printf("modbus: %u requests  %u responses  %u exceptions  %u CRC errors  %u overruns  turnaround us p50 <=%u  p99 <=%u  max %u\n",
+                   (unsigned)bus.requests, (unsigned)bus.responses, (unsigned)bus.exceptions,
+                   (unsigned)bus.crcErrors, (unsigned)(bus.overruns + bus.txOverruns),
+                   (unsigned)bus.turnaroundUs.percentile(50), (unsigned)bus.turnaroundUs.percentile(99),
+                   (unsigned)bus.turnaroundUs.max);
+        unsigned long reads = 0;
+        for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++)
+            reads += hal::native::fakeSensor(channel).reads;
+        printf("sensor reads: %lu (%d sensors)  emails sent: %lu  SMTP connects: %lu\n", reads, acquisition.count(),
+               hal::native::fakeMail().sent, hal::native::fakeMail().connects);
+        const AcquisitionStats &sensor = acquisition.stats();
+        printf("sensor cache: hits %u  passes %u  pass us total %llu  mean %llu  max %u\n",
+               (unsigned)sensor.hits, (unsigned)sensor.misses, (unsigned long long)sensor.totalI2cUs,
+               (unsigned long long)(sensor.misses ? sensor.totalI2cUs / sensor.misses : 0), (unsigned)sensor.maxI2cUs);
+        for (int p = 0; p < BOOT_PHASES; p++)
+        {
+            const BootPhaseTiming &phase = boot.timing((BootPhase)p);
+            if (phase.ran)
+                printf("boot %-13s: %6lu - %6lu ms%s\n", BootSequence::phaseName((BootPhase)p),
+                       (unsigned long)phase.startMs, (unsigned long)phase.endMs, phase.ok ? "" : "  (failed)");
+        }
+        const BootPhaseTiming &first = boot.timing(BOOT_FIRST_READING);
+        printf("boot: first reading at %lu ms  local stages done at %lu ms  network %s\n",
+               first.ran && first.ok ? (unsigned long)first.endMs : 0UL,
+               (unsigned long)boot.timing(BOOT_SERVICES).endMs, boot.networkDone() ? "done" : "still connecting");
+        const DutyStats &duty = dutyCycle.stats();
+        if (duty.wakes)
+        {
+            printf("duty cycle: %u wakes  %u uplinks  %u readings  %u alerts  fast connects %u (%u failed)  %u timeouts  slept %.1f h (%lu fake sleeps)\n",
+                   (unsigned)duty.wakes, (unsigned)duty.uplinks, (unsigned)duty.readings, (unsigned)duty.events,
+                   (unsigned)duty.fastConnects, (unsigned)duty.fastConnectFailures, (unsigned)duty.timeouts,
+                   duty.sleptMs / 3600000.0, hal::native::fakeSystem().sleeps);
+            printf("duty cycle ms per wake:");
+            for (int p = 0; p < DUTY_PHASES; p++)
+                printf("  %s %.1f", DutyCycle::phaseName((DutyPhase)p), (double)duty.phaseMs[p] / duty.wakes);
+            printf("\nduty cycle average current: %lu uA (active %u, radio %u, sleep %u uA)\n",
+                   (unsigned long)dutyCycle.averageMicroAmps(), (unsigned)DUTY_ACTIVE_UA, (unsigned)DUTY_RADIO_UA,
+                   (unsigned)DUTY_SLEEP_UA);
+        }
+        const TimeStats &time = timeService.stats();
+        printf("time: %s  %u syncs (%lu answered)  drift %.2f ppm (actual %.2f)  last offset %ld ms  uncorrected %ld ms  max %ld ms\n",
+               TimeService::qualityName(timeService.quality()), (unsigned)time.syncs, clock.syncs, time.driftPpm,
+               clock.driftPpm, (long)time.lastOffsetMs, (long)time.rawOffsetMs, (long)time.maxOffsetMs);
+        printf("time holdover: %u  longest %lu s  max clock error %.1f ms  (uncorrected %.1f ms)\n",
+               (unsigned)time.holdovers, (unsigned long)time.longestHoldoverS, holdoverErrorUs / 1000.0,
+               holdoverRawErrorUs / 1000.0);
+        if (httpServer.running())
+        {
+            const HttpStats &http = httpServer.stats();
+            printf("http: %u connections (max %u at once)  %u responses  %u not found  %u bad  %u timeouts  %u aborted  %u chunks  %llu bytes\n",
+                   (unsigned)http.accepted, (unsigned)http.maxActive, (unsigned)http.responses,
+                   (unsigned)http.notFound, (unsigned)http.badRequests, (unsigned)http.timeouts,
+                   (unsigned)http.aborted, (unsigned)http.chunks, (unsigned long long)http.bytes);
+            printf("http response ms: n %u  p50 <=%u  p95 <=%u  max %u  mean %u\n", (unsigned)http.responseMs.count,
+                   (unsigned)http.responseMs.percentile(50), (unsigned)http.responseMs.percentile(95),
+                   (unsigned)http.responseMs.max, (unsigned)http.responseMs.mean());
+        }
+        if (mqttPublisher.configured())
+        {
+            MqttStats mqtt = mqttPublisher.stats();
+            printf("mqtt: %s  %u samples  %u batches (%u samples)  %u failed  backlog %u (max %u)  %u dropped  %u connects (%u failed)  %u pings  %llu bytes\n",
+                   MqttPublisher::stateName(mqttPublisher.state()), (unsigned)mqtt.samples, (unsigned)mqtt.published,
+                   (unsigned)mqtt.publishedSamples, (unsigned)mqtt.failures, (unsigned)mqtt.backlog,
+                   (unsigned)mqtt.maxBacklog, (unsigned)mqtt.dropped, (unsigned)mqtt.connects,
+                   (unsigned)mqtt.connectFailures, (unsigned)mqtt.pings, (unsigned long long)mqtt.bytes);
+        }
+        const ConfigStats &loaded = configStore.stats();
+        printf("config: from %s  %u bytes  load %lu us  %u bad slots  %u truncated\n",
+               ConfigStore::sourceName(loaded.source), (unsigned)loaded.bytes, (unsigned long)loaded.loadUs,
+               (unsigned)loaded.badSlots, (unsigned)loaded.truncated);
+        // Reload from the binary store, as every later boot does.
+        const int reloads = 10000;
+        unsigned long configAllocs = allocationCount;
+        auto cStart = std::chrono::steady_clock::now();
+        for (int q = 0; q < reloads; q++)
+            configStore.load();
+        auto cEnd = std::chrono::steady_clock::now();
+        printf("config reload us: %.2f  (%lu allocations, from %s)\n",
+               std::chrono::duration<double, std::micro>(cEnd - cStart).count() / reloads,
+               allocationCount - configAllocs, ConfigStore::sourceName(configStore.stats().source));
+        // Command parsing: tokenise in place and look up, on typical lines.
+        static const char *const lines[] = {"read", "stats", "history 6h",
+                                            "cfg set mail_subject \"Lab 3 sensor\"", "stream off"};
+        const int parses = 100000;
+        size_t found = 0;
+        char line[CONSOLE_LINE_MAX];
+        char *args[CONSOLE_MAX_ARGS];
+        unsigned long parseAllocs = allocationCount;
+        auto pStart = std::chrono::steady_clock::now();
+        for (int q = 0; q < parses; q++)
+        {
+            strcpy(line, lines[q % 5]);
+            if (Console::tokenize(line, args, CONSOLE_MAX_ARGS) > 0 && usbConsole.find(args[0]))
+                found++;
+        }
+        auto pEnd = std::chrono::steady_clock::now();
+        printf("command parse ns: %.1f per line  (%zu/%d found, %lu allocations)\n",
+               std::chrono::duration<double, std::nano>(pEnd - pStart).count() / parses, found, parses,
+               allocationCount - parseAllocs);
+        const ConsoleStats &console = usbConsole.stats();
+        printf("console (usb): %u lines  %u unknown  %u too long  max %u lines per pass\n",
+               (unsigned)console.lines, (unsigned)console.unknown, (unsigned)console.overflows,
+               (unsigned)console.maxBurst);
+        printf("history: %zu samples (ch0), %zu bytes/sample, %zu bytes total for %zu slots per channel\n",
+               history[0].size(), SampleHistory::BYTES_PER_SAMPLE, sizeof(history), SampleHistory::CAPACITY);
+        const int queries = 10000;
+        WindowStats window;
+        int32_t p95 = 0;
+        auto qStart = std::chrono::steady_clock::now();
+        for (int q = 0; q < queries; q++)
+            history[0].window(uptimeSeconds(), 86400, window);
+        auto qMid = std::chrono::steady_clock::now();
+        for (int q = 0; q < queries; q++)
+            history[0].percentile(uptimeSeconds(), 86400, HISTORY_TEMPERATURE, 95, p95);
+        auto qEnd = std::chrono::steady_clock::now();
+        printf("history query us (24 h window): min/max/mean %.3f  p95 %.3f  (%u samples in window)\n",
+               std::chrono::duration<double, std::micro>(qMid - qStart).count() / queries,
+               std::chrono::duration<double, std::micro>(qEnd - qMid).count() / queries,
+               (unsigned)window.count);
+        HistoryLogStats log = historyLog.stats();
+        printf("history log: %u records  %u page writes  %u bytes written  %u segments  %u rotations\n",
+               (unsigned)log.appended, (unsigned)log.flushes, (unsigned)log.bytesWritten,
+               (unsigned)log.segments, (unsigned)log.rotations);
+        uint32_t dayEnd = (uint32_t)hal::clock().now();
+        size_t dayRecords = 0;
+        auto lStart = std::chrono::steady_clock::now();
+        for (int q = 0; q < 100; q++)
+            dayRecords = historyLog.query(dayEnd - 86400, dayEnd, [](const LogRecord &, void *) { return true; }, nullptr);
+        auto lEnd = std::chrono::steady_clock::now();
+        printf("history log query us (last day): %.1f  (%zu records)\n",
+               std::chrono::duration<double, std::micro>(lEnd - lStart).count() / 100, dayRecords);
+        const DigestStats &digests = digest.stats();
+        printf("digests: %u built  %u rows  %u CSV bytes  %u skipped  (last attachment %ld bytes)\n",
+               (unsigned)digests.built, (unsigned)digests.rows, (unsigned)digests.bytes,
+               (unsigned)digests.busy, hal::native::fakeMail().lastAttachmentBytes);
+        SmtpStats smtp = smtpManager.stats();
+        printf("smtp (%s): %u connects  %u failed  %u sends  %u reused  %u idle closes  %u refused in backoff\n",
+               SmtpManager::policyName(smtpManager.policy()), (unsigned)smtp.connects,
+               (unsigned)smtp.connectFailures, (unsigned)smtp.sends, (unsigned)smtp.reused,
+               (unsigned)smtp.idleCloses, (unsigned)smtp.backoffRejects);
+        const Histogram *histograms[] = {&smtp.handshakeMs, &smtp.authMs, &smtp.sendMs};
+        const char *const labels[] = {"handshake", "auth", "send"};
+        for (int h = 0; h < 3; h++)
+            printf("smtp %s ms: n %u  min %u  p50 <=%u  p95 <=%u  max %u  mean %u  total %llu\n", labels[h],
+                   (unsigned)histograms[h]->count, (unsigned)histograms[h]->min,
+                   (unsigned)histograms[h]->percentile(50), (unsigned)histograms[h]->percentile(95),
+                   (unsigned)histograms[h]->max, (unsigned)histograms[h]->mean(),
+                   (unsigned long long)histograms[h]->total);
+        MailQueueStats mail = mailQueue.stats();
+        uint32_t attempts = mail.sent + mail.failed;
+        printf("mail queue: enqueued %u  dropped %u  sent %u  failed %u  max depth %u\n",
+               (unsigned)mail.enqueued, (unsigned)mail.dropped, (unsigned)mail.sent,
+               (unsigned)mail.failed, (unsigned)mail.maxDepth);
+        printf("mail send ms: avg %u  max %u  max queue wait %u\n",
+               (unsigned)(attempts ? mail.totalSendMs / attempts : 0), (unsigned)mail.maxSendMs,
+               (unsigned)mail.maxQueueWaitMs);
+        OutboxStats queued = outbox.stats();
+        printf("outbox: queued %u  flushed %u  evicted %u  damaged %u  max pending %u  left %u\n",
+               (unsigned)queued.queued, (unsigned)queued.flushed, (unsigned)queued.evicted,
+               (unsigned)queued.damaged, (unsigned)queued.maxPending, (unsigned)queued.pending);
+        for (int job = 0; job < scheduler.jobCount(); job++)
+        {
+            const SchedulerJobStats &run = scheduler.stats(job);
+            printf("job %-6s: %u runs  %u skipped  late ms p50 <=%u  p95 <=%u  max %u  longest run %u ms\n",
+                   scheduler.name(job), (unsigned)run.runs, (unsigned)run.skipped,
+                   (unsigned)run.lateMs.percentile(50), (unsigned)run.lateMs.percentile(95),
+                   (unsigned)run.lateMs.max, (unsigned)run.maxRunMs);
+        }
+    }
+
+    if (mqttBatches > 0 && mqttPublisher.configured())
+    {
+        // Full batches back-to-back on the task's connection, timed here
+        // from add() to the batch being sent (QoS 0) or acknowledged (QoS 1).
+        mqttPublisher.setEnabled(true);
+        MqttStats before = mqttPublisher.stats();
+        std::vector<double> publishUs;
+        publishUs.reserve(mqttBatches);
+        uint32_t epoch = (uint32_t)(clock.trueUs() / 1000000);
+        unsigned long batchAllocs = allocationCount;
+        auto bStart = std::chrono::steady_clock::now();
+        for (unsigned long b = 0; b < mqttBatches; b++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int n = 0; n < MQTT_BATCH_MAX; n++, epoch += 60)
+                mqttPublisher.add(epoch, (uint8_t)(n % SENSOR_CHANNELS), 21.5f + (n % 7) * 0.1f, 45.0f + (n % 5) * 0.2f);
+            if (!mqttPublisher.step(true))
+            {
+                fprintf(stderr, "mqtt bench: publish failed (%s) after %lu batches\n",
+                        MqttPublisher::stateName(mqttPublisher.state()), b);
+                break;
+            }
+            publishUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - bStart).count();
+        batchAllocs = allocationCount - batchAllocs;
+        MqttStats after = mqttPublisher.stats();
+        if (!publishUs.empty())
+        {
+            std::sort(publishUs.begin(), publishUs.end());
+            unsigned published = after.published - before.published;
+            printf("mqtt bench (QoS %s): %u batches  %.0f msgs/s  %.0f samples/s  %.1f KiB/s  %.0f bytes/batch  %lu allocations\n",
+                   mqtt_qos, published, published / seconds,
+                   (after.publishedSamples - before.publishedSamples) / seconds,
+                   (after.bytes - before.bytes) / seconds / 1024, (double)(after.bytes - before.bytes) / published,
+                   batchAllocs);
+            printf("mqtt publish us: p50 %.1f  p99 %.1f  max %.1f\n", publishUs[publishUs.size() / 2],
+                   publishUs[publishUs.size() * 99 / 100], publishUs.back());
+        }
+    }
+    if (bench)
+    {
+        benchAcquisition();
+        benchFilters();
+        benchModbus();
+    }
+    return 0;
+}
+
+#endif // !ARDUINO && !PIO_UNIT_TESTING
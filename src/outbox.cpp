@@ -0,0 +1,159 @@
+// --- Persistent Outbox ---
+#include "outbox.h"
+
+#include "crc16.h"
+#include "hal.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+Outbox outbox;
+
+struct OutboxHeader
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t queuedEpoch;
+    uint16_t length;
+    uint16_t crc; // CRC16 of the fields above and the body
+} __attribute__((packed));
+
+static void slotPath(char *buffer, size_t size, uint32_t seq)
+{
+    snprintf(buffer, size, "/outbox_%02u.bin", (unsigned)(seq % OUTBOX_SLOTS));
+}
+
+static uint16_t reportCrc(const OutboxHeader &header, const char *body)
+{
+    return crc16(body, header.length, crc16(&header, offsetof(OutboxHeader, crc)));
+}
+
+// Reads just the header, checking it against the file's size.
+static bool readHeader(const char *path, OutboxHeader &header)
+{
+    hal::Storage &fs = hal::storage();
+    return fs.readFileAt(path, 0, (char *)&header, sizeof(header)) == (long)sizeof(header) &&
+           header.magic == OUTBOX_MAGIC && header.length < MAIL_BODY_SIZE &&
+           fs.fileSize(path) == (long)(sizeof(header) + header.length);
+}
+
+bool Outbox::begin()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    hal::Storage &fs = hal::storage();
+    bool found = false;
+    uint32_t oldest = 0, newest = 0;
+    char path[20];
+    for (uint32_t slot = 0; slot < OUTBOX_SLOTS; slot++)
+    {
+        slotPath(path, sizeof(path), slot);
+        if (!fs.exists(path))
+            continue;
+        OutboxHeader header;
+        if (!readHeader(path, header) || header.seq % OUTBOX_SLOTS != slot)
+        {
+            fs.remove(path); // Torn write, or not one of ours
+            counters.damaged++;
+            continue;
+        }
+        if (!found || (int32_t)(header.seq - oldest) < 0)
+            oldest = header.seq;
+        if (!found || (int32_t)(header.seq - newest) > 0)
+            newest = header.seq;
+        found = true;
+    }
+    readSeq = found ? oldest : 0;
+    writeSeq = found ? newest + 1 : 0;
+    counters.pending = writeSeq - readSeq;
+    counters.maxPending = counters.pending;
+    return true;
+}
+
+bool Outbox::push(uint32_t epoch, const char *body)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    size_t length = strlen(body);
+    if (length >= MAIL_BODY_SIZE)
+        length = MAIL_BODY_SIZE - 1;
+    OutboxHeader header;
+    header.magic = OUTBOX_MAGIC;
+    header.seq = writeSeq;
+    header.queuedEpoch = epoch;
+    header.length = (uint16_t)length;
+    header.crc = reportCrc(header, body);
+
+    // Header and body go out in one write, so the slot is replaced whole.
+    char record[sizeof(OutboxHeader) + MAIL_BODY_SIZE];
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), body, length);
+    char path[20];
+    slotPath(path, sizeof(path), writeSeq);
+    if (!hal::storage().writeFile(path, record, sizeof(header) + length))
+    {
+        counters.writeErrors++;
+        return false;
+    }
+    writeSeq++;
+    if (writeSeq - readSeq > OUTBOX_SLOTS)
+    {
+        readSeq++; // Its slot now holds the new report
+        counters.evicted++;
+    }
+    counters.queued++;
+    counters.pending = writeSeq - readSeq;
+    if (counters.pending > counters.maxPending)
+        counters.maxPending = counters.pending;
+    return true;
+}
+
+bool Outbox::peek(OutboxReport &report)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    hal::Storage &fs = hal::storage();
+    char path[20];
+    while (readSeq != writeSeq)
+    {
+        slotPath(path, sizeof(path), readSeq);
+        OutboxHeader header;
+        if (readHeader(path, header) && header.seq == readSeq &&
+            fs.readFileAt(path, sizeof(header), report.body, header.length) == (long)header.length &&
+            reportCrc(header, report.body) == header.crc)
+        {
+            report.body[header.length] = '\0';
+            report.seq = header.seq;
+            report.queuedEpoch = header.queuedEpoch;
+            return true;
+        }
+        fs.remove(path);
+        counters.damaged++;
+        readSeq++;
+        counters.pending = writeSeq - readSeq;
+    }
+    return false;
+}
+
+void Outbox::pop(uint32_t seq)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (seq != readSeq || readSeq == writeSeq)
+        return;
+    char path[20];
+    slotPath(path, sizeof(path), readSeq);
+    hal::storage().remove(path);
+    readSeq++;
+    counters.flushed++;
+    counters.pending = writeSeq - readSeq;
+}
+
+uint32_t Outbox::pending()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return writeSeq - readSeq;
+}
+
+OutboxStats Outbox::stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
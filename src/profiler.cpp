@@ -0,0 +1,58 @@
+// --- Hot-Path Profiler ---
+#include "profiler.h"
+
+#include "hal.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+Profiler profiler;
+
+void Profiler::begin()
+{
+#ifdef ARDUINO
+    cyclesPerUs = getCpuFrequencyMhz();
+#else
+    cyclesPerUs = 1000;
+#endif
+}
+
+void Profiler::addTask(const char *name)
+{
+    std::lock_guard<std::mutex> guard(taskLock);
+    size_t slot = tasks.load();
+    if (slot == PROFILER_MAX_TASKS)
+        return;
+    taskList[slot].name = name;
+    taskList[slot].handle = hal::system().currentTask();
+    tasks = slot + 1;
+}
+
+void Profiler::reset()
+{
+    for (Histogram &h : histograms)
+        h.clear();
+}
+
+const char *Profiler::pointName(ProfilePoint point)
+{
+    static const char *const names[PROF_POINTS] = {"loop", "serial", "time", "read+print",
+                                                   "read+report", "send email"};
+    return names[point];
+}
+
+const char *Profiler::unitName(ProfilePoint point)
+{
+    return point == PROF_SEND_EMAIL ? "ms" : "us";
+}
+
+uint32_t Profiler::wallMs()
+{
+#ifdef ARDUINO
+    return millis();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
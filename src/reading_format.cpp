@@ -0,0 +1,27 @@
+// --- Fixed-Point Readings ---
+#include "reading_format.h"
+
+size_t formatFixed(char *out, int32_t value, uint8_t decimals)
+{
+    char digits[11];
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    int n = 0;
+    // Least significant first, and at least one digit before the point.
+    do
+    {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude || n <= decimals);
+
+    char *p = out;
+    if (value < 0)
+        *p++ = '-';
+    while (n)
+    {
+        if (n == decimals)
+            *p++ = '.';
+        *p++ = digits[--n];
+    }
+    *p = '\0';
+    return p - out;
+}
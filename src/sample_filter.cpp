@@ -0,0 +1,34 @@
+// --- Sample Filters ---
+#include "sample_filter.h"
+
+uint16_t TickFilter::apply(uint16_t ticks, const FilterSettings &settings)
+{
+    uint8_t size = settings.median < 1 ? 1 : settings.median > FILTER_MEDIAN_MAX ? FILTER_MEDIAN_MAX : settings.median;
+    bool first = used == 0;
+    if (used > size)
+        used = size; // The window was made smaller
+    if (next >= size)
+        next = 0;
+    window[next] = ticks;
+    next = (uint8_t)((next + 1) % size);
+    if (used < size)
+        used++;
+
+    // Insertion sort of at most nine values beats anything cleverer here.
+    uint16_t sorted[FILTER_MEDIAN_MAX];
+    for (uint8_t i = 0; i < used; i++)
+    {
+        uint16_t value = window[i];
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+    }
+    uint32_t median = sorted[used / 2];
+
+    if (first || settings.emaPercent == 0 || settings.emaPercent >= 100)
+        ema = median << 8;
+    else
+        ema = (uint32_t)((int32_t)ema + ((int32_t)(median << 8) - (int32_t)ema) * settings.emaPercent / 100);
+    return (uint16_t)((ema + 128) >> 8);
+}
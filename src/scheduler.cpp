@@ -0,0 +1,363 @@
+// --- Job Scheduler ---
+#include "scheduler.h"
+
+#include "hal.h"
+
+#include <stdint.h>
+
+Scheduler scheduler;
+
+static const time_t EPOCH_2023 = 1672531200; // Earlier: the clock has not been synced yet
+
+// --- Cron Expressions ---
+
+static bool readNumber(const char *&p, unsigned &value)
+{
+    if (*p < '0' || *p > '9')
+        return false;
+    value = 0;
+    while (*p >= '0' && *p <= '9' && value < 100)
+        value = value * 10 + (*p++ - '0');
+    return true;
+}
+
+// Parses one field ("*", "5", "1-5", "*/15", "0,30", "8-18/2") into a bit
+// per allowed value, leaving 'p' at the separator after it.
+static bool parseField(const char *&p, unsigned lo, unsigned hi, uint64_t &bits, bool &star)
+{
+    while (*p == ' ')
+        p++;
+    bits = 0;
+    star = *p == '*';
+    for (;;)
+    {
+        unsigned from, to, step = 1;
+        if (*p == '*')
+        {
+            from = lo;
+            to = hi;
+            p++;
+        }
+        else
+        {
+            if (!readNumber(p, from))
+                return false;
+            to = from;
+            if (*p == '-')
+            {
+                p++;
+                if (!readNumber(p, to))
+                    return false;
+            }
+        }
+        if (*p == '/')
+        {
+            p++;
+            if (!readNumber(p, step) || step == 0)
+                return false;
+            if (to == from)
+                to = hi; // "5/15" means from 5 to the end
+        }
+        if (from < lo || to > hi || from > to)
+            return false;
+        for (unsigned value = from; value <= to; value += step)
+            bits |= 1ULL << value;
+        if (*p != ',')
+            break;
+        p++;
+    }
+    return *p == ' ' || *p == '\0';
+}
+
+bool CronSchedule::parse(const char *text)
+{
+    uint64_t fields[5];
+    bool star[5];
+    static const uint8_t LIMITS[5][2] = {{0, 59}, {0, 23}, {1, 31}, {1, 12}, {0, 7}};
+    const char *p = text;
+    for (int i = 0; i < 5; i++)
+        if (!parseField(p, LIMITS[i][0], LIMITS[i][1], fields[i], star[i]))
+            return false;
+    while (*p == ' ')
+        p++;
+    if (*p)
+        return false;
+
+    minutes = fields[0];
+    hours = (uint32_t)fields[1];
+    days = (uint32_t)fields[2];
+    months = (uint16_t)fields[3];
+    weekdays = (uint8_t)((fields[4] | fields[4] >> 7) & 0x7F); // 7 is Sunday too
+    anyDay = star[2];
+    anyWeekday = star[4];
+    return true;
+}
+
+time_t CronSchedule::next(time_t after) const
+{
+    time_t t = after - after % 60 + 60;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    int lastYear = tm.tm_year + 8;
+
+    // Each step moves to the start of the next month, day or hour that
+    // could match, or settles the minute, so a year takes a few hundred
+    // steps at most.
+    while (tm.tm_year <= lastYear)
+    {
+        bool dayOfMonth = days >> tm.tm_mday & 1;
+        bool dayOfWeek = weekdays >> tm.tm_wday & 1;
+        bool day = anyDay || anyWeekday ? dayOfMonth && dayOfWeek : dayOfMonth || dayOfWeek;
+        if (!(months >> (tm.tm_mon + 1) & 1))
+        {
+            tm.tm_mon++;
+            tm.tm_mday = 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        }
+        else if (!day)
+        {
+            tm.tm_mday++;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        }
+        else if (!(hours >> tm.tm_hour & 1))
+        {
+            tm.tm_hour++;
+            tm.tm_min = 0;
+        }
+        else
+        {
+            int minute = tm.tm_min;
+            while (minute < 60 && !(minutes >> minute & 1))
+                minute++;
+            if (minute < 60)
+            {
+                // Same hour as the normalised 'tm', so its DST flag holds.
+                tm.tm_min = minute;
+                tm.tm_sec = 0;
+                time_t candidate = mktime(&tm);
+                if (candidate > after)
+                    return candidate;
+                // A repeated hour at the end of DST: carry on from the next.
+            }
+            tm.tm_hour++;
+            tm.tm_min = 0;
+        }
+        tm.tm_sec = 0;
+        tm.tm_isdst = -1;
+        t = mktime(&tm);
+        localtime_r(&t, &tm);
+    }
+    return 0;
+}
+
+// --- Timer Wheel ---
+
+int Scheduler::add(const char *name, JobFunction run)
+{
+    if (jobsUsed == SCHEDULER_MAX_JOBS)
+        return -1;
+    Job &job = jobs[jobsUsed];
+    job = {};
+    job.name = name;
+    job.run = run;
+    return jobsUsed++;
+}
+
+void Scheduler::arm(Job &job, uint32_t dueMs)
+{
+    unlink(job);
+    job.dueMs = dueMs;
+    job.armed = true;
+    // Already overdue: file it where the next poll() looks first.
+    uint32_t tick = dueMs / SCHEDULER_TICK_MS;
+    if ((int32_t)(tick - lastTick) < 0)
+        tick = lastTick;
+    Job *&slot = wheel[tick % SCHEDULER_WHEEL_SLOTS];
+    job.next = slot;
+    slot = &job;
+}
+
+void Scheduler::unlink(Job &job)
+{
+    if (!job.armed)
+        return;
+    for (Job *&slot : wheel)
+        for (Job **link = &slot; *link; link = &(*link)->next)
+            if (*link == &job)
+            {
+                *link = job.next;
+                job.next = nullptr;
+                job.armed = false;
+                return;
+            }
+}
+
+void Scheduler::every(int job, uint32_t intervalMs, uint32_t firstInMs)
+{
+    if (!valid(job))
+        return;
+    Job &j = jobs[job];
+    j.isCron = false;
+    j.intervalMs = intervalMs;
+    arm(j, hal::clock().millis() + firstInMs);
+}
+
+bool Scheduler::cron(int job, const char *expression)
+{
+    if (!valid(job))
+        return false;
+    Job &j = jobs[job];
+    CronSchedule schedule;
+    if (!schedule.parse(expression))
+        return false;
+    j.schedule = schedule;
+    j.isCron = true;
+    j.intervalMs = 0;
+    armCron(j);
+    return true;
+}
+
+// Due at the start of the next matching minute. now() is whole seconds, so
+// the job may start up to a second after the minute, but never before it.
+void Scheduler::armCron(Job &job)
+{
+    unlink(job);
+    hal::Clock &clock = hal::clock();
+    time_t now = clock.now();
+    if (now < EPOCH_2023)
+        return; // Until retime(), once the clock is set
+    time_t next = job.schedule.next(now);
+    if (next == 0)
+        return;
+    job.dueEpoch = next;
+    arm(job, clock.millis() + (uint32_t)(next - now) * 1000);
+}
+
+void Scheduler::cancel(int job)
+{
+    if (!valid(job))
+        return;
+    Job &j = jobs[job];
+    unlink(j);
+    j.isCron = false;
+    j.intervalMs = 0;
+}
+
+// An armed cron job keeps its wall-clock target (a resync landing just
+// before it must not push it to the next match); only its millis() due
+// time moves. Unarmed ones were waiting for the clock.
+void Scheduler::retime()
+{
+    hal::Clock &clock = hal::clock();
+    time_t now = clock.now();
+    if (now < EPOCH_2023)
+        return;
+    for (int i = 0; i < jobsUsed; i++)
+    {
+        Job &job = jobs[i];
+        if (!job.isCron)
+            continue;
+        if (!job.armed)
+            armCron(job);
+        else if (job.dueEpoch > now)
+            arm(job, clock.millis() + (uint32_t)(job.dueEpoch - now) * 1000);
+        else
+            arm(job, clock.millis()); // Stepped past it: run now
+    }
+}
+
+void Scheduler::runDue(uint32_t slot, uint32_t nowMs)
+{
+    // Unlink first: a job may re-arm itself (or others) into this slot.
+    // The due times are kept because an earlier job in the batch may re-arm
+    // a later one (e.g. the resync job calling retime()).
+    Job *due[SCHEDULER_MAX_JOBS];
+    uint32_t dueMs[SCHEDULER_MAX_JOBS];
+    int count = 0;
+    for (Job **link = &wheel[slot]; *link;)
+    {
+        Job *job = *link;
+        if ((int32_t)(nowMs - job->dueMs) >= 0)
+        {
+            *link = job->next;
+            job->next = nullptr;
+            job->armed = false;
+            dueMs[count] = job->dueMs;
+            due[count++] = job;
+        }
+        else
+            link = &job->next;
+    }
+
+    hal::Clock &clock = hal::clock();
+    for (int i = 0; i < count; i++)
+    {
+        Job &job = *due[i];
+        if (job.isCron)
+        {
+            // millis() and the wall clock drift apart (the time service
+            // slews the oscillator's drift out of the clock): a cron job
+            // due by millis() but not yet by the clock waits for the rest.
+            time_t now = clock.now();
+            if (now >= EPOCH_2023 && now < job.dueEpoch)
+            {
+                arm(job, clock.millis() + (uint32_t)(job.dueEpoch - now) * 1000);
+                continue;
+            }
+        }
+        uint32_t start = clock.millis();
+        job.counters.lateMs.record(start - dueMs[i]);
+        job.run();
+        uint32_t end = clock.millis();
+        job.counters.runs++;
+        if (end - start > job.counters.maxRunMs)
+            job.counters.maxRunMs = end - start;
+
+        if (job.armed)
+            continue; // The job re-armed itself
+        if (job.isCron)
+            armCron(job);
+        else if (job.intervalMs)
+        {
+            uint32_t next = dueMs[i] + job.intervalMs;
+            while ((int32_t)(end - next) >= 0)
+            {
+                next += job.intervalMs;
+                job.counters.skipped++;
+            }
+            arm(job, next);
+        }
+    }
+}
+
+void Scheduler::poll()
+{
+    uint32_t nowMs = hal::clock().millis();
+    uint32_t tick = nowMs / SCHEDULER_TICK_MS;
+    // The last tick's slot again (jobs may have been armed into it since),
+    // then every tick passed since; after a long gap, each slot once.
+    uint32_t ticks = tick - lastTick;
+    if (ticks >= SCHEDULER_WHEEL_SLOTS)
+        ticks = SCHEDULER_WHEEL_SLOTS - 1;
+    uint32_t first = lastTick;
+    lastTick = tick;
+    for (uint32_t i = 0; i <= ticks; i++)
+        runDue((first + i) % SCHEDULER_WHEEL_SLOTS, nowMs);
+}
+
+uint32_t Scheduler::dueInMs(int job) const
+{
+    if (!armed(job))
+        return UINT32_MAX;
+    const Job &j = jobs[job];
+    int32_t left = (int32_t)(j.dueMs - hal::clock().millis());
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+const SchedulerJobStats &Scheduler::stats(int job) const
+{
+    static const SchedulerJobStats none = {};
+    return valid(job) ? jobs[job].counters : none;
+}
@@ -0,0 +1,228 @@
+// --- SMTP Connection Manager ---
+#include "smtp_manager.h"
+
+#include "logger.h"
+
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+SmtpManager smtpManager;
+
+// Wall time on the mail task, like the mail queue's timings.
+static uint32_t nowMs()
+{
+#ifdef ARDUINO
+    return millis();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void SmtpManager::begin(hal::MailTransport &transport, const hal::MailServerConfig &server,
+                        SmtpPolicy policy, uint32_t idleCloseMs)
+{
+    this->transport = &transport;
+    this->server = server;
+    sessionPolicy = policy;
+    this->idleCloseMs = idleCloseMs;
+    random = nowMs() | 1;
+    setState(SMTP_IDLE);
+}
+
+bool SmtpManager::connect()
+{
+    setState(SMTP_CONNECTING);
+    uint32_t start = nowMs();
+    bool ok = transport->connect(server);
+    uint32_t connected = nowMs();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.connects++;
+        if (ok)
+            counters.handshakeMs.record(connected - start);
+    }
+    if (!ok)
+    {
+        logger.error("ERROR: SMTP connect failed. Last Error: %s", transport->errorReason());
+        fail();
+        return false;
+    }
+
+    ok = transport->login();
+    uint32_t loggedIn = nowMs();
+    if (!ok)
+    {
+        logger.error("ERROR: SMTP login failed. Last Error: %s", transport->errorReason());
+        fail();
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.authMs.record(loggedIn - connected);
+        counters.consecutiveFailures = 0;
+    }
+    logger.info("SUCCESS: Connected to SMTP Server (handshake %lu ms, login %lu ms).",
+                (unsigned long)(connected - start), (unsigned long)(loggedIn - connected));
+    lastUseMs = loggedIn;
+    setState(SMTP_READY);
+    return true;
+}
+
+void SmtpManager::close()
+{
+    transport->close();
+    setState(SMTP_IDLE);
+}
+
+// Drops the session and backs off: 5 s, 10 s, 20 s ... up to 15 min, each
+// scaled by a random 75-125% so a fleet does not retry in lockstep.
+void SmtpManager::fail()
+{
+    transport->close();
+    uint32_t failures;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.connectFailures++;
+        failures = ++counters.consecutiveFailures;
+    }
+    uint32_t delay = SMTP_BACKOFF_MAX_MS;
+    if (failures <= 8 && (SMTP_BACKOFF_BASE_MS << (failures - 1)) < SMTP_BACKOFF_MAX_MS)
+        delay = SMTP_BACKOFF_BASE_MS << (failures - 1);
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    delay = delay / 4 * 3 + random % (delay / 2);
+    backoffUntilMs = nowMs() + delay;
+    setState(SMTP_BACKOFF);
+    logger.info("SMTP: retrying in %lu s.", (unsigned long)(delay / 1000));
+}
+
+uint32_t SmtpManager::backoffRemainingMs() const
+{
+    if (state() != SMTP_BACKOFF)
+        return 0;
+    int32_t left = (int32_t)(backoffUntilMs - nowMs());
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+bool SmtpManager::send(const hal::MailMessage &message, bool more)
+{
+    if (!transport || !enabled)
+        return false;
+    if (state() == SMTP_BACKOFF)
+    {
+        uint32_t left = backoffRemainingMs();
+        if (left > 0)
+        {
+            logger.error("ERROR: SMTP is backing off after failures (%lu s left). Email deferred.",
+                         (unsigned long)(left / 1000));
+            std::lock_guard<std::mutex> guard(lock);
+            counters.backoffRejects++;
+            return false;
+        }
+        setState(SMTP_IDLE);
+    }
+
+    bool reused = state() == SMTP_READY && transport->isLoggedIn();
+    if (!reused)
+    {
+        if (state() == SMTP_READY)
+            transport->close(); // The server dropped us since the last send
+        if (!connect())
+            return false;
+    }
+
+    bool closeAfter = sessionPolicy == SMTP_ON_DEMAND && !more;
+    uint32_t start = nowMs();
+    bool ok = transport->send(message, closeAfter);
+    uint32_t elapsed = nowMs() - start;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.sends++;
+        if (reused)
+            counters.reused++;
+        if (ok)
+            counters.sendMs.record(elapsed);
+        else
+            counters.sendFailures++;
+    }
+    lastUseMs = nowMs();
+    if (!ok)
+    {
+        // A failed send leaves the session in an unknown state.
+        logger.error("ERROR: Failed to send email. Last Error: %s", transport->errorReason());
+        close();
+        return false;
+    }
+    if (closeAfter)
+        setState(SMTP_IDLE);
+    return true;
+}
+
+void SmtpManager::poll()
+{
+    if (!transport || !enabled)
+        return;
+    switch (state())
+    {
+    case SMTP_READY:
+        if (sessionPolicy == SMTP_ON_DEMAND)
+            close(); // Held open for a run of sends that ended early
+        else if (sessionPolicy == SMTP_CLOSE_AFTER_IDLE && nowMs() - lastUseMs >= idleCloseMs)
+        {
+            close();
+            std::lock_guard<std::mutex> guard(lock);
+            counters.idleCloses++;
+        }
+        else if (!transport->isLoggedIn())
+            setState(SMTP_IDLE); // Server timed the session out
+        break;
+    case SMTP_BACKOFF:
+        if (backoffRemainingMs() == 0)
+            setState(SMTP_IDLE);
+        break;
+    case SMTP_IDLE:
+        if (sessionPolicy == SMTP_PERSISTENT)
+            connect();
+        break;
+    case SMTP_CONNECTING:
+        break;
+    }
+}
+
+SmtpStats SmtpManager::stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+bool SmtpManager::parsePolicy(const char *text, SmtpPolicy &policy)
+{
+    if (strcmp(text, "persistent") == 0)
+        policy = SMTP_PERSISTENT;
+    else if (strcmp(text, "ondemand") == 0)
+        policy = SMTP_ON_DEMAND;
+    else if (strcmp(text, "idle") == 0)
+        policy = SMTP_CLOSE_AFTER_IDLE;
+    else
+        return false;
+    return true;
+}
+
+const char *SmtpManager::policyName(SmtpPolicy policy)
+{
+    static const char *const names[] = {"persistent", "ondemand", "idle"};
+    return names[policy];
+}
+
+const char *SmtpManager::stateName(SmtpState state)
+{
+    static const char *const names[] = {"idle", "connecting", "ready", "backoff"};
+    return names[state];
+}
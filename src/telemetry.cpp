@@ -0,0 +1,117 @@
+// --- Binary Telemetry Streaming ---
+#include "telemetry.h"
+
+#include "crc16.h"
+
+TelemetryStream telemetry;
+
+// After a stall longer than this many periods, resynchronise instead of
+// bursting out every missed frame.
+static const uint32_t MAX_CATCH_UP_FRAMES = 8;
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+size_t TelemetryStream::encode(uint8_t *out, uint16_t seq, const Sample &sample, uint32_t epoch)
+{
+    out[0] = TELEMETRY_SYNC0;
+    out[1] = TELEMETRY_SYNC1;
+    out[2] = TELEMETRY_TYPE_READING;
+    out[3] = TELEMETRY_FRAME_BYTES - 6;
+    put16(out + 4, seq);
+    put32(out + 6, sample.takenAtMs);
+    put32(out + 10, epoch);
+    put16(out + 14, (uint16_t)sample.centiC);
+    put16(out + 16, (uint16_t)(sample.centiRH | sample.channel << 14));
+    put16(out + 18, crc16(out + 2, TELEMETRY_FRAME_BYTES - 4));
+    return TELEMETRY_FRAME_BYTES;
+}
+
+void TelemetryStream::begin(hal::SerialPort &port, long idleBaud)
+{
+    this->port = &port;
+    this->idleBaud = idleBaud;
+}
+
+bool TelemetryStream::start(uint16_t rateHz, long baud)
+{
+    if (!port || rateHz == 0 || rateHz > TELEMETRY_MAX_RATE_HZ || baud <= 0 || baud > TELEMETRY_MAX_BAUD)
+        return false;
+    // 10 bits per byte on the wire (8N1): refuse rates the baud cannot carry.
+    if ((uint32_t)rateHz * TELEMETRY_FRAME_BYTES * 10 > (uint32_t)baud)
+        return false;
+    if (baud != idleBaud || streaming)
+        port->begin(baud);
+    periodUs = 1000000UL / rateHz;
+    nextDueUs = hal::clock().micros();
+    streaming = true;
+    return true;
+}
+
+void TelemetryStream::stop()
+{
+    if (!streaming)
+        return;
+    streaming = false;
+    port->begin(idleBaud);
+}
+
+void TelemetryStream::poll()
+{
+    if (!streaming)
+        return;
+
+    hal::Clock &clock = hal::clock();
+    uint32_t now = clock.micros();
+    if ((int32_t)(now - nextDueUs) < 0)
+        return;
+
+    uint32_t behind = (now - nextDueUs) / periodUs;
+    if (behind > MAX_CATCH_UP_FRAMES)
+    {
+        counters.skipped += behind;
+        nextDueUs += behind * periodUs;
+    }
+
+    uint32_t maxAgeMs = periodUs / 1000;
+    if (maxAgeMs < TELEMETRY_MIN_SAMPLE_MS)
+        maxAgeMs = TELEMETRY_MIN_SAMPLE_MS;
+    // One sensor per poll(), in turn.
+    for (int i = 0; i < SENSOR_CHANNELS && !acquisition.present(channel); i++)
+        channel = (channel + 1) % SENSOR_CHANNELS;
+    Sample sample;
+    bool haveSample = acquisition.read(channel, sample, maxAgeMs);
+    channel = (channel + 1) % SENSOR_CHANNELS;
+    uint32_t epoch = (uint32_t)clock.now();
+    if (epoch < 1672531200)
+        epoch = 0; // Before 2023: the clock has not been synced yet
+
+    while ((int32_t)(clock.micros() - nextDueUs) >= 0)
+    {
+        nextDueUs += periodUs;
+        if (!haveSample)
+        {
+            counters.sensorErrors++;
+            continue;
+        }
+        uint8_t frame[TELEMETRY_FRAME_BYTES];
+        encode(frame, seq++, sample, epoch);
+        if (port->availableForWrite() < TELEMETRY_FRAME_BYTES)
+        {
+            counters.overruns++;
+            continue;
+        }
+        port->write((const char *)frame, sizeof(frame));
+        counters.frames++;
+        counters.bytes += sizeof(frame);
+    }
+}
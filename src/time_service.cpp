@@ -0,0 +1,159 @@
+// --- Time Service ---
+#include "time_service.h"
+
+#include "hal.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+TimeService timeService;
+
+// Runs on the SNTP task: hand the result over, nothing else.
+void TimeService::onSync(int64_t epochUs)
+{
+    timeService.pendingSeconds = (uint32_t)(epochUs / 1000000);
+    timeService.pendingMicros = (uint32_t)(epochUs % 1000000);
+    timeService.pendingAtMs = hal::clock().millis();
+    timeService.pending = true;
+}
+
+void TimeService::begin(const char *timeZone)
+{
+    hal::Clock &clock = hal::clock();
+    clock.onTimeSync(onSync, TIME_SYNC_INTERVAL_MS);
+    if (!running)
+    {
+        // Before SNTP starts: poll() only looks at these once it has answered.
+        awaiting = true;
+        requestedAtMs = clock.millis();
+    }
+    clock.configTzTime(timeZone, "pool.ntp.org", "time.nist.gov", "time.google.com");
+    running = true;
+}
+
+void TimeService::requestSync()
+{
+    if (!running)
+        return;
+    counters.requests++;
+    if (!awaiting)
+    {
+        awaiting = true;
+        requestedAtMs = hal::clock().millis();
+    }
+    hal::clock().requestSync();
+}
+
+uint64_t TimeService::localMs() const
+{
+    return extendedMs + (uint32_t)(hal::clock().millis() - lastMillis);
+}
+
+TimeEvent TimeService::poll()
+{
+    bool synced = pending; // Before millis(), so pendingAtMs is not later
+    uint32_t millis = hal::clock().millis();
+    extendedMs += (uint32_t)(millis - lastMillis);
+    lastMillis = millis;
+
+    if (synced)
+    {
+        int64_t epochUs = (int64_t)pendingSeconds * 1000000 + pendingMicros;
+        uint64_t atMs = extendedMs - (uint32_t)(millis - pendingAtMs);
+        pending = false;
+        if (awaiting)
+        {
+            counters.answerMs.record(pendingAtMs - requestedAtMs);
+            awaiting = false;
+        }
+        bool first = counters.syncs == 0;
+        if (!first)
+        {
+            // Where the oscillator alone, and the oscillator with the drift
+            // correction, would have put the clock.
+            double elapsedUs = (double)(atMs - syncLocalMs) * 1000;
+            int64_t rawUs = syncEpochUs + (int64_t)elapsedUs;
+            int64_t correctedUs = rawUs - (int64_t)(elapsedUs * counters.driftPpm * 1e-6);
+            counters.rawOffsetMs = (int32_t)((epochUs - rawUs) / 1000);
+            counters.lastOffsetMs = (int32_t)((epochUs - correctedUs) / 1000);
+            if (abs(counters.lastOffsetMs) > counters.maxOffsetMs)
+                counters.maxOffsetMs = abs(counters.lastOffsetMs);
+            float measured = (float)(-(epochUs - rawUs) / elapsedUs * 1e6);
+            if (elapsedUs >= TIME_DRIFT_MIN_INTERVAL_S * 1e6 && fabsf(measured) <= TIME_DRIFT_MAX_PPM)
+            {
+                counters.driftPpm = counters.driftKnown
+                                        ? counters.driftPpm + (measured - counters.driftPpm) * TIME_DRIFT_GAIN
+                                        : measured;
+                counters.driftKnown = true;
+            }
+        }
+        if (inHoldover)
+        {
+            uint32_t heldS = (uint32_t)((atMs - syncLocalMs) / 1000);
+            if (heldS > counters.longestHoldoverS)
+                counters.longestHoldoverS = heldS;
+            inHoldover = false;
+        }
+        syncEpochUs = epochUs;
+        syncLocalMs = atMs;
+        slewedUs = 0;
+        counters.slewedMs = 0;
+        counters.syncs++;
+        return first ? TIME_EVENT_FIRST_SYNC : TIME_EVENT_SYNC;
+    }
+
+    if (!inHoldover && quality() == TIME_HOLDOVER)
+    {
+        inHoldover = true;
+        counters.holdovers++;
+        return TIME_EVENT_HOLDOVER;
+    }
+    return TIME_EVENT_NONE;
+}
+
+void TimeService::correct()
+{
+    if (!counters.driftKnown || counters.syncs == 0)
+        return;
+    // A fast oscillator (positive ppm) has run the clock ahead: pull it back.
+    double elapsedUs = (double)(localMs() - syncLocalMs) * 1000;
+    int64_t targetUs = -(int64_t)(elapsedUs * counters.driftPpm * 1e-6);
+    int64_t deltaUs = targetUs - slewedUs;
+    if (deltaUs > -1000 && deltaUs < 1000)
+        return; // Not worth a slew yet
+    hal::clock().adjust((int32_t)deltaUs);
+    slewedUs += deltaUs;
+    counters.slewedMs = (int32_t)(slewedUs / 1000);
+}
+
+TimeQuality TimeService::quality() const
+{
+    if (counters.syncs == 0)
+        return TIME_UNSYNCED;
+    return secondsSinceSync() > TIME_HOLDOVER_AFTER_S ? TIME_HOLDOVER : TIME_SYNCED;
+}
+
+uint32_t TimeService::secondsSinceSync() const
+{
+    return counters.syncs ? (uint32_t)((localMs() - syncLocalMs) / 1000) : 0;
+}
+
+time_t TimeService::now() const
+{
+    return hal::clock().now();
+}
+
+bool TimeService::localTime(struct tm &info) const
+{
+    if (!valid())
+        return false;
+    time_t t = now();
+    localtime_r(&t, &info);
+    return true;
+}
+
+const char *TimeService::qualityName(TimeQuality quality)
+{
+    static const char *const names[] = {"unsynced", "synced", "holdover"};
+    return names[quality];
+}
@@ -0,0 +1,273 @@
+// --- Config Store Tests ---
+// The binary store against the in-memory LittleFS fake: the TLV round
+// trip, which of the two slots load() picks, what it does with a damaged
+// or foreign blob, and the portal's copy of the settings.
+// Run with: pio test -e native -f test_config
+#include "config.h"
+#include "crc16.h"
+#include "hal_native.h"
+
+#include <string.h>
+#include <unity.h>
+
+static const size_t HEADER_BYTES = 14; // magic, version, fields, length, sequence, crc
+
+static void setValue(const char *key, const char *value)
+{
+    const ConfigField *field = configStore.find(key);
+    if (field)
+        ConfigStore::set(*field, value);
+}
+
+// Clobbers every setting, so a test can tell load() put it back.
+static void scribble()
+{
+    for (size_t i = 0; i < configStore.fieldCount(); i++)
+        ConfigStore::set(configStore.field(i), "x");
+}
+
+static void flipByte(const char *path, size_t offset)
+{
+    char blob[1024];
+    long length = hal::storage().readFile(path, blob, sizeof(blob));
+    TEST_ASSERT_TRUE((long)offset < length);
+    blob[offset] ^= 0x5A;
+    hal::storage().writeFile(path, blob, length);
+}
+
+// A blob as some firmware might have written it: 'payload' is the TLV bytes.
+static void writeBlob(const char *path, uint32_t sequence, const uint8_t *payload, uint16_t length)
+{
+    uint8_t blob[HEADER_BYTES + 256];
+    uint32_t magic = CONFIG_MAGIC;
+    memcpy(blob, &magic, 4);
+    blob[4] = CONFIG_VERSION;
+    blob[5] = 2;
+    memcpy(blob + 6, &length, 2);
+    memcpy(blob + 8, &sequence, 4);
+    memcpy(blob + HEADER_BYTES, payload, length);
+    uint16_t crc = crc16(payload, length, crc16(blob, 12));
+    memcpy(blob + 12, &crc, 2);
+    hal::storage().writeFile(path, (const char *)blob, HEADER_BYTES + length);
+}
+
+// After the first boot's defaults (sequence 1 in A): B holds sequence 2,
+// A sequence 3.
+static void saveTwice()
+{
+    setValue("mail_server", "second.example.com");
+    TEST_ASSERT_TRUE(configStore.save());
+    setValue("mail_server", "third.example.com");
+    TEST_ASSERT_TRUE(configStore.save());
+}
+
+void setUp()
+{
+    hal::storage().format();
+    configStore.load(); // First boot: the defaults, saved as sequence 1 in A
+}
+
+void tearDown() {}
+
+static void test_first_boot_saves_the_defaults()
+{
+    TEST_ASSERT_EQUAL(CONFIG_FROM_DEFAULTS, configStore.stats().source);
+    TEST_ASSERT_TRUE(hal::storage().exists(CONFIG_SLOT_A));
+    TEST_ASSERT_FALSE(hal::storage().exists(CONFIG_SLOT_B));
+    TEST_ASSERT_EQUAL_STRING("19200", modbus_baud);
+
+    scribble();
+    configStore.load();
+    TEST_ASSERT_EQUAL(CONFIG_FROM_BLOB, configStore.stats().source);
+    TEST_ASSERT_EQUAL_UINT32(1, configStore.stats().sequence);
+    TEST_ASSERT_EQUAL_STRING("19200", modbus_baud);
+}
+
+static void test_every_field_round_trips()
+{
+    // Each field filled to its size, with a different byte per field.
+    char expected[64][256];
+    size_t count = configStore.fieldCount();
+    TEST_ASSERT_TRUE(count <= 64);
+    for (size_t i = 0; i < count; i++)
+    {
+        const ConfigField &field = configStore.field(i);
+        memset(expected[i], 'A' + (int)(i % 26), field.size - 1);
+        expected[i][field.size - 1] = '\0';
+        ConfigStore::set(field, expected[i]);
+    }
+    TEST_ASSERT_TRUE(configStore.save());
+    uint16_t bytes = configStore.stats().bytes;
+
+    scribble();
+    configStore.load();
+    TEST_ASSERT_EQUAL(CONFIG_FROM_BLOB, configStore.stats().source);
+    TEST_ASSERT_EQUAL_UINT16(bytes, configStore.stats().bytes);
+    TEST_ASSERT_EQUAL(0, configStore.stats().truncated);
+    for (size_t i = 0; i < count; i++)
+        TEST_ASSERT_EQUAL_STRING(expected[i], configStore.field(i).value);
+}
+
+static void test_saves_alternate_slots()
+{
+    saveTwice();
+    TEST_ASSERT_EQUAL_UINT32(3, configStore.stats().sequence);
+    TEST_ASSERT_TRUE(hal::storage().exists(CONFIG_SLOT_A));
+    TEST_ASSERT_TRUE(hal::storage().exists(CONFIG_SLOT_B));
+}
+
+static void test_newest_slot_wins()
+{
+    saveTwice();
+    scribble();
+    configStore.load();
+    TEST_ASSERT_EQUAL_STRING("third.example.com", mail_server);
+    TEST_ASSERT_EQUAL_UINT32(3, configStore.stats().sequence);
+
+    // One more save goes to B, which is now the newer of the two.
+    setValue("mail_server", "fourth.example.com");
+    TEST_ASSERT_TRUE(configStore.save());
+    scribble();
+    configStore.load();
+    TEST_ASSERT_EQUAL_STRING("fourth.example.com", mail_server);
+    TEST_ASSERT_EQUAL_UINT32(4, configStore.stats().sequence);
+}
+
+// Regression: B was read into the same buffer after A, and when B was
+// damaged A's settings were applied from B's bytes.
+static void test_newest_slot_good_other_damaged()
+{
+    saveTwice();
+    flipByte(CONFIG_SLOT_B, HEADER_BYTES + 3);
+    scribble();
+    configStore.load();
+    TEST_ASSERT_EQUAL(CONFIG_FROM_BLOB, configStore.stats().source);
+    TEST_ASSERT_EQUAL(1, configStore.stats().badSlots);
+    TEST_ASSERT_EQUAL_UINT32(3, configStore.stats().sequence);
+    TEST_ASSERT_EQUAL_STRING("third.example.com", mail_server);
+}
+
+static void test_damaged_newest_falls_back_to_the_other()
+{
+    saveTwice();
+    flipByte(CONFIG_SLOT_A, HEADER_BYTES + 3);
+    scribble();
+    configStore.load();
+    TEST_ASSERT_EQUAL(1, configStore.stats().badSlots);
+    TEST_ASSERT_EQUAL_UINT32(2, configStore.stats().sequence);
+    TEST_ASSERT_EQUAL_STRING("second.example.com", mail_server);
+
+    // The next save must not overwrite the good copy in B.
+    TEST_ASSERT_TRUE(configStore.save());
+    scribble();
+    configStore.load();
+    TEST_ASSERT_EQUAL(0, configStore.stats().badSlots);
+    TEST_ASSERT_EQUAL_STRING("second.example.com", mail_server);
+}
+
+static void test_both_damaged_keeps_the_defaults()
+{
+    saveTwice();
+    flipByte(CONFIG_SLOT_A, 0);
+    flipByte(CONFIG_SLOT_B, HEADER_BYTES);
+    configStore.load();
+    TEST_ASSERT_EQUAL(CONFIG_FROM_DEFAULTS, configStore.stats().source);
+    TEST_ASSERT_EQUAL(2, configStore.stats().badSlots);
+    TEST_ASSERT_EQUAL_STRING("smtp.gmail.com", mail_server);
+}
+
+static void test_sequence_wraps()
+{
+    const uint8_t older[] = {30, 1, '7'};
+    const uint8_t newer[] = {30, 1, '9'};
+    writeBlob(CONFIG_SLOT_A, 0xFFFFFFFFUL, older, sizeof(older));
+    writeBlob(CONFIG_SLOT_B, 0, newer, sizeof(newer));
+    configStore.load();
+    TEST_ASSERT_EQUAL_STRING("9", modbus_addr);
+    TEST_ASSERT_EQUAL_UINT32(0, configStore.stats().sequence);
+}
+
+static void test_unknown_ids_and_long_values()
+{
+    // id 200 is no field; modbus_addr (id 30) holds three characters.
+    const uint8_t payload[] = {200, 3, 'a', 'b', 'c', 30, 5, '1', '2', '3', '4', '5', 31, 4, '9', '6', '0', '0'};
+    writeBlob(CONFIG_SLOT_A, 7, payload, sizeof(payload));
+    configStore.load();
+    TEST_ASSERT_EQUAL(CONFIG_FROM_BLOB, configStore.stats().source);
+    TEST_ASSERT_EQUAL(1, configStore.stats().truncated);
+    TEST_ASSERT_EQUAL_STRING("123", modbus_addr);
+    TEST_ASSERT_EQUAL_STRING("9600", modbus_baud);
+    TEST_ASSERT_EQUAL_STRING("0", heater_rh); // Missing: keeps its default
+}
+
+static void test_truncated_tlv_stops_cleanly()
+{
+    // The last entry claims more bytes than the payload has.
+    const uint8_t payload[] = {31, 4, '9', '6', '0', '0', 30, 9, '1'};
+    writeBlob(CONFIG_SLOT_A, 1, payload, sizeof(payload));
+    configStore.load();
+    TEST_ASSERT_EQUAL_STRING("9600", modbus_baud);
+    TEST_ASSERT_EQUAL_STRING("0", modbus_addr);
+}
+
+// The portal edits a copy; only applyPortal() changes the settings.
+static void test_portal_edits_a_copy()
+{
+    hal::PortalParam params[64];
+    char values[CONFIG_VALUES_MAX];
+    size_t count = configStore.portalParams(params, 64, values, sizeof(values));
+    TEST_ASSERT_EQUAL(configStore.fieldCount(), count);
+    for (size_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_TRUE(params[i].value != configStore.field(i).value);
+        TEST_ASSERT_EQUAL_STRING(configStore.field(i).value, params[i].value);
+    }
+    const ConfigField *baud = configStore.find("modbus_baud");
+    size_t index = baud - &configStore.field(0);
+    strcpy(params[index].value, "38400");
+    TEST_ASSERT_EQUAL_STRING("19200", modbus_baud);
+    ConfigStore::applyPortal(params, count);
+    TEST_ASSERT_EQUAL_STRING("38400", modbus_baud);
+    TEST_ASSERT_EQUAL_STRING("smtp.gmail.com", mail_server);
+}
+
+// A value cfg set would refuse keeps the old one; the rest still apply.
+static void test_portal_refuses_bad_values()
+{
+    hal::PortalParam params[64];
+    char values[CONFIG_VALUES_MAX];
+    size_t count = configStore.portalParams(params, 64, values, sizeof(values));
+    const struct
+    {
+        const char *key;
+        const char *value;
+    } edits[] = {{"modbus_addr", "300"}, {"http_port", "99999"}, {"mail_port", "smtp"}, {"modbus_baud", "9600"}};
+    for (const auto &edit : edits)
+    {
+        size_t index = configStore.find(edit.key) - &configStore.field(0);
+        strcpy(params[index].value, edit.value);
+    }
+    ConfigStore::applyPortal(params, count);
+    TEST_ASSERT_EQUAL_STRING("0", modbus_addr);
+    TEST_ASSERT_EQUAL_STRING("80", http_port);
+    TEST_ASSERT_EQUAL_STRING("587", mail_port);
+    TEST_ASSERT_EQUAL_STRING("9600", modbus_baud);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_boot_saves_the_defaults);
+    RUN_TEST(test_every_field_round_trips);
+    RUN_TEST(test_saves_alternate_slots);
+    RUN_TEST(test_newest_slot_wins);
+    RUN_TEST(test_newest_slot_good_other_damaged);
+    RUN_TEST(test_damaged_newest_falls_back_to_the_other);
+    RUN_TEST(test_both_damaged_keeps_the_defaults);
+    RUN_TEST(test_sequence_wraps);
+    RUN_TEST(test_unknown_ids_and_long_values);
+    RUN_TEST(test_truncated_tlv_stops_cleanly);
+    RUN_TEST(test_portal_edits_a_copy);
+    RUN_TEST(test_portal_refuses_bad_values);
+    return UNITY_END();
+}
@@ -0,0 +1,340 @@
+// --- Modbus RTU Tests ---
+// The slave's framing and replies against a fake serial port and clock:
+// CRC-16/MODBUS, exception replies, the write length checks, t3.5 framing
+// in poll(), and the report schedule's register form.
+// Run with: pio test -e native -f test_modbus
+#include "hal_native.h"
+#include "modbus_registers.h"
+#include "modbus_slave.h"
+
+#include <string.h>
+#include <unity.h>
+
+static hal::native::FakeSerialPort port("modbus-test");
+static ModbusSlave slave;
+static uint8_t response[MODBUS_FRAME_MAX];
+static int writesSeen;
+
+// Refuses any value over 1000, as a setting's range check would.
+static ModbusException checkWrite(const uint16_t *holding, uint16_t first, uint16_t count)
+{
+    writesSeen++;
+    for (uint16_t a = first; a < first + count; a++)
+        if (holding[a] > 1000)
+            return MODBUS_ILLEGAL_VALUE;
+    return MODBUS_OK;
+}
+
+// Appends the CRC, low byte first; returns the frame's length.
+static size_t seal(uint8_t *frame, size_t length)
+{
+    uint16_t crc = ModbusSlave::crc(frame, length);
+    frame[length] = (uint8_t)crc;
+    frame[length + 1] = (uint8_t)(crc >> 8);
+    return length + 2;
+}
+
+static size_t request(uint8_t *frame, uint8_t unit, uint8_t function, uint16_t first, uint16_t count)
+{
+    const uint8_t pdu[] = {unit, function, (uint8_t)(first >> 8), (uint8_t)first, (uint8_t)(count >> 8),
+                           (uint8_t)count};
+    memcpy(frame, pdu, sizeof(pdu));
+    return seal(frame, sizeof(pdu));
+}
+
+static size_t handle(const uint8_t *frame, size_t length)
+{
+    return slave.handle(frame, length, response);
+}
+
+// The reply must be "unit, function | 0x80, code" with a good CRC.
+static void assertException(size_t reply, uint8_t function, ModbusException code)
+{
+    TEST_ASSERT_EQUAL(5, reply);
+    TEST_ASSERT_EQUAL_HEX8(1, response[0]);
+    TEST_ASSERT_EQUAL_HEX8(function | 0x80, response[1]);
+    TEST_ASSERT_EQUAL_HEX8(code, response[2]);
+    TEST_ASSERT_EQUAL_HEX16(ModbusSlave::crc(response, 3), response[3] | response[4] << 8);
+}
+
+void setUp()
+{
+    port.echo = false;
+    port.input.clear();
+    port.inputPos = 0;
+    port.bytesWritten = 0;
+    slave = ModbusSlave();
+    slave.begin(port, 9600);
+    TEST_ASSERT_TRUE(slave.start(1, 19200, checkWrite));
+    writesSeen = 0;
+}
+
+void tearDown() {}
+
+// --- CRC and t3.5 ---
+
+static void test_crc_vectors()
+{
+    // The CRC-16/MODBUS check value.
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, ModbusSlave::crc(check, sizeof(check)));
+    // Read 10 holding registers from unit 1: sent as ... C5 CD.
+    const uint8_t read[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A};
+    TEST_ASSERT_EQUAL_HEX16(0xCDC5, ModbusSlave::crc(read, sizeof(read)));
+    // Write 0x0003 to register 1 of unit 17.
+    const uint8_t write[] = {0x11, 0x06, 0x00, 0x01, 0x00, 0x03};
+    TEST_ASSERT_EQUAL_HEX16(0x9B9A, ModbusSlave::crc(write, sizeof(write)));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, ModbusSlave::crc(read, 0));
+}
+
+static void test_frame_gap()
+{
+    // 3.5 characters of 11 bits, rounded up; fixed above 19200 baud.
+    TEST_ASSERT_EQUAL_UINT32(32084, ModbusSlave::frameGapUs(1200));
+    TEST_ASSERT_EQUAL_UINT32(4011, ModbusSlave::frameGapUs(9600));
+    TEST_ASSERT_EQUAL_UINT32(2006, ModbusSlave::frameGapUs(19200));
+    TEST_ASSERT_EQUAL_UINT32(1750, ModbusSlave::frameGapUs(38400));
+    TEST_ASSERT_EQUAL_UINT32(1750, ModbusSlave::frameGapUs(115200));
+}
+
+static void test_start_refuses_bad_settings()
+{
+    TEST_ASSERT_FALSE(slave.start(0, 19200, checkWrite));
+    TEST_ASSERT_FALSE(slave.start(248, 19200, checkWrite));
+    TEST_ASSERT_FALSE(slave.start(1, 600, checkWrite));
+    TEST_ASSERT_FALSE(slave.start(1, 230400, checkWrite));
+    TEST_ASSERT_TRUE(slave.active());
+    TEST_ASSERT_EQUAL(19200, port.baud);
+    slave.stop();
+    TEST_ASSERT_EQUAL(9600, port.baud);
+}
+
+// --- Reads ---
+
+static void test_read_replies_with_the_image()
+{
+    slave.setHolding(4, 0x1234);
+    slave.setHolding32(5, 0xCAFEBABE);
+    uint8_t frame[8];
+    size_t reply = handle(frame, request(frame, 1, 0x03, 4, 3));
+    const uint8_t expected[] = {0x01, 0x03, 0x06, 0x12, 0x34, 0xCA, 0xFE, 0xBA, 0xBE};
+    TEST_ASSERT_EQUAL(sizeof(expected) + 2, reply);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, response, sizeof(expected));
+    TEST_ASSERT_EQUAL_HEX16(ModbusSlave::crc(response, sizeof(expected)),
+                            response[sizeof(expected)] | response[sizeof(expected) + 1] << 8);
+
+    slave.setInput(MODBUS_INPUT_REGISTERS - 1, 0xBEEF);
+    reply = handle(frame, request(frame, 1, 0x04, MODBUS_INPUT_REGISTERS - 1, 1));
+    TEST_ASSERT_EQUAL(7, reply);
+    TEST_ASSERT_EQUAL_HEX8(0xBE, response[3]);
+    TEST_ASSERT_EQUAL_HEX8(0xEF, response[4]);
+}
+
+static void test_read_exceptions()
+{
+    uint8_t frame[16];
+    assertException(handle(frame, request(frame, 1, 0x03, 0, 0)), 0x03, MODBUS_ILLEGAL_VALUE);
+    assertException(handle(frame, request(frame, 1, 0x04, 0, MODBUS_MAX_READ + 1)), 0x04, MODBUS_ILLEGAL_VALUE);
+    assertException(handle(frame, request(frame, 1, 0x03, MODBUS_HOLDING_REGISTERS - 1, 2)), 0x03,
+                    MODBUS_ILLEGAL_ADDRESS);
+    assertException(handle(frame, request(frame, 1, 0x04, 0xFFFF, 1)), 0x04, MODBUS_ILLEGAL_ADDRESS);
+    assertException(handle(frame, request(frame, 1, 0x07, 0, 1)), 0x07, MODBUS_ILLEGAL_FUNCTION);
+
+    // A read with a byte too many.
+    const uint8_t longer[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00};
+    memcpy(frame, longer, sizeof(longer));
+    assertException(handle(frame, seal(frame, sizeof(longer))), 0x03, MODBUS_ILLEGAL_VALUE);
+    TEST_ASSERT_EQUAL_UINT32(6, slave.stats().exceptions);
+}
+
+static void test_dropped_frames()
+{
+    uint8_t frame[8];
+    size_t length = request(frame, 1, 0x03, 0, 1);
+    frame[length - 1] ^= 0x01;
+    TEST_ASSERT_EQUAL(0, handle(frame, length));
+    TEST_ASSERT_EQUAL(0, handle(frame, 3)); // Too short to hold a CRC
+    TEST_ASSERT_EQUAL_UINT32(2, slave.stats().crcErrors);
+
+    TEST_ASSERT_EQUAL(0, handle(frame, request(frame, 2, 0x03, 0, 1)));
+    TEST_ASSERT_EQUAL_UINT32(1, slave.stats().foreign);
+    TEST_ASSERT_EQUAL_UINT32(0, slave.stats().requests);
+}
+
+// --- Writes ---
+
+static void test_write_single()
+{
+    uint8_t frame[8];
+    size_t length = request(frame, 1, 0x06, 8, 55);
+    TEST_ASSERT_EQUAL(8, handle(frame, length));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, response, 8); // The echo
+    TEST_ASSERT_EQUAL_UINT16(55, slave.holding(8));
+
+    // Refused by the application: exception 3, the image unchanged.
+    assertException(handle(frame, request(frame, 1, 0x06, 8, 5000)), 0x06, MODBUS_ILLEGAL_VALUE);
+    TEST_ASSERT_EQUAL_UINT16(55, slave.holding(8));
+    assertException(handle(frame, request(frame, 1, 0x06, MODBUS_HOLDING_REGISTERS, 1)), 0x06,
+                    MODBUS_ILLEGAL_ADDRESS);
+    TEST_ASSERT_EQUAL(2, writesSeen);
+
+    const uint8_t shorter[] = {0x01, 0x06, 0x00, 0x08, 0x00};
+    memcpy(frame, shorter, sizeof(shorter));
+    assertException(handle(frame, seal(frame, sizeof(shorter))), 0x06, MODBUS_ILLEGAL_VALUE);
+    TEST_ASSERT_EQUAL(2, writesSeen);
+}
+
+static size_t writeMultiple(uint8_t *frame, uint16_t first, uint16_t count, uint8_t byteCount, size_t dataBytes)
+{
+    size_t length = 0;
+    frame[length++] = 1;
+    frame[length++] = 0x10;
+    frame[length++] = (uint8_t)(first >> 8);
+    frame[length++] = (uint8_t)first;
+    frame[length++] = (uint8_t)(count >> 8);
+    frame[length++] = (uint8_t)count;
+    frame[length++] = byteCount;
+    for (size_t i = 0; i < dataBytes; i++)
+        frame[length++] = (uint8_t)(i & 1 ? i : 0); // Registers 0x0001, 0x0003, ...
+    return seal(frame, length);
+}
+
+static void test_write_multiple_lengths()
+{
+    uint8_t frame[MODBUS_FRAME_MAX + 8];
+    TEST_ASSERT_EQUAL(8, handle(frame, writeMultiple(frame, 3, 2, 4, 4)));
+    const uint8_t echo[] = {0x01, 0x10, 0x00, 0x03, 0x00, 0x02};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(echo, response, sizeof(echo));
+    TEST_ASSERT_EQUAL_UINT16(0x0001, slave.holding(3));
+    TEST_ASSERT_EQUAL_UINT16(0x0003, slave.holding(4));
+    TEST_ASSERT_EQUAL(1, writesSeen);
+
+    // Byte count disagreeing with the register count, and with the frame.
+    assertException(handle(frame, writeMultiple(frame, 3, 2, 3, 4)), 0x10, MODBUS_ILLEGAL_VALUE);
+    assertException(handle(frame, writeMultiple(frame, 3, 2, 4, 3)), 0x10, MODBUS_ILLEGAL_VALUE);
+    assertException(handle(frame, writeMultiple(frame, 3, 2, 4, 5)), 0x10, MODBUS_ILLEGAL_VALUE);
+    // No registers, and more than one frame may carry.
+    assertException(handle(frame, writeMultiple(frame, 3, 0, 0, 0)), 0x10, MODBUS_ILLEGAL_VALUE);
+    assertException(handle(frame, writeMultiple(frame, 0, MODBUS_MAX_WRITE + 1, 248, 248)), 0x10,
+                    MODBUS_ILLEGAL_VALUE);
+    // Shorter than its own header.
+    const uint8_t stub[] = {0x01, 0x10, 0x00, 0x03};
+    memcpy(frame, stub, sizeof(stub));
+    assertException(handle(frame, seal(frame, sizeof(stub))), 0x10, MODBUS_ILLEGAL_VALUE);
+    // Past the end of the image.
+    assertException(handle(frame, writeMultiple(frame, MODBUS_HOLDING_REGISTERS - 1, 2, 4, 4)), 0x10,
+                    MODBUS_ILLEGAL_ADDRESS);
+    TEST_ASSERT_EQUAL(1, writesSeen);
+    TEST_ASSERT_EQUAL_UINT16(0x0001, slave.holding(3));
+}
+
+static void test_broadcast_write_has_no_reply()
+{
+    uint8_t frame[8];
+    TEST_ASSERT_EQUAL(0, handle(frame, request(frame, MODBUS_BROADCAST, 0x06, 2, 77)));
+    TEST_ASSERT_EQUAL_UINT16(77, slave.holding(2));
+    // Nor does a refused one.
+    TEST_ASSERT_EQUAL(0, handle(frame, request(frame, MODBUS_BROADCAST, 0x06, 2, 5000)));
+    TEST_ASSERT_EQUAL_UINT16(77, slave.holding(2));
+}
+
+// --- Framing in poll() ---
+
+static void receive(const uint8_t *bytes, size_t length)
+{
+    port.input.append((const char *)bytes, length);
+    slave.poll();
+}
+
+static void test_poll_answers_after_t35()
+{
+    uint32_t gap = ModbusSlave::frameGapUs(19200);
+    uint8_t frame[8];
+    size_t length = request(frame, 1, 0x03, 0, 2);
+    hal::native::FakeClock &clock = hal::native::fakeClock();
+
+    // Half the frame, a pause shorter than t3.5, then the rest: one frame.
+    receive(frame, 3);
+    clock.advanceMicros(gap - 1);
+    slave.poll();
+    receive(frame + 3, length - 3);
+    clock.advanceMicros(gap - 1);
+    slave.poll();
+    TEST_ASSERT_EQUAL(0, port.bytesWritten);
+    clock.advanceMicros(1);
+    slave.poll();
+    TEST_ASSERT_EQUAL(9, port.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT32(1, slave.stats().responses);
+    TEST_ASSERT_EQUAL_UINT32(0, slave.stats().crcErrors);
+
+    // Two frames with no t3.5 between them run together and fail the CRC.
+    receive(frame, length);
+    receive(frame, length);
+    clock.advanceMicros(gap);
+    slave.poll();
+    TEST_ASSERT_EQUAL(9, port.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT32(1, slave.stats().crcErrors);
+}
+
+static void test_poll_drops_an_overlong_frame()
+{
+    uint8_t junk[MODBUS_FRAME_MAX + 1];
+    memset(junk, 0x55, sizeof(junk));
+    receive(junk, sizeof(junk));
+    hal::native::fakeClock().advanceMicros(ModbusSlave::frameGapUs(19200));
+    slave.poll();
+    TEST_ASSERT_EQUAL_UINT32(1, slave.stats().overruns);
+    TEST_ASSERT_EQUAL_UINT32(0, slave.stats().crcErrors);
+
+    // The next frame is read from its first byte.
+    uint8_t frame[8];
+    receive(frame, request(frame, 1, 0x03, 0, 1));
+    hal::native::fakeClock().advanceMicros(ModbusSlave::frameGapUs(19200));
+    slave.poll();
+    TEST_ASSERT_EQUAL_UINT32(1, slave.stats().responses);
+}
+
+// --- Register Map ---
+
+static void test_report_schedule_registers()
+{
+    uint16_t minute;
+    uint32_t hours;
+    TEST_ASSERT_TRUE(ModbusRegisterMap::reportHours("0 9,13,16 * * *", minute, hours));
+    TEST_ASSERT_EQUAL_UINT16(0, minute);
+    TEST_ASSERT_EQUAL_UINT32(1UL << 9 | 1UL << 13 | 1UL << 16, hours);
+    TEST_ASSERT_TRUE(ModbusRegisterMap::reportHours("45 * * * *", minute, hours));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFF, hours);
+    TEST_ASSERT_FALSE(ModbusRegisterMap::reportHours("0 9 * * 1", minute, hours));
+    TEST_ASSERT_FALSE(ModbusRegisterMap::reportHours("*/5 * * * *", minute, hours));
+    TEST_ASSERT_FALSE(ModbusRegisterMap::reportHours("0 24 * * *", minute, hours));
+
+    char cron[SCHEDULER_CRON_MAX];
+    ModbusRegisterMap::formatReportCron(cron, sizeof(cron), 30, 0xF00UL | 1UL << 14 | 1UL << 20 | 1UL << 21);
+    TEST_ASSERT_EQUAL_STRING("30 8-11,14,20,21 * * *", cron);
+    ModbusRegisterMap::formatReportCron(cron, sizeof(cron), 5, 0xFFFFFF);
+    TEST_ASSERT_EQUAL_STRING("5 * * * *", cron);
+    // Every other hour: the longest form, and it still fits.
+    ModbusRegisterMap::formatReportCron(cron, sizeof(cron), 59, 0x555555);
+    TEST_ASSERT_EQUAL_STRING("59 0,2,4,6,8,10,12,14,16,18,20,22 * * *", cron);
+    TEST_ASSERT_TRUE(ModbusRegisterMap::reportHours(cron, minute, hours));
+    TEST_ASSERT_EQUAL_UINT32(0x555555, hours);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc_vectors);
+    RUN_TEST(test_frame_gap);
+    RUN_TEST(test_start_refuses_bad_settings);
+    RUN_TEST(test_read_replies_with_the_image);
+    RUN_TEST(test_read_exceptions);
+    RUN_TEST(test_dropped_frames);
+    RUN_TEST(test_write_single);
+    RUN_TEST(test_write_multiple_lengths);
+    RUN_TEST(test_broadcast_write_has_no_reply);
+    RUN_TEST(test_poll_answers_after_t35);
+    RUN_TEST(test_poll_drops_an_overlong_frame);
+    RUN_TEST(test_report_schedule_registers);
+    return UNITY_END();
+}
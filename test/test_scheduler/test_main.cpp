@@ -0,0 +1,65 @@
+// --- Scheduler Tests ---
+// The job table's limits against the fake clock: a full table refuses
+// further jobs, and the calls that take a job id ignore one add() did not
+// return. Run with: pio test -e native -f test_scheduler
+#include "hal_native.h"
+#include "scheduler.h"
+
+#include <stdint.h>
+#include <unity.h>
+
+static int runs;
+
+static void count()
+{
+    runs++;
+}
+
+void setUp()
+{
+    runs = 0;
+}
+
+void tearDown() {}
+
+static void test_full_table_refuses_a_job()
+{
+    Scheduler table;
+    for (int i = 0; i < SCHEDULER_MAX_JOBS; i++)
+        TEST_ASSERT_EQUAL(i, table.add("job", count));
+    TEST_ASSERT_EQUAL(-1, table.add("one too many", count));
+    TEST_ASSERT_EQUAL(SCHEDULER_MAX_JOBS, table.jobCount());
+}
+
+static void test_invalid_ids_are_ignored()
+{
+    Scheduler table;
+    int job = table.add("job", count);
+    table.every(job, 1000, 1000);
+    for (int bad : {-1, 1, SCHEDULER_MAX_JOBS})
+    {
+        table.every(bad, 10, 0);
+        TEST_ASSERT_FALSE(table.cron(bad, "* * * * *"));
+        table.cancel(bad);
+        TEST_ASSERT_FALSE(table.armed(bad));
+        TEST_ASSERT_FALSE(table.isCron(bad));
+        TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, table.dueInMs(bad));
+        TEST_ASSERT_EQUAL_UINT32(0, table.stats(bad).runs);
+        TEST_ASSERT_EQUAL_STRING("?", table.name(bad));
+    }
+    // The real job is untouched.
+    TEST_ASSERT_TRUE(table.armed(job));
+    TEST_ASSERT_EQUAL_UINT32(1000, table.dueInMs(job));
+    hal::native::fakeClock().advance(1000);
+    table.poll();
+    TEST_ASSERT_EQUAL(1, runs);
+    TEST_ASSERT_EQUAL_UINT32(1, table.stats(job).runs);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_full_table_refuses_a_job);
+    RUN_TEST(test_invalid_ids_are_ignored);
+    return UNITY_END();
+}
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# --- Alert Trace Generator ---
+# Writes synthetic reading traces in the digest CSV format
+# (time_utc,temperature_c,temperature_f,humidity_pct), one row per minute
+# (or per --rate-s seconds), for replaying through the alert rules on the
+# host:
+#
+#   tools/alert_trace.py hover > hover.csv
+#   .pio/build/native/program --replay-alerts hover.csv --alert-rules "temp>82~1"
+#
+# --filter on the replay compares the alerts with and without the sensor
+# filters; at the sensor's own rate (e.g. --rate-s 1 for 1 mps) 'glitch'
+# shows the false positives they remove and 'heatwave' that real events
+# still get through:
+#
+#   tools/alert_trace.py glitch --rate-s 1 > glitch.csv
+#   .pio/build/native/program --replay-alerts glitch.csv --filter 5:30
+#
+# Scenarios:
+#   hover     temperature wandering around 82 F with sensor noise
+#   heatwave  a slow rise to 86 F over six hours and back
+#   spike     a door left open: +1 F/min for 8 minutes, then recovery
+#   humid     humidity climbing past 70 % for 40 minutes
+#   cold      a night dipping below 40 F
+#   glitch    a steady 78 F with a rare single reading 12 F off (a bus
+#             error or an ESD hit); every alert it raises is a false one
+# Standard library only.
+import argparse
+import datetime
+import math
+import random
+import sys
+
+
+def hover(minute, rng):
+    return 82.0 + 0.6 * math.sin(minute / 17.0) + rng.gauss(0, 0.15), 45.0
+
+
+def heatwave(minute, rng):
+    rise = 8.0 * max(0.0, math.sin(math.pi * minute / 720.0)) if minute < 720 else 0.0
+    return 78.0 + rise + rng.gauss(0, 0.1), 45.0 - rise
+
+
+def spike(minute, rng):
+    if 240 <= minute < 248:
+        extra = minute - 240 + 1
+    elif 248 <= minute < 308:
+        extra = 8.0 * (1 - (minute - 248) / 60.0)
+    else:
+        extra = 0.0
+    return 72.0 + extra + rng.gauss(0, 0.05), 40.0
+
+
+def humid(minute, rng):
+    if 300 <= minute < 340:
+        rh = 74.0
+    elif 280 <= minute < 360:
+        rh = 66.0 + 0.2 * abs(minute - 320)
+    else:
+        rh = 55.0
+    return 70.0, rh + rng.gauss(0, 0.5)
+
+
+def cold(minute, rng):
+    return 45.0 - 8.0 * math.sin(math.pi * minute / 720.0) + rng.gauss(0, 0.1), 60.0
+
+
+def glitch(minute, rng):
+    extra = 12.0 if rng.random() < 0.002 else 0.0
+    return 78.0 + extra + rng.gauss(0, 0.1), 45.0
+
+
+SCENARIOS = {"hover": hover, "heatwave": heatwave, "spike": spike, "humid": humid, "cold": cold, "glitch": glitch}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Synthetic traces for --replay-alerts")
+    parser.add_argument("scenario", choices=sorted(SCENARIOS))
+    parser.add_argument("--hours", type=float, default=12, help="trace length")
+    parser.add_argument("--rate-s", type=float, default=60, help="seconds between readings")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    start = datetime.datetime(2024, 5, 1, tzinfo=datetime.timezone.utc)
+    out = sys.stdout
+    out.write("time_utc,temperature_c,temperature_f,humidity_pct\n")
+    for row in range(int(args.hours * 3600 / args.rate_s)):
+        minute = row * args.rate_s / 60
+        f, rh = SCENARIOS[args.scenario](minute, rng)
+        c = (f - 32) * 5 / 9
+        when = start + datetime.timedelta(minutes=minute)
+        out.write("%s,%.2f,%.2f,%.2f\n" % (when.strftime("%Y-%m-%dT%H:%M:%SZ"), c, f, max(0.0, min(100.0, rh))))
+
+
+if __name__ == "__main__":
+    main()
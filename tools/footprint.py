@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+# --- Flash and RAM Footprint ---
+# What each feature (see include/feature_flags.h) costs in flash and static
+# RAM, from the linker map, and whether the image stays within its budget.
+# Every input section the linker kept is put down to the feature whose
+# library or source file it came from (or whose symbols it holds, for the
+# header-only ArduinoJson); sections loaded into RAM count as flash too,
+# since their initial values are stored there. Static RAM is .data and
+# .bss only: the heap gets what is left (see heap_monitor.h).
+#
+# As a PlatformIO post script (extra_scripts = post:tools/footprint.py) it
+# has the linker write firmware.map, reports after every link and fails the
+# build past the env's custom_flash_budget / custom_ram_budget (bytes, or
+# KiB with a K; 0 or unset for none). Standalone, on any GNU ld map:
+#
+#   tools/footprint.py .pio/build/esp32dev-rs232/firmware.map --flash-budget 1228800
+#   g++ ... -ffunction-sections -fdata-sections -Wl,--gc-sections -Wl,-Map=/tmp/host.map
+#   tools/footprint.py /tmp/host.map
+#
+# The attribution is by file and symbol name, so a feature's cost includes
+# the library code only it pulls in, but not framework code it shares.
+# Standard library only.
+import argparse
+import os
+import re
+import sys
+
+# First match wins: a TLS section used by email counts as "tls", not "email".
+FEATURES = [
+    ("portal", re.compile(r"WiFiManager")),
+    ("email", re.compile(r"ESP[_ -]?Mail[_ -]?Client|smtp_manager|mail_queue|outbox|digest\.cpp")),
+    ("json", re.compile(r"ArduinoJson")),
+    ("tls", re.compile(r"mbedtls|mbedcrypto|mbedx509|esp-tls|WiFiClientSecure")),
+    ("network", re.compile(r"net80211|libpp\.a|libwpa|supplicant|lwip|esp_netif|esp_wifi|libcoexist|libphy|"
+                           r"[/\\]WiFi[/\\]|http_server|http_routes|mqtt_publisher")),
+    ("streaming", re.compile(r"telemetry")),
+    ("modbus", re.compile(r"modbus")),
+    ("app", re.compile(r"[/\\]src[/\\][^/\\]+\.cpp\.o")),
+]
+
+INPUT = re.compile(r"^ (\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+OUTPUT = re.compile(r"^(\.\S+|\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+))?")
+
+
+def classify(section, path):
+    text = section + " " + path
+    for name, pattern in FEATURES:
+        if pattern.search(text):
+            return name
+    return "core"
+
+
+def costs(kind):
+    """(flash, ram) for an output section name: code and constants take
+    flash, initialised data both, zeroed data RAM only."""
+    name = kind.lower()
+    if "noload" in name or "noinit" in name or "bss" in name:
+        return (False, "bss" in name)
+    if "data" in name and "rodata" not in name:
+        return (True, True)
+    return (True, False)
+
+
+def parse(path):
+    """{feature: [flash, ram]} for the sections kept in the map at 'path'."""
+    totals = {}
+    output = None  # (counts flash, counts RAM), None outside allocated sections
+    pending = None  # An input section name on a line of its own
+    started = False
+    with open(path, errors="replace") as lines:
+        for line in lines:
+            line = line.rstrip("\n")
+            if not started:
+                started = line.startswith("Linker script and memory map")
+                continue
+            if not line.strip():
+                continue
+            if not line[0].isspace():
+                match = OUTPUT.match(line)
+                name, address = match.group(1), match.group(2)
+                # Debug and other unallocated sections sit at address 0.
+                output = costs(name) if address is None or int(address, 16) else None
+                pending = None
+                if address is None and not name.startswith("."):
+                    output = None  # LOAD lines, OUTPUT(...) and the like
+                continue
+            if output is None:
+                continue
+            match = INPUT.match(line)
+            if not match:
+                stripped = line.strip()
+                # "name" alone when it is too long for the column.
+                pending = stripped if " " not in stripped and not stripped.startswith("0x") else None
+                continue
+            section = match.group(1) or pending or ""
+            pending = None
+            size = int(match.group(3), 16)
+            if not size or section == "*fill*" or int(match.group(2), 16) == 0:
+                continue
+            entry = totals.setdefault(classify(section, match.group(4)), [0, 0])
+            if output[0]:
+                entry[0] += size
+            if output[1]:
+                entry[1] += size
+    if not started:
+        raise ValueError(f"{path}: no 'Linker script and memory map' section; not a GNU ld map?")
+    return totals
+
+
+def report(totals, flash_budget, ram_budget, label):
+    """Prints the table; returns the number of budgets exceeded."""
+    flash = sum(entry[0] for entry in totals.values())
+    ram = sum(entry[1] for entry in totals.values())
+    print(f"footprint ({label}):")
+    print(f"  {'feature':<10} {'flash':>9} {'RAM':>9}")
+    for name, (f, r) in sorted(totals.items(), key=lambda item: -item[1][0]):
+        print(f"  {name:<10} {f:9d} {r:9d}")
+    print(f"  {'total':<10} {flash:9d} {ram:9d}")
+    over = 0
+    for what, used, budget in (("flash", flash, flash_budget), ("RAM", ram, ram_budget)):
+        if not budget:
+            continue
+        if used > budget:
+            print(f"  {what} over budget: {used} of {budget} bytes ({used - budget} over)")
+            over += 1
+        else:
+            print(f"  {what}: {used} of {budget} bytes ({used * 100 // budget}%, {budget - used} left)")
+    return over
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-feature flash and RAM cost from a GNU ld map file.")
+    parser.add_argument("map", help="linker map (-Wl,-Map=...)")
+    parser.add_argument("--flash-budget", type=int, default=0, help="bytes; exit 1 above it")
+    parser.add_argument("--ram-budget", type=int, default=0, help="static .data + .bss bytes; exit 1 above it")
+    args = parser.parse_args()
+    try:
+        totals = parse(args.map)
+    except (OSError, ValueError) as error:
+        print(f"footprint: {error}", file=sys.stderr)
+        return 2
+    return 1 if report(totals, args.flash_budget, args.ram_budget, os.path.basename(args.map)) else 0
+
+
+def register(env):
+    """Hooks the report onto the firmware link of a PlatformIO env."""
+    env.Append(LINKFLAGS=["-Wl,-Map=${BUILD_DIR}/firmware.map"])
+
+    def budget(option):
+        value = env.GetProjectOption(option, "0").strip().upper()
+        scale = 1024 if value.endswith("K") else 1
+        return int(value.rstrip("K") or 0) * scale
+
+    def check(target, source, env):
+        path = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+        over = report(parse(path), budget("custom_flash_budget"), budget("custom_ram_budget"), env["PIOENV"])
+        return 1 if over else 0
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check)
+
+
+try:
+    Import("env")  # noqa: F821 - defined when PlatformIO runs this as an extra script
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
+else:
+    register(env)  # noqa: F821
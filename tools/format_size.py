@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# --- Reading Formatter Code Size ---
+# What the fixed-point formatter (src/reading_format.cpp) costs in flash,
+# next to the float-to-text machinery behind printf's %f that it replaces
+# on the report paths. The host's static libc pulls printf in regardless,
+# so the comparison is by symbol: the formatter's object file compiled with
+# the given toolchain, and, given a firmware ELF, the sizes of the float
+# conversion routines linked into it.
+#
+#   tools/format_size.py                                   # host g++ -Os
+#   tools/format_size.py --cc xtensa-esp32-elf-g++ --nm xtensa-esp32-elf-nm \
+#       --elf .pio/build/esp32dev/firmware.elf
+#
+# The float routines stay in the image as long as anything still formats a
+# float (the alert rules' %g, the drift in ppm, ...); the number to watch is
+# what a build that drops them would save. Standard library only.
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# newlib's floating point output: the printf core, dtoa and its bignum helpers.
+FLOAT_SYMBOLS = [
+    "_vfprintf_r", "_svfprintf_r", "_vfiprintf_r", "_svfiprintf_r", "_dtoa_r", "_ldtoa_r", "__cvt", "__exponent",
+    "_Balloc", "_Bfree", "__multadd", "__i2b", "__multiply", "__pow5mult", "__lshift", "__mcmp", "__mdiff",
+    "__ulp", "__b2d", "__d2b", "__ratio", "__hi0bits", "__lo0bits", "__mprec_tens", "__mprec_bigtens",
+    "__mprec_tinytens", "_mprec_log10", "frexp", "__fpclassifyd",
+]
+
+
+def symbols(nm, path):
+    """{name: size} of the sized symbols in an object or ELF."""
+    out = subprocess.run([nm, "-S", "-C", "--defined-only", path], check=True, capture_output=True, text=True).stdout
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4 and parts[2].lower() in "tdrb":
+            sizes[parts[3]] = sizes.get(parts[3], 0) + int(parts[1], 16)
+    return sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Code size of the fixed-point formatter vs float printf.")
+    parser.add_argument("--cc", default="g++", help="compiler for src/reading_format.cpp")
+    parser.add_argument("--nm", default="nm")
+    parser.add_argument("--flags", default="-Os -ffunction-sections", help="compiler flags")
+    parser.add_argument("--elf", help="firmware ELF to look for the float printf routines in")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        obj = os.path.join(tmp, "reading_format.o")
+        subprocess.run([args.cc, "-std=gnu++17", *args.flags.split(), "-I", os.path.join(ROOT, "include"), "-c",
+                        os.path.join(ROOT, "src", "reading_format.cpp"), "-o", obj], check=True)
+        formatter = symbols(args.nm, obj)
+    print(f"formatter ({args.cc} {args.flags}):")
+    for name, size in sorted(formatter.items(), key=lambda item: -item[1]):
+        print(f"  {size:7d}  {name}")
+    print(f"  {sum(formatter.values()):7d}  total")
+
+    if args.elf:
+        linked = symbols(args.nm, args.elf)
+        found = [(name, linked[name]) for name in FLOAT_SYMBOLS if name in linked]
+        print(f"float printf routines in {os.path.basename(args.elf)}:")
+        for name, size in sorted(found, key=lambda item: -item[1]):
+            print(f"  {size:7d}  {name}")
+        print(f"  {sum(size for _, size in found):7d}  total ({len(found)} of {len(FLOAT_SYMBOLS)} known routines linked)")
+        inline = [name for name in linked if name.startswith("formatFixed")]
+        if inline:
+            print(f"  formatFixed linked as {', '.join(inline)} ({sum(linked[n] for n in inline)} bytes)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
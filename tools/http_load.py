@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# --- HTTP Endpoint Load Test ---
+# Hammers /metrics and /readings (see include/http_server.h) from several
+# concurrent clients, checks every response (status, chunked framing,
+# Prometheus lines, CSV rows, JSON) and reports throughput and latency
+# percentiles. Point it at the native build on loopback, or at a board.
+# Standard library only.
+#
+#   .pio/build/native/program --bench --http 8080 --realtime 30 --history-days 7 &
+#   tools/http_load.py --port 8080 --clients 3 --requests 200
+import argparse
+import json
+import socket
+import sys
+import threading
+import time
+
+PATHS = ["/metrics", "/readings?since=1h&format=csv", "/readings?since=7d", "/readings?since=6h&format=csv"]
+
+
+def get(host, port, path, timeout):
+    """One request on its own connection. Returns (status, headers, body, seconds)."""
+    start = time.monotonic()
+    with socket.create_connection((host, port), timeout=timeout) as sock:
+        sock.sendall(f"GET {path} HTTP/1.1\r\nHost: {host}\r\n\r\n".encode())
+        data = bytearray()
+        while True:
+            block = sock.recv(65536)
+            if not block:
+                break
+            data += block
+    elapsed = time.monotonic() - start
+    head, _, rest = bytes(data).partition(b"\r\n\r\n")
+    lines = head.decode("latin-1").split("\r\n")
+    status = int(lines[0].split()[1])
+    headers = {k.lower(): v.strip() for k, _, v in (line.partition(":") for line in lines[1:])}
+    if headers.get("transfer-encoding") == "chunked":
+        body = bytearray()
+        while True:
+            size_line, _, rest = rest.partition(b"\r\n")
+            size = int(size_line, 16)
+            if size == 0:
+                break
+            body += rest[:size]
+            if rest[size:size + 2] != b"\r\n":
+                raise ValueError("bad chunk framing")
+            rest = rest[size + 2:]
+        return status, headers, bytes(body), elapsed
+    return status, headers, rest, elapsed
+
+
+def check(path, status, headers, body):
+    """Returns the number of records in the response; raises on anything malformed."""
+    if status != 200:
+        raise ValueError(f"{path}: HTTP {status}")
+    text = body.decode()
+    if path.startswith("/metrics"):
+        samples = [line for line in text.splitlines() if line and not line.startswith("#")]
+        for line in samples:
+            float(line.rsplit(" ", 1)[1])
+        return len(samples)
+    if "format=csv" in path:
+        rows = text.splitlines()
+        if rows[0] != "time_utc,temperature_c,temperature_f,humidity_pct":
+            raise ValueError(f"{path}: bad CSV header")
+        for row in rows[1:]:
+            if len(row.split(",")) != 4:
+                raise ValueError(f"{path}: bad CSV row {row!r}")
+        return len(rows) - 1
+    return len(json.loads(text)["readings"])
+
+
+def worker(args, results, errors, lock):
+    for i in range(args.requests):
+        path = PATHS[i % len(PATHS)]
+        try:
+            status, headers, body, elapsed = get(args.host, args.port, path, args.timeout)
+            records = check(path, status, headers, body)
+            with lock:
+                results.setdefault(path, []).append((elapsed, len(body), records))
+        except Exception as error:  # Report and carry on
+            with lock:
+                errors.append(f"{path}: {error}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load-test the HTTP metrics/readings endpoint.")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--clients", type=int, default=3, help="concurrent connections")
+    parser.add_argument("--requests", type=int, default=100, help="requests per client")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    args = parser.parse_args()
+
+    results, errors, lock = {}, [], threading.Lock()
+    threads = [threading.Thread(target=worker, args=(args, results, errors, lock)) for _ in range(args.clients)]
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    wall = time.monotonic() - start
+
+    total = sum(len(samples) for samples in results.values())
+    total_bytes = sum(size for samples in results.values() for _, size, _ in samples)
+    print(f"{total} responses in {wall:.2f} s: {total / wall:.1f} req/s, {total_bytes / wall / 1024:.0f} KiB/s, "
+          f"{len(errors)} errors")
+    for path, samples in sorted(results.items()):
+        times = sorted(elapsed * 1000 for elapsed, _, _ in samples)
+        size = sum(s for _, s, _ in samples) / len(samples)
+        records = samples[-1][2]
+        print(f"{path:34} n {len(samples):4}  {size / 1024:7.1f} KiB  {records:6} records  "
+              f"ms p50 {times[len(times) // 2]:7.2f}  p95 {times[len(times) * 95 // 100]:7.2f}  max {times[-1]:7.2f}")
+    for error in errors[:10]:
+        print("error:", error, file=sys.stderr)
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
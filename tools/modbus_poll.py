@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+# --- Modbus RTU Poller ---
+# A minimal Modbus RTU master for the slave on the RS-232 port (see
+# include/modbus_slave.h and the register map in include/modbus_registers.h).
+# Prints the readings and settings once, or with --bench polls back-to-back
+# the way a SCADA master does (every input register, then every holding
+# register, in one frame each), checks every response and reports polls per
+# second and response latency. --write-check also writes a setting, reads it
+# back and restores it. Standard library only.
+#
+#   .pio/build/native/program --rs232-pty --modbus 1:115200 --realtime 30 &
+#   tools/modbus_poll.py /dev/pts/3 --baud 115200 --bench 20 --write-check
+import argparse
+import os
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+
+INPUT_REGISTERS = 96
+HOLDING_REGISTERS = 56
+CHANNELS = 4
+CHANNEL_BASE = 32
+CHANNEL_SIZE = 16
+RULE_BASE = 16
+RULE_SIZE = 5
+RULE_NONE = 0xFFFF
+SETTINGS = ["digest_hours", "duty_s", "sensor_mps", "filter_median", "filter_ema_pct", "heater_rh"]
+HEATER_RH = 8  # Holding register the write check uses
+
+BAUDS = {
+    1200: termios.B1200,
+    2400: termios.B2400,
+    4800: termios.B4800,
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+}
+
+EXCEPTIONS = {1: "illegal function", 2: "illegal address", 3: "illegal value", 4: "device failure"}
+
+
+class ModbusError(Exception):
+    pass
+
+
+def crc16(data):
+    """CRC-16/MODBUS, as in src/modbus_slave.cpp."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def frame_gap(baud):
+    """t3.5 in seconds."""
+    return 0.00175 if baud > 19200 else 38.5 / baud
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        speed = BAUDS.get(baud)
+        if speed is not None:
+            attrs = termios.tcgetattr(fd)
+            attrs[4] = attrs[5] = speed
+            termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+class Master:
+    def __init__(self, fd, unit, baud, timeout):
+        self.fd = fd
+        self.unit = unit
+        self.gap = frame_gap(baud)
+        self.timeout = timeout
+        self.last_reply = 0.0
+        self.latencies = []
+        self.timeouts = 0
+        self.crc_errors = 0
+
+    def transact(self, pdu, reply_length):
+        """Sends one request; returns the reply PDU. 'reply_length' is the
+        whole reply frame when it is not an exception."""
+        frame = bytes([self.unit]) + pdu
+        frame += struct.pack("<H", crc16(frame))
+        # The line must have been quiet for t3.5 since the last reply.
+        wait = self.last_reply + self.gap - time.monotonic()
+        if wait > 0:
+            time.sleep(wait)
+        os.write(self.fd, frame)
+        sent = time.monotonic()
+        reply = bytearray()
+        deadline = sent + self.timeout
+        while True:
+            expected = 5 if len(reply) >= 2 and reply[1] & 0x80 else reply_length
+            if len(reply) >= expected:
+                break
+            left = deadline - time.monotonic()
+            if left <= 0:
+                self.timeouts += 1
+                raise ModbusError("timeout (%d of %d bytes)" % (len(reply), expected))
+            ready, _, _ = select.select([self.fd], [], [], left)
+            if ready:
+                reply += os.read(self.fd, 512)
+        self.last_reply = time.monotonic()
+        self.latencies.append(self.last_reply - sent)
+        reply = bytes(reply)
+        if len(reply) != expected or crc16(reply[:-2]) != struct.unpack("<H", reply[-2:])[0]:
+            self.crc_errors += 1
+            raise ModbusError("bad CRC or length (%d bytes)" % len(reply))
+        if reply[0] != self.unit or reply[1] & 0x7F != pdu[0]:
+            raise ModbusError("reply for unit %d function 0x%02X" % (reply[0], reply[1]))
+        if reply[1] & 0x80:
+            raise ModbusError("exception %d (%s)" % (reply[2], EXCEPTIONS.get(reply[2], "?")))
+        return reply[1:-2]
+
+    def read(self, function, first, count):
+        pdu = self.transact(struct.pack(">BHH", function, first, count), 5 + 2 * count)
+        if pdu[1] != 2 * count:
+            raise ModbusError("byte count %d for %d registers" % (pdu[1], count))
+        return list(struct.unpack(">%dH" % count, pdu[2:]))
+
+    def write(self, first, values):
+        if len(values) == 1:
+            pdu = struct.pack(">BHH", 0x06, first, values[0])
+        else:
+            pdu = struct.pack(">BHHB%dH" % len(values), 0x10, first, len(values), 2 * len(values), *values)
+        self.transact(pdu, 8)
+
+
+def signed(value):
+    return value - 0x10000 if value & 0x8000 else value
+
+
+def u32(registers, at):
+    return registers[at] << 16 | registers[at + 1]
+
+
+def show(inputs, holding):
+    quality = {0: "unsynced", 1: "synced", 2: "holdover"}.get(inputs[6], "?")
+    print("sensors 0x%X  uptime %d s  time %d (%s)  heap %d KiB" % (inputs[0], u32(inputs, 2), u32(inputs, 4),
+                                                                   quality, inputs[7]))
+    print("passes %d  sensor failures %d  alerts raised %d cleared %d  log records %d  modbus requests %d crc errors %d"
+          % (u32(inputs, 8), u32(inputs, 10), u32(inputs, 12), u32(inputs, 14), u32(inputs, 16),
+             u32(inputs, 18), u32(inputs, 20)))
+    for channel in range(CHANNELS):
+        r = inputs[CHANNEL_BASE + channel * CHANNEL_SIZE:][:CHANNEL_SIZE]
+        if not r[0]:
+            continue
+        reading = "no reading" if r[1] == 0x8000 else "%.2f C %.2f %%RH, %d s old" % (signed(r[1]) / 100,
+                                                                                 r[2] / 100, r[3])
+        day = "" if r[4] == 0x8000 else "  24 h %.2f..%.2f C %.2f..%.2f %%RH" % (
+            signed(r[4]) / 100, signed(r[5]) / 100, r[6] / 100, r[7] / 100)
+        print("ch%d: %s%s  alerts active 0x%02X pending 0x%02X  failures %d" % (channel, reading, day, r[8], r[9],
+                                                                                u32(r, 10)))
+    if holding[0] == 0xFFFF:
+        print("report: not a 'M H,H * * *' schedule")
+    else:
+        hours = u32(holding, 1)
+        print("report: minute %d of hours %s" % (holding[0], ",".join(str(h) for h in range(24) if hours >> h & 1)))
+    print("  ".join("%s %d" % (name, holding[3 + i]) for i, name in enumerate(SETTINGS)))
+    for rule in range(inputs[1]):
+        r = holding[RULE_BASE + rule * RULE_SIZE:][:RULE_SIZE]
+        if r[0] == RULE_NONE:
+            continue
+        print("rule %d: %s%s %s %g ~%g @%ds" % (rule + 1, "d" if r[0] & 2 else "", "rh" if r[0] & 1 else "temp",
+                                               ">" if r[0] & 4 else "<", signed(r[1]) / 100, r[2] / 100,
+                                               u32(r, 3)))
+
+
+def write_check(master):
+    """Writes heater_rh one up (0x06), reads it back and restores it (0x10)."""
+    (old,) = master.read(0x03, HEATER_RH, 1)
+    new = old + 1 if old < 100 else old - 1
+    master.write(HEATER_RH, [new])
+    (back,) = master.read(0x03, HEATER_RH, 1)
+    (ema,) = master.read(0x03, HEATER_RH - 1, 1)
+    master.write(HEATER_RH - 1, [ema, old])  # filter_ema_pct unchanged
+    (restored,) = master.read(0x03, HEATER_RH, 1)
+    if back != new or restored != old:
+        raise ModbusError("write check: wrote %d, read %d, restored %d (was %d)" % (new, back, restored, old))
+    print("write check: heater_rh %d -> %d -> %d ok" % (old, new, restored))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Poll the Modbus RTU slave on the RS-232 port.")
+    parser.add_argument("port", help="serial device or pty")
+    parser.add_argument("--baud", type=int, default=19200)
+    parser.add_argument("--unit", type=int, default=1)
+    parser.add_argument("--timeout", type=float, default=1.0, help="seconds to wait for a reply")
+    parser.add_argument("--bench", type=float, metavar="SECONDS", help="poll back-to-back and report")
+    parser.add_argument("--write-check", action="store_true", help="write a setting, read it back, restore it")
+    args = parser.parse_args()
+
+    master = Master(open_port(args.port, args.baud), args.unit, args.baud, args.timeout)
+    try:
+        if args.write_check:
+            write_check(master)
+        if not args.bench:
+            show(master.read(0x04, 0, INPUT_REGISTERS), master.read(0x03, 0, HOLDING_REGISTERS))
+            return 0
+    except ModbusError as error:
+        print("modbus: %s" % error, file=sys.stderr)
+        return 1
+
+    master.latencies.clear()
+    polls = errors = registers = 0
+    start = time.monotonic()
+    while time.monotonic() - start < args.bench:
+        try:
+            registers += len(master.read(0x04, 0, INPUT_REGISTERS))
+            registers += len(master.read(0x03, 0, HOLDING_REGISTERS))
+            polls += 1
+        except ModbusError as error:
+            errors += 1
+            if errors <= 5:
+                print("modbus: %s" % error, file=sys.stderr)
+    elapsed = time.monotonic() - start
+    latencies = sorted(master.latencies)
+    print("polls: %d in %.1f s (%.1f polls/s, %.0f requests/s, %.0f registers/s)"
+          % (polls, elapsed, polls / elapsed, len(latencies) / elapsed, registers / elapsed))
+    if latencies:
+        def pick(percent):
+            return latencies[min(len(latencies) - 1, len(latencies) * percent // 100)] * 1000
+
+        print("response ms: p50 %.2f  p99 %.2f  max %.2f  (t3.5 is %.2f)" % (pick(50), pick(99), latencies[-1] * 1000,
+                                                                           master.gap * 1000))
+    print("errors: %d  timeouts: %d  bad CRC: %d" % (errors, master.timeouts, master.crc_errors))
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+# --- MQTT Broker Stand-in ---
+# Just enough of an MQTT 3.1.1 broker to take the publisher's batches (see
+# include/mqtt_publisher.h) when there is no mosquitto to hand: answers
+# CONNECT, PUBLISH (QoS 1) and PINGREQ, decodes every batch, checks it and
+# counts messages, samples and duplicates. Standard library only.
+#
+#   tools/mqtt_sink.py --port 1883 &
+#   .pio/build/native/program --bench --mqtt 127.0.0.1:1883 --mqtt-bench 2000
+#
+# --delay-ms holds each PUBACK back to mimic a broker across a network;
+# --print shows every batch.
+import argparse
+import json
+import socket
+import sys
+import threading
+import time
+
+stats = {"connects": 0, "messages": 0, "samples": 0, "duplicates": 0, "bytes": 0}
+seen_t0 = set()
+lock = threading.Lock()
+
+
+def read_exact(conn, n):
+    data = bytearray()
+    while len(data) < n:
+        block = conn.recv(n - len(data))
+        if not block:
+            raise ConnectionError("closed")
+        data += block
+    return bytes(data)
+
+
+def read_packet(conn):
+    first = read_exact(conn, 1)[0]
+    length, shift = 0, 0
+    while True:
+        digit = read_exact(conn, 1)[0]
+        length |= (digit & 0x7F) << shift
+        shift += 7
+        if not digit & 0x80:
+            break
+    return first, read_exact(conn, length)
+
+
+def check_batch(batch):
+    """Returns the sample count; raises on a malformed batch."""
+    n = len(batch["dt"])
+    channels = batch.get("ch", [0] * n)  # Absent before multi-sensor firmware
+    if n == 0 or len(batch["c"]) != n or len(batch["rh"]) != n or len(channels) != n or batch["dt"][0] != 0:
+        raise ValueError(f"bad batch {batch}")
+    return n
+
+
+def serve(conn, args):
+    with conn:
+        while True:
+            try:
+                first, body = read_packet(conn)
+            except (ConnectionError, OSError):
+                return
+            kind = first >> 4
+            if kind == 1:  # CONNECT
+                with lock:
+                    stats["connects"] += 1
+                conn.sendall(b"\x20\x02\x00\x00")
+            elif kind == 3:  # PUBLISH
+                qos = (first >> 1) & 3
+                topic_len = int.from_bytes(body[:2], "big")
+                offset = 2 + topic_len
+                packet_id = body[offset:offset + 2] if qos else b""
+                payload = json.loads(body[offset + len(packet_id):])
+                samples = check_batch(payload)
+                with lock:
+                    duplicate = payload["t0"] in seen_t0
+                    seen_t0.add(payload["t0"])
+                    stats["messages"] += 1
+                    stats["samples"] += samples
+                    stats["duplicates"] += duplicate
+                    stats["bytes"] += len(body) + 2
+                if args.print:
+                    print(f"{body[2:offset].decode()} t0={payload['t0']} n={samples}"
+                          f"{' dup' if first & 0x08 else ''}{' seen' if duplicate else ''}", flush=True)
+                if qos:
+                    if args.delay_ms:
+                        time.sleep(args.delay_ms / 1000)
+                    conn.sendall(b"\x40\x02" + packet_id)
+            elif kind == 12:  # PINGREQ
+                conn.sendall(b"\xd0\x00")
+            elif kind == 14:  # DISCONNECT
+                return
+
+
+def report():
+    with lock:
+        print(f"connects {stats['connects']}  messages {stats['messages']}  samples {stats['samples']}  "
+              f"duplicates {stats['duplicates']}  bytes {stats['bytes']}", flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Minimal MQTT broker that counts telemetry batches.")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--delay-ms", type=float, default=0, help="hold each PUBACK back this long")
+    parser.add_argument("--print", action="store_true", help="print every batch")
+    parser.add_argument("--report-s", type=float, default=5, help="print totals this often")
+    args = parser.parse_args()
+
+    server = socket.create_server((args.host, args.port), reuse_port=False)
+    server.settimeout(args.report_s)
+    print(f"listening on {args.host}:{args.port}", flush=True)
+    last = (0, 0)
+    try:
+        while True:
+            try:
+                conn, _ = server.accept()
+                conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                threading.Thread(target=serve, args=(conn, args), daemon=True).start()
+            except socket.timeout:
+                pass
+            with lock:
+                current = (stats["messages"], stats["connects"])
+            if current != last:
+                report()
+                last = current
+    except KeyboardInterrupt:
+        report()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# --- Telemetry Stream Decoder ---
+# Reads the binary telemetry frames described in include/telemetry.h from a
+# serial device (or a file) and prints them as CSV, or with --bench reports
+# throughput and loss. Standard library only.
+#
+#   tools/telemetry_decode.py /dev/ttyUSB0 --baud 115200
+#   tools/telemetry_decode.py /dev/pts/3 --bench 10
+import argparse
+import os
+import struct
+import sys
+import termios
+import time
+import tty
+
+SYNC = b"\xa5\x5a"
+FRAME_BYTES = 20
+TYPE_READING = 0x01
+
+BAUDS = {
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+    230400: termios.B230400,
+    460800: getattr(termios, "B460800", None),
+    921600: getattr(termios, "B921600", None),
+}
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, as in src/crc16.cpp."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        speed = BAUDS.get(baud)
+        if speed is not None:
+            attrs = termios.tcgetattr(fd)
+            attrs[4] = attrs[5] = speed
+            termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+class Decoder:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.frames = 0
+        self.crc_errors = 0
+        self.resyncs = 0
+        self.lost = 0
+        self.last_seq = None
+
+    def feed(self, data):
+        """Yields (seq, uptime_ms, epoch, channel, temp_c, rh) for each good frame."""
+        self.buffer += data
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # Keep a trailing 0xA5 that may be the first half of a sync word.
+                keep = 1 if self.buffer[-1:] == SYNC[:1] else 0
+                if len(self.buffer) > keep:
+                    self.resyncs += 1
+                del self.buffer[: len(self.buffer) - keep]
+                return
+            if start:
+                self.resyncs += 1
+                del self.buffer[:start]
+            if len(self.buffer) < FRAME_BYTES:
+                return
+            frame = bytes(self.buffer[:FRAME_BYTES])
+            (crc,) = struct.unpack_from("<H", frame, 18)
+            if frame[2] != TYPE_READING or frame[3] != FRAME_BYTES - 6 or crc16(frame[2:18]) != crc:
+                # Bad frame or a false sync inside the payload: skip one byte.
+                self.crc_errors += 1
+                del self.buffer[:1]
+                continue
+            del self.buffer[:FRAME_BYTES]
+            seq, uptime, epoch, centi_c, centi_rh = struct.unpack_from("<HIIhH", frame, 4)
+            if self.last_seq is not None:
+                self.lost += (seq - self.last_seq - 1) & 0xFFFF
+            self.last_seq = seq
+            self.frames += 1
+            # The channel rides in the two bits humidity never needs.
+            yield seq, uptime, epoch, centi_rh >> 14, centi_c / 100.0, (centi_rh & 0x3FFF) / 100.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode binary telemetry frames.")
+    parser.add_argument("port", help="serial device, pty or capture file")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--bench", type=float, metavar="SECONDS",
+                        help="report throughput and loss instead of printing frames")
+    args = parser.parse_args()
+
+    fd = open_port(args.port, args.baud)
+    decoder = Decoder()
+    received = 0
+    start = time.monotonic()
+    if not args.bench:
+        print("seq,uptime_ms,epoch,channel,temperature_c,humidity_pct")
+    try:
+        while not args.bench or time.monotonic() - start < args.bench:
+            data = os.read(fd, 4096)
+            if not data:
+                if not os.isatty(fd):
+                    break  # End of a capture file
+                continue
+            received += len(data)
+            for frame in decoder.feed(data):
+                if not args.bench:
+                    print("%d,%d,%d,%d,%.2f,%.2f" % frame)
+            if not args.bench:
+                sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    elapsed = max(time.monotonic() - start, 1e-9)
+
+    if args.bench:
+        expected = decoder.frames + decoder.lost
+        print("frames: %d in %.1f s (%.1f frames/s)" % (decoder.frames, elapsed, decoder.frames / elapsed))
+        print("bytes: %d (%.0f bytes/s)" % (received, received / elapsed))
+        print("lost (sequence gaps): %d (%.3f%%)" % (decoder.lost, 100.0 * decoder.lost / expected if expected else 0))
+        print("crc errors: %d  resyncs: %d" % (decoder.crc_errors, decoder.resyncs))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())